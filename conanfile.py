@@ -38,6 +38,7 @@ class GeoWorldConan(ConanFile):
     def requirements(self):
         self.requires("qt/6.8.3")
         self.requires("qt-advanced-docking-system/4.3.1")
+        self.requires("zlib/1.3.1")
     
     def generate(self):
         deps = CMakeDeps(self)
@@ -118,6 +118,7 @@
             git
 
             # System libraries
+            zlib
             xorg.libX11
             xorg.libXext
             xorg.libXrender
@@ -225,6 +226,7 @@
             qt-advanced-docking-system
 
             # System libraries
+            zlib
             xorg.libX11
             xorg.libXext
             xorg.libXrender
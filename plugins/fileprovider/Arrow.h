@@ -0,0 +1,152 @@
+#pragma once
+
+#include <QtGlobal>
+
+// Layout of the Arrow IPC file format (https://arrow.apache.org/docs/format/
+// Columnar.html) shared by the reader and the writer. A file is the magic
+// bytes, a stream of size-prefixed FlatBuffers messages each followed by
+// its body of column buffers, and a FlatBuffers footer locating the schema
+// and the record batches. The field enums are the vtable slots of the
+// schema tables; union fields take two slots, the type code and the value.
+class Arrow
+{
+public:
+    static constexpr char Magic[6] = {'A', 'R', 'R', 'O', 'W', '1'};
+    // Marks an encapsulated message; the end of the stream is this followed
+    // by a zero length
+    static constexpr quint32 Continuation = 0xffffffff;
+    // Buffers in a message body start on this boundary
+    static constexpr qint64 Alignment = 8;
+    
+    enum MetadataVersion : qint16 {
+        V4 = 3,
+        V5 = 4
+    };
+    
+    enum Type : quint8 {
+        NoType,
+        Null,
+        Int,
+        FloatingPoint,
+        Binary,
+        Utf8,
+        Bool,
+        Decimal,
+        Date,
+        Time,
+        Timestamp,
+        Interval,
+        List,
+        Struct,
+        Union,
+        FixedSizeBinary,
+        FixedSizeList,
+        Map,
+        Duration,
+        LargeBinary,
+        LargeUtf8,
+        LargeList,
+        RunEndEncoded,
+        BinaryView,
+        Utf8View,
+        ListView,
+        LargeListView
+    };
+    
+    enum Precision : qint16 {
+        Half,
+        Single,
+        DoublePrecision
+    };
+    
+    enum DateUnit : qint16 {
+        Day,
+        DateMillisecond
+    };
+    
+    enum TimeUnit : qint16 {
+        Second,
+        Millisecond,
+        Microsecond,
+        Nanosecond
+    };
+    
+    enum MessageHeader : quint8 {
+        NoHeader,
+        SchemaHeader,
+        DictionaryBatchHeader,
+        RecordBatchHeader
+    };
+    
+    enum FooterField {
+        FooterVersion,
+        FooterSchema,
+        FooterDictionaries,
+        FooterRecordBatches
+    };
+    
+    enum SchemaField {
+        SchemaEndianness,
+        SchemaFields
+    };
+    
+    enum FieldField {
+        FieldName,
+        FieldNullable,
+        FieldTypeType,
+        FieldType,
+        FieldDictionary,
+        FieldChildren,
+        FieldCustomMetadata
+    };
+    
+    enum KeyValueField {
+        KeyValueKey,
+        KeyValueValue
+    };
+    
+    enum DictionaryEncodingField {
+        DictionaryId,
+        DictionaryIndexType
+    };
+    
+    enum MessageField {
+        MessageVersion,
+        MessageHeaderType,
+        MessageHeaderField,
+        MessageBodyLength
+    };
+    
+    enum RecordBatchField {
+        RecordBatchLength,
+        RecordBatchNodes,
+        RecordBatchBuffers,
+        RecordBatchCompression
+    };
+    
+    enum DictionaryBatchField {
+        DictionaryBatchId,
+        DictionaryBatchData,
+        DictionaryBatchIsDelta
+    };
+    
+    // Fields of the Int, FloatingPoint, FixedSizeList, Date, Timestamp
+    // and Union type tables
+    enum TypeField {
+        IntBitWidth = 0,
+        IntIsSigned = 1,
+        FloatingPointPrecision = 0,
+        FixedSizeListSize = 0,
+        DateUnitField = 0,
+        TimestampUnit = 0,
+        TimestampTimezone = 1,
+        UnionMode = 0
+    };
+    
+    // Footer block: message offset, metadata length, padding, body length
+    static const qsizetype BlockSize = 24;
+    // Record batch field node: length and null count
+    static const qsizetype FieldNodeSize = 16;
+    // Record batch buffer: offset into the body and length
+    static const qsizetype BufferSize = 16;
+};
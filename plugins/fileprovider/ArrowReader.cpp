@@ -0,0 +1,1127 @@
+#include "ArrowReader.h"
+#include "Arrow.h"
+#include "WkbReader.h"
+#include "WktReader.h"
+#include <QDate>
+#include <QDateTime>
+#include <QFuture>
+#include <QThread>
+#include <QThreadPool>
+#include <QTimeZone>
+#include <QtConcurrentRun>
+#include <QtEndian>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+namespace {
+
+// Runs of batches parsed per thread hold at least this many rows
+const qint64 MinChunkRows = 65536;
+const qsizetype ChunksPerThread = 4;
+// Nested fields deeper than this are rejected; guards against offset cycles
+const int MaxFieldDepth = 32;
+
+const qint64 MillisecondsPerDay = 86400000;
+
+struct ChunkResult {
+    FeatureStore store;
+    bool ok = false;
+    QString error;
+    std::atomic<bool> done{false};
+};
+
+// GeoArrow native encodings and the list levels above their coordinates
+const struct {
+    const char* name;
+    FeatureStore::GeometryType type;
+    int levels;
+} NativeEncodings[] = {
+    {"geoarrow.point", FeatureStore::Point, 0},
+    {"geoarrow.linestring", FeatureStore::LineString, 1},
+    {"geoarrow.polygon", FeatureStore::Polygon, 2},
+    {"geoarrow.multipoint", FeatureStore::MultiPoint, 1},
+    {"geoarrow.multilinestring", FeatureStore::MultiLineString, 2},
+    {"geoarrow.multipolygon", FeatureStore::MultiPolygon, 3}
+};
+
+template<typename T>
+T readLE(const char* data)
+{
+    return qFromLittleEndian<T>(data);
+}
+
+bool isValid(const char* validity, qint64 row)
+{
+    return !validity || (quint8(validity[row >> 3]) >> (row & 7)) & 1;
+}
+
+qint64 offsetAt(const char* offsets, bool large, qint64 index)
+{
+    return large ? readLE<qint64>(offsets + index * 8) : readLE<qint32>(offsets + index * 4);
+}
+
+// Buffers an array of the type takes up in a record batch, not counting
+// its children; -1 for the layouts that are not supported
+int bufferCount(quint8 type, qint16 unionMode)
+{
+    switch (type) {
+    case Arrow::Null:
+    case Arrow::RunEndEncoded:
+        return 0;
+    case Arrow::Struct:
+    case Arrow::FixedSizeList:
+        return 1;
+    case Arrow::Int:
+    case Arrow::FloatingPoint:
+    case Arrow::Bool:
+    case Arrow::Decimal:
+    case Arrow::Date:
+    case Arrow::Time:
+    case Arrow::Timestamp:
+    case Arrow::Interval:
+    case Arrow::Duration:
+    case Arrow::FixedSizeBinary:
+    case Arrow::List:
+    case Arrow::LargeList:
+    case Arrow::Map:
+        return 2;
+    case Arrow::Binary:
+    case Arrow::Utf8:
+    case Arrow::LargeBinary:
+    case Arrow::LargeUtf8:
+        return 3;
+    case Arrow::Union:
+        // Type ids, plus offsets for dense unions
+        return unionMode == 0 ? 1 : 2;
+    default:
+        break;
+    }
+    return -1;
+}
+
+bool isDoubleField(quint8 type, qint16 precision)
+{
+    return type == Arrow::FloatingPoint && precision == Arrow::DoublePrecision;
+}
+
+qint64 floorDivide(qint64 value, qint64 divisor)
+{
+    qint64 quotient = value / divisor;
+    return quotient * divisor > value ? quotient - 1 : quotient;
+}
+
+} // namespace
+
+ArrowReader::ArrowReader(const char* data, qsizetype size)
+    : m_data(data)
+    , m_size(size)
+    , m_threads(1)
+    , m_headerRead(false)
+    , m_nodeCount(0)
+    , m_bufferCount(0)
+    , m_geometryField(-1)
+    , m_geometryType(FeatureStore::NoGeometry)
+    , m_geometryLevels(0)
+    , m_rowCount(0)
+    , m_cancelled(false)
+{
+}
+
+int ArrowReader::threadCount() const
+{
+    return m_threads > 0 ? m_threads : QThread::idealThreadCount();
+}
+
+QStringList ArrowReader::fieldNames() const
+{
+    QStringList names;
+    for (int index : m_properties) {
+        names.append(m_fields[index].name);
+    }
+    return names;
+}
+
+QString ArrowReader::geometryEncoding() const
+{
+    return m_geometryField >= 0 ? m_fields[m_geometryField].extension : QString();
+}
+
+bool ArrowReader::readHeader()
+{
+    if (m_headerRead) {
+        return true;
+    }
+    
+    // The magic bytes are padded to 8 at the start and followed by the
+    // footer length at the end
+    const qsizetype magicSize = sizeof(Arrow::Magic);
+    if (m_size < 2 * Arrow::Alignment + 4 || std::memcmp(m_data, Arrow::Magic, magicSize) != 0
+        || std::memcmp(m_data + m_size - magicSize, Arrow::Magic, magicSize) != 0) {
+        m_error = "Not an Arrow IPC file";
+        return false;
+    }
+    qint32 footerSize = readLE<qint32>(m_data + m_size - magicSize - 4);
+    if (footerSize < 0 || footerSize > m_size - magicSize - 4 - Arrow::Alignment) {
+        m_error = "Truncated footer";
+        return false;
+    }
+    
+    const char* footerData = m_data + m_size - magicSize - 4 - footerSize;
+    FlatBufferTable footer = FlatBufferTable::root(footerData, footerSize);
+    FlatBufferTable schema = footer.table(Arrow::FooterSchema);
+    if (!footer.isValid() || !schema.isValid()) {
+        m_error = "Malformed footer";
+        return false;
+    }
+    if (footer.scalar<qint16>(Arrow::FooterVersion, 0) < Arrow::V4) {
+        m_error = "Unsupported Arrow format version";
+        return false;
+    }
+    if (schema.scalar<qint16>(Arrow::SchemaEndianness, 0) != 0) {
+        m_error = "Big-endian Arrow files are not supported";
+        return false;
+    }
+    
+    m_fields.clear();
+    m_topFields.clear();
+    qsizetype fieldCount = 0;
+    const char* fields = schema.vector(Arrow::SchemaFields, 4, fieldCount);
+    for (qsizetype i = 0; i < fieldCount; ++i) {
+        int index = readField(schema.tableAt(fields, i), 0);
+        if (index < 0) {
+            return false;
+        }
+        m_topFields.append(index);
+    }
+    
+    m_nodeCount = 0;
+    m_bufferCount = 0;
+    for (int index : m_topFields) {
+        if (!assignLayout(index, m_nodeCount, m_bufferCount)) {
+            return false;
+        }
+    }
+    if (!findGeometry()) {
+        return false;
+    }
+    
+    m_properties.clear();
+    for (int index : m_topFields) {
+        if (index != m_geometryField && isProperty(m_fields[index])) {
+            m_properties.append(index);
+        }
+    }
+    
+    m_batches.clear();
+    m_rowCount = 0;
+    qsizetype batchCount = 0;
+    const char* blocks = footer.vector(Arrow::FooterRecordBatches, Arrow::BlockSize, batchCount);
+    for (qsizetype i = 0; i < batchCount; ++i) {
+        Batch batch;
+        FlatBufferTable header;
+        if (!readMessage(blocks + i * Arrow::BlockSize, Arrow::RecordBatchHeader, batch, header)
+            || !readBatchHeader(header, batch)) {
+            return false;
+        }
+        m_batches.append(batch);
+        m_rowCount += batch.length;
+    }
+    
+    qsizetype dictionaryCount = 0;
+    const char* dictionaries = footer.vector(Arrow::FooterDictionaries, Arrow::BlockSize, dictionaryCount);
+    if (!readDictionaries(dictionaries, dictionaryCount)) {
+        return false;
+    }
+    
+    m_headerRead = true;
+    return true;
+}
+
+// Adds a field and its children to m_fields and returns its index
+int ArrowReader::readField(const FlatBufferTable& table, int depth)
+{
+    if (!table.isValid() || depth > MaxFieldDepth) {
+        m_error = "Malformed schema";
+        return -1;
+    }
+    
+    Field field;
+    field.name = table.string(Arrow::FieldName);
+    field.type = table.scalar<quint8>(Arrow::FieldTypeType, Arrow::NoType);
+    FlatBufferTable type = table.table(Arrow::FieldType);
+    switch (field.type) {
+    case Arrow::Int:
+        field.bitWidth = type.scalar<qint32>(Arrow::IntBitWidth, 0);
+        field.isSigned = type.scalar<quint8>(Arrow::IntIsSigned, 0) != 0;
+        break;
+    case Arrow::FloatingPoint:
+        field.unit = type.scalar<qint16>(Arrow::FloatingPointPrecision, Arrow::Half);
+        break;
+    case Arrow::FixedSizeList:
+        field.listSize = type.scalar<qint32>(Arrow::FixedSizeListSize, 0);
+        break;
+    case Arrow::Date:
+        field.unit = type.scalar<qint16>(Arrow::DateUnitField, Arrow::DateMillisecond);
+        break;
+    case Arrow::Timestamp:
+        field.unit = type.scalar<qint16>(Arrow::TimestampUnit, Arrow::Second);
+        field.hasTimezone = !type.string(Arrow::TimestampTimezone).isEmpty();
+        break;
+    case Arrow::Union:
+        field.unit = type.scalar<qint16>(Arrow::UnionMode, 0);
+        break;
+    default:
+        break;
+    }
+    
+    // Dictionary-encoded columns hold indices of the integer type given here
+    FlatBufferTable dictionary = table.table(Arrow::FieldDictionary);
+    if (dictionary.isValid()) {
+        field.dictionary = dictionary.scalar<qint64>(Arrow::DictionaryId, 0);
+        FlatBufferTable indexType = dictionary.table(Arrow::DictionaryIndexType);
+        field.bitWidth = indexType.scalar<qint32>(Arrow::IntBitWidth, 32);
+        field.isSigned = indexType.scalar<quint8>(Arrow::IntIsSigned, 1) != 0;
+    }
+    
+    qsizetype metadataCount = 0;
+    const char* metadata = table.vector(Arrow::FieldCustomMetadata, 4, metadataCount);
+    for (qsizetype i = 0; i < metadataCount; ++i) {
+        FlatBufferTable entry = table.tableAt(metadata, i);
+        if (entry.string(Arrow::KeyValueKey) == "ARROW:extension:name") {
+            field.extension = entry.string(Arrow::KeyValueValue);
+        }
+    }
+    
+    qsizetype childCount = 0;
+    const char* children = table.vector(Arrow::FieldChildren, 4, childCount);
+    for (qsizetype i = 0; i < childCount; ++i) {
+        int child = readField(table.tableAt(children, i), depth + 1);
+        if (child < 0) {
+            return -1;
+        }
+        field.children.append(child);
+    }
+    
+    m_fields.append(field);
+    return m_fields.size() - 1;
+}
+
+// Batches carry a field node per field and the buffers of each, depth
+// first in schema order; this records where each field's start
+bool ArrowReader::assignLayout(int index, int& node, int& buffer)
+{
+    Field& field = m_fields[index];
+    field.node = node++;
+    field.buffer = buffer;
+    
+    // A dictionary-encoded column only holds its indices
+    if (field.dictionary >= 0) {
+        buffer += 2;
+        return true;
+    }
+    int count = bufferCount(field.type, field.unit);
+    if (count < 0) {
+        m_error = QString("Unsupported type of column %1").arg(field.name);
+        return false;
+    }
+    buffer += count;
+    for (int child : field.children) {
+        if (!assignLayout(child, node, buffer)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool ArrowReader::findGeometry()
+{
+    m_geometryField = -1;
+    m_geometryType = FeatureStore::NoGeometry;
+    m_geometryLevels = 0;
+    
+    int fallback = -1;
+    for (int index : m_topFields) {
+        const Field& field = m_fields[index];
+        if (field.dictionary >= 0) {
+            continue;
+        }
+        bool binary = field.type == Arrow::Binary || field.type == Arrow::LargeBinary;
+        bool text = field.type == Arrow::Utf8 || field.type == Arrow::LargeUtf8;
+        if ((field.extension == "geoarrow.wkb" && binary) || (field.extension == "geoarrow.wkt" && text)) {
+            m_geometryField = index;
+            return true;
+        }
+        for (const auto& encoding : NativeEncodings) {
+            if (field.extension == encoding.name) {
+                m_geometryField = index;
+                m_geometryType = encoding.type;
+                m_geometryLevels = encoding.levels;
+                break;
+            }
+        }
+        if (m_geometryField >= 0) {
+            break;
+        }
+        if (fallback < 0 && binary && field.extension.isEmpty() && field.name.compare("geometry", Qt::CaseInsensitive) == 0) {
+            fallback = index;
+        }
+    }
+    if (m_geometryField < 0) {
+        m_geometryField = fallback;
+        return true;
+    }
+    
+    // Native encodings nest lists down to a fixed-size list of interleaved
+    // ordinates or a struct of one array per ordinate
+    const Field* field = &m_fields[m_geometryField];
+    for (int level = 0; level < m_geometryLevels; ++level) {
+        if ((field->type != Arrow::List && field->type != Arrow::LargeList) || field->children.size() != 1) {
+            m_error = QString("Unsupported layout of geometry column %1").arg(m_fields[m_geometryField].name);
+            return false;
+        }
+        field = &m_fields[field->children.first()];
+    }
+    bool interleaved = field->type == Arrow::FixedSizeList && field->listSize >= 2 && field->children.size() == 1
+        && isDoubleField(m_fields[field->children.first()].type, m_fields[field->children.first()].unit);
+    bool separated = field->type == Arrow::Struct && field->children.size() >= 2;
+    for (int i = 0; separated && i < 2; ++i) {
+        const Field& ordinate = m_fields[field->children[i]];
+        separated = isDoubleField(ordinate.type, ordinate.unit);
+    }
+    if (!interleaved && !separated) {
+        m_error = QString("Unsupported layout of geometry column %1").arg(m_fields[m_geometryField].name);
+        return false;
+    }
+    return true;
+}
+
+bool ArrowReader::isProperty(const Field& field) const
+{
+    switch (field.type) {
+    case Arrow::Null:
+    case Arrow::Bool:
+    case Arrow::Binary:
+    case Arrow::Utf8:
+    case Arrow::LargeBinary:
+    case Arrow::LargeUtf8:
+    case Arrow::Date:
+    case Arrow::Timestamp:
+        return field.children.isEmpty() || field.dictionary >= 0;
+    case Arrow::Int:
+        return field.bitWidth == 8 || field.bitWidth == 16 || field.bitWidth == 32 || field.bitWidth == 64;
+    case Arrow::FloatingPoint:
+        return field.unit == Arrow::Single || field.unit == Arrow::DoublePrecision;
+    default:
+        break;
+    }
+    return false;
+}
+
+// Locates the message of a footer block and its body. The metadata length
+// of the block covers the size prefix and the padded message.
+bool ArrowReader::readMessage(const char* block, quint8 headerType, Batch& batch, FlatBufferTable& header)
+{
+    qint64 offset = readLE<qint64>(block);
+    qint32 metadataSize = readLE<qint32>(block + 8);
+    qint64 bodySize = readLE<qint64>(block + 16);
+    if (offset < Arrow::Alignment || metadataSize < 8 || offset > m_size - metadataSize
+        || bodySize < 0 || bodySize > m_size - offset - metadataSize) {
+        m_error = "Malformed block in footer";
+        return false;
+    }
+    
+    // Files from before the continuation marker prefix only the length
+    const char* message = m_data + offset;
+    qsizetype prefix = readLE<quint32>(message) == Arrow::Continuation ? 8 : 4;
+    qint32 size = readLE<qint32>(message + prefix - 4);
+    if (size < 0 || size > metadataSize - prefix) {
+        m_error = QString("Malformed message at offset %1").arg(offset);
+        return false;
+    }
+    FlatBufferTable table = FlatBufferTable::root(message + prefix, size);
+    header = table.table(Arrow::MessageHeaderField);
+    if (table.scalar<quint8>(Arrow::MessageHeaderType, Arrow::NoHeader) != headerType || !header.isValid()) {
+        m_error = QString("Malformed message at offset %1").arg(offset);
+        return false;
+    }
+    
+    batch.offset = offset;
+    batch.end = offset + metadataSize + bodySize;
+    batch.body = message + metadataSize;
+    batch.bodySize = bodySize;
+    return true;
+}
+
+bool ArrowReader::readBatchHeader(const FlatBufferTable& header, Batch& batch)
+{
+    if (header.table(Arrow::RecordBatchCompression).isValid()) {
+        m_error = "Compressed Arrow files are not supported";
+        return false;
+    }
+    batch.length = header.scalar<qint64>(Arrow::RecordBatchLength, 0);
+    batch.nodes = header.vector(Arrow::RecordBatchNodes, Arrow::FieldNodeSize, batch.nodeCount);
+    batch.buffers = header.vector(Arrow::RecordBatchBuffers, Arrow::BufferSize, batch.bufferCount);
+    if (batch.length < 0) {
+        m_error = QString("Malformed record batch at offset %1").arg(batch.offset);
+        return false;
+    }
+    return true;
+}
+
+// Dictionaries are read up front into a column of values per id; batches
+// of a column marked as deltas extend its dictionary
+bool ArrowReader::readDictionaries(const char* blocks, qsizetype count)
+{
+    m_dictionaries.clear();
+    for (qsizetype i = 0; i < count; ++i) {
+        Batch batch;
+        FlatBufferTable header;
+        if (!readMessage(blocks + i * Arrow::BlockSize, Arrow::DictionaryBatchHeader, batch, header)) {
+            return false;
+        }
+        qint64 id = header.scalar<qint64>(Arrow::DictionaryBatchId, 0);
+        FlatBufferTable data = header.table(Arrow::DictionaryBatchData);
+        if (!data.isValid() || !readBatchHeader(data, batch)) {
+            m_error = QString("Malformed dictionary batch at offset %1").arg(batch.offset);
+            return false;
+        }
+        
+        // The values are laid out as a batch of a single column of the
+        // dictionary's value type
+        const Field* encoded = nullptr;
+        for (const Field& field : m_fields) {
+            if (field.dictionary == id) {
+                encoded = &field;
+                break;
+            }
+        }
+        if (!encoded || !isProperty(*encoded) || !encoded->children.isEmpty()) {
+            continue;
+        }
+        Field values = *encoded;
+        values.dictionary = -1;
+        values.node = 0;
+        values.buffer = 0;
+        
+        Array array;
+        if (!resolve(batch, values, array)) {
+            return false;
+        }
+        PropertyColumn& column = m_dictionaries[id];
+        if (!header.scalar<quint8>(Arrow::DictionaryBatchIsDelta, 0)) {
+            column.clear();
+        }
+        for (qint64 row = 0; row < array.length; ++row) {
+            qsizetype size = column.size();
+            appendValue(column, values, array, row);
+            if (column.size() == size) {
+                column.appendNull();
+            }
+        }
+    }
+    return true;
+}
+
+// Buffer index of a batch, checked to lie in the body and to hold at least
+// minSize bytes. Empty buffers give a null pointer.
+bool ArrowReader::buffer(const Batch& batch, int index, qint64 minSize, const char*& data, qint64& size)
+{
+    data = nullptr;
+    size = 0;
+    if (index >= batch.bufferCount) {
+        m_error = QString("Missing buffers in record batch at offset %1").arg(batch.offset);
+        return false;
+    }
+    qint64 offset = readLE<qint64>(batch.buffers + index * Arrow::BufferSize);
+    qint64 length = readLE<qint64>(batch.buffers + index * Arrow::BufferSize + 8);
+    if (offset < 0 || length < 0 || offset > batch.bodySize || length > batch.bodySize - offset || length < minSize) {
+        m_error = QString("Malformed buffer in record batch at offset %1").arg(batch.offset);
+        return false;
+    }
+    if (length > 0) {
+        data = batch.body + offset;
+        size = length;
+    }
+    return true;
+}
+
+// Finds the buffers of a property, WKB or WKT column and checks that they
+// cover the column's length
+bool ArrowReader::resolve(const Batch& batch, const Field& field, Array& array)
+{
+    if (field.node >= batch.nodeCount) {
+        m_error = QString("Missing columns in record batch at offset %1").arg(batch.offset);
+        return false;
+    }
+    array = Array();
+    array.length = readLE<qint64>(batch.nodes + field.node * Arrow::FieldNodeSize);
+    qint64 nullCount = readLE<qint64>(batch.nodes + field.node * Arrow::FieldNodeSize + 8);
+    if (array.length < 0 || array.length > std::numeric_limits<qint64>::max() / 16) {
+        m_error = QString("Malformed column %1").arg(field.name);
+        return false;
+    }
+    if (field.type == Arrow::Null && field.dictionary < 0) {
+        return true;
+    }
+    
+    qint64 size = 0;
+    if (!buffer(batch, field.buffer, nullCount > 0 ? (array.length + 7) / 8 : 0, array.validity, size)) {
+        return false;
+    }
+    if (nullCount == 0) {
+        array.validity = nullptr;
+    }
+    
+    qint64 width = 0;
+    bool variable = false;
+    if (field.dictionary >= 0 || field.type == Arrow::Int) {
+        width = field.bitWidth / 8;
+    } else if (field.type == Arrow::FloatingPoint) {
+        width = field.unit == Arrow::Single ? 4 : 8;
+    } else if (field.type == Arrow::Date) {
+        width = field.unit == Arrow::Day ? 4 : 8;
+    } else if (field.type == Arrow::Timestamp) {
+        width = 8;
+    } else if (field.type == Arrow::Binary || field.type == Arrow::Utf8) {
+        width = 4;
+        variable = true;
+    } else if (field.type == Arrow::LargeBinary || field.type == Arrow::LargeUtf8) {
+        width = 8;
+        variable = true;
+    }
+    
+    qint64 minSize = field.type == Arrow::Bool && field.dictionary < 0 ? (array.length + 7) / 8 : array.length * width;
+    if (variable && array.length > 0) {
+        minSize += width;
+    }
+    if (!buffer(batch, field.buffer + 1, minSize, array.values, size)) {
+        return false;
+    }
+    if (variable && !buffer(batch, field.buffer + 2, 0, array.data, array.dataSize)) {
+        return false;
+    }
+    return true;
+}
+
+bool ArrowReader::resolveGeometry(const Batch& batch, GeometryArrays& geometry)
+{
+    const Field* field = &m_fields[m_geometryField];
+    if (m_geometryType == FeatureStore::NoGeometry) {
+        return resolve(batch, *field, geometry.encoded);
+    }
+    
+    // Every level is checked to hold its length + 1 offsets; the offsets
+    // themselves are checked against the next level as they are used
+    qint64 size = 0;
+    for (int level = 0; level <= m_geometryLevels; ++level) {
+        if (field->node >= batch.nodeCount) {
+            m_error = QString("Missing columns in record batch at offset %1").arg(batch.offset);
+            return false;
+        }
+        qint64 length = readLE<qint64>(batch.nodes + field->node * Arrow::FieldNodeSize);
+        qint64 nullCount = readLE<qint64>(batch.nodes + field->node * Arrow::FieldNodeSize + 8);
+        if (length < 0 || length > std::numeric_limits<qint64>::max() / 64) {
+            m_error = QString("Malformed geometry column %1").arg(m_fields[m_geometryField].name);
+            return false;
+        }
+        geometry.lengths[level] = length;
+        if (level == 0) {
+            if (!buffer(batch, field->buffer, nullCount > 0 ? (length + 7) / 8 : 0, geometry.validity, size)) {
+                return false;
+            }
+            if (nullCount == 0) {
+                geometry.validity = nullptr;
+            }
+        }
+        if (level == m_geometryLevels) {
+            break;
+        }
+        geometry.large[level] = field->type == Arrow::LargeList;
+        qint64 width = geometry.large[level] ? 8 : 4;
+        if (!buffer(batch, field->buffer + 1, length > 0 ? (length + 1) * width : 0, geometry.offsets[level], size)) {
+            return false;
+        }
+        field = &m_fields[field->children.first()];
+    }
+    
+    qint64 coordinates = geometry.lengths[m_geometryLevels];
+    const char* values = nullptr;
+    if (field->type == Arrow::FixedSizeList) {
+        const Field& ordinates = m_fields[field->children.first()];
+        if (!buffer(batch, ordinates.buffer + 1, coordinates * field->listSize * 8, values, size)) {
+            return false;
+        }
+        geometry.x = values;
+        geometry.y = values ? values + 8 : nullptr;
+        geometry.stride = field->listSize * 8;
+    } else {
+        if (!buffer(batch, m_fields[field->children[0]].buffer + 1, coordinates * 8, geometry.x, size)
+            || !buffer(batch, m_fields[field->children[1]].buffer + 1, coordinates * 8, geometry.y, size)) {
+            return false;
+        }
+        geometry.stride = 8;
+    }
+    return true;
+}
+
+QVariantMap ArrowReader::boundingBox()
+{
+    QVariantMap box;
+    if (!readHeader() || m_geometryField < 0 || m_geometryType == FeatureStore::NoGeometry) {
+        return box;
+    }
+    
+    double minX = INFINITY, minY = INFINITY;
+    double maxX = -INFINITY, maxY = -INFINITY;
+    for (const Batch& batch : m_batches) {
+        GeometryArrays geometry;
+        if (!resolveGeometry(batch, geometry)) {
+            return QVariantMap();
+        }
+        // Only the coordinates the rows refer to, through every level
+        qint64 first = 0;
+        qint64 last = qMin(batch.length, geometry.lengths[0]);
+        for (int level = 0; level < m_geometryLevels && first < last; ++level) {
+            first = offsetAt(geometry.offsets[level], geometry.large[level], first);
+            last = offsetAt(geometry.offsets[level], geometry.large[level], last);
+            if (first < 0 || first > last || last > geometry.lengths[level + 1]) {
+                return QVariantMap();
+            }
+        }
+        for (qint64 i = first; i < last; ++i) {
+            double x = readLE<double>(geometry.x + i * geometry.stride);
+            double y = readLE<double>(geometry.y + i * geometry.stride);
+            // NaN compares false, so empty points are left out
+            minX = qMin(minX, x);
+            maxX = qMax(maxX, x);
+            minY = qMin(minY, y);
+            maxY = qMax(maxY, y);
+        }
+    }
+    if (minX > maxX || minY > maxY) {
+        return box;
+    }
+    box["minLat"] = minY;
+    box["maxLat"] = maxY;
+    box["minLon"] = minX;
+    box["maxLon"] = maxX;
+    return box;
+}
+
+bool ArrowReader::read(FeatureStore& store, const IngestProgress& progress, QThreadPool* pool)
+{
+    m_cancelled = false;
+    if (!readHeader()) {
+        return false;
+    }
+    
+    if (threadCount() > 1 && m_batches.size() > 1 && m_rowCount >= 2 * MinChunkRows) {
+        return readParallel(store, progress, pool);
+    }
+    
+    prepareColumns(store);
+    if (!readRange(store, 0, m_batches.size(), progress)) {
+        return false;
+    }
+    if (progress) {
+        progress(m_size, store.featureCount());
+    }
+    return true;
+}
+
+bool ArrowReader::readRecords(FeatureStore& store, qint64 first, qint64 last)
+{
+    m_cancelled = false;
+    if (!readHeader()) {
+        return false;
+    }
+    prepareColumns(store);
+    
+    qint64 batchStart = 0;
+    for (const Batch& batch : m_batches) {
+        if (batchStart >= last) {
+            break;
+        }
+        qint64 begin = qMax<qint64>(first - batchStart, 0);
+        qint64 end = qMin(last - batchStart, batch.length);
+        if (begin < end && !readBatch(store, batch, begin, end)) {
+            return false;
+        }
+        batchStart += batch.length;
+    }
+    return true;
+}
+
+void ArrowReader::prepareColumns(FeatureStore& store)
+{
+    m_columns.clear();
+    for (int index : m_properties) {
+        store.column(m_fields[index].name);
+        m_columns.append(store.columnIndex(m_fields[index].name));
+    }
+}
+
+bool ArrowReader::readRange(FeatureStore& store, qsizetype firstBatch, qsizetype lastBatch, const IngestProgress& progress)
+{
+    for (qsizetype i = firstBatch; i < lastBatch; ++i) {
+        if (!readBatch(store, m_batches[i], 0, m_batches[i].length)) {
+            return false;
+        }
+        if (progress && !progress(m_batches[i].end, store.featureCount())) {
+            m_cancelled = true;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool ArrowReader::readBatch(FeatureStore& store, const Batch& batch, qint64 first, qint64 last)
+{
+    if (batch.nodeCount < m_nodeCount || batch.bufferCount < m_bufferCount) {
+        m_error = QString("Record batch at offset %1 does not match the schema").arg(batch.offset);
+        return false;
+    }
+    
+    GeometryArrays geometry;
+    if (m_geometryField >= 0 && !resolveGeometry(batch, geometry)) {
+        return false;
+    }
+    QVector<Array> arrays(m_properties.size());
+    for (qsizetype i = 0; i < m_properties.size(); ++i) {
+        if (!resolve(batch, m_fields[m_properties[i]], arrays[i])) {
+            return false;
+        }
+        if (arrays[i].length < last) {
+            m_error = QString("Column %1 is shorter than its record batch").arg(m_fields[m_properties[i]].name);
+            return false;
+        }
+    }
+    qint64 geometryLength = m_geometryType != FeatureStore::NoGeometry ? geometry.lengths[0] : geometry.encoded.length;
+    if (m_geometryField >= 0 && geometryLength < last) {
+        m_error = QString("Column %1 is shorter than its record batch").arg(m_fields[m_geometryField].name);
+        return false;
+    }
+    
+    for (qint64 row = first; row < last; ++row) {
+        store.beginFeature();
+        if (m_geometryField >= 0 && !readGeometry(store, geometry, row)) {
+            m_error = QString("Invalid geometry in row %1 of the record batch at offset %2").arg(row).arg(batch.offset);
+            return false;
+        }
+        for (qsizetype i = 0; i < m_properties.size(); ++i) {
+            appendValue(store.columnAt(m_columns[i]), m_fields[m_properties[i]], arrays[i], row);
+        }
+        store.endFeature();
+    }
+    return true;
+}
+
+bool ArrowReader::readGeometry(FeatureStore& store, const GeometryArrays& geometry, qint64 row)
+{
+    if (m_geometryType == FeatureStore::NoGeometry) {
+        // Undecodable WKB or WKT leaves the feature without geometry, as in
+        // CSV files
+        const Array& array = geometry.encoded;
+        if (!isValid(array.validity, row)) {
+            return true;
+        }
+        bool large = m_fields[m_geometryField].type == Arrow::LargeBinary || m_fields[m_geometryField].type == Arrow::LargeUtf8;
+        qint64 begin = offsetAt(array.values, large, row);
+        qint64 end = offsetAt(array.values, large, row + 1);
+        if (begin < 0 || begin > end || end > array.dataSize) {
+            return false;
+        }
+        QByteArrayView value(array.data + begin, end - begin);
+        if (m_fields[m_geometryField].type == Arrow::Binary || m_fields[m_geometryField].type == Arrow::LargeBinary) {
+            WkbReader(value).read(store);
+        } else {
+            WktReader(value).read(store);
+        }
+        return true;
+    }
+    
+    if (!isValid(geometry.validity, row)) {
+        return true;
+    }
+    store.setGeometryType(m_geometryType);
+    
+    // Offsets of item at one level, checked against the next
+    auto range = [&geometry](int level, qint64 item, qint64& begin, qint64& end) {
+        begin = offsetAt(geometry.offsets[level], geometry.large[level], item);
+        end = offsetAt(geometry.offsets[level], geometry.large[level], item + 1);
+        return begin >= 0 && begin <= end && end <= geometry.lengths[level + 1];
+    };
+    auto addCoordinates = [&store, &geometry](qint64 begin, qint64 end) {
+        if (geometry.stride == 16 && geometry.y == geometry.x + 8 && Q_BYTE_ORDER == Q_LITTLE_ENDIAN) {
+            store.addCoordinates(reinterpret_cast<const double*>(geometry.x + begin * 16), end - begin);
+            return;
+        }
+        for (qint64 i = begin; i < end; ++i) {
+            store.addCoordinate(readLE<double>(geometry.x + i * geometry.stride), readLE<double>(geometry.y + i * geometry.stride));
+        }
+    };
+    
+    qint64 begin = 0, end = 0, ringBegin = 0, ringEnd = 0, coordinateBegin = 0, coordinateEnd = 0;
+    switch (m_geometryType) {
+    case FeatureStore::Point: {
+        // Empty points are written with NaN coordinates
+        if (std::isnan(readLE<double>(geometry.x + row * geometry.stride))) {
+            return true;
+        }
+        store.beginPart(FeatureStore::Point);
+        store.beginRing();
+        addCoordinates(row, row + 1);
+        return true;
+    }
+    case FeatureStore::LineString:
+        if (!range(0, row, begin, end)) {
+            return false;
+        }
+        if (begin < end) {
+            store.beginPart(FeatureStore::LineString);
+            store.beginRing();
+            addCoordinates(begin, end);
+        }
+        return true;
+    case FeatureStore::Polygon:
+        if (!range(0, row, begin, end)) {
+            return false;
+        }
+        if (begin < end) {
+            store.beginPart(FeatureStore::Polygon);
+        }
+        for (qint64 ring = begin; ring < end; ++ring) {
+            if (!range(1, ring, coordinateBegin, coordinateEnd)) {
+                return false;
+            }
+            store.beginRing();
+            addCoordinates(coordinateBegin, coordinateEnd);
+        }
+        return true;
+    case FeatureStore::MultiPoint:
+        if (!range(0, row, begin, end)) {
+            return false;
+        }
+        for (qint64 point = begin; point < end; ++point) {
+            store.beginPart(FeatureStore::Point);
+            store.beginRing();
+            addCoordinates(point, point + 1);
+        }
+        return true;
+    case FeatureStore::MultiLineString:
+        if (!range(0, row, begin, end)) {
+            return false;
+        }
+        for (qint64 line = begin; line < end; ++line) {
+            if (!range(1, line, coordinateBegin, coordinateEnd)) {
+                return false;
+            }
+            store.beginPart(FeatureStore::LineString);
+            store.beginRing();
+            addCoordinates(coordinateBegin, coordinateEnd);
+        }
+        return true;
+    case FeatureStore::MultiPolygon:
+        if (!range(0, row, begin, end)) {
+            return false;
+        }
+        for (qint64 polygon = begin; polygon < end; ++polygon) {
+            if (!range(1, polygon, ringBegin, ringEnd)) {
+                return false;
+            }
+            store.beginPart(FeatureStore::Polygon);
+            for (qint64 ring = ringBegin; ring < ringEnd; ++ring) {
+                if (!range(2, ring, coordinateBegin, coordinateEnd)) {
+                    return false;
+                }
+                store.beginRing();
+                addCoordinates(coordinateBegin, coordinateEnd);
+            }
+        }
+        return true;
+    case FeatureStore::NoGeometry:
+    case FeatureStore::GeometryCollection:
+        break;
+    }
+    return false;
+}
+
+// Nulls are left for endFeature() to pad
+void ArrowReader::appendValue(PropertyColumn& column, const Field& field, const Array& array, qint64 row)
+{
+    if (!isValid(array.validity, row) || (field.type == Arrow::Null && field.dictionary < 0)) {
+        return;
+    }
+    
+    if (field.dictionary >= 0) {
+        qint64 index = 0;
+        switch (field.bitWidth) {
+        case 8:
+            index = field.isSigned ? qint64(qint8(array.values[row])) : qint64(quint8(array.values[row]));
+            break;
+        case 16:
+            index = field.isSigned ? qint64(readLE<qint16>(array.values + row * 2)) : qint64(readLE<quint16>(array.values + row * 2));
+            break;
+        case 32:
+            index = field.isSigned ? qint64(readLE<qint32>(array.values + row * 4)) : qint64(readLE<quint32>(array.values + row * 4));
+            break;
+        default:
+            index = readLE<qint64>(array.values + row * 8);
+            break;
+        }
+        auto dictionary = m_dictionaries.constFind(field.dictionary);
+        if (dictionary != m_dictionaries.constEnd() && index >= 0 && index < dictionary.value().size()
+            && !dictionary.value().isNull(index)) {
+            column.append(dictionary.value().value(index));
+        }
+        return;
+    }
+    
+    switch (field.type) {
+    case Arrow::Bool:
+        column.appendBool((quint8(array.values[row >> 3]) >> (row & 7)) & 1);
+        break;
+    case Arrow::Int:
+        switch (field.bitWidth) {
+        case 8:
+            column.appendInt(field.isSigned ? qint64(qint8(array.values[row])) : qint64(quint8(array.values[row])));
+            break;
+        case 16:
+            column.appendInt(field.isSigned ? qint64(readLE<qint16>(array.values + row * 2)) : qint64(readLE<quint16>(array.values + row * 2)));
+            break;
+        case 32:
+            column.appendInt(field.isSigned ? qint64(readLE<qint32>(array.values + row * 4)) : qint64(readLE<quint32>(array.values + row * 4)));
+            break;
+        default: {
+            quint64 number = readLE<quint64>(array.values + row * 8);
+            if (field.isSigned || number <= quint64(std::numeric_limits<qint64>::max())) {
+                column.appendInt(qint64(number));
+            } else {
+                column.appendDouble(double(number));
+            }
+            break;
+        }
+        }
+        break;
+    case Arrow::FloatingPoint:
+        column.appendDouble(field.unit == Arrow::Single ? double(readLE<float>(array.values + row * 4)) : readLE<double>(array.values + row * 8));
+        break;
+    case Arrow::Date: {
+        // Dates become ISO 8601 text, as in Shapefile attributes
+        qint64 days = field.unit == Arrow::Day ? readLE<qint32>(array.values + row * 4)
+                                               : floorDivide(readLE<qint64>(array.values + row * 8), MillisecondsPerDay);
+        column.appendString(QDate(1970, 1, 1).addDays(days).toString(Qt::ISODate));
+        break;
+    }
+    case Arrow::Timestamp: {
+        static const qint64 perMillisecond[] = {0, 1, 1000, 1000000};
+        qint64 value = readLE<qint64>(array.values + row * 8);
+        qint64 milliseconds = field.unit == Arrow::Second ? value * 1000 : floorDivide(value, perMillisecond[qBound(1, int(field.unit), 3)]);
+        QDateTime time = QDateTime::fromMSecsSinceEpoch(milliseconds, QTimeZone::utc());
+        // Timestamps without a time zone are wall-clock times
+        column.appendString(field.hasTimezone ? time.toString(Qt::ISODateWithMs) : time.toString("yyyy-MM-dd'T'HH:mm:ss.zzz"));
+        break;
+    }
+    default: {
+        bool large = field.type == Arrow::LargeBinary || field.type == Arrow::LargeUtf8;
+        qint64 begin = offsetAt(array.values, large, row);
+        qint64 end = offsetAt(array.values, large, row + 1);
+        if (begin < 0 || begin > end || end > array.dataSize) {
+            break;
+        }
+        if (field.type == Arrow::Binary || field.type == Arrow::LargeBinary) {
+            column.append(QByteArray(array.data + begin, end - begin));
+        } else {
+            column.appendString(m_strings.intern(QByteArrayView(array.data + begin, end - begin)));
+        }
+        break;
+    }
+    }
+}
+
+bool ArrowReader::readParallel(FeatureStore& store, const IngestProgress& progress, QThreadPool* pool)
+{
+    // Consecutive batches are grouped into runs of about equal row counts
+    int threads = threadCount();
+    qint64 chunkRows = qMax(MinChunkRows, m_rowCount / (threads * ChunksPerThread));
+    QVector<qsizetype> bounds{0};
+    qint64 rows = 0;
+    for (qsizetype i = 0; i < m_batches.size(); ++i) {
+        rows += m_batches[i].length;
+        if (rows >= chunkRows || i + 1 == m_batches.size()) {
+            bounds.append(i + 1);
+            rows = 0;
+        }
+    }
+    qsizetype chunkCount = bounds.size() - 1;
+    
+    prepareColumns(store);
+    std::vector<ChunkResult> results(chunkCount);
+    std::atomic<qsizetype> nextChunk(0);
+    std::atomic<bool> stop(false);
+    auto readChunk = [this, &bounds, &results, &stop](qsizetype chunk) {
+        ChunkResult& result = results[chunk];
+        ArrowReader reader(*this);
+        reader.prepareColumns(result.store);
+        result.ok = reader.readRange(result.store, bounds[chunk], bounds[chunk + 1], [&stop](qint64, qint64) {
+            return !stop.load(std::memory_order_relaxed);
+        });
+        if (!result.ok) {
+            result.error = reader.errorString();
+        }
+        result.done.store(true, std::memory_order_release);
+    };
+    auto readChunks = [&readChunk, &nextChunk, &stop, chunkCount]() {
+        for (qsizetype chunk = nextChunk++; chunk < chunkCount && !stop.load(std::memory_order_relaxed); chunk = nextChunk++) {
+            readChunk(chunk);
+        }
+    };
+    
+    // Merge in file order while later runs are still being read; the
+    // calling thread does so after each of its own runs
+    bool ok = true;
+    qsizetype merged = 0;
+    auto mergeRead = [&]() {
+        for (; ok && merged < chunkCount && results[merged].done.load(std::memory_order_acquire); ++merged) {
+            ChunkResult& result = results[merged];
+            if (!result.ok) {
+                m_error = result.error;
+                m_cancelled = m_error.isEmpty();
+                stop = true;
+                ok = false;
+                break;
+            }
+            
+            store.append(result.store);
+            result.store.clear();
+            qint64 bytes = merged + 1 < chunkCount ? m_batches[bounds[merged + 1] - 1].end : m_size;
+            if (progress && !progress(bytes, store.featureCount())) {
+                m_cancelled = true;
+                stop = true;
+                ok = false;
+            }
+        }
+    };
+    
+    // The calling thread and threads - 1 pool tasks take runs in turn until
+    // none are left, so a busy pool only slows the read down
+    if (!pool) {
+        pool = QThreadPool::globalInstance();
+    }
+    QVector<QFuture<void>> futures;
+    for (qsizetype worker = 1; worker < qMin<qsizetype>(threads, chunkCount); ++worker) {
+        futures.append(QtConcurrent::run(pool, readChunks));
+    }
+    for (qsizetype chunk = nextChunk++; chunk < chunkCount && !stop.load(std::memory_order_relaxed); chunk = nextChunk++) {
+        readChunk(chunk);
+        mergeRead();
+    }
+    for (QFuture<void>& future : futures) {
+        future.waitForFinished();
+    }
+    mergeRead();
+    return ok;
+}
@@ -0,0 +1,153 @@
+#pragma once
+
+#include "FeatureStore.h"
+#include "FlatBuffers.h"
+#include "StringPool.h"
+#include <QHash>
+#include <QString>
+#include <QVariantMap>
+#include <QVector>
+
+class QThreadPool;
+
+// Reads an Arrow IPC file (Feather V2) straight from an in-memory (usually
+// mapped) file. Column buffers are used where they lie: coordinates are
+// copied into the store in bulk and values are decoded row by row from the
+// mapping. The geometry column is found by its GeoArrow extension name;
+// the native point, linestring, polygon and Multi* encodings with
+// interleaved or separated coordinates are read, as are WKB and WKT, and a
+// binary column named "geometry" without one is taken as WKB. Boolean,
+// integer, floating point, string, binary, date and timestamp columns
+// become properties, dictionary-encoded ones included; other columns are
+// skipped. Record batches are independent, so large files are split into
+// runs of batches parsed on several threads and merged in file order.
+// Compressed files are not supported.
+class ArrowReader
+{
+public:
+    ArrowReader(const char* data, qsizetype size);
+    
+    // Batches are split across this many threads; 0 picks
+    // QThread::idealThreadCount()
+    void setThreadCount(int threads) { m_threads = threads; }
+    int threadCount() const;
+    
+    // Parses the footer, the schema and the dictionaries; read() does this
+    // as needed
+    bool readHeader();
+    
+    // Large files are read on the calling thread and on pool (the global
+    // pool unless given)
+    bool read(FeatureStore& store, const IngestProgress& progress = IngestProgress(), QThreadPool* pool = nullptr);
+    // Reads only the rows in [first, last)
+    bool readRecords(FeatureStore& store, qint64 first, qint64 last);
+    
+    bool wasCancelled() const { return m_cancelled; }
+    QString errorString() const { return m_error; }
+    
+    // Header information, valid after readHeader()
+    qint64 featureCount() const { return m_rowCount; }
+    QStringList fieldNames() const;
+    // GeoArrow extension name of the geometry column, empty without one
+    QString geometryEncoding() const;
+    // Extent of the coordinates of a native geometry column, computed from
+    // the coordinate buffers alone; empty for WKB and WKT
+    QVariantMap boundingBox();
+
+private:
+    struct Field {
+        QString name;
+        quint8 type = 0;
+        // Int width and signedness; also the index type of dictionaries
+        int bitWidth = 0;
+        bool isSigned = false;
+        // FloatingPoint precision, Date and Timestamp unit or Union mode
+        qint16 unit = 0;
+        bool hasTimezone = false;
+        int listSize = 0;
+        qint64 dictionary = -1;
+        QString extension;
+        QVector<int> children;
+        // First field node and buffer in a record batch
+        int node = 0;
+        int buffer = 0;
+    };
+    
+    struct Batch {
+        qint64 offset = 0;
+        qint64 end = 0;
+        qint64 length = 0;
+        const char* nodes = nullptr;
+        qsizetype nodeCount = 0;
+        const char* buffers = nullptr;
+        qsizetype bufferCount = 0;
+        const char* body = nullptr;
+        qint64 bodySize = 0;
+    };
+    
+    // Buffers of one column in a batch
+    struct Array {
+        qint64 length = 0;
+        const char* validity = nullptr;
+        const char* values = nullptr;
+        const char* data = nullptr;
+        qint64 dataSize = 0;
+    };
+    
+    // Buffers of the geometry column in a batch. Native encodings have a
+    // list offset array per nesting level, outermost first, over lengths
+    // that end with the coordinate count; coordinate i is at x and y plus
+    // i * stride.
+    struct GeometryArrays {
+        Array encoded;
+        const char* validity = nullptr;
+        const char* offsets[3] = {};
+        bool large[3] = {};
+        qint64 lengths[4] = {};
+        const char* x = nullptr;
+        const char* y = nullptr;
+        qsizetype stride = 0;
+    };
+    
+    int readField(const FlatBufferTable& table, int depth);
+    bool assignLayout(int index, int& node, int& buffer);
+    bool findGeometry();
+    bool isProperty(const Field& field) const;
+    bool readMessage(const char* block, quint8 headerType, Batch& batch, FlatBufferTable& header);
+    bool readBatchHeader(const FlatBufferTable& header, Batch& batch);
+    bool readDictionaries(const char* blocks, qsizetype count);
+    
+    bool buffer(const Batch& batch, int index, qint64 minSize, const char*& data, qint64& size);
+    bool resolve(const Batch& batch, const Field& field, Array& array);
+    bool resolveGeometry(const Batch& batch, GeometryArrays& geometry);
+    
+    void prepareColumns(FeatureStore& store);
+    bool readRange(FeatureStore& store, qsizetype firstBatch, qsizetype lastBatch, const IngestProgress& progress);
+    bool readBatch(FeatureStore& store, const Batch& batch, qint64 first, qint64 last);
+    bool readGeometry(FeatureStore& store, const GeometryArrays& geometry, qint64 row);
+    void appendValue(PropertyColumn& column, const Field& field, const Array& array, qint64 row);
+    bool readParallel(FeatureStore& store, const IngestProgress& progress, QThreadPool* pool);
+    
+    const char* m_data;
+    qsizetype m_size;
+    int m_threads;
+    bool m_headerRead;
+    
+    QVector<Field> m_fields;
+    QVector<int> m_topFields;
+    int m_nodeCount;
+    int m_bufferCount;
+    int m_geometryField;
+    FeatureStore::GeometryType m_geometryType;
+    int m_geometryLevels;
+    QVector<int> m_properties;
+    QVector<int> m_columns;
+    QHash<qint64, PropertyColumn> m_dictionaries;
+    
+    QVector<Batch> m_batches;
+    qint64 m_rowCount;
+    
+    StringPool m_strings;
+    bool m_cancelled;
+    QString m_error;
+};
@@ -0,0 +1,610 @@
+#include "ArrowWriter.h"
+#include "Arrow.h"
+#include "FlatBuffers.h"
+#include <QIODevice>
+#include <QJsonDocument>
+#include <QtEndian>
+#include <cmath>
+#include <functional>
+
+namespace {
+
+template<typename T>
+void appendLE(QByteArray& buffer, T value)
+{
+    char bytes[sizeof(T)];
+    qToLittleEndian(value, bytes);
+    buffer.append(bytes, sizeof(T));
+}
+
+template<typename T>
+QByteArray littleEndian(const QVector<T>& values)
+{
+    QByteArray bytes(values.size() * qsizetype(sizeof(T)), Qt::Uninitialized);
+    qToLittleEndian<T>(values.constData(), values.size(), bytes.data());
+    return bytes;
+}
+
+// List levels above the coordinates in the GeoArrow encoding of a type
+int listLevels(FeatureStore::GeometryType type)
+{
+    switch (type) {
+    case FeatureStore::LineString:
+    case FeatureStore::MultiPoint:
+        return 1;
+    case FeatureStore::Polygon:
+    case FeatureStore::MultiLineString:
+        return 2;
+    case FeatureStore::MultiPolygon:
+        return 3;
+    default:
+        break;
+    }
+    return 0;
+}
+
+void setBit(QByteArray& bits, qsizetype index)
+{
+    bits[index >> 3] = char(quint8(bits[index >> 3]) | (1 << (index & 7)));
+}
+
+// Builds a Message table whose header is written by appendHeader, padded
+// so that the body following it stays 8-aligned
+QByteArray encodeMessage(quint8 headerType, qint64 bodyLength, const std::function<void(QByteArray&, qsizetype)>& appendHeader)
+{
+    QByteArray buffer(4, '\0');
+    FlatBufferWriter message;
+    message.add<qint16>(Arrow::MessageVersion, Arrow::V5);
+    message.add<quint8>(Arrow::MessageHeaderType, headerType);
+    message.addOffset(Arrow::MessageHeaderField);
+    message.add<qint64>(Arrow::MessageBodyLength, bodyLength);
+    FlatBufferWriter::patch(buffer, 0, message.finish(buffer));
+    appendHeader(buffer, message.position(Arrow::MessageHeaderField));
+    FlatBufferWriter::pad(buffer, Arrow::Alignment);
+    return buffer;
+}
+
+// Mixed-type values become text, with nested maps and lists as JSON
+QByteArray textValue(const QVariant& value)
+{
+    if (value.typeId() == QMetaType::QVariantMap || value.typeId() == QMetaType::QVariantList) {
+        return QJsonDocument::fromVariant(value).toJson(QJsonDocument::Compact);
+    }
+    return value.toString().toUtf8();
+}
+
+void appendCoordinates(const FeatureStore& store, qsizetype ring, QVector<double>& xy)
+{
+    for (qsizetype coordinate = store.coordinateBegin(ring); coordinate < store.coordinateEnd(ring); ++coordinate) {
+        xy.append(store.x(coordinate));
+        xy.append(store.y(coordinate));
+    }
+}
+
+// WKB of a simple geometry made of one part; a missing part is empty
+void appendWkbPart(QByteArray& wkb, const FeatureStore& store, qsizetype part, FeatureStore::GeometryType type)
+{
+    wkb.append(char(1));
+    appendLE(wkb, quint32(type));
+    qsizetype firstRing = part >= 0 ? store.ringBegin(part) : 0;
+    qsizetype lastRing = part >= 0 ? store.ringEnd(part) : 0;
+    switch (type) {
+    case FeatureStore::Point:
+        if (firstRing < lastRing && store.coordinateBegin(firstRing) < store.coordinateEnd(firstRing)) {
+            appendLE(wkb, store.x(store.coordinateBegin(firstRing)));
+            appendLE(wkb, store.y(store.coordinateBegin(firstRing)));
+        } else {
+            appendLE(wkb, double(NAN));
+            appendLE(wkb, double(NAN));
+        }
+        break;
+    case FeatureStore::LineString: {
+        qsizetype first = firstRing < lastRing ? store.coordinateBegin(firstRing) : 0;
+        qsizetype last = firstRing < lastRing ? store.coordinateEnd(firstRing) : 0;
+        appendLE(wkb, quint32(last - first));
+        for (qsizetype coordinate = first; coordinate < last; ++coordinate) {
+            appendLE(wkb, store.x(coordinate));
+            appendLE(wkb, store.y(coordinate));
+        }
+        break;
+    }
+    default:
+        appendLE(wkb, quint32(lastRing - firstRing));
+        for (qsizetype ring = firstRing; ring < lastRing; ++ring) {
+            appendLE(wkb, quint32(store.coordinateEnd(ring) - store.coordinateBegin(ring)));
+            for (qsizetype coordinate = store.coordinateBegin(ring); coordinate < store.coordinateEnd(ring); ++coordinate) {
+                appendLE(wkb, store.x(coordinate));
+                appendLE(wkb, store.y(coordinate));
+            }
+        }
+        break;
+    }
+}
+
+void appendWkb(QByteArray& wkb, const FeatureStore& store, qsizetype feature)
+{
+    FeatureStore::GeometryType type = store.geometryType(feature);
+    qsizetype first = store.partBegin(feature);
+    qsizetype last = store.partEnd(feature);
+    if (type <= FeatureStore::Polygon) {
+        appendWkbPart(wkb, store, first < last ? first : -1, type);
+        return;
+    }
+    wkb.append(char(1));
+    appendLE(wkb, quint32(type));
+    appendLE(wkb, quint32(last - first));
+    for (qsizetype part = first; part < last; ++part) {
+        appendWkbPart(wkb, store, part, store.partType(part));
+    }
+}
+
+// Appends a Field table and its children and points the offset at slot to it
+void appendField(QByteArray& buffer, qsizetype slot, const QByteArray& name, quint8 type, int parameter,
+                 const QByteArray& extension, const std::function<void(QByteArray&, qsizetype)>& appendChildren,
+                 qsizetype childCount)
+{
+    FlatBufferWriter field;
+    field.addOffset(Arrow::FieldName);
+    field.add<quint8>(Arrow::FieldNullable, 1);
+    field.add<quint8>(Arrow::FieldTypeType, type);
+    field.addOffset(Arrow::FieldType);
+    field.addOffset(Arrow::FieldChildren);
+    if (!extension.isEmpty()) {
+        field.addOffset(Arrow::FieldCustomMetadata);
+    }
+    FlatBufferWriter::patch(buffer, slot, field.finish(buffer));
+    FlatBufferWriter::patch(buffer, field.position(Arrow::FieldName), FlatBufferWriter::appendString(buffer, name));
+    
+    // Every type has a table, most of them empty
+    FlatBufferWriter typeTable;
+    switch (type) {
+    case Arrow::Int:
+        typeTable.add<qint32>(Arrow::IntBitWidth, parameter);
+        typeTable.add<quint8>(Arrow::IntIsSigned, 1);
+        break;
+    case Arrow::FloatingPoint:
+        typeTable.add<qint16>(Arrow::FloatingPointPrecision, qint16(parameter));
+        break;
+    case Arrow::FixedSizeList:
+        typeTable.add<qint32>(Arrow::FixedSizeListSize, parameter);
+        break;
+    default:
+        break;
+    }
+    FlatBufferWriter::patch(buffer, field.position(Arrow::FieldType), typeTable.finish(buffer));
+    
+    qsizetype children = FlatBufferWriter::appendVector(buffer, nullptr, childCount, 4);
+    FlatBufferWriter::patch(buffer, field.position(Arrow::FieldChildren), children);
+    if (appendChildren) {
+        appendChildren(buffer, children + 4);
+    }
+    
+    if (!extension.isEmpty()) {
+        // Coordinates are always WGS 84 longitude and latitude
+        const QByteArray entries[2][2] = {
+            {"ARROW:extension:name", extension},
+            {"ARROW:extension:metadata", "{\"crs\":\"OGC:CRS84\"}"}
+        };
+        qsizetype metadata = FlatBufferWriter::appendVector(buffer, nullptr, 2, 4);
+        FlatBufferWriter::patch(buffer, field.position(Arrow::FieldCustomMetadata), metadata);
+        for (qsizetype i = 0; i < 2; ++i) {
+            FlatBufferWriter entry;
+            entry.addOffset(Arrow::KeyValueKey);
+            entry.addOffset(Arrow::KeyValueValue);
+            FlatBufferWriter::patch(buffer, metadata + 4 + i * 4, entry.finish(buffer));
+            FlatBufferWriter::patch(buffer, entry.position(Arrow::KeyValueKey), FlatBufferWriter::appendString(buffer, entries[i][0]));
+            FlatBufferWriter::patch(buffer, entry.position(Arrow::KeyValueValue), FlatBufferWriter::appendString(buffer, entries[i][1]));
+        }
+    }
+}
+
+} // namespace
+
+void ArrowWriter::Body::addNode(qint64 length, qint64 nullCount)
+{
+    appendLE(nodes, length);
+    appendLE(nodes, nullCount);
+}
+
+void ArrowWriter::Body::addBuffer(const char* bytes, qint64 size)
+{
+    appendLE(buffers, qint64(data.size()));
+    appendLE(buffers, size);
+    data.append(bytes, size);
+    FlatBufferWriter::pad(data, Arrow::Alignment);
+}
+
+ArrowWriter::ArrowWriter(QIODevice* device)
+    : m_device(device)
+    , m_batchSize(65536)
+    , m_geometryType(FeatureStore::NoGeometry)
+    , m_hasGeometry(false)
+    , m_offset(0)
+    , m_blockCount(0)
+{
+}
+
+bool ArrowWriter::write(const FeatureStore& store)
+{
+    m_error.clear();
+    m_offset = 0;
+    m_blocks.clear();
+    m_blockCount = 0;
+    
+    m_fields.clear();
+    Field geometry = geometryField(store);
+    if (m_hasGeometry) {
+        m_fields.append(geometry);
+    }
+    const QVector<PropertyColumn>& columns = store.columns();
+    for (const PropertyColumn& column : columns) {
+        Field field;
+        field.name = column.name().toUtf8();
+        switch (column.type()) {
+        case PropertyColumn::Null:
+            field.type = Arrow::Null;
+            break;
+        case PropertyColumn::Bool:
+            field.type = Arrow::Bool;
+            break;
+        case PropertyColumn::Int:
+            field.type = Arrow::Int;
+            field.parameter = 64;
+            break;
+        case PropertyColumn::Double:
+            field.type = Arrow::FloatingPoint;
+            field.parameter = Arrow::DoublePrecision;
+            break;
+        case PropertyColumn::String:
+        case PropertyColumn::Variant:
+            field.type = Arrow::Utf8;
+            break;
+        }
+        m_fields.append(field);
+    }
+    
+    QByteArray magic(Arrow::Magic, sizeof(Arrow::Magic));
+    FlatBufferWriter::pad(magic, Arrow::Alignment);
+    QByteArray schema = encodeMessage(Arrow::SchemaHeader, 0, [this](QByteArray& buffer, qsizetype field) {
+        appendSchema(buffer, field);
+    });
+    if (!writeBlock(magic) || !writeMessage(schema, QByteArray(), false)) {
+        return false;
+    }
+    
+    for (qsizetype first = 0; first < store.featureCount(); first += m_batchSize) {
+        qsizetype last = qMin(first + m_batchSize, store.featureCount());
+        Body body;
+        if (m_hasGeometry) {
+            encodeGeometry(store, first, last, body);
+        }
+        for (const PropertyColumn& column : columns) {
+            encodeColumn(column, first, last, body);
+        }
+        QByteArray message = encodeMessage(Arrow::RecordBatchHeader, body.data.size(), [&](QByteArray& buffer, qsizetype field) {
+            FlatBufferWriter batch;
+            batch.add<qint64>(Arrow::RecordBatchLength, last - first);
+            batch.addOffset(Arrow::RecordBatchNodes);
+            batch.addOffset(Arrow::RecordBatchBuffers);
+            FlatBufferWriter::patch(buffer, field, batch.finish(buffer));
+            FlatBufferWriter::patch(buffer, batch.position(Arrow::RecordBatchNodes),
+                                    FlatBufferWriter::appendVector(buffer, body.nodes.constData(), body.nodes.size() / Arrow::FieldNodeSize, Arrow::FieldNodeSize));
+            FlatBufferWriter::patch(buffer, batch.position(Arrow::RecordBatchBuffers),
+                                    FlatBufferWriter::appendVector(buffer, body.buffers.constData(), body.buffers.size() / Arrow::BufferSize, Arrow::BufferSize));
+        });
+        if (!writeMessage(message, body.data, true)) {
+            return false;
+        }
+    }
+    
+    // The end-of-stream marker, then the footer repeating the schema and
+    // locating every record batch
+    QByteArray footer(4, '\0');
+    FlatBufferWriter table;
+    table.add<qint16>(Arrow::FooterVersion, Arrow::V5);
+    table.addOffset(Arrow::FooterSchema);
+    table.addOffset(Arrow::FooterRecordBatches);
+    FlatBufferWriter::patch(footer, 0, table.finish(footer));
+    appendSchema(footer, table.position(Arrow::FooterSchema));
+    FlatBufferWriter::patch(footer, table.position(Arrow::FooterRecordBatches),
+                            FlatBufferWriter::appendVector(footer, m_blocks.constData(), m_blockCount, Arrow::BlockSize));
+    
+    QByteArray end;
+    appendLE(end, Arrow::Continuation);
+    appendLE(end, quint32(0));
+    QByteArray trailer;
+    appendLE(trailer, qint32(footer.size()));
+    trailer.append(Arrow::Magic, sizeof(Arrow::Magic));
+    return writeBlock(end) && writeBlock(footer) && writeBlock(trailer);
+}
+
+ArrowWriter::Field ArrowWriter::geometryField(const FeatureStore& store)
+{
+    // Single and Multi* geometries of one family share the Multi* encoding;
+    // other mixes and collections fall back to WKB
+    m_hasGeometry = false;
+    m_geometryType = FeatureStore::NoGeometry;
+    bool mixed = false;
+    for (qsizetype feature = 0; feature < store.featureCount() && !mixed; ++feature) {
+        FeatureStore::GeometryType type = store.geometryType(feature);
+        if (type == FeatureStore::NoGeometry) {
+            continue;
+        }
+        if (!m_hasGeometry) {
+            m_geometryType = type;
+            m_hasGeometry = true;
+        } else if (type != m_geometryType) {
+            int family = (type - 1) % 3;
+            int current = (m_geometryType - 1) % 3;
+            if (type == FeatureStore::GeometryCollection || m_geometryType == FeatureStore::GeometryCollection || family != current) {
+                mixed = true;
+            } else {
+                m_geometryType = FeatureStore::GeometryType(family + FeatureStore::MultiPoint);
+            }
+        }
+    }
+    if (mixed || m_geometryType == FeatureStore::GeometryCollection) {
+        m_geometryType = FeatureStore::NoGeometry;
+    }
+    
+    Field field;
+    field.name = "geometry";
+    if (m_geometryType == FeatureStore::NoGeometry) {
+        field.type = Arrow::Binary;
+        field.extension = "geoarrow.wkb";
+        return field;
+    }
+    
+    // Interleaved x/y pairs, nested in one list per level above them
+    Field coordinates;
+    coordinates.type = Arrow::FixedSizeList;
+    coordinates.parameter = 2;
+    Field xy;
+    xy.name = "xy";
+    xy.type = Arrow::FloatingPoint;
+    xy.parameter = Arrow::DoublePrecision;
+    coordinates.children.append(xy);
+    
+    static const char* const Names[][3] = {
+        {nullptr, nullptr, nullptr},
+        {"vertices", nullptr, nullptr},
+        {"rings", "vertices", nullptr},
+        {"points", nullptr, nullptr},
+        {"linestrings", "vertices", nullptr},
+        {"polygons", "rings", "vertices"}
+    };
+    static const char* const Extensions[] = {"geoarrow.point", "geoarrow.linestring", "geoarrow.polygon",
+                                             "geoarrow.multipoint", "geoarrow.multilinestring", "geoarrow.multipolygon"};
+    const char* const* names = Names[m_geometryType - 1];
+    Field* level = &field;
+    for (int i = 0; i < listLevels(m_geometryType); ++i) {
+        level->type = Arrow::List;
+        Field child;
+        child.name = names[i];
+        level->children.append(child);
+        level = &level->children.last();
+    }
+    QByteArray name = level->name;
+    *level = coordinates;
+    level->name = name;
+    field.name = "geometry";
+    field.extension = Extensions[m_geometryType - 1];
+    return field;
+}
+
+void ArrowWriter::appendSchema(QByteArray& buffer, qsizetype slot) const
+{
+    FlatBufferWriter schema;
+    schema.addOffset(Arrow::SchemaFields);
+    FlatBufferWriter::patch(buffer, slot, schema.finish(buffer));
+    
+    std::function<void(QByteArray&, qsizetype, const QVector<Field>&)> appendFields;
+    appendFields = [&appendFields](QByteArray& data, qsizetype vector, const QVector<Field>& fields) {
+        for (qsizetype i = 0; i < fields.size(); ++i) {
+            const Field& field = fields[i];
+            appendField(data, vector + i * 4, field.name, field.type, field.parameter, field.extension,
+                        [&appendFields, &field](QByteArray& children, qsizetype position) {
+                            appendFields(children, position, field.children);
+                        },
+                        field.children.size());
+        }
+    };
+    qsizetype fields = FlatBufferWriter::appendVector(buffer, nullptr, m_fields.size(), 4);
+    FlatBufferWriter::patch(buffer, schema.position(Arrow::SchemaFields), fields);
+    appendFields(buffer, fields + 4, m_fields);
+}
+
+void ArrowWriter::encodeGeometry(const FeatureStore& store, qsizetype first, qsizetype last, Body& body) const
+{
+    qsizetype rows = last - first;
+    QByteArray validity((rows + 7) / 8, '\0');
+    qint64 nullCount = 0;
+    
+    if (m_geometryType == FeatureStore::NoGeometry) {
+        QVector<qint32> offsets{0};
+        QByteArray wkb;
+        for (qsizetype feature = first; feature < last; ++feature) {
+            if (store.geometryType(feature) == FeatureStore::NoGeometry) {
+                ++nullCount;
+            } else {
+                setBit(validity, feature - first);
+                appendWkb(wkb, store, feature);
+            }
+            offsets.append(qint32(wkb.size()));
+        }
+        body.addNode(rows, nullCount);
+        body.addBuffer(nullCount > 0 ? validity : QByteArray());
+        body.addBuffer(littleEndian(offsets));
+        body.addBuffer(wkb);
+        return;
+    }
+    
+    // One offset array per list level, counting items of the next level;
+    // null rows repeat the previous offset, or hold NaN for points
+    int levels = listLevels(m_geometryType);
+    QVector<qint32> offsets[3] = {{0}, {0}, {0}};
+    QVector<double> xy;
+    for (qsizetype feature = first; feature < last; ++feature) {
+        qsizetype firstPart = store.partBegin(feature);
+        qsizetype lastPart = store.partEnd(feature);
+        if (store.geometryType(feature) == FeatureStore::NoGeometry) {
+            ++nullCount;
+            lastPart = firstPart;
+        } else {
+            setBit(validity, feature - first);
+        }
+        
+        switch (m_geometryType) {
+        case FeatureStore::Point:
+            if (firstPart < lastPart && store.ringBegin(firstPart) < store.ringEnd(firstPart)
+                && store.coordinateBegin(store.ringBegin(firstPart)) < store.coordinateEnd(store.ringBegin(firstPart))) {
+                qsizetype coordinate = store.coordinateBegin(store.ringBegin(firstPart));
+                xy.append(store.x(coordinate));
+                xy.append(store.y(coordinate));
+            } else {
+                xy.append(NAN);
+                xy.append(NAN);
+            }
+            break;
+        case FeatureStore::LineString:
+        case FeatureStore::MultiPoint:
+            for (qsizetype part = firstPart; part < lastPart; ++part) {
+                for (qsizetype ring = store.ringBegin(part); ring < store.ringEnd(part); ++ring) {
+                    appendCoordinates(store, ring, xy);
+                }
+            }
+            offsets[0].append(qint32(xy.size() / 2));
+            break;
+        case FeatureStore::Polygon:
+        case FeatureStore::MultiLineString:
+            // Rings of a polygon or the lines of a MultiLineString
+            for (qsizetype part = firstPart; part < lastPart; ++part) {
+                for (qsizetype ring = store.ringBegin(part); ring < store.ringEnd(part); ++ring) {
+                    appendCoordinates(store, ring, xy);
+                    offsets[1].append(qint32(xy.size() / 2));
+                }
+            }
+            offsets[0].append(qint32(offsets[1].size() - 1));
+            break;
+        case FeatureStore::MultiPolygon:
+            for (qsizetype part = firstPart; part < lastPart; ++part) {
+                for (qsizetype ring = store.ringBegin(part); ring < store.ringEnd(part); ++ring) {
+                    appendCoordinates(store, ring, xy);
+                    offsets[2].append(qint32(xy.size() / 2));
+                }
+                offsets[1].append(qint32(offsets[2].size() - 1));
+            }
+            offsets[0].append(qint32(offsets[1].size() - 1));
+            break;
+        case FeatureStore::NoGeometry:
+        case FeatureStore::GeometryCollection:
+            break;
+        }
+    }
+    
+    // Nulls are recorded on the outermost array only
+    qint64 length = rows;
+    for (int level = 0; level < levels; ++level) {
+        body.addNode(length, level == 0 ? nullCount : 0);
+        body.addBuffer(level == 0 && nullCount > 0 ? validity : QByteArray());
+        body.addBuffer(littleEndian(offsets[level]));
+        length = offsets[level].last();
+    }
+    body.addNode(length, levels == 0 ? nullCount : 0);
+    body.addBuffer(levels == 0 && nullCount > 0 ? validity : QByteArray());
+    body.addNode(length * 2, 0);
+    body.addBuffer(QByteArray());
+    body.addBuffer(littleEndian(xy));
+}
+
+void ArrowWriter::encodeColumn(const PropertyColumn& column, qsizetype first, qsizetype last, Body& body) const
+{
+    qsizetype rows = last - first;
+    if (column.type() == PropertyColumn::Null) {
+        body.addNode(rows, rows);
+        return;
+    }
+    
+    QByteArray validity((rows + 7) / 8, '\0');
+    qint64 nullCount = 0;
+    for (qsizetype row = first; row < last; ++row) {
+        if (column.isNull(row)) {
+            ++nullCount;
+        } else {
+            setBit(validity, row - first);
+        }
+    }
+    body.addNode(rows, nullCount);
+    body.addBuffer(nullCount > 0 ? validity : QByteArray());
+    
+    switch (column.type()) {
+    case PropertyColumn::Bool: {
+        QByteArray bits((rows + 7) / 8, '\0');
+        for (qsizetype row = first; row < last; ++row) {
+            if (!column.isNull(row) && column.value(row).toBool()) {
+                setBit(bits, row - first);
+            }
+        }
+        body.addBuffer(bits);
+        break;
+    }
+    case PropertyColumn::Int: {
+        QVector<qint64> values(rows, 0);
+        for (qsizetype row = first; row < last; ++row) {
+            if (!column.isNull(row)) {
+                values[row - first] = column.value(row).toLongLong();
+            }
+        }
+        body.addBuffer(littleEndian(values));
+        break;
+    }
+    case PropertyColumn::Double: {
+        QVector<double> values(rows, 0);
+        for (qsizetype row = first; row < last; ++row) {
+            if (!column.isNull(row)) {
+                values[row - first] = column.value(row).toDouble();
+            }
+        }
+        body.addBuffer(littleEndian(values));
+        break;
+    }
+    default: {
+        QVector<qint32> offsets{0};
+        QByteArray text;
+        for (qsizetype row = first; row < last; ++row) {
+            if (!column.isNull(row)) {
+                text.append(textValue(column.value(row)));
+            }
+            offsets.append(qint32(text.size()));
+        }
+        body.addBuffer(littleEndian(offsets));
+        body.addBuffer(text);
+        break;
+    }
+    }
+}
+
+bool ArrowWriter::writeMessage(const QByteArray& message, const QByteArray& body, bool recordBatch)
+{
+    if (recordBatch) {
+        appendLE(m_blocks, m_offset);
+        appendLE(m_blocks, qint32(8 + message.size()));
+        appendLE(m_blocks, qint32(0));
+        appendLE(m_blocks, qint64(body.size()));
+        ++m_blockCount;
+    }
+    QByteArray prefix;
+    appendLE(prefix, Arrow::Continuation);
+    appendLE(prefix, qint32(message.size()));
+    return writeBlock(prefix) && writeBlock(message) && writeBlock(body);
+}
+
+bool ArrowWriter::writeBlock(const QByteArray& data)
+{
+    if (m_device->write(data) != data.size()) {
+        m_error = m_device->errorString();
+        return false;
+    }
+    m_offset += data.size();
+    return true;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "FeatureStore.h"
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+
+class QIODevice;
+
+// Writes a FeatureStore as an uncompressed Arrow IPC file (Feather V2) with
+// a GeoArrow geometry column named "geometry". Layers of a single geometry
+// family use the native encoding with interleaved coordinates, the Multi*
+// one when single and multi geometries are mixed; any other mix is written
+// as WKB. Properties become boolean, 64-bit integer, double or UTF-8 columns,
+// with mixed-type values written as text. Features are split into record
+// batches of a fixed size. Feature ids are not written.
+class ArrowWriter
+{
+public:
+    explicit ArrowWriter(QIODevice* device);
+    
+    // Features per record batch
+    void setBatchSize(qsizetype rows) { m_batchSize = qMax<qsizetype>(1, rows); }
+    
+    bool write(const FeatureStore& store);
+    QString errorString() const { return m_error; }
+
+private:
+    struct Field {
+        QByteArray name;
+        quint8 type = 0;
+        // Int width, FloatingPoint precision or FixedSizeList size
+        int parameter = 0;
+        QByteArray extension;
+        QVector<Field> children;
+    };
+    
+    // A record batch body under construction: its field nodes, the offset
+    // and length of each buffer, and the buffers themselves
+    struct Body {
+        QByteArray nodes;
+        QByteArray buffers;
+        QByteArray data;
+        void addNode(qint64 length, qint64 nullCount);
+        void addBuffer(const char* bytes, qint64 size);
+        void addBuffer(const QByteArray& bytes) { addBuffer(bytes.constData(), bytes.size()); }
+    };
+    
+    Field geometryField(const FeatureStore& store);
+    void appendSchema(QByteArray& buffer, qsizetype slot) const;
+    void encodeGeometry(const FeatureStore& store, qsizetype first, qsizetype last, Body& body) const;
+    void encodeColumn(const PropertyColumn& column, qsizetype first, qsizetype last, Body& body) const;
+    // Writes an encapsulated message; record batches are added to the footer
+    bool writeMessage(const QByteArray& message, const QByteArray& body, bool recordBatch);
+    bool writeBlock(const QByteArray& data);
+    
+    QIODevice* m_device;
+    qsizetype m_batchSize;
+    
+    QVector<Field> m_fields;
+    // GeoArrow type of the geometry column; NoGeometry stands for WKB
+    FeatureStore::GeometryType m_geometryType;
+    bool m_hasGeometry;
+    
+    qint64 m_offset;
+    // Footer blocks of the record batches
+    QByteArray m_blocks;
+    qsizetype m_blockCount;
+    QString m_error;
+};
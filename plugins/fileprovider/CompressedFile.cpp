@@ -0,0 +1,192 @@
+#include "CompressedFile.h"
+#include "InflateDevice.h"
+#include "ReadAheadDevice.h"
+#include <QFileInfo>
+#include <QtEndian>
+#ifdef HAVE_ZSTD
+#include "ZstdDevice.h"
+#endif
+
+namespace {
+
+// Buffer growth step while reading data of unknown size
+const qint64 ReadBlock = 4 * 1024 * 1024;
+
+// Members of the archive that hold no data, such as the resource forks
+// macOS adds
+bool isSkipped(const QString& name)
+{
+    return name.endsWith('/') || name.startsWith("__MACOSX/") || name.contains("/__MACOSX/");
+}
+
+} // namespace
+
+CompressedFile::Compression CompressedFile::compression(const QString& filePath)
+{
+    QString suffix = QFileInfo(filePath).suffix().toLower();
+    if (suffix == "gz") {
+        return Gzip;
+    } else if (suffix == "zst") {
+        return Zstd;
+    } else if (suffix == "zip") {
+        return Zip;
+    }
+    return None;
+}
+
+QString CompressedFile::strippedName(const QString& filePath)
+{
+    QFileInfo fileInfo(filePath);
+    if (compression(filePath) == None) {
+        return fileInfo.fileName();
+    }
+    return fileInfo.fileName().left(fileInfo.fileName().size() - fileInfo.suffix().size() - 1);
+}
+
+bool CompressedFile::open(const QString& filePath, const QStringList& memberSuffixes)
+{
+    m_compression = compression(filePath);
+    m_member = -1;
+    m_dataName = strippedName(filePath);
+    m_uncompressedSize = -1;
+    m_error.clear();
+    
+    if (m_compression == None) {
+        m_error = "Not a compressed file";
+        return false;
+    }
+    if (m_compression == Zip) {
+        if (!m_archive.open(filePath)) {
+            m_error = m_archive.errorString();
+            return false;
+        }
+        const QVector<ZipArchive::Entry>& entries = m_archive.entries();
+        for (const QString& suffix : memberSuffixes) {
+            for (qsizetype i = 0; i < entries.size() && m_member < 0; ++i) {
+                if (!isSkipped(entries[i].name) && QFileInfo(entries[i].name).suffix().compare(suffix, Qt::CaseInsensitive) == 0) {
+                    m_member = i;
+                }
+            }
+        }
+        if (m_member < 0) {
+            m_error = "No supported data file in the archive";
+            return false;
+        }
+        m_dataName = entries[m_member].name;
+        m_compressedSize = entries[m_member].compressedSize;
+        m_uncompressedSize = entries[m_member].uncompressedSize;
+        return true;
+    }
+    
+    if (!m_file.open(filePath)) {
+        m_error = m_file.errorString();
+        return false;
+    }
+    m_compressedSize = m_file.size();
+    if (m_compression == Gzip) {
+        // The trailer of the last member ends with the size modulo 2^32;
+        // deflate expands data at most 1032 times, so larger values are wrong
+        if (m_file.size() >= 18) {
+            m_uncompressedSize = qFromLittleEndian<quint32>(m_file.data() + m_file.size() - 4);
+            if (m_uncompressedSize > m_file.size() * 1032) {
+                m_uncompressedSize = -1;
+            }
+        }
+    } else {
+#ifdef HAVE_ZSTD
+        m_uncompressedSize = ZstdDevice::contentSize(m_file.data(), m_file.size());
+#else
+        m_error = "Zstandard support is not built in";
+        return false;
+#endif
+    }
+    return true;
+}
+
+std::unique_ptr<QIODevice> CompressedFile::openStream()
+{
+    std::unique_ptr<QIODevice> decoder = openDecoder();
+    if (!decoder) {
+        return nullptr;
+    }
+    auto stream = std::make_unique<ReadAheadDevice>(std::move(decoder));
+    if (!stream->open(QIODevice::ReadOnly)) {
+        m_error = stream->errorString();
+        return nullptr;
+    }
+    return stream;
+}
+
+bool CompressedFile::readAll(QByteArray& data)
+{
+    std::unique_ptr<QIODevice> decoder = openDecoder();
+    return decoder && readDevice(decoder.get(), m_uncompressedSize, data);
+}
+
+bool CompressedFile::readSibling(const QString& suffix, QByteArray& data)
+{
+    if (m_compression != Zip || m_member < 0) {
+        return false;
+    }
+    QString name = m_dataName.left(m_dataName.size() - QFileInfo(m_dataName).suffix().size()) + suffix;
+    for (const ZipArchive::Entry& entry : m_archive.entries()) {
+        if (entry.name.compare(name, Qt::CaseInsensitive) == 0) {
+            std::unique_ptr<QIODevice> device = m_archive.openEntry(entry);
+            if (!device) {
+                m_error = m_archive.errorString();
+                return false;
+            }
+            return readDevice(device.get(), entry.uncompressedSize, data);
+        }
+    }
+    return false;
+}
+
+// Open device decompressing the data on the calling thread
+std::unique_ptr<QIODevice> CompressedFile::openDecoder()
+{
+    if (m_compression == Zip) {
+        if (m_member < 0) {
+            return nullptr;
+        }
+        std::unique_ptr<QIODevice> device = m_archive.openEntry(m_archive.entries()[m_member]);
+        if (!device) {
+            m_error = m_archive.errorString();
+        }
+        return device;
+    }
+    
+    std::unique_ptr<QIODevice> device;
+    if (m_compression == Gzip) {
+        device = std::make_unique<InflateDevice>(m_file.data(), m_file.size(), InflateDevice::Gzip);
+#ifdef HAVE_ZSTD
+    } else if (m_compression == Zstd) {
+        device = std::make_unique<ZstdDevice>(m_file.data(), m_file.size());
+#endif
+    }
+    if (!device || !device->open(QIODevice::ReadOnly)) {
+        m_error = device ? device->errorString() : QString("File is not open");
+        return nullptr;
+    }
+    return device;
+}
+
+bool CompressedFile::readDevice(QIODevice* device, qint64 sizeHint, QByteArray& data)
+{
+    data.clear();
+    if (sizeHint > 0) {
+        data.reserve(sizeHint + 1);
+    }
+    while (!device->atEnd()) {
+        qsizetype size = data.size();
+        data.resize(size + qMax<qint64>(ReadBlock, data.capacity() - size));
+        qint64 read = device->read(data.data() + size, data.size() - size);
+        data.truncate(size + qMax<qint64>(read, 0));
+        if (read < 0 || (read == 0 && !device->atEnd())) {
+            m_error = device->errorString();
+            data.clear();
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "MappedFile.h"
+#include "ZipArchive.h"
+#include <QByteArray>
+#include <QIODevice>
+#include <QString>
+#include <QStringList>
+#include <memory>
+
+// A data file stored compressed: gzip (.gz), Zstandard (.zst, when built
+// with libzstd) or a zip archive holding the data file. The data format is
+// named by the suffix under the compression one, as in roads.csv.gz, or by
+// the suffix of the archive member. Data is decompressed in memory as it
+// is read, never to disk.
+class CompressedFile
+{
+public:
+    enum Compression {
+        None,
+        Gzip,
+        Zstd,
+        Zip
+    };
+    
+    // Recognised by the file's last suffix
+    static Compression compression(const QString& filePath);
+    // File name without its compression suffix: roads.csv for roads.csv.gz
+    static QString strippedName(const QString& filePath);
+    
+    // In a zip archive the data member is the first one whose suffix comes
+    // first in memberSuffixes
+    bool open(const QString& filePath, const QStringList& memberSuffixes);
+    
+    Compression compression() const { return m_compression; }
+    // Name of the compressed data: the archive member or the stripped name
+    QString dataName() const { return m_dataName; }
+    qint64 compressedSize() const { return m_compressedSize; }
+    // Size of the data as recorded by the file, or -1. Gzip only records it
+    // modulo 4 GB, so it is a hint rather than a bound.
+    qint64 uncompressedSize() const { return m_uncompressedSize; }
+    
+    // Returns an open device streaming the decompressed data, which is
+    // decompressed on a background thread a few blocks ahead of the reader
+    std::unique_ptr<QIODevice> openStream();
+    // Decompresses all of the data into memory
+    bool readAll(QByteArray& data);
+    // Reads the zip member named like the data member but with another
+    // suffix, such as the .dbf of a .shp. False when there is none.
+    bool readSibling(const QString& suffix, QByteArray& data);
+    
+    QString errorString() const { return m_error; }
+
+private:
+    std::unique_ptr<QIODevice> openDecoder();
+    bool readDevice(QIODevice* device, qint64 sizeHint, QByteArray& data);
+    
+    Compression m_compression = None;
+    MappedFile m_file;
+    ZipArchive m_archive;
+    qsizetype m_member = -1;
+    QString m_dataName;
+    qint64 m_compressedSize = 0;
+    qint64 m_uncompressedSize = -1;
+    QString m_error;
+};
@@ -0,0 +1,446 @@
+#include "CsvReader.h"
+#include "CsvScanner.h"
+#include "WktReader.h"
+#include <QFuture>
+#include <QThread>
+#include <QThreadPool>
+#include <QtConcurrentRun>
+#include <atomic>
+#include <charconv>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+const qint64 ProgressInterval = 65536;
+const qsizetype MinChunkSize = 1 << 20;
+const qsizetype ChunksPerThread = 4;
+
+struct ChunkResult {
+    FeatureStore store;
+    bool ok = false;
+    std::atomic<bool> done{false};
+};
+
+bool equalsIgnoreCase(QByteArrayView field, const char* word)
+{
+    qsizetype length = qsizetype(std::strlen(word));
+    if (field.size() != length) {
+        return false;
+    }
+    for (qsizetype i = 0; i < length; ++i) {
+        char c = field[i];
+        if (c >= 'A' && c <= 'Z') {
+            c = char(c - 'A' + 'a');
+        }
+        if (c != word[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool parseInteger(QByteArrayView field, qint64& value)
+{
+    const char* begin = field.data();
+    const char* end = begin + field.size();
+    if (begin < end && *begin == '+') {
+        ++begin;
+    }
+    if (begin == end) {
+        return false;
+    }
+    
+    auto result = std::from_chars(begin, end, value);
+    return result.ec == std::errc() && result.ptr == end;
+}
+
+bool parseDouble(QByteArrayView field, double& value)
+{
+    const char* begin = field.data();
+    const char* end = begin + field.size();
+    if (begin < end && *begin == '+') {
+        ++begin;
+    }
+    if (begin == end || !((*begin >= '0' && *begin <= '9') || *begin == '-' || *begin == '.')) {
+        return false;
+    }
+    
+    auto result = std::from_chars(begin, end, value);
+    return result.ec == std::errc() && result.ptr == end;
+}
+
+// Values such as ZIP codes with a leading zero are kept as text
+bool hasLeadingZero(QByteArrayView field)
+{
+    qsizetype i = (field.startsWith('-') || field.startsWith('+')) ? 1 : 0;
+    return field.size() - i > 1 && field[i] == '0' && field[i + 1] >= '0' && field[i + 1] <= '9';
+}
+
+// Header names recognized as geometry columns
+const QStringList LongitudeNames = {"lon", "lng", "long", "longitude"};
+const QStringList LatitudeNames = {"lat", "latitude"};
+const QStringList XNames = {"x", "easting"};
+const QStringList YNames = {"y", "northing"};
+const QStringList WktNames = {"wkt", "geometry", "geom", "the_geom", "wkt_geom", "shape"};
+
+int findColumn(const QStringList& headers, const QStringList& candidates)
+{
+    for (const QString& candidate : candidates) {
+        for (int i = 0; i < headers.size(); ++i) {
+            if (headers[i].trimmed().compare(candidate, Qt::CaseInsensitive) == 0) {
+                return i;
+            }
+        }
+    }
+    return -1;
+}
+
+} // namespace
+
+CsvReader::CsvReader(const char* data, qsizetype size)
+    : m_data(data)
+    , m_size(size)
+    , m_bomSize(0)
+    , m_headerEnd(0)
+    , m_delimiter(0)
+    , m_threads(0)
+    , m_xColumn(-1)
+    , m_yColumn(-1)
+    , m_wktColumn(-1)
+    , m_cancelled(false)
+{
+    if (m_size >= 3 && std::memcmp(m_data, "\xEF\xBB\xBF", 3) == 0) {
+        m_bomSize = 3;
+        m_data += m_bomSize;
+        m_size -= m_bomSize;
+    }
+}
+
+void CsvReader::setCoordinateFields(const QString& xField, const QString& yField)
+{
+    m_xField = xField;
+    m_yField = yField;
+}
+
+int CsvReader::threadCount() const
+{
+    return m_threads > 0 ? m_threads : QThread::idealThreadCount();
+}
+
+bool CsvReader::read(FeatureStore& store, const IngestProgress& progress, QThreadPool* pool)
+{
+    m_cancelled = false;
+    m_error.clear();
+    
+    char delimiter = m_delimiter ? m_delimiter : detectDelimiter();
+    CsvScanner scanner(m_data, m_size, delimiter);
+    QVector<QByteArrayView> fields;
+    if (!scanner.nextRecord(fields)) {
+        m_error = "CSV file has no header";
+        return false;
+    }
+    readHeader(fields);
+    m_headerEnd = m_bomSize + scanner.position();
+    prepareColumns(store);
+    
+    if (threadCount() > 1 && m_size - scanner.position() >= 2 * MinChunkSize) {
+        return readParallel(store, scanner.position(), delimiter, progress, pool);
+    }
+    
+    qint64 records = 0;
+    if (!readRecords(scanner, store, progress, records)) {
+        m_cancelled = true;
+        return false;
+    }
+    if (progress) {
+        progress(scanner.position(), records);
+    }
+    return true;
+}
+
+// Appends every remaining record of the scanner. Returns false when the
+// progress callback asked to stop.
+bool CsvReader::readRecords(CsvScanner& scanner, FeatureStore& store, const IngestProgress& progress, qint64& records)
+{
+    QVector<QByteArrayView> fields;
+    while (scanner.nextRecord(fields)) {
+        // Skip blank lines
+        if (fields.size() == 1 && fields[0].isEmpty()) {
+            continue;
+        }
+        appendRecord(store, fields);
+        
+        if (progress && ++records % ProgressInterval == 0 && !progress(scanner.position(), records)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Splits the records after the header into newline-aligned chunks that are
+// parsed on a thread pool into separate stores and appended in file order.
+// Split points must not fall inside a quoted field, so the quote parity of
+// every slice is counted first (in parallel) and each split is moved forward
+// to the next line feed outside quotes. The calling thread and threads - 1
+// pool tasks take chunks in turn until none are left, so a busy pool only
+// slows the read down.
+bool CsvReader::readParallel(FeatureStore& store, qsizetype begin, char delimiter, const IngestProgress& progress,
+                             QThreadPool* pool)
+{
+    int threads = threadCount();
+    qsizetype chunkCount = qBound<qsizetype>(1, (m_size - begin) / MinChunkSize, threads * ChunksPerThread);
+    QVector<qsizetype> targets;
+    for (qsizetype chunk = 0; chunk <= chunkCount; ++chunk) {
+        targets.append(begin + (m_size - begin) * chunk / chunkCount);
+    }
+    if (!pool) {
+        pool = QThreadPool::globalInstance();
+    }
+    
+    QVector<qsizetype> quotes(chunkCount);
+    std::atomic<qsizetype> nextCount(0);
+    auto countQuotes = [this, &targets, &quotes, &nextCount, chunkCount]() {
+        for (qsizetype chunk = nextCount++; chunk < chunkCount; chunk = nextCount++) {
+            quotes[chunk] = CsvScanner::countQuotes(m_data + targets[chunk], targets[chunk + 1] - targets[chunk]);
+        }
+    };
+    QVector<QFuture<void>> counts;
+    for (qsizetype worker = 1; worker < qMin<qsizetype>(threads, chunkCount); ++worker) {
+        counts.append(QtConcurrent::run(pool, countQuotes));
+    }
+    countQuotes();
+    for (QFuture<void>& count : counts) {
+        count.waitForFinished();
+    }
+    
+    QVector<qsizetype> bounds{begin};
+    bool inQuotes = false;
+    for (qsizetype chunk = 1; chunk < chunkCount; ++chunk) {
+        inQuotes ^= (quotes[chunk - 1] & 1) != 0;
+        qsizetype target = targets[chunk];
+        qsizetype start = target;
+        if (inQuotes || m_data[target - 1] != '\n') {
+            // Skip the rest of the record the target falls into
+            CsvScanner probe(m_data + target, m_size - target, delimiter, inQuotes);
+            QVector<QByteArrayView> skipped;
+            probe.nextRecord(skipped);
+            start = target + probe.position();
+        }
+        bounds.append(qMax(bounds.last(), start));
+    }
+    bounds.append(m_size);
+    
+    std::vector<ChunkResult> results(chunkCount);
+    std::atomic<qsizetype> nextChunk(0);
+    std::atomic<bool> stop(false);
+    auto parseChunk = [this, &bounds, &results, &stop, delimiter](qsizetype chunk) {
+        ChunkResult& result = results[chunk];
+        CsvReader reader(*this);
+        reader.prepareColumns(result.store);
+        CsvScanner scanner(m_data + bounds[chunk], bounds[chunk + 1] - bounds[chunk], delimiter);
+        qint64 records = 0;
+        result.ok = reader.readRecords(scanner, result.store, [&stop](qint64, qint64) {
+            return !stop.load(std::memory_order_relaxed);
+        }, records);
+        result.done.store(true, std::memory_order_release);
+    };
+    auto parseChunks = [&parseChunk, &nextChunk, &stop, chunkCount]() {
+        for (qsizetype chunk = nextChunk++; chunk < chunkCount && !stop.load(std::memory_order_relaxed); chunk = nextChunk++) {
+            parseChunk(chunk);
+        }
+    };
+    
+    // Stitch the chunks together in file order as they complete; the
+    // calling thread does so after each of its own chunks
+    bool ok = true;
+    qsizetype merged = 0;
+    auto mergeParsed = [&]() {
+        for (; ok && merged < chunkCount && results[merged].done.load(std::memory_order_acquire); ++merged) {
+            store.append(results[merged].store);
+            results[merged].store.clear();
+            if (!results[merged].ok || (progress && !progress(bounds[merged + 1], store.featureCount()))) {
+                m_cancelled = true;
+                stop = true;
+                ok = false;
+            }
+        }
+    };
+    
+    QVector<QFuture<void>> futures;
+    for (qsizetype worker = 1; worker < qMin<qsizetype>(threads, chunkCount); ++worker) {
+        futures.append(QtConcurrent::run(pool, parseChunks));
+    }
+    for (qsizetype chunk = nextChunk++; chunk < chunkCount && !stop.load(std::memory_order_relaxed); chunk = nextChunk++) {
+        parseChunk(chunk);
+        mergeParsed();
+    }
+    for (QFuture<void>& future : futures) {
+        future.waitForFinished();
+    }
+    mergeParsed();
+    return ok;
+}
+
+// Picks the most frequent of the common delimiters outside quotes on the
+// first line, defaulting to a comma
+char CsvReader::detectDelimiter() const
+{
+    const char candidates[] = {',', ';', '\t', '|'};
+    int counts[4] = {0, 0, 0, 0};
+    bool inQuotes = false;
+    
+    for (qsizetype i = 0; i < m_size && (inQuotes || m_data[i] != '\n'); ++i) {
+        if (m_data[i] == '"') {
+            inQuotes = !inQuotes;
+        } else if (!inQuotes) {
+            for (int c = 0; c < 4; ++c) {
+                counts[c] += m_data[i] == candidates[c];
+            }
+        }
+    }
+    
+    int best = 0;
+    for (int c = 1; c < 4; ++c) {
+        if (counts[c] > counts[best]) {
+            best = c;
+        }
+    }
+    return candidates[best];
+}
+
+void CsvReader::readHeader(const QVector<QByteArrayView>& fields)
+{
+    m_headers.clear();
+    
+    for (int i = 0; i < fields.size(); ++i) {
+        QString name = QString::fromUtf8(CsvScanner::unquote(fields[i], m_scratch)).trimmed();
+        if (name.isEmpty()) {
+            name = QString("field_%1").arg(i + 1);
+        }
+        
+        // Duplicate names get a numeric suffix so no column is lost
+        QString unique = name;
+        for (int suffix = 2; m_headers.contains(unique); ++suffix) {
+            unique = QString("%1_%2").arg(name).arg(suffix);
+        }
+        m_headers.append(unique);
+    }
+    
+    detectGeometryColumns();
+}
+
+// Creates a column per header field so they keep the file's order
+void CsvReader::prepareColumns(FeatureStore& store)
+{
+    m_columns.clear();
+    for (const QString& header : m_headers) {
+        store.column(header);
+        m_columns.append(store.columnIndex(header));
+    }
+}
+
+void CsvReader::detectGeometryColumns()
+{
+    m_xColumn = -1;
+    m_yColumn = -1;
+    m_wktColumn = -1;
+    
+    if (!m_wktField.isEmpty()) {
+        m_wktColumn = findColumn(m_headers, {m_wktField});
+        return;
+    }
+    if (!m_xField.isEmpty() && !m_yField.isEmpty()) {
+        m_xColumn = findColumn(m_headers, {m_xField});
+        m_yColumn = findColumn(m_headers, {m_yField});
+        return;
+    }
+    
+    // Longitude/latitude first, then planar x/y, then WKT
+    m_xColumn = findColumn(m_headers, LongitudeNames);
+    m_yColumn = findColumn(m_headers, LatitudeNames);
+    if (m_xColumn < 0 || m_yColumn < 0) {
+        m_xColumn = findColumn(m_headers, XNames);
+        m_yColumn = findColumn(m_headers, YNames);
+    }
+    if (m_xColumn < 0 || m_yColumn < 0) {
+        m_xColumn = -1;
+        m_yColumn = -1;
+        m_wktColumn = findColumn(m_headers, WktNames);
+    }
+}
+
+bool CsvReader::hasGeometryFields(const QStringList& headers)
+{
+    return (findColumn(headers, LongitudeNames) >= 0 && findColumn(headers, LatitudeNames) >= 0)
+        || (findColumn(headers, XNames) >= 0 && findColumn(headers, YNames) >= 0)
+        || findColumn(headers, WktNames) >= 0;
+}
+
+void CsvReader::appendRecord(FeatureStore& store, const QVector<QByteArrayView>& fields)
+{
+    store.beginFeature();
+    
+    if (m_wktColumn >= 0 && m_wktColumn < fields.size()) {
+        QByteArrayView text = CsvScanner::unquote(fields[m_wktColumn], m_scratch);
+        if (!text.isEmpty()) {
+            WktReader(text).read(store);
+        }
+    } else if (m_xColumn >= 0 && m_xColumn < fields.size() && m_yColumn < fields.size()) {
+        double x = 0.0;
+        double y = 0.0;
+        if (parseCoordinate(fields[m_xColumn], x) && parseCoordinate(fields[m_yColumn], y)) {
+            store.setGeometryType(FeatureStore::Point);
+            store.beginPart(FeatureStore::Point);
+            store.beginRing();
+            store.addCoordinate(x, y);
+        }
+    }
+    
+    qsizetype count = qMin(fields.size(), qsizetype(m_columns.size()));
+    for (qsizetype i = 0; i < count; ++i) {
+        appendValue(store.columnAt(m_columns[i]), fields[i]);
+    }
+    store.endFeature();
+}
+
+void CsvReader::appendValue(PropertyColumn& column, QByteArrayView field)
+{
+    if (field.isEmpty()) {
+        column.appendNull();
+        return;
+    }
+    
+    // Quoted values are always text
+    if (field[0] == '"') {
+        column.appendString(m_strings.intern(CsvScanner::unquote(field, m_scratch)));
+        return;
+    }
+    
+    char first = field[0];
+    if (((first >= '0' && first <= '9') || first == '-' || first == '+' || first == '.') && !hasLeadingZero(field)) {
+        qint64 integer = 0;
+        double number = 0.0;
+        if (parseInteger(field, integer)) {
+            column.appendInt(integer);
+            return;
+        }
+        if (parseDouble(field, number)) {
+            column.appendDouble(number);
+            return;
+        }
+    } else if (equalsIgnoreCase(field, "true")) {
+        column.appendBool(true);
+        return;
+    } else if (equalsIgnoreCase(field, "false")) {
+        column.appendBool(false);
+        return;
+    }
+    
+    column.appendString(m_strings.intern(field));
+}
+
+bool CsvReader::parseCoordinate(QByteArrayView field, double& value)
+{
+    return parseDouble(CsvScanner::unquote(field, m_scratch).trimmed(), value);
+}
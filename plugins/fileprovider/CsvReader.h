@@ -0,0 +1,86 @@
+#pragma once
+
+#include "FeatureStore.h"
+#include "StringPool.h"
+#include <QByteArray>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+class CsvScanner;
+class QThreadPool;
+
+// Reads delimited text into a FeatureStore. Unquoted values are typed as
+// they are read (integers, doubles, booleans), quoted values and anything
+// else are strings, and empty fields are null. Point geometry is built from
+// a longitude/latitude or x/y column pair, or a WKT column, detected from
+// the header unless set explicitly. Large inputs can be parsed on several
+// threads.
+class CsvReader
+{
+public:
+    CsvReader(const char* data, qsizetype size);
+    
+    // 0 detects the delimiter from the header line
+    void setDelimiter(char delimiter) { m_delimiter = delimiter; }
+    void setCoordinateFields(const QString& xField, const QString& yField);
+    void setWktField(const QString& wktField) { m_wktField = wktField; }
+    
+    // Records are split across this many threads; 0 picks
+    // QThread::idealThreadCount()
+    void setThreadCount(int threads) { m_threads = threads; }
+    int threadCount() const;
+    
+    // Large inputs are parsed on the calling thread and on pool (the global
+    // pool unless given)
+    bool read(FeatureStore& store, const IngestProgress& progress = IngestProgress(), QThreadPool* pool = nullptr);
+    
+    bool wasCancelled() const { return m_cancelled; }
+    QString errorString() const { return m_error; }
+    
+    // Geometry columns in use after read(), empty when none were found
+    QString xField() const { return m_xColumn >= 0 ? m_headers[m_xColumn] : QString(); }
+    QString yField() const { return m_yColumn >= 0 ? m_headers[m_yColumn] : QString(); }
+    QString wktField() const { return m_wktColumn >= 0 ? m_headers[m_wktColumn] : QString(); }
+    
+    // End of the header record after read(), line break included, as an
+    // offset into the data; rows parsed later under these bytes get the same
+    // columns
+    qsizetype headerEnd() const { return m_headerEnd; }
+    
+    // Whether geometry would be detected from these header names
+    static bool hasGeometryFields(const QStringList& headers);
+
+private:
+    char detectDelimiter() const;
+    void readHeader(const QVector<QByteArrayView>& fields);
+    void detectGeometryColumns();
+    void prepareColumns(FeatureStore& store);
+    bool readRecords(CsvScanner& scanner, FeatureStore& store, const IngestProgress& progress, qint64& records);
+    bool readParallel(FeatureStore& store, qsizetype begin, char delimiter, const IngestProgress& progress,
+                      QThreadPool* pool);
+    void appendRecord(FeatureStore& store, const QVector<QByteArrayView>& fields);
+    void appendValue(PropertyColumn& column, QByteArrayView field);
+    bool parseCoordinate(QByteArrayView field, double& value);
+    
+    const char* m_data;
+    qsizetype m_size;
+    qsizetype m_bomSize;
+    qsizetype m_headerEnd;
+    char m_delimiter;
+    int m_threads;
+    QString m_xField;
+    QString m_yField;
+    QString m_wktField;
+    
+    QStringList m_headers;
+    QVector<int> m_columns;
+    int m_xColumn;
+    int m_yColumn;
+    int m_wktColumn;
+    
+    StringPool m_strings;
+    QByteArray m_scratch;
+    bool m_cancelled;
+    QString m_error;
+};
@@ -0,0 +1,184 @@
+#include "CsvScanner.h"
+#include <bit>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define CSV_SCANNER_SSE2
+#endif
+
+namespace {
+
+const qsizetype BlockSize = 64;
+
+struct BlockMasks {
+    quint64 quotes;
+    quint64 delimiters;
+    quint64 lineFeeds;
+};
+
+#ifdef CSV_SCANNER_SSE2
+
+BlockMasks classify(const char* block, char delimiter)
+{
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i separator = _mm_set1_epi8(delimiter);
+    const __m128i lineFeed = _mm_set1_epi8('\n');
+    
+    BlockMasks masks = {0, 0, 0};
+    for (int i = 0; i < 4; ++i) {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + i * 16));
+        int shift = i * 16;
+        masks.quotes |= quint64(quint16(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, quote)))) << shift;
+        masks.delimiters |= quint64(quint16(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, separator)))) << shift;
+        masks.lineFeeds |= quint64(quint16(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, lineFeed)))) << shift;
+    }
+    return masks;
+}
+
+#else
+
+BlockMasks classify(const char* block, char delimiter)
+{
+    BlockMasks masks = {0, 0, 0};
+    for (int i = 0; i < BlockSize; ++i) {
+        quint64 bit = quint64(1) << i;
+        char c = block[i];
+        masks.quotes |= c == '"' ? bit : 0;
+        masks.delimiters |= c == delimiter ? bit : 0;
+        masks.lineFeeds |= c == '\n' ? bit : 0;
+    }
+    return masks;
+}
+
+#endif
+
+// Bit i of the result is the XOR of bits 0..i of the input, i.e. set for
+// every byte that follows an odd number of quotes
+quint64 prefixXor(quint64 bits)
+{
+    bits ^= bits << 1;
+    bits ^= bits << 2;
+    bits ^= bits << 4;
+    bits ^= bits << 8;
+    bits ^= bits << 16;
+    bits ^= bits << 32;
+    return bits;
+}
+
+} // namespace
+
+CsvScanner::CsvScanner(const char* data, qsizetype size, char delimiter, bool inQuotes)
+    : m_data(data)
+    , m_size(size)
+    , m_delimiter(delimiter)
+    , m_nextBlock(0)
+    , m_blockBase(0)
+    , m_separators(0)
+    , m_lineFeeds(0)
+    , m_inQuotes(inQuotes)
+    , m_fieldStart(0)
+{
+}
+
+bool CsvScanner::nextRecord(QVector<QByteArrayView>& fields)
+{
+    fields.clear();
+    if (m_fieldStart >= m_size) {
+        return false;
+    }
+    
+    while (true) {
+        while (m_separators == 0) {
+            if (m_nextBlock >= m_size) {
+                // Last record without a trailing line break
+                QByteArrayView field(m_data + m_fieldStart, m_size - m_fieldStart);
+                if (field.endsWith('\r')) {
+                    field.chop(1);
+                }
+                fields.append(field);
+                m_fieldStart = m_size;
+                return true;
+            }
+            scanBlock();
+        }
+        
+        int bit = std::countr_zero(m_separators);
+        m_separators &= m_separators - 1;
+        qsizetype pos = m_blockBase + bit;
+        QByteArrayView field(m_data + m_fieldStart, pos - m_fieldStart);
+        m_fieldStart = pos + 1;
+        
+        if ((m_lineFeeds >> bit) & 1) {
+            if (field.endsWith('\r')) {
+                field.chop(1);
+            }
+            fields.append(field);
+            return true;
+        }
+        fields.append(field);
+    }
+}
+
+void CsvScanner::scanBlock()
+{
+    const char* block = m_data + m_nextBlock;
+    char tail[BlockSize];
+    if (m_size - m_nextBlock < BlockSize) {
+        // Pad the final partial block; NUL never matches
+        std::memset(tail, 0, BlockSize);
+        std::memcpy(tail, block, m_size - m_nextBlock);
+        block = tail;
+    }
+    
+    BlockMasks masks = classify(block, m_delimiter);
+    quint64 inside = prefixXor(masks.quotes) ^ (m_inQuotes ? ~quint64(0) : 0);
+    m_inQuotes = (inside >> 63) != 0;
+    
+    m_separators = (masks.delimiters | masks.lineFeeds) & ~inside;
+    m_lineFeeds = masks.lineFeeds & ~inside;
+    m_blockBase = m_nextBlock;
+    m_nextBlock += BlockSize;
+}
+
+QByteArrayView CsvScanner::unquote(QByteArrayView field, QByteArray& scratch)
+{
+    if (field.isEmpty() || field[0] != '"') {
+        return field;
+    }
+    
+    QByteArrayView inner = field.sliced(1);
+    if (inner.endsWith('"')) {
+        inner.chop(1);
+    }
+    if (inner.indexOf('"') < 0) {
+        return inner;
+    }
+    
+    scratch.clear();
+    scratch.reserve(inner.size());
+    for (qsizetype i = 0; i < inner.size(); ++i) {
+        if (inner[i] == '"' && i + 1 < inner.size() && inner[i + 1] == '"') {
+            ++i;
+        }
+        scratch.append(inner[i]);
+    }
+    return QByteArrayView(scratch);
+}
+
+qsizetype CsvScanner::countQuotes(const char* data, qsizetype size)
+{
+    qsizetype count = 0;
+    qsizetype i = 0;
+#ifdef CSV_SCANNER_SSE2
+    const __m128i quote = _mm_set1_epi8('"');
+    for (; i + 16 <= size; i += 16) {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        count += std::popcount(quint32(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, quote))));
+    }
+#endif
+    for (; i < size; ++i) {
+        count += data[i] == '"';
+    }
+    return count;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <QByteArray>
+#include <QByteArrayView>
+#include <QVector>
+
+// Splits RFC 4180 CSV text into records and fields without copying.
+//
+// The input is classified 64 bytes at a time: vector compares produce
+// bitmasks of quotes, delimiters and line feeds, and a prefix XOR over the
+// quote mask marks every byte inside a quoted field. Delimiters and line
+// breaks outside quotes are then visited one set bit at a time, so the
+// per-byte work is a handful of SIMD instructions instead of a state
+// machine. Escaped quotes ("") toggle the mask twice and need no special
+// casing.
+class CsvScanner
+{
+public:
+    // inQuotes gives the quoting state at the first byte, for scanning
+    // from the middle of a file
+    CsvScanner(const char* data, qsizetype size, char delimiter = ',', bool inQuotes = false);
+    
+    // Returns the raw fields of the next record as views into the input.
+    // Quoted fields keep their quotes; see unquote(). A trailing CR is
+    // stripped from the last field.
+    bool nextRecord(QVector<QByteArrayView>& fields);
+    
+    // Offset of the first byte not consumed yet
+    qsizetype position() const { return m_fieldStart; }
+    
+    // Removes the surrounding quotes and unescapes doubled quotes. Returns
+    // a view into the field when nothing needs unescaping, into scratch
+    // otherwise.
+    static QByteArrayView unquote(QByteArrayView field, QByteArray& scratch);
+    
+    // Number of quote characters in the range; its parity tells whether
+    // the range ends inside a quoted field
+    static qsizetype countQuotes(const char* data, qsizetype size);
+
+private:
+    void scanBlock();
+    
+    const char* m_data;
+    qsizetype m_size;
+    char m_delimiter;
+    
+    qsizetype m_nextBlock;
+    qsizetype m_blockBase;
+    quint64 m_separators;
+    quint64 m_lineFeeds;
+    bool m_inQuotes;
+    qsizetype m_fieldStart;
+};
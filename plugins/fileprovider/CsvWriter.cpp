@@ -0,0 +1,438 @@
+#include "CsvWriter.h"
+#include "CsvReader.h"
+#include <QFuture>
+#include <QIODevice>
+#include <QJsonDocument>
+#include <QThread>
+#include <QThreadPool>
+#include <QtConcurrentRun>
+#include <atomic>
+#include <charconv>
+#include <cmath>
+#include <vector>
+
+namespace {
+
+const qsizetype BlockRows = 16384;
+// Blocks formatted ahead of the writer, per thread
+const int BlocksPerThread = 2;
+
+struct FormattedBlock {
+    QByteArray data;
+    std::atomic<bool> done{false};
+};
+
+const char* const LongitudeName = "lon";
+const char* const LatitudeName = "lat";
+const char* const WktName = "wkt";
+
+void appendNumber(QByteArray& out, double value)
+{
+    char text[32];
+    std::to_chars_result result = std::to_chars(text, text + sizeof(text), value);
+    out.append(text, result.ptr - text);
+}
+
+void appendInteger(QByteArray& out, qint64 value)
+{
+    char text[24];
+    std::to_chars_result result = std::to_chars(text, text + sizeof(text), value);
+    out.append(text, result.ptr - text);
+}
+
+const char* wktTypeName(FeatureStore::GeometryType type)
+{
+    switch (type) {
+    case FeatureStore::Point:
+        return "POINT";
+    case FeatureStore::LineString:
+        return "LINESTRING";
+    case FeatureStore::Polygon:
+        return "POLYGON";
+    case FeatureStore::MultiPoint:
+        return "MULTIPOINT";
+    case FeatureStore::MultiLineString:
+        return "MULTILINESTRING";
+    case FeatureStore::MultiPolygon:
+        return "MULTIPOLYGON";
+    case FeatureStore::GeometryCollection:
+        return "GEOMETRYCOLLECTION";
+    case FeatureStore::NoGeometry:
+        break;
+    }
+    return "";
+}
+
+void appendRing(QByteArray& out, const FeatureStore& store, qsizetype ring)
+{
+    qsizetype begin = store.coordinateBegin(ring);
+    qsizetype end = store.coordinateEnd(ring);
+    out.append('(');
+    for (qsizetype i = begin; i < end; ++i) {
+        if (i > begin) {
+            out.append(", ", 2);
+        }
+        appendNumber(out, store.x(i));
+        out.append(' ');
+        appendNumber(out, store.y(i));
+    }
+    out.append(')');
+}
+
+// Coordinate text of a simple geometry, the part of its WKT after the type
+void appendPartText(QByteArray& out, const FeatureStore& store, qsizetype part)
+{
+    qsizetype firstRing = store.ringBegin(part);
+    qsizetype lastRing = store.ringEnd(part);
+    bool empty = firstRing == lastRing || store.coordinateBegin(firstRing) == store.coordinateEnd(firstRing);
+    if (empty) {
+        out.append("EMPTY");
+    } else if (store.partType(part) == FeatureStore::Polygon) {
+        out.append('(');
+        for (qsizetype ring = firstRing; ring < lastRing; ++ring) {
+            if (ring > firstRing) {
+                out.append(", ", 2);
+            }
+            appendRing(out, store, ring);
+        }
+        out.append(')');
+    } else {
+        appendRing(out, store, firstRing);
+    }
+}
+
+void appendWkt(QByteArray& out, const FeatureStore& store, qsizetype feature)
+{
+    FeatureStore::GeometryType type = store.geometryType(feature);
+    qsizetype firstPart = store.partBegin(feature);
+    qsizetype lastPart = store.partEnd(feature);
+    out.append(wktTypeName(type));
+    out.append(' ');
+    if (firstPart == lastPart) {
+        out.append("EMPTY");
+        return;
+    }
+    
+    switch (type) {
+    case FeatureStore::Point:
+    case FeatureStore::LineString:
+    case FeatureStore::Polygon:
+        appendPartText(out, store, firstPart);
+        break;
+    default:
+        out.append('(');
+        for (qsizetype part = firstPart; part < lastPart; ++part) {
+            if (part > firstPart) {
+                out.append(", ", 2);
+            }
+            if (type == FeatureStore::GeometryCollection) {
+                out.append(wktTypeName(store.partType(part)));
+                out.append(' ');
+            }
+            appendPartText(out, store, part);
+        }
+        out.append(')');
+        break;
+    }
+}
+
+} // namespace
+
+CsvWriter::CsvWriter(QIODevice* device)
+    : m_device(device)
+    , m_delimiter(',')
+    , m_geometryFormat(AutoGeometry)
+    , m_threads(0)
+    , m_format(SkipGeometry)
+{
+}
+
+CsvWriter::GeometryFormat CsvWriter::geometryFormatFromName(const QString& name)
+{
+    QString lower = name.toLower();
+    if (lower == "none") {
+        return SkipGeometry;
+    } else if (lower == "lonlat") {
+        return LonLatGeometry;
+    } else if (lower == "wkt") {
+        return WktGeometry;
+    }
+    return AutoGeometry;
+}
+
+bool CsvWriter::write(const FeatureStore& store, QThreadPool* pool)
+{
+    QStringList geometryTypes;
+    FeatureStore::GeometryType last = FeatureStore::NoGeometry;
+    for (qsizetype feature = 0; feature < store.featureCount(); ++feature) {
+        FeatureStore::GeometryType type = store.geometryType(feature);
+        if (type != last && type != FeatureStore::NoGeometry) {
+            QString name = FeatureStore::geometryTypeName(type);
+            if (!geometryTypes.contains(name)) {
+                geometryTypes.append(name);
+            }
+            last = type;
+        }
+    }
+    return begin(store.columnNames(), geometryTypes) && writeFeatures(store, pool);
+}
+
+bool CsvWriter::begin(const QStringList& columnNames, const QStringList& geometryTypes)
+{
+    m_error.clear();
+    m_format = resolveGeometryFormat(columnNames, geometryTypes);
+    
+    QStringList geometryNames;
+    if (m_format == LonLatGeometry) {
+        geometryNames << LongitudeName << LatitudeName;
+    } else if (m_format == WktGeometry) {
+        geometryNames << WktName;
+    }
+    
+    // Header: geometry columns, then every property column they don't replace
+    QByteArray header;
+    for (const QString& name : geometryNames) {
+        if (!header.isEmpty()) {
+            header.append(m_delimiter);
+        }
+        header.append(name.toUtf8());
+    }
+    m_columnNames.clear();
+    for (const QString& name : columnNames) {
+        if (geometryNames.contains(name, Qt::CaseInsensitive)) {
+            continue;
+        }
+        if (!m_columnNames.isEmpty() || !geometryNames.isEmpty()) {
+            header.append(m_delimiter);
+        }
+        appendField(header, name.toUtf8());
+        m_columnNames.append(name);
+    }
+    header.append("\r\n", 2);
+    return writeBlock(header);
+}
+
+bool CsvWriter::writeFeatures(const FeatureStore& store, QThreadPool* pool)
+{
+    // Columns the store lacks are written empty
+    m_columns.clear();
+    for (const QString& name : m_columnNames) {
+        m_columns.append(store.columnIndex(name));
+    }
+    
+    qsizetype count = store.featureCount();
+    qsizetype blockCount = (count + BlockRows - 1) / BlockRows;
+    int threads = m_threads > 0 ? m_threads : QThread::idealThreadCount();
+    if (threads < 2 || blockCount < 2) {
+        for (qsizetype first = 0; first < count; first += BlockRows) {
+            if (!writeBlock(formatRows(store, first, qMin(count, first + BlockRows)))) {
+                return false;
+            }
+        }
+        return true;
+    }
+    
+    // Blocks are formatted in rounds of a bounded number, so memory use
+    // depends on the thread count and not on the layer size. The calling
+    // thread and threads - 1 pool tasks take the blocks of a round in turn,
+    // and the calling thread writes the formatted ones in order between its
+    // own, so a busy pool only slows the write down.
+    if (!pool) {
+        pool = QThreadPool::globalInstance();
+    }
+    qsizetype roundSize = qsizetype(threads) * BlocksPerThread;
+    std::vector<FormattedBlock> blocks(qMin(blockCount, roundSize));
+    bool ok = true;
+    for (qsizetype roundStart = 0; ok && roundStart < blockCount; roundStart += roundSize) {
+        qsizetype roundEnd = qMin(blockCount, roundStart + roundSize);
+        for (FormattedBlock& block : blocks) {
+            block.done = false;
+        }
+        std::atomic<qsizetype> nextBlock(roundStart);
+        auto formatBlock = [this, &store, &blocks, count, roundStart](qsizetype block) {
+            qsizetype first = block * BlockRows;
+            FormattedBlock& formatted = blocks[block - roundStart];
+            formatted.data = formatRows(store, first, qMin(count, first + BlockRows));
+            formatted.done.store(true, std::memory_order_release);
+        };
+        auto formatBlocks = [&formatBlock, &nextBlock, roundEnd]() {
+            for (qsizetype block = nextBlock++; block < roundEnd; block = nextBlock++) {
+                formatBlock(block);
+            }
+        };
+        qsizetype written = roundStart;
+        auto writeFormatted = [&]() {
+            for (; ok && written < roundEnd && blocks[written - roundStart].done.load(std::memory_order_acquire); ++written) {
+                ok = writeBlock(blocks[written - roundStart].data);
+                blocks[written - roundStart].data.clear();
+            }
+        };
+        
+        QVector<QFuture<void>> futures;
+        for (qsizetype worker = 1; worker < qMin<qsizetype>(threads, roundEnd - roundStart); ++worker) {
+            futures.append(QtConcurrent::run(pool, formatBlocks));
+        }
+        for (qsizetype block = nextBlock++; block < roundEnd; block = nextBlock++) {
+            formatBlock(block);
+            writeFormatted();
+        }
+        for (QFuture<void>& future : futures) {
+            future.waitForFinished();
+        }
+        writeFormatted();
+    }
+    return ok;
+}
+
+CsvWriter::GeometryFormat CsvWriter::resolveGeometryFormat(const QStringList& columnNames, const QStringList& geometryTypes) const
+{
+    if (m_geometryFormat != AutoGeometry) {
+        return m_geometryFormat;
+    }
+    if (CsvReader::hasGeometryFields(columnNames) || geometryTypes.isEmpty()) {
+        return SkipGeometry;
+    }
+    bool points = geometryTypes.size() == 1 && geometryTypes.first() == FeatureStore::geometryTypeName(FeatureStore::Point);
+    return points ? LonLatGeometry : WktGeometry;
+}
+
+QByteArray CsvWriter::formatRows(const FeatureStore& store, qsizetype first, qsizetype last) const
+{
+    const QVector<PropertyColumn>& columns = store.columns();
+    QByteArray out;
+    out.reserve((last - first) * (m_columns.size() + 2) * 8);
+    for (qsizetype feature = first; feature < last; ++feature) {
+        bool separate = false;
+        FeatureStore::GeometryType type = store.geometryType(feature);
+        if (m_format == LonLatGeometry) {
+            // Only single points have a position; other geometry is left empty
+            qsizetype part = store.partBegin(feature);
+            if (type == FeatureStore::Point && part < store.partEnd(feature)
+                && store.ringBegin(part) < store.ringEnd(part)
+                && store.coordinateBegin(store.ringBegin(part)) < store.coordinateEnd(store.ringBegin(part))) {
+                qsizetype coordinate = store.coordinateBegin(store.ringBegin(part));
+                appendNumber(out, store.x(coordinate));
+                out.append(m_delimiter);
+                appendNumber(out, store.y(coordinate));
+            } else {
+                out.append(m_delimiter);
+            }
+            separate = true;
+        } else if (m_format == WktGeometry) {
+            if (type != FeatureStore::NoGeometry) {
+                QByteArray wkt;
+                appendWkt(wkt, store, feature);
+                appendField(out, wkt);
+            }
+            separate = true;
+        }
+        
+        for (int column : m_columns) {
+            if (separate) {
+                out.append(m_delimiter);
+            }
+            separate = true;
+            if (column >= 0 && !columns[column].isNull(feature)) {
+                appendValue(out, columns[column], feature);
+            }
+        }
+        out.append("\r\n", 2);
+    }
+    return out;
+}
+
+void CsvWriter::appendValue(QByteArray& out, const PropertyColumn& column, qsizetype row) const
+{
+    switch (column.type()) {
+    case PropertyColumn::Bool:
+        out.append(column.boolAt(row) ? "true" : "false");
+        break;
+    case PropertyColumn::Int:
+        appendInteger(out, column.intAt(row));
+        break;
+    case PropertyColumn::Double:
+        // NaN and infinity are written as empty fields
+        if (std::isfinite(column.doubleAt(row))) {
+            appendNumber(out, column.doubleAt(row));
+        }
+        break;
+    case PropertyColumn::String:
+        appendField(out, column.stringAt(row).toUtf8(), true);
+        break;
+    default:
+        appendVariant(out, column.value(row));
+        break;
+    }
+}
+
+void CsvWriter::appendVariant(QByteArray& out, const QVariant& value) const
+{
+    switch (value.metaType().id()) {
+    case QMetaType::UnknownType:
+    case QMetaType::Nullptr:
+        break;
+    case QMetaType::Bool:
+        out.append(value.toBool() ? "true" : "false");
+        break;
+    case QMetaType::Int:
+    case QMetaType::UInt:
+    case QMetaType::Long:
+    case QMetaType::LongLong:
+    case QMetaType::Short:
+    case QMetaType::UShort:
+        appendInteger(out, value.toLongLong());
+        break;
+    case QMetaType::Double:
+    case QMetaType::Float:
+        if (std::isfinite(value.toDouble())) {
+            appendNumber(out, value.toDouble());
+        }
+        break;
+    case QMetaType::QVariantMap:
+    case QMetaType::QVariantList:
+    case QMetaType::QStringList:
+        // Nested values are written as JSON text
+        appendField(out, QJsonDocument::fromVariant(value).toJson(QJsonDocument::Compact), true);
+        break;
+    default:
+        appendField(out, value.toString().toUtf8(), true);
+        break;
+    }
+}
+
+void CsvWriter::appendField(QByteArray& out, const QByteArray& text, bool quote) const
+{
+    if (!quote) {
+        for (char c : text) {
+            if (c == m_delimiter || c == '"' || c == '\n' || c == '\r') {
+                quote = true;
+                break;
+            }
+        }
+    }
+    if (!quote) {
+        out.append(text);
+        return;
+    }
+    
+    out.append('"');
+    qsizetype start = 0;
+    for (qsizetype i = 0; i < text.size(); ++i) {
+        if (text[i] == '"') {
+            out.append(text.constData() + start, i + 1 - start);
+            out.append('"');
+            start = i + 1;
+        }
+    }
+    out.append(text.constData() + start, text.size() - start);
+    out.append('"');
+}
+
+bool CsvWriter::writeBlock(const QByteArray& data)
+{
+    if (m_device->write(data) != data.size()) {
+        m_error = m_device->errorString();
+        return false;
+    }
+    return true;
+}
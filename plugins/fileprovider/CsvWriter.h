@@ -0,0 +1,72 @@
+#pragma once
+
+#include "FeatureStore.h"
+#include <QByteArray>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+class QIODevice;
+class QThreadPool;
+
+// Writes a FeatureStore as delimited text following RFC 4180: a header
+// line, CRLF line ends, and fields quoted when they contain the delimiter,
+// a quote or a line break, with quotes doubled. Every property column is
+// written, nulls as empty fields; strings are always quoted so that they
+// read back as text. Geometry goes into lon/lat columns or a WKT column.
+// Rows are formatted in blocks on several threads and the blocks are
+// written in file order.
+class CsvWriter
+{
+public:
+    enum GeometryFormat {
+        // lon/lat for layers of points, WKT otherwise, and nothing when the
+        // properties already hold the geometry columns of a CSV import
+        AutoGeometry,
+        SkipGeometry,
+        LonLatGeometry,
+        WktGeometry
+    };
+    
+    explicit CsvWriter(QIODevice* device);
+    
+    void setDelimiter(char delimiter) { m_delimiter = delimiter; }
+    // Geometry columns replace property columns of the same name
+    void setGeometryFormat(GeometryFormat format) { m_geometryFormat = format; }
+    // 0 picks QThread::idealThreadCount()
+    void setThreadCount(int threads) { m_threads = threads; }
+    
+    // Blocks are formatted on the calling thread and on pool (the global
+    // pool unless given)
+    bool write(const FeatureStore& store, QThreadPool* pool = nullptr);
+    // Writes a layer in parts, such as the pages of a paged layer: begin()
+    // writes the header for the layer's property columns and geometry type
+    // names (FeatureStore::geometryTypeName()), each writeFeatures() adds
+    // the rows of a store, whose columns are matched to the header by name
+    bool begin(const QStringList& columnNames, const QStringList& geometryTypes);
+    bool writeFeatures(const FeatureStore& store, QThreadPool* pool = nullptr);
+    QString errorString() const { return m_error; }
+    
+    static GeometryFormat geometryFormatFromName(const QString& name);
+
+private:
+    GeometryFormat resolveGeometryFormat(const QStringList& columnNames, const QStringList& geometryTypes) const;
+    QByteArray formatRows(const FeatureStore& store, qsizetype first, qsizetype last) const;
+    void appendValue(QByteArray& out, const PropertyColumn& column, qsizetype row) const;
+    void appendVariant(QByteArray& out, const QVariant& value) const;
+    // Quotes the field only when it needs it, or always when forced
+    void appendField(QByteArray& out, const QByteArray& text, bool quote = false) const;
+    bool writeBlock(const QByteArray& data);
+    
+    QIODevice* m_device;
+    char m_delimiter;
+    GeometryFormat m_geometryFormat;
+    int m_threads;
+    
+    // Resolved by begin(), and the header columns in the store being
+    // written, -1 when it lacks them
+    GeometryFormat m_format;
+    QStringList m_columnNames;
+    QVector<int> m_columns;
+    QString m_error;
+};
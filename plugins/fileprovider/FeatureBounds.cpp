@@ -0,0 +1,155 @@
+#include "FeatureBounds.h"
+#include <QFuture>
+#include <QThread>
+#include <QThreadPool>
+#include <QtConcurrentRun>
+#include <atomic>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define FEATURE_BOUNDS_SSE2
+#endif
+
+namespace {
+
+// Stores with fewer coordinates are reduced faster than threads start
+const qsizetype ParallelCoordinates = 1 << 20;
+const int ChunksPerThread = 4;
+
+// First coordinate of a feature. The offset arrays only grow, so the
+// coordinates of a feature end where those of the next one begin.
+qsizetype firstCoordinate(const FeatureStore& store, qsizetype feature)
+{
+    if (feature >= store.featureCount() || store.partBegin(feature) >= store.partCount()) {
+        return store.coordinateCount();
+    }
+    qsizetype ring = store.ringBegin(store.partBegin(feature));
+    return ring < store.ringCount() ? store.coordinateBegin(ring) : store.coordinateCount();
+}
+
+PackedRTree::Node reduceFeatures(const FeatureStore& store, qsizetype first, qsizetype last, PackedRTree::Node* bounds)
+{
+    PackedRTree::Node extent;
+    const double* xy = store.coordinates();
+    qsizetype begin = firstCoordinate(store, first);
+    for (qsizetype feature = first; feature < last; ++feature) {
+        qsizetype end = firstCoordinate(store, feature + 1);
+        bounds[feature] = FeatureBounds::reduce(xy + begin * 2, end - begin);
+        extent.expand(bounds[feature]);
+        begin = end;
+    }
+    return extent;
+}
+
+} // namespace
+
+QVector<PackedRTree::Node> FeatureBounds::compute(const FeatureStore& store, PackedRTree::Node& extent, int threads,
+                                                   QThreadPool* pool)
+{
+    qsizetype count = store.featureCount();
+    QVector<PackedRTree::Node> bounds(count);
+    extent = PackedRTree::Node();
+    if (threads <= 0) {
+        threads = QThread::idealThreadCount();
+    }
+    if (threads < 2 || store.coordinateCount() < ParallelCoordinates) {
+        extent = reduceFeatures(store, 0, count, bounds.data());
+        return bounds;
+    }
+    if (!pool) {
+        pool = QThreadPool::globalInstance();
+    }
+    
+    // The calling thread and threads - 1 pool tasks take ranges in turn
+    // until none are left, so a busy pool only slows the reduction down.
+    // Each range writes the bounds of its own features.
+    qsizetype chunkCount = qMin<qsizetype>(count, threads * ChunksPerThread);
+    QVector<PackedRTree::Node> extents(chunkCount);
+    std::atomic<qsizetype> nextChunk(0);
+    auto reduceChunks = [&store, &bounds, &extents, &nextChunk, count, chunkCount]() {
+        for (qsizetype chunk = nextChunk++; chunk < chunkCount; chunk = nextChunk++) {
+            qsizetype first = count * chunk / chunkCount;
+            qsizetype last = count * (chunk + 1) / chunkCount;
+            extents[chunk] = reduceFeatures(store, first, last, bounds.data());
+        }
+    };
+    QVector<QFuture<void>> futures;
+    futures.reserve(threads - 1);
+    for (int worker = 1; worker < threads; ++worker) {
+        futures.append(QtConcurrent::run(pool, reduceChunks));
+    }
+    reduceChunks();
+    for (QFuture<void>& future : futures) {
+        future.waitForFinished();
+    }
+    for (const PackedRTree::Node& chunkExtent : extents) {
+        extent.expand(chunkExtent);
+    }
+    return bounds;
+}
+
+#ifdef FEATURE_BOUNDS_SSE2
+
+PackedRTree::Node FeatureBounds::reduce(const double* xy, qsizetype count)
+{
+    // Each register holds an x/y pair. MINPD and MAXPD return their second
+    // operand when either is NaN, so NaN ordinates leave the accumulators
+    // as they are; two accumulators per bound hide the latency.
+    __m128d min0 = _mm_set1_pd(INFINITY);
+    __m128d max0 = _mm_set1_pd(-INFINITY);
+    __m128d min1 = min0;
+    __m128d max1 = max0;
+    qsizetype i = 0;
+    for (; i + 2 <= count; i += 2) {
+        __m128d a = _mm_loadu_pd(xy + i * 2);
+        __m128d b = _mm_loadu_pd(xy + i * 2 + 2);
+        min0 = _mm_min_pd(a, min0);
+        max0 = _mm_max_pd(a, max0);
+        min1 = _mm_min_pd(b, min1);
+        max1 = _mm_max_pd(b, max1);
+    }
+    if (i < count) {
+        __m128d a = _mm_loadu_pd(xy + i * 2);
+        min0 = _mm_min_pd(a, min0);
+        max0 = _mm_max_pd(a, max0);
+    }
+    
+    double minimum[2];
+    double maximum[2];
+    _mm_storeu_pd(minimum, _mm_min_pd(min0, min1));
+    _mm_storeu_pd(maximum, _mm_max_pd(max0, max1));
+    PackedRTree::Node bounds;
+    bounds.minX = minimum[0];
+    bounds.minY = minimum[1];
+    bounds.maxX = maximum[0];
+    bounds.maxY = maximum[1];
+    return bounds;
+}
+
+#else
+
+PackedRTree::Node FeatureBounds::reduce(const double* xy, qsizetype count)
+{
+    // Comparisons with NaN are false, so NaN ordinates are skipped
+    PackedRTree::Node bounds;
+    for (qsizetype i = 0; i < count; ++i) {
+        double x = xy[i * 2];
+        double y = xy[i * 2 + 1];
+        if (x < bounds.minX) {
+            bounds.minX = x;
+        }
+        if (x > bounds.maxX) {
+            bounds.maxX = x;
+        }
+        if (y < bounds.minY) {
+            bounds.minY = y;
+        }
+        if (y > bounds.maxY) {
+            bounds.maxY = y;
+        }
+    }
+    return bounds;
+}
+
+#endif
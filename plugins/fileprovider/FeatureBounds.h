@@ -0,0 +1,27 @@
+#pragma once
+
+#include "FeatureStore.h"
+#include "PackedRTree.h"
+#include <QVector>
+
+class QThreadPool;
+
+// Bounds of the features of a FeatureStore, for every geometry type. A
+// feature's coordinates are one contiguous run of the packed x/y array, so
+// each feature's bounds are a min/max reduction over that run, taken two
+// ordinates at a time with SSE2 where available. Large stores are split
+// into feature ranges reduced on several threads of a shared pool, so that
+// repeated calls start no threads of their own. NaN ordinates are skipped.
+class FeatureBounds
+{
+public:
+    // Bounds of each feature, empty for features without coordinates, and
+    // their union in extent. At most threads threads work on it, the calling
+    // one and others from pool (the global pool unless given); 0 threads
+    // picks QThread::idealThreadCount().
+    static QVector<PackedRTree::Node> compute(const FeatureStore& store, PackedRTree::Node& extent, int threads = 0,
+                                              QThreadPool* pool = nullptr);
+    
+    // Bounds of count interleaved x/y pairs
+    static PackedRTree::Node reduce(const double* xy, qsizetype count);
+};
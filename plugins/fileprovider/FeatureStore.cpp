@@ -0,0 +1,1296 @@
+#include "FeatureStore.h"
+#include <QDataStream>
+#include <QIODevice>
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+// Binary snapshots store each array as a 64-bit element count followed by
+// the raw elements, padded to 8 bytes so arrays stay aligned in a mapping
+bool writePadding(QIODevice* device, qint64 size)
+{
+    static const char padding[8] = {};
+    qint64 padded = (8 - size % 8) % 8;
+    return device->write(padding, padded) == padded;
+}
+
+bool writeBytes(QIODevice* device, const void* data, qint64 size)
+{
+    return device->write(static_cast<const char*>(data), size) == size && writePadding(device, size);
+}
+
+bool writeValue(QIODevice* device, quint64 value)
+{
+    return writeBytes(device, &value, sizeof(value));
+}
+
+template <typename T>
+bool writeArray(QIODevice* device, const QVector<T>& array)
+{
+    return writeValue(device, array.size())
+        && writeBytes(device, array.constData(), qint64(array.size()) * qint64(sizeof(T)));
+}
+
+// Strings as end offsets into one block of UTF-16 text, the layout String
+// columns keep in memory
+bool writeText(QIODevice* device, const QVector<quint64>& ends, const QVector<QChar>& text)
+{
+    return writeArray(device, ends) && writeArray(device, text);
+}
+
+bool writeStrings(QIODevice* device, const QVector<QString>& strings)
+{
+    QVector<quint64> ends;
+    ends.reserve(strings.size());
+    quint64 length = 0;
+    for (const QString& string : strings) {
+        length += string.size();
+        ends.append(length);
+    }
+    if (!writeArray(device, ends) || !writeValue(device, length)) {
+        return false;
+    }
+    
+    qint64 bytes = 0;
+    for (const QString& string : strings) {
+        qint64 size = qint64(string.size()) * qint64(sizeof(QChar));
+        if (device->write(reinterpret_cast<const char*>(string.constData()), size) != size) {
+            return false;
+        }
+        bytes += size;
+    }
+    return writePadding(device, bytes);
+}
+
+// Anything without a fixed layout goes through QDataStream
+template <typename T>
+bool writeStreamed(QIODevice* device, const T& value)
+{
+    QByteArray bytes;
+    QDataStream stream(&bytes, QIODevice::WriteOnly);
+    stream << value;
+    return writeValue(device, bytes.size()) && writeBytes(device, bytes.constData(), bytes.size());
+}
+
+// Capacity of an array, one allocation unless it holds none
+template <typename T>
+MemoryUsage arrayUsage(const QVector<T>& array)
+{
+    MemoryUsage usage;
+    if (array.capacity() > 0) {
+        usage.bytes = qint64(array.capacity()) * qint64(sizeof(T));
+        usage.allocations = 1;
+    }
+    return usage;
+}
+
+// Offsets into the next level down start at 0, never decrease and stay
+// within that level
+bool validOffsets(const QVector<quint32>& offsets, qsizetype limit)
+{
+    quint32 previous = 0;
+    for (quint32 offset : offsets) {
+        if (offset < previous || qsizetype(offset) > limit) {
+            return false;
+        }
+        previous = offset;
+    }
+    return offsets.isEmpty() || offsets.first() == 0;
+}
+
+class BinaryCursor
+{
+public:
+    BinaryCursor(const char* data, qsizetype size)
+        : m_data(data)
+        , m_size(size)
+        , m_pos(0)
+    {
+    }
+    
+    bool readValue(quint64& value)
+    {
+        const char* bytes = take(sizeof(value));
+        if (!bytes) {
+            return false;
+        }
+        std::memcpy(&value, bytes, sizeof(value));
+        return true;
+    }
+    
+    template <typename T>
+    bool readArray(QVector<T>& array)
+    {
+        quint64 count = 0;
+        if (!readValue(count) || count > quint64(remaining()) / sizeof(T)) {
+            return false;
+        }
+        const char* bytes = take(qsizetype(count * sizeof(T)));
+        if (!bytes) {
+            return false;
+        }
+        array.resize(qsizetype(count));
+        if (count > 0) {
+            std::memcpy(array.data(), bytes, count * sizeof(T));
+        }
+        return true;
+    }
+    
+    bool readText(QVector<quint64>& ends, QVector<QChar>& text)
+    {
+        if (!readArray(ends) || !readArray(text)) {
+            return false;
+        }
+        quint64 begin = 0;
+        for (quint64 end : ends) {
+            if (end < begin || end > quint64(text.size())) {
+                return false;
+            }
+            begin = end;
+        }
+        return true;
+    }
+    
+    bool readStrings(QVector<QString>& strings)
+    {
+        QVector<quint64> ends;
+        QVector<QChar> text;
+        if (!readText(ends, text)) {
+            return false;
+        }
+        strings.resize(ends.size());
+        quint64 begin = 0;
+        for (qsizetype i = 0; i < ends.size(); ++i) {
+            strings[i] = QString(text.constData() + begin, qsizetype(ends[i] - begin));
+            begin = ends[i];
+        }
+        return true;
+    }
+    
+    template <typename T>
+    bool readStreamed(T& value)
+    {
+        quint64 size = 0;
+        if (!readValue(size) || size > quint64(remaining())) {
+            return false;
+        }
+        const char* bytes = take(qsizetype(size));
+        if (!bytes) {
+            return false;
+        }
+        QDataStream stream(QByteArray::fromRawData(bytes, qsizetype(size)));
+        stream >> value;
+        return stream.status() == QDataStream::Ok;
+    }
+    
+    bool atEnd() const { return m_pos == m_size; }
+
+private:
+    qsizetype remaining() const { return m_size - m_pos; }
+    
+    // Returns the next size bytes and skips their padding
+    const char* take(qsizetype size)
+    {
+        qsizetype padded = size + (8 - size % 8) % 8;
+        if (padded > remaining()) {
+            return nullptr;
+        }
+        const char* bytes = m_data + m_pos;
+        m_pos += padded;
+        return bytes;
+    }
+    
+    const char* m_data;
+    qsizetype m_size;
+    qsizetype m_pos;
+};
+
+} // namespace
+
+PropertyColumn::PropertyColumn(const QString& name)
+    : m_name(name)
+    , m_type(Null)
+    , m_size(0)
+    , m_encoded(false)
+{
+}
+
+bool PropertyColumn::isNull(qsizetype row) const
+{
+    if (row < 0 || row >= m_size) {
+        return true;
+    }
+    return !(m_validBits[row / 64] & (quint64(1) << (row % 64)));
+}
+
+QStringView PropertyColumn::stringAt(qsizetype row) const
+{
+    if (m_encoded) {
+        return m_dictionary[m_codes[row]];
+    }
+    qsizetype begin = row > 0 ? qsizetype(m_textEnds[row - 1]) : 0;
+    return QStringView(m_text.constData() + begin, qsizetype(m_textEnds[row]) - begin);
+}
+
+QVariant PropertyColumn::value(qsizetype row) const
+{
+    if (isNull(row)) {
+        return QVariant();
+    }
+    
+    switch (m_type) {
+    case Bool:
+        return QVariant(m_ints[row] != 0);
+    case Int:
+        return QVariant(qlonglong(m_ints[row]));
+    case Double:
+        return QVariant(m_doubles[row]);
+    case String:
+        return m_encoded ? QVariant(m_dictionary[m_codes[row]]) : QVariant(stringAt(row).toString());
+    case Variant:
+        return m_variants[row];
+    case Null:
+        break;
+    }
+    return QVariant();
+}
+
+void PropertyColumn::append(const QVariant& value)
+{
+    if (!value.isValid() || value.metaType().id() == QMetaType::Nullptr) {
+        appendNull();
+        return;
+    }
+    
+    switch (value.metaType().id()) {
+    case QMetaType::Bool:
+        appendBool(value.toBool());
+        return;
+    case QMetaType::Int:
+    case QMetaType::UInt:
+    case QMetaType::Long:
+    case QMetaType::LongLong:
+    case QMetaType::Short:
+    case QMetaType::UShort:
+        appendInt(value.toLongLong());
+        return;
+    case QMetaType::Double:
+    case QMetaType::Float:
+        appendDouble(value.toDouble());
+        return;
+    case QMetaType::QString:
+        appendString(value.toString());
+        return;
+    default:
+        break;
+    }
+    
+    if (prepareAppend(Variant)) {
+        m_variants.append(value);
+        setValid(m_size++, true);
+    }
+}
+
+void PropertyColumn::appendNull()
+{
+    switch (m_type) {
+    case Bool:
+    case Int:
+        m_ints.append(0);
+        break;
+    case Double:
+        m_doubles.append(0.0);
+        break;
+    case String:
+        storeNullString();
+        break;
+    case Variant:
+        m_variants.append(QVariant());
+        break;
+    case Null:
+        break;
+    }
+    setValid(m_size++, false);
+}
+
+void PropertyColumn::appendBool(bool value)
+{
+    if (prepareAppend(Bool)) {
+        m_ints.append(value ? 1 : 0);
+    } else {
+        m_variants.append(QVariant(value));
+    }
+    setValid(m_size++, true);
+}
+
+void PropertyColumn::appendInt(qint64 value)
+{
+    if (m_type == Double) {
+        appendDouble(double(value));
+        return;
+    }
+    if (prepareAppend(Int)) {
+        m_ints.append(value);
+    } else {
+        m_variants.append(QVariant(qlonglong(value)));
+    }
+    setValid(m_size++, true);
+}
+
+void PropertyColumn::appendDouble(double value)
+{
+    if (m_type == Int) {
+        convertTo(Double);
+    }
+    if (prepareAppend(Double)) {
+        m_doubles.append(value);
+    } else {
+        m_variants.append(QVariant(value));
+    }
+    setValid(m_size++, true);
+}
+
+void PropertyColumn::appendString(const QString& value)
+{
+    if (prepareAppend(String)) {
+        storeString(value);
+    } else {
+        m_variants.append(QVariant(value));
+    }
+    setValid(m_size++, true);
+}
+
+void PropertyColumn::appendColumn(const PropertyColumn& other)
+{
+    // Settle on a type that holds both sides before copying
+    Type target = m_type;
+    if (other.m_type != Null && other.m_type != m_type) {
+        if (m_type == Null) {
+            target = other.m_type;
+        } else if ((m_type == Int && other.m_type == Double) || (m_type == Double && other.m_type == Int)) {
+            target = Double;
+        } else {
+            target = Variant;
+        }
+    }
+    convertTo(target);
+    
+    if (m_type == String && (m_encoded || other.m_encoded)) {
+        for (qsizetype row = 0; row < other.m_size; ++row) {
+            if (other.isNull(row)) {
+                storeNullString();
+            } else if (other.m_encoded) {
+                storeString(other.m_dictionary[other.m_codes[row]]);
+            } else {
+                storeText(other.stringAt(row));
+            }
+        }
+    } else if (m_type == other.m_type) {
+        m_ints.append(other.m_ints);
+        m_doubles.append(other.m_doubles);
+        // Text is copied in one go, its end offsets shifted past ours
+        quint64 base = m_text.size();
+        m_text.append(other.m_text);
+        m_textEnds.reserve(m_textEnds.size() + other.m_textEnds.size());
+        for (quint64 end : other.m_textEnds) {
+            m_textEnds.append(base + end);
+        }
+        m_variants.append(other.m_variants);
+    } else {
+        for (qsizetype row = 0; row < other.m_size; ++row) {
+            switch (m_type) {
+            case Bool:
+            case Int:
+                m_ints.append(0);
+                break;
+            case Double:
+                m_doubles.append(other.m_type == Int ? double(other.m_ints[row]) : 0.0);
+                break;
+            case String:
+                storeNullString();
+                break;
+            case Variant:
+                m_variants.append(other.value(row));
+                break;
+            case Null:
+                break;
+            }
+        }
+    }
+    
+    // Whole bitmap words can be copied when this column ends on a word boundary
+    if (m_size % 64 == 0) {
+        m_validBits.resize(m_size / 64);
+        m_validBits.append(other.m_validBits);
+        m_size += other.m_size;
+        return;
+    }
+    m_validBits.reserve((m_size + other.m_size) / 64 + 1);
+    for (qsizetype row = 0; row < other.m_size; ++row) {
+        setValid(m_size++, !other.isNull(row));
+    }
+}
+
+void PropertyColumn::resize(qsizetype rows)
+{
+    while (m_size < rows) {
+        appendNull();
+    }
+}
+
+void PropertyColumn::reserve(qsizetype rows)
+{
+    m_validBits.reserve(rows / 64 + 1);
+    switch (m_type) {
+    case Bool:
+    case Int:
+        m_ints.reserve(rows);
+        break;
+    case Double:
+        m_doubles.reserve(rows);
+        break;
+    case String:
+        if (m_encoded) {
+            m_codes.reserve(rows);
+        } else {
+            m_textEnds.reserve(rows);
+        }
+        break;
+    case Variant:
+        m_variants.reserve(rows);
+        break;
+    case Null:
+        break;
+    }
+}
+
+void PropertyColumn::clear()
+{
+    m_type = Null;
+    m_size = 0;
+    m_validBits.clear();
+    m_ints.clear();
+    m_doubles.clear();
+    m_text.clear();
+    m_textEnds.clear();
+    m_variants.clear();
+    m_encoded = false;
+    m_codes.clear();
+    m_dictionary.clear();
+    m_dictionaryIndex.clear();
+}
+
+MemoryUsage PropertyColumn::memoryUsage() const
+{
+    MemoryUsage usage = arrayUsage(m_validBits);
+    usage += arrayUsage(m_ints);
+    usage += arrayUsage(m_doubles);
+    usage += arrayUsage(m_text);
+    usage += arrayUsage(m_textEnds);
+    usage += arrayUsage(m_variants);
+    usage.allocations += m_variants.size();
+    usage += arrayUsage(m_codes);
+    usage += arrayUsage(m_dictionary);
+    for (const QString& value : m_dictionary) {
+        usage.bytes += qint64(value.capacity()) * qint64(sizeof(QChar));
+        usage.allocations += value.isEmpty() ? 0 : 1;
+    }
+    // The index shares the dictionary strings, only its buckets are its own
+    if (!m_dictionaryIndex.isEmpty()) {
+        usage.bytes += qint64(m_dictionaryIndex.capacity()) * qint64(sizeof(QString) + sizeof(quint32));
+        usage.allocations += 1;
+    }
+    return usage;
+}
+
+bool PropertyColumn::encodeDictionary()
+{
+    if (m_type != String || m_encoded) {
+        return m_encoded;
+    }
+    
+    // Encoding only pays off when values repeat, so give up as soon as
+    // more than half of the rows are distinct
+    qsizetype limit = qMin(MaxDictionarySize, m_size / 2);
+    QHash<QStringView, quint32> index;
+    QVector<QString> dictionary;
+    QVector<quint32> codes;
+    codes.reserve(m_size);
+    for (qsizetype row = 0; row < m_size; ++row) {
+        if (isNull(row)) {
+            codes.append(0);
+            continue;
+        }
+        QStringView text = stringAt(row);
+        auto it = index.constFind(text);
+        if (it != index.constEnd()) {
+            codes.append(it.value());
+            continue;
+        }
+        if (dictionary.size() >= limit) {
+            return false;
+        }
+        index.insert(text, quint32(dictionary.size()));
+        codes.append(quint32(dictionary.size()));
+        dictionary.append(text.toString());
+    }
+    
+    m_codes = std::move(codes);
+    m_dictionary = std::move(dictionary);
+    m_dictionaryIndex.clear();
+    for (qsizetype code = 0; code < m_dictionary.size(); ++code) {
+        m_dictionaryIndex.insert(m_dictionary[code], quint32(code));
+    }
+    m_text.clear();
+    m_text.squeeze();
+    m_textEnds.clear();
+    m_textEnds.squeeze();
+    m_encoded = true;
+    return true;
+}
+
+void PropertyColumn::matchRows(const QVariant& value, QVector<quint64>& rows) const
+{
+    bool matchNull = !value.isValid() || value.metaType().id() == QMetaType::Nullptr;
+    auto keep = [&](auto equal) {
+        for (qsizetype row = 0; row < rows.size() * 64; ++row) {
+            quint64 bit = quint64(1) << (row % 64);
+            if (!(rows[row / 64] & bit)) {
+                continue;
+            }
+            bool match = isNull(row) ? matchNull : (!matchNull && equal(row));
+            if (!match) {
+                rows[row / 64] &= ~bit;
+            }
+        }
+    };
+    
+    switch (m_type) {
+    case Bool: {
+        bool wanted = value.toBool();
+        keep([&](qsizetype row) { return (m_ints[row] != 0) == wanted; });
+        break;
+    }
+    case Int:
+    case Double: {
+        bool ok = false;
+        double wanted = value.toDouble(&ok);
+        if (m_type == Int) {
+            keep([&](qsizetype row) { return ok && double(m_ints[row]) == wanted; });
+        } else {
+            keep([&](qsizetype row) { return ok && m_doubles[row] == wanted; });
+        }
+        break;
+    }
+    case String:
+        if (m_encoded) {
+            // One hash lookup, then integer compares
+            QString text = value.toString();
+            qint64 wanted = m_dictionaryIndex.contains(text) ? qint64(m_dictionaryIndex.value(text)) : -1;
+            keep([&](qsizetype row) { return m_codes[row] == wanted; });
+        } else {
+            QString wanted = value.toString();
+            keep([&](qsizetype row) { return stringAt(row) == QStringView(wanted); });
+        }
+        break;
+    case Variant:
+        keep([&](qsizetype row) { return m_variants[row] == value; });
+        break;
+    case Null:
+        keep([](qsizetype) { return false; });
+        break;
+    }
+}
+
+QString PropertyColumn::typeName(Type type)
+{
+    switch (type) {
+    case Null:
+        return "null";
+    case Bool:
+        return "bool";
+    case Int:
+        return "int";
+    case Double:
+        return "double";
+    case String:
+        return "string";
+    case Variant:
+        return "variant";
+    }
+    return QString();
+}
+
+// Returns true when a value of the given type can be stored natively,
+// false when it has to go into the Variant storage.
+bool PropertyColumn::prepareAppend(Type type)
+{
+    if (m_type == type) {
+        return true;
+    }
+    if (m_type == Variant) {
+        return false;
+    }
+    convertTo(m_type == Null ? type : Variant);
+    return m_type == type;
+}
+
+void PropertyColumn::convertTo(Type type)
+{
+    if (m_type == type) {
+        return;
+    }
+    
+    if (m_type == Null) {
+        // Every existing row is null, only the storage needs padding
+        m_type = type;
+        switch (type) {
+        case Bool:
+        case Int:
+            m_ints.resize(m_size);
+            break;
+        case Double:
+            m_doubles.resize(m_size);
+            break;
+        case String:
+            m_textEnds.resize(m_size);
+            break;
+        case Variant:
+            m_variants.resize(m_size);
+            break;
+        case Null:
+            break;
+        }
+        return;
+    }
+    
+    if (type == Double && m_type == Int) {
+        m_doubles.reserve(m_ints.size());
+        for (qint64 value : m_ints) {
+            m_doubles.append(double(value));
+        }
+        m_ints.clear();
+        m_ints.squeeze();
+        m_type = Double;
+        return;
+    }
+    
+    // Anything else degrades to generic variants
+    QVector<QVariant> variants;
+    variants.reserve(m_size);
+    for (qsizetype row = 0; row < m_size; ++row) {
+        variants.append(value(row));
+    }
+    m_ints.clear();
+    m_ints.squeeze();
+    m_doubles.clear();
+    m_doubles.squeeze();
+    m_text.clear();
+    m_text.squeeze();
+    m_textEnds.clear();
+    m_textEnds.squeeze();
+    m_encoded = false;
+    m_codes.clear();
+    m_codes.squeeze();
+    m_dictionary.clear();
+    m_dictionaryIndex.clear();
+    m_variants = std::move(variants);
+    m_type = Variant;
+}
+
+void PropertyColumn::setValid(qsizetype row, bool valid)
+{
+    qsizetype word = row / 64;
+    while (m_validBits.size() <= word) {
+        m_validBits.append(0);
+    }
+    if (valid) {
+        m_validBits[word] |= quint64(1) << (row % 64);
+    } else {
+        m_validBits[word] &= ~(quint64(1) << (row % 64));
+    }
+}
+
+void PropertyColumn::storeString(const QString& value)
+{
+    if (m_encoded) {
+        auto it = m_dictionaryIndex.constFind(value);
+        if (it != m_dictionaryIndex.constEnd()) {
+            m_codes.append(it.value());
+            return;
+        }
+        if (m_dictionary.size() < MaxDictionarySize) {
+            m_dictionaryIndex.insert(value, quint32(m_dictionary.size()));
+            m_codes.append(quint32(m_dictionary.size()));
+            m_dictionary.append(value);
+            return;
+        }
+        decodeDictionary();
+    }
+    storeText(value);
+}
+
+void PropertyColumn::storeText(QStringView value)
+{
+    if (m_encoded) {
+        storeString(value.toString());
+        return;
+    }
+    qsizetype begin = m_text.size();
+    m_text.resize(begin + value.size());
+    std::copy(value.begin(), value.end(), m_text.begin() + begin);
+    m_textEnds.append(quint64(m_text.size()));
+}
+
+void PropertyColumn::storeNullString()
+{
+    if (m_encoded) {
+        m_codes.append(0);
+    } else {
+        m_textEnds.append(quint64(m_text.size()));
+    }
+}
+
+void PropertyColumn::decodeDictionary()
+{
+    QVector<quint32> codes = std::move(m_codes);
+    QVector<QString> dictionary = std::move(m_dictionary);
+    m_codes.clear();
+    m_dictionary.clear();
+    m_dictionaryIndex.clear();
+    m_encoded = false;
+    
+    m_textEnds.reserve(codes.size());
+    for (qsizetype row = 0; row < codes.size(); ++row) {
+        if (isNull(row)) {
+            storeNullString();
+        } else {
+            storeText(dictionary[codes[row]]);
+        }
+    }
+}
+
+FeatureStore::FeatureStore()
+    : m_ids("id")
+{
+}
+
+void FeatureStore::beginFeature(GeometryType type)
+{
+    m_featureTypes.append(type);
+    m_featureParts.append(quint32(m_partTypes.size()));
+}
+
+void FeatureStore::beginPart(GeometryType type)
+{
+    m_partTypes.append(type);
+    m_partRings.append(quint32(m_ringCoords.size()));
+}
+
+void FeatureStore::beginRing()
+{
+    m_ringCoords.append(quint32(coordinateCount()));
+}
+
+void FeatureStore::addCoordinates(const double* xy, qsizetype count)
+{
+    qsizetype size = m_coordinates.size();
+    m_coordinates.resize(size + count * 2);
+    std::memcpy(m_coordinates.data() + size, xy, count * 2 * sizeof(double));
+}
+
+void FeatureStore::setFeatureId(const QVariant& id)
+{
+    qsizetype row = featureCount() - 1;
+    if (m_ids.size() > row) {
+        return;
+    }
+    m_ids.resize(row);
+    m_ids.append(id);
+}
+
+PropertyColumn& FeatureStore::column(const QString& name)
+{
+    int index = m_columnIndex.value(name, -1);
+    if (index < 0) {
+        index = m_columns.size();
+        m_columns.append(PropertyColumn(name));
+        m_columnIndex.insert(name, index);
+    }
+    
+    PropertyColumn& result = m_columns[index];
+    result.resize(qMax<qsizetype>(0, featureCount() - 1));
+    return result;
+}
+
+void FeatureStore::setProperty(const QString& name, const QVariant& value)
+{
+    PropertyColumn& target = column(name);
+    if (target.size() < featureCount()) {
+        target.append(value);
+    }
+}
+
+void FeatureStore::clearGeometry()
+{
+    qsizetype firstPart = m_featureParts.last();
+    if (firstPart < partCount()) {
+        qsizetype firstRing = m_partRings[firstPart];
+        if (firstRing < ringCount()) {
+            m_coordinates.resize(qsizetype(m_ringCoords[firstRing]) * 2);
+        }
+        m_ringCoords.resize(firstRing);
+        m_partRings.resize(firstPart);
+        m_partTypes.resize(firstPart);
+    }
+    m_featureTypes.last() = NoGeometry;
+}
+
+void FeatureStore::endFeature()
+{
+    qsizetype rows = featureCount();
+    m_ids.resize(rows);
+    for (PropertyColumn& propertyColumn : m_columns) {
+        propertyColumn.resize(rows);
+    }
+}
+
+void FeatureStore::append(const FeatureStore& other)
+{
+    qsizetype rows = featureCount();
+    quint32 partOffset = quint32(partCount());
+    quint32 ringOffset = quint32(ringCount());
+    quint32 coordinateOffset = quint32(coordinateCount());
+    
+    m_featureTypes.append(other.m_featureTypes);
+    m_partTypes.append(other.m_partTypes);
+    m_coordinates.append(other.m_coordinates);
+    
+    // Offsets are relative to the other store and need rebasing
+    m_featureParts.reserve(m_featureParts.size() + other.m_featureParts.size());
+    for (quint32 part : other.m_featureParts) {
+        m_featureParts.append(part + partOffset);
+    }
+    m_partRings.reserve(m_partRings.size() + other.m_partRings.size());
+    for (quint32 ring : other.m_partRings) {
+        m_partRings.append(ring + ringOffset);
+    }
+    m_ringCoords.reserve(m_ringCoords.size() + other.m_ringCoords.size());
+    for (quint32 coordinate : other.m_ringCoords) {
+        m_ringCoords.append(coordinate + coordinateOffset);
+    }
+    
+    m_ids.resize(rows);
+    m_ids.appendColumn(other.m_ids);
+    for (const PropertyColumn& source : other.m_columns) {
+        int index = m_columnIndex.value(source.name(), -1);
+        if (index < 0) {
+            index = m_columns.size();
+            m_columns.append(PropertyColumn(source.name()));
+            m_columnIndex.insert(source.name(), index);
+        }
+        m_columns[index].resize(rows);
+        m_columns[index].appendColumn(source);
+    }
+    endFeature();
+    
+    for (auto it = other.m_metadata.begin(); it != other.m_metadata.end(); ++it) {
+        if (!m_metadata.contains(it.key())) {
+            m_metadata.insert(it.key(), it.value());
+        }
+    }
+}
+
+void FeatureStore::appendFeature(const FeatureStore& other, qsizetype feature)
+{
+    beginFeature(other.geometryType(feature));
+    for (qsizetype part = other.partBegin(feature); part < other.partEnd(feature); ++part) {
+        beginPart(other.partType(part));
+        for (qsizetype ring = other.ringBegin(part); ring < other.ringEnd(part); ++ring) {
+            beginRing();
+            qsizetype first = other.coordinateBegin(ring);
+            addCoordinates(other.coordinates() + first * 2, other.coordinateEnd(ring) - first);
+        }
+    }
+    
+    if (!other.m_ids.isNull(feature)) {
+        setFeatureId(other.m_ids.value(feature));
+    }
+    for (const PropertyColumn& source : other.m_columns) {
+        if (!source.isNull(feature)) {
+            setProperty(source.name(), source.value(feature));
+        }
+    }
+    endFeature();
+}
+
+void FeatureStore::encodeDictionaries()
+{
+    for (PropertyColumn& column : m_columns) {
+        column.encodeDictionary();
+    }
+}
+
+QVector<qsizetype> FeatureStore::featuresWhere(const QVariantMap& attributes) const
+{
+    qsizetype count = featureCount();
+    QVector<quint64> rows((count + 63) / 64, ~quint64(0));
+    for (auto it = attributes.constBegin(); it != attributes.constEnd(); ++it) {
+        int index = columnIndex(it.key());
+        if (index >= 0) {
+            m_columns[index].matchRows(it.value(), rows);
+        } else if (it.value().isValid() && !it.value().isNull()) {
+            // A missing column is null on every feature
+            return QVector<qsizetype>();
+        }
+    }
+    
+    QVector<qsizetype> features;
+    for (qsizetype feature = 0; feature < count; ++feature) {
+        if (rows[feature / 64] & (quint64(1) << (feature % 64))) {
+            features.append(feature);
+        }
+    }
+    return features;
+}
+
+void FeatureStore::reserve(qsizetype features, qsizetype coordinates)
+{
+    m_featureTypes.reserve(features);
+    m_featureParts.reserve(features);
+    m_coordinates.reserve(coordinates * 2);
+}
+
+void FeatureStore::clear()
+{
+    m_featureTypes.clear();
+    m_featureParts.clear();
+    m_partTypes.clear();
+    m_partRings.clear();
+    m_ringCoords.clear();
+    m_coordinates.clear();
+    m_ids.clear();
+    m_columns.clear();
+    m_columnIndex.clear();
+    m_metadata.clear();
+}
+
+MemoryUsage FeatureStore::memoryUsage() const
+{
+    MemoryUsage usage = arrayUsage(m_featureTypes);
+    usage += arrayUsage(m_featureParts);
+    usage += arrayUsage(m_partTypes);
+    usage += arrayUsage(m_partRings);
+    usage += arrayUsage(m_ringCoords);
+    usage += arrayUsage(m_coordinates);
+    usage += m_ids.memoryUsage();
+    usage += arrayUsage(m_columns);
+    for (const PropertyColumn& column : m_columns) {
+        usage += column.memoryUsage();
+    }
+    return usage;
+}
+
+qsizetype FeatureStore::partEnd(qsizetype feature) const
+{
+    return feature + 1 < featureCount() ? qsizetype(m_featureParts[feature + 1]) : partCount();
+}
+
+qsizetype FeatureStore::ringEnd(qsizetype part) const
+{
+    return part + 1 < partCount() ? qsizetype(m_partRings[part + 1]) : ringCount();
+}
+
+qsizetype FeatureStore::coordinateEnd(qsizetype ring) const
+{
+    return ring + 1 < ringCount() ? qsizetype(m_ringCoords[ring + 1]) : coordinateCount();
+}
+
+QStringList FeatureStore::columnNames() const
+{
+    QStringList names;
+    names.reserve(m_columns.size());
+    for (const PropertyColumn& propertyColumn : m_columns) {
+        names.append(propertyColumn.name());
+    }
+    return names;
+}
+
+QVariantList FeatureStore::positionAt(qsizetype coordinate) const
+{
+    return QVariantList() << x(coordinate) << y(coordinate);
+}
+
+QVariantList FeatureStore::coordinateList(qsizetype ring) const
+{
+    QVariantList positions;
+    qsizetype end = coordinateEnd(ring);
+    positions.reserve(end - coordinateBegin(ring));
+    for (qsizetype i = coordinateBegin(ring); i < end; ++i) {
+        positions.append(QVariant(positionAt(i)));
+    }
+    return positions;
+}
+
+QVariantMap FeatureStore::partGeometry(qsizetype part) const
+{
+    GeometryType type = partType(part);
+    qsizetype firstRing = ringBegin(part);
+    qsizetype lastRing = ringEnd(part);
+    
+    QVariantList coordinates;
+    if (type == Point) {
+        if (firstRing < lastRing && coordinateBegin(firstRing) < coordinateEnd(firstRing)) {
+            coordinates = positionAt(coordinateBegin(firstRing));
+        }
+    } else if (type == LineString) {
+        if (firstRing < lastRing) {
+            coordinates = coordinateList(firstRing);
+        }
+    } else {
+        for (qsizetype ring = firstRing; ring < lastRing; ++ring) {
+            coordinates.append(QVariant(coordinateList(ring)));
+        }
+    }
+    
+    QVariantMap geometry;
+    geometry["type"] = geometryTypeName(type);
+    geometry["coordinates"] = coordinates;
+    return geometry;
+}
+
+QVariantMap FeatureStore::geometryAt(qsizetype feature) const
+{
+    GeometryType type = geometryType(feature);
+    if (type == NoGeometry) {
+        return QVariantMap();
+    }
+    
+    qsizetype firstPart = partBegin(feature);
+    qsizetype lastPart = partEnd(feature);
+    
+    QVariantMap geometry;
+    geometry["type"] = geometryTypeName(type);
+    
+    switch (type) {
+    case Point:
+    case LineString:
+    case Polygon:
+        if (firstPart < lastPart) {
+            return partGeometry(firstPart);
+        }
+        geometry["coordinates"] = QVariantList();
+        break;
+    case MultiPoint:
+    case MultiLineString:
+    case MultiPolygon: {
+        QVariantList members;
+        for (qsizetype part = firstPart; part < lastPart; ++part) {
+            members.append(partGeometry(part).value("coordinates"));
+        }
+        geometry["coordinates"] = members;
+        break;
+    }
+    case GeometryCollection: {
+        QVariantList geometries;
+        for (qsizetype part = firstPart; part < lastPart; ++part) {
+            geometries.append(partGeometry(part));
+        }
+        geometry["geometries"] = geometries;
+        break;
+    }
+    case NoGeometry:
+        break;
+    }
+    
+    return geometry;
+}
+
+QVariantMap FeatureStore::propertiesAt(qsizetype feature) const
+{
+    QVariantMap properties;
+    for (const PropertyColumn& propertyColumn : m_columns) {
+        if (!propertyColumn.isNull(feature)) {
+            properties[propertyColumn.name()] = propertyColumn.value(feature);
+        }
+    }
+    return properties;
+}
+
+QVariantMap FeatureStore::featureAt(qsizetype feature) const
+{
+    QVariantMap result;
+    result["type"] = "Feature";
+    if (!m_ids.isNull(feature)) {
+        result["id"] = m_ids.value(feature);
+    }
+    
+    QVariantMap geometry = geometryAt(feature);
+    result["geometry"] = geometry.isEmpty() ? QVariant() : QVariant(geometry);
+    result["properties"] = propertiesAt(feature);
+    return result;
+}
+
+QVariant FeatureStore::toVariant() const
+{
+    QVariantList features;
+    features.reserve(featureCount());
+    for (qsizetype i = 0; i < featureCount(); ++i) {
+        features.append(featureAt(i));
+    }
+    
+    QVariantMap collection = m_metadata;
+    collection["type"] = "FeatureCollection";
+    collection["features"] = features;
+    return collection;
+}
+
+bool FeatureStore::writeBinary(QIODevice* device) const
+{
+    if (!writeArray(device, m_featureTypes)
+        || !writeArray(device, m_featureParts)
+        || !writeArray(device, m_partTypes)
+        || !writeArray(device, m_partRings)
+        || !writeArray(device, m_ringCoords)
+        || !writeArray(device, m_coordinates)
+        || !writeValue(device, m_columns.size())) {
+        return false;
+    }
+    
+    QVector<const PropertyColumn*> columns{&m_ids};
+    for (const PropertyColumn& column : m_columns) {
+        columns.append(&column);
+    }
+    for (const PropertyColumn* column : columns) {
+        if (!writeStrings(device, {column->m_name})
+            || !writeValue(device, column->m_type)
+            || !writeValue(device, column->m_size)
+            || !writeArray(device, column->m_validBits)
+            || !writeArray(device, column->m_ints)
+            || !writeArray(device, column->m_doubles)
+            || !writeText(device, column->m_textEnds, column->m_text)
+            || !writeStreamed(device, column->m_variants)
+            || !writeValue(device, column->m_encoded)
+            || !writeArray(device, column->m_codes)
+            || !writeStrings(device, column->m_dictionary)) {
+            return false;
+        }
+    }
+    return writeStreamed(device, m_metadata);
+}
+
+bool FeatureStore::readBinary(const char* data, qsizetype size)
+{
+    clear();
+    BinaryCursor cursor(data, size);
+    quint64 columnCount = 0;
+    bool valid = cursor.readArray(m_featureTypes)
+        && cursor.readArray(m_featureParts)
+        && cursor.readArray(m_partTypes)
+        && cursor.readArray(m_partRings)
+        && cursor.readArray(m_ringCoords)
+        && cursor.readArray(m_coordinates)
+        && cursor.readValue(columnCount)
+        && columnCount <= quint64(size);
+    
+    valid = valid
+        && m_featureParts.size() == m_featureTypes.size()
+        && m_partRings.size() == m_partTypes.size()
+        && m_coordinates.size() % 2 == 0
+        && validOffsets(m_featureParts, partCount())
+        && validOffsets(m_partRings, ringCount())
+        && validOffsets(m_ringCoords, coordinateCount());
+    
+    for (quint64 i = 0; valid && i <= columnCount; ++i) {
+        PropertyColumn column;
+        QVector<QString> name;
+        quint64 type = 0;
+        quint64 rows = 0;
+        quint64 encoded = 0;
+        valid = cursor.readStrings(name) && name.size() == 1
+            && cursor.readValue(type) && type <= PropertyColumn::Variant
+            && cursor.readValue(rows) && rows == quint64(featureCount())
+            && cursor.readArray(column.m_validBits)
+            && cursor.readArray(column.m_ints)
+            && cursor.readArray(column.m_doubles)
+            && cursor.readText(column.m_textEnds, column.m_text)
+            && cursor.readStreamed(column.m_variants)
+            && cursor.readValue(encoded) && encoded <= 1
+            && cursor.readArray(column.m_codes)
+            && cursor.readStrings(column.m_dictionary);
+        if (!valid) {
+            break;
+        }
+        
+        column.m_name = name.first();
+        column.m_type = PropertyColumn::Type(type);
+        column.m_size = qsizetype(rows);
+        column.m_encoded = encoded != 0;
+        qsizetype values = column.m_ints.size() + column.m_doubles.size() + column.m_textEnds.size() + column.m_variants.size() + column.m_codes.size();
+        // Every value must be in the array the column's type reads
+        const qsizetype typed[] = {values, column.m_ints.size(), column.m_ints.size(), column.m_doubles.size(),
+                                   column.m_encoded ? column.m_codes.size() : column.m_textEnds.size(), column.m_variants.size()};
+        valid = column.m_validBits.size() >= (column.m_size + 63) / 64
+            && (column.m_type == PropertyColumn::Null || (values == column.m_size && typed[type] == column.m_size))
+            && (!column.m_encoded || (column.m_type == PropertyColumn::String && column.m_textEnds.isEmpty()));
+        
+        // Codes of valid rows must point into the dictionary
+        for (qsizetype row = 0; valid && column.m_encoded && row < column.m_size; ++row) {
+            valid = column.isNull(row) || column.m_codes[row] < quint64(column.m_dictionary.size());
+        }
+        for (qsizetype code = 0; valid && code < column.m_dictionary.size(); ++code) {
+            column.m_dictionaryIndex.insert(column.m_dictionary[code], quint32(code));
+        }
+        
+        if (i == 0) {
+            m_ids = column;
+        } else {
+            m_columnIndex.insert(column.m_name, m_columns.size());
+            m_columns.append(column);
+        }
+    }
+    
+    valid = valid && cursor.readStreamed(m_metadata) && cursor.atEnd();
+    if (!valid) {
+        clear();
+    }
+    return valid;
+}
+
+QString FeatureStore::geometryTypeName(GeometryType type)
+{
+    switch (type) {
+    case Point:
+        return "Point";
+    case LineString:
+        return "LineString";
+    case Polygon:
+        return "Polygon";
+    case MultiPoint:
+        return "MultiPoint";
+    case MultiLineString:
+        return "MultiLineString";
+    case MultiPolygon:
+        return "MultiPolygon";
+    case GeometryCollection:
+        return "GeometryCollection";
+    case NoGeometry:
+        break;
+    }
+    return QString();
+}
+
+FeatureStore::GeometryType FeatureStore::geometryTypeFromName(const QString& name)
+{
+    static const QHash<QString, GeometryType> types = {
+        {"Point", Point},
+        {"LineString", LineString},
+        {"Polygon", Polygon},
+        {"MultiPoint", MultiPoint},
+        {"MultiLineString", MultiLineString},
+        {"MultiPolygon", MultiPolygon},
+        {"GeometryCollection", GeometryCollection}
+    };
+    return types.value(name, NoGeometry);
+}
@@ -0,0 +1,253 @@
+#pragma once
+
+#include <QString>
+#include <QStringList>
+#include <QStringView>
+#include <QVariant>
+#include <QVariantMap>
+#include <QVector>
+#include <QHash>
+#include <functional>
+
+class QIODevice;
+
+// Heap memory held by a column or store: bytes of capacity and the number
+// of separate allocations they are spread over. Values that may live
+// outside the column, such as variants, are estimated at one each.
+struct MemoryUsage
+{
+    qint64 bytes = 0;
+    qint64 allocations = 0;
+    
+    MemoryUsage& operator+=(const MemoryUsage& other)
+    {
+        bytes += other.bytes;
+        allocations += other.allocations;
+        return *this;
+    }
+};
+
+// Progress hook shared by the format readers. It receives the number of
+// input bytes consumed and features produced so far; returning false asks
+// the reader to stop.
+using IngestProgress = std::function<bool(qint64 bytesProcessed, qint64 featuresProcessed)>;
+
+// A single typed property column. Values are appended row by row; a column
+// starts out untyped and settles on the narrowest type that can hold every
+// value seen so far (Int widens to Double, anything else mixed falls back to
+// Variant). Missing values are tracked in a validity bitmap. String columns
+// with few distinct values can be dictionary encoded, storing a 32-bit code
+// per row into a table of the distinct strings.
+class PropertyColumn
+{
+public:
+    // Distinct strings an encoded column may hold before it is decoded
+    static constexpr qsizetype MaxDictionarySize = 1 << 16;
+    
+    enum Type {
+        Null,
+        Bool,
+        Int,
+        Double,
+        String,
+        Variant
+    };
+    
+    explicit PropertyColumn(const QString& name = QString());
+    
+    QString name() const { return m_name; }
+    Type type() const { return m_type; }
+    qsizetype size() const { return m_size; }
+    
+    bool isNull(qsizetype row) const;
+    QVariant value(qsizetype row) const;
+    
+    // Typed access without a QVariant, for rows that are not null and a
+    // column of the matching type (boolAt() and intAt() for Bool columns)
+    bool boolAt(qsizetype row) const { return m_ints[row] != 0; }
+    qint64 intAt(qsizetype row) const { return m_ints[row]; }
+    double doubleAt(qsizetype row) const { return m_doubles[row]; }
+    // The view stays valid until the column is next modified
+    QStringView stringAt(qsizetype row) const;
+    
+    // Encodes a String column when it has at most MaxDictionarySize distinct
+    // values and each repeats on average; appends keep the encoding until
+    // the dictionary outgrows that size
+    bool encodeDictionary();
+    bool isDictionaryEncoded() const { return m_encoded; }
+    const QVector<QString>& dictionary() const { return m_dictionary; }
+    // Code of a non-null row of an encoded column
+    quint32 codeAt(qsizetype row) const { return m_codes[row]; }
+    
+    // Clears the bits of rows that do not equal value, one bit per row;
+    // a null value matches null rows. Encoded columns compare codes.
+    void matchRows(const QVariant& value, QVector<quint64>& rows) const;
+    
+    void append(const QVariant& value);
+    void appendNull();
+    void appendBool(bool value);
+    void appendInt(qint64 value);
+    void appendDouble(double value);
+    void appendString(const QString& value);
+    
+    // Appends all rows of another column, promoting the type if needed
+    void appendColumn(const PropertyColumn& other);
+    
+    // Pads the column with nulls up to the given row count
+    void resize(qsizetype rows);
+    void reserve(qsizetype rows);
+    void clear();
+    
+    MemoryUsage memoryUsage() const;
+    
+    static QString typeName(Type type);
+
+private:
+    friend class FeatureStore;
+    
+    bool prepareAppend(Type type);
+    void convertTo(Type type);
+    void setValid(qsizetype row, bool valid);
+    // String storage of a row, through the dictionary while encoded
+    void storeString(const QString& value);
+    void storeText(QStringView value);
+    void storeNullString();
+    void decodeDictionary();
+    
+    QString m_name;
+    Type m_type;
+    qsizetype m_size;
+    
+    QVector<quint64> m_validBits;
+    QVector<qint64> m_ints;       // Bool and Int
+    QVector<double> m_doubles;
+    // Text of every String row, row i ending at m_textEnds[i]
+    QVector<QChar> m_text;
+    QVector<quint64> m_textEnds;
+    QVector<QVariant> m_variants;
+    
+    // String storage while encoded, in place of the text
+    bool m_encoded;
+    QVector<quint32> m_codes;
+    QVector<QString> m_dictionary;
+    QHash<QString, quint32> m_dictionaryIndex;
+};
+
+// Columnar storage for the features of a file layer.
+//
+// Coordinates are packed as interleaved x/y doubles. Geometry structure is
+// described by three start-offset arrays: feature -> parts -> rings ->
+// coordinates. A part is always a simple geometry (Point, LineString or
+// Polygon); Multi* geometries and GeometryCollections are a feature with
+// several parts. Readers flatten the Multi* and collection members of a
+// GeometryCollection into its simple parts, so no geometry is lost but the
+// nesting is. Coordinates are 2D, extra ordinates are dropped.
+class FeatureStore
+{
+public:
+    enum GeometryType : quint8 {
+        NoGeometry = 0,
+        Point,
+        LineString,
+        Polygon,
+        MultiPoint,
+        MultiLineString,
+        MultiPolygon,
+        GeometryCollection
+    };
+    
+    FeatureStore();
+    
+    // Building
+    void beginFeature(GeometryType type = NoGeometry);
+    void setGeometryType(GeometryType type) { m_featureTypes.last() = type; }
+    void beginPart(GeometryType type);
+    void beginRing();
+    void addCoordinate(double x, double y) { m_coordinates.append(x); m_coordinates.append(y); }
+    // Adds count interleaved x/y pairs at once
+    void addCoordinates(const double* xy, qsizetype count);
+    void setFeatureId(const QVariant& id);
+    PropertyColumn& column(const QString& name);
+    PropertyColumn& columnAt(int index) { return m_columns[index]; }
+    void setProperty(const QString& name, const QVariant& value);
+    // Drops the parts added to the current feature, for geometry that turns
+    // out to be invalid or unsupported part way through
+    void clearGeometry();
+    void endFeature();
+    
+    void setMetadata(const QVariantMap& metadata) { m_metadata = metadata; }
+    QVariantMap metadata() const { return m_metadata; }
+    
+    // Appends every feature of another store. Columns are matched by name;
+    // columns missing on either side are padded with nulls.
+    void append(const FeatureStore& other);
+    // Appends a single feature of another store, matching columns by name
+    void appendFeature(const FeatureStore& other, qsizetype feature);
+    
+    // Dictionary encodes the String columns that profit from it
+    void encodeDictionaries();
+    // Features whose properties equal every given value
+    QVector<qsizetype> featuresWhere(const QVariantMap& attributes) const;
+    
+    void reserve(qsizetype features, qsizetype coordinates);
+    void clear();
+    
+    MemoryUsage memoryUsage() const;
+    
+    // Geometry access
+    qsizetype featureCount() const { return m_featureTypes.size(); }
+    qsizetype partCount() const { return m_partTypes.size(); }
+    qsizetype ringCount() const { return m_ringCoords.size(); }
+    qsizetype coordinateCount() const { return m_coordinates.size() / 2; }
+    
+    GeometryType geometryType(qsizetype feature) const { return GeometryType(m_featureTypes[feature]); }
+    GeometryType partType(qsizetype part) const { return GeometryType(m_partTypes[part]); }
+    qsizetype partBegin(qsizetype feature) const { return m_featureParts[feature]; }
+    qsizetype partEnd(qsizetype feature) const;
+    qsizetype ringBegin(qsizetype part) const { return m_partRings[part]; }
+    qsizetype ringEnd(qsizetype part) const;
+    qsizetype coordinateBegin(qsizetype ring) const { return m_ringCoords[ring]; }
+    qsizetype coordinateEnd(qsizetype ring) const;
+    
+    const double* coordinates() const { return m_coordinates.constData(); }
+    double x(qsizetype coordinate) const { return m_coordinates[coordinate * 2]; }
+    double y(qsizetype coordinate) const { return m_coordinates[coordinate * 2 + 1]; }
+    
+    // Property access
+    const PropertyColumn& featureIds() const { return m_ids; }
+    const QVector<PropertyColumn>& columns() const { return m_columns; }
+    QStringList columnNames() const;
+    int columnIndex(const QString& name) const { return m_columnIndex.value(name, -1); }
+    
+    // Conversion to the GeoJSON-shaped QVariant contract of IDataLayer::data()
+    QVariantMap geometryAt(qsizetype feature) const;
+    QVariantMap propertiesAt(qsizetype feature) const;
+    QVariantMap featureAt(qsizetype feature) const;
+    QVariant toVariant() const;
+    
+    // Raw snapshot of the arrays, used by the layer cache. The layout is
+    // native endian and specific to this build; reading only checks that
+    // the arrays are consistent with each other.
+    bool writeBinary(QIODevice* device) const;
+    bool readBinary(const char* data, qsizetype size);
+    
+    static QString geometryTypeName(GeometryType type);
+    static GeometryType geometryTypeFromName(const QString& name);
+
+private:
+    QVariantList coordinateList(qsizetype ring) const;
+    QVariantList positionAt(qsizetype coordinate) const;
+    QVariantMap partGeometry(qsizetype part) const;
+    
+    QVector<quint8> m_featureTypes;
+    QVector<quint32> m_featureParts;
+    QVector<quint8> m_partTypes;
+    QVector<quint32> m_partRings;
+    QVector<quint32> m_ringCoords;
+    QVector<double> m_coordinates;
+    
+    PropertyColumn m_ids;
+    QVector<PropertyColumn> m_columns;
+    QHash<QString, int> m_columnIndex;
+    QVariantMap m_metadata;
+};
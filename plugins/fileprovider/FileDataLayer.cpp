@@ -1,21 +1,322 @@
 #include "FileDataLayer.h"
-#include <QJsonDocument>
-#include <QJsonArray>
+#include "CsvReader.h"
+#include "CsvScanner.h"
+#include "ArrowReader.h"
+#include "CompressedFile.h"
+#include "FeatureBounds.h"
+#include "FlatGeobufReader.h"
+#include "GeoJsonReader.h"
+#include "GeoJsonScanner.h"
+#include "GeoJsonSeqReader.h"
+#include "KmlReader.h"
+#include "LayerCache.h"
+#include "LayerSchema.h"
+#include "MappedFile.h"
+#include "PageCache.h"
+#include "PagedLayerFile.h"
+#include "PagedLayerWriter.h"
+#include "ParallelGeoJsonReader.h"
+#include "ShapefileReader.h"
+#include "ZipArchive.h"
+#include <QCryptographicHash>
+#include <QDir>
 #include <QFile>
 #include <QFileInfo>
-#include <QTextStream>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+#include <QStandardPaths>
 #include <QDebug>
 #include <QUuid>
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+// Files below this size parse faster on one thread than it takes to split them
+const qint64 ParallelThreshold = 16 * 1024 * 1024;
+
+// Features read to describe a layer imported metadata-only
+const qint64 SampleSize = 1000;
+// Leading bytes of a CSV file or GeoJSON sequence parsed for the same purpose
+const qsizetype SamplePrefix = 256 * 1024;
+
+// Smaller files parse about as fast as their snapshot loads
+const qint64 LayerCacheThreshold = 1024 * 1024;
+
+// Bytes at each end of the part of a file already read that must be
+// unchanged for its growth to count as appended rows
+const qint64 AppendCheckSize = 64 * 1024;
+
+// Bytes of the source parsed at a time while building a paged layer
+const qsizetype PageBatchSize = 64 * 1024 * 1024;
+// Default budget of a paged layer's page cache, in megabytes
+const qint64 DefaultPageCacheSize = 256;
+// Pages read ahead while a paged layer is read in full
+const qsizetype ReadAheadPages = 4;
+
+// Data formats looked for among the members of a zip archive, in order of
+// preference
+const QStringList ArchiveFormats = {
+    "shp", "fgb", "arrow", "feather", "geojson", "json", "geojsonl", "geojsons", "ndjson", "csv", "kml"
+};
+
+// Progress of a reader of decompressed data, reported in bytes of the file
+// on disk; compression is the ratio of stored to uncompressed size
+IngestProgress storedProgress(const IngestProgress& progress, double compression)
+{
+    if (!progress) {
+        return IngestProgress();
+    }
+    return [&progress, compression](qint64 bytes, qint64 features) {
+        return progress(qint64(bytes * compression), features);
+    };
+}
+
+// The bytes of a data file: mapped when it is stored plain, otherwise
+// decompressed into memory for the readers that need all of it at once
+struct SourceData
+{
+    MappedFile mapped;
+    QByteArray decompressed;
+    qint64 storedSize = 0;
+    
+    bool open(const QString& filePath)
+    {
+        if (CompressedFile::compression(filePath) == CompressedFile::None) {
+            return mapped.open(filePath);
+        }
+        CompressedFile file;
+        if (!file.open(filePath, ArchiveFormats) || !file.readAll(decompressed)) {
+            qWarning() << "Cannot decompress file:" << filePath << "Error:" << file.errorString();
+            return false;
+        }
+        storedSize = QFileInfo(filePath).size();
+        return true;
+    }
+    
+    const char* data() const { return mapped.data() ? mapped.data() : (decompressed.isEmpty() ? nullptr : decompressed.constData()); }
+    qsizetype size() const { return mapped.data() ? mapped.size() : decompressed.size(); }
+    double compression() const { return mapped.data() || decompressed.isEmpty() ? 1.0 : double(storedSize) / decompressed.size(); }
+};
+
+// A Shapefile's .shp with whichever of its .shx, .dbf and .cpg parts sit
+// next to it; the part suffixes may be in either case. In a zip archive the
+// parts are the members next to the .shp.
+struct ShapefileParts
+{
+    SourceData shp;
+    SourceData shx;
+    SourceData dbf;
+    QByteArray codePage;
+    
+    bool open(const QString& filePath)
+    {
+        if (CompressedFile::compression(filePath) == CompressedFile::Zip) {
+            CompressedFile archive;
+            if (!archive.open(filePath, {"shp"}) || !archive.readAll(shp.decompressed)) {
+                qWarning() << "Cannot read Shapefile archive:" << filePath << "Error:" << archive.errorString();
+                return false;
+            }
+            shp.storedSize = QFileInfo(filePath).size();
+            archive.readSibling("shx", shx.decompressed);
+            archive.readSibling("dbf", dbf.decompressed);
+            archive.readSibling("cpg", codePage);
+            return true;
+        }
+        if (!shp.open(filePath)) {
+            return false;
+        }
+        
+        // The parts of a compressed .shp are looked for under its stripped
+        // name, stored plain
+        QFileInfo fileInfo(filePath);
+        QString baseName = QFileInfo(CompressedFile::strippedName(filePath)).completeBaseName();
+        auto part = [&fileInfo, &baseName](const QString& suffix) {
+            for (const QString& name : {suffix, suffix.toUpper()}) {
+                QString path = fileInfo.dir().filePath(baseName + '.' + name);
+                if (QFileInfo::exists(path)) {
+                    return path;
+                }
+            }
+            return QString();
+        };
+        
+        QString shxPath = part("shx");
+        if (!shxPath.isEmpty() && !shx.open(shxPath)) {
+            qWarning() << "Cannot open Shapefile index:" << shxPath;
+        }
+        QString dbfPath = part("dbf");
+        if (!dbfPath.isEmpty() && !dbf.open(dbfPath)) {
+            qWarning() << "Cannot open Shapefile attributes:" << dbfPath;
+        }
+        QFile cpg(part("cpg"));
+        if (cpg.open(QIODevice::ReadOnly)) {
+            codePage = cpg.readAll();
+        }
+        return true;
+    }
+    
+    void attach(ShapefileReader& reader) const
+    {
+        if (shx.data()) {
+            reader.setIndex(shx.data(), shx.size());
+        }
+        if (dbf.data()) {
+            reader.setAttributes(dbf.data(), dbf.size(), codePage);
+        }
+    }
+};
+
+// Cuts the text of a CSV file or GeoJSON sequence read from a stream into
+// batches of whole records. CSV batches after the first start with a copy
+// of the header line, so they parse to the same columns.
+class RecordBatches
+{
+public:
+    RecordBatches(QIODevice* stream, bool csv)
+        : m_stream(stream)
+        , m_csv(csv)
+        , m_separator('\n')
+        , m_position(0)
+        , m_started(false)
+        , m_ended(false)
+        , m_failed(false)
+    {
+    }
+    
+    // Fills batch with records from at least size bytes of the stream, or
+    // from what is left of it. False once the stream is exhausted or fails.
+    bool next(QByteArray& batch, qsizetype size)
+    {
+        QByteArray text = m_pending;
+        m_pending.clear();
+        qsizetype target = size;
+        qsizetype cut = -1;
+        while (true) {
+            while (text.size() < target && !m_ended) {
+                QByteArray block = m_stream->read(target - text.size());
+                if (block.isEmpty()) {
+                    m_ended = true;
+                    m_failed = !m_stream->atEnd();
+                }
+                text.append(block);
+            }
+            if (!m_started && !text.isEmpty()) {
+                m_started = true;
+                if (m_csv) {
+                    CsvScanner scanner(text.constData(), text.size());
+                    QVector<QByteArrayView> fields;
+                    scanner.nextRecord(fields);
+                    m_header = text.left(scanner.position());
+                } else {
+                    m_separator = GeoJsonSeqReader::separator(text.constData(), text.size());
+                }
+            }
+            if (m_ended) {
+                break;
+            }
+            cut = cutPosition(text);
+            if (cut > 0) {
+                break;
+            }
+            // A record longer than a batch
+            target = text.size() + size;
+        }
+        if (m_failed || text.isEmpty()) {
+            return false;
+        }
+        
+        if (cut > 0) {
+            m_pending = text.mid(cut);
+            text.truncate(cut);
+        }
+        batch = m_csv && m_position > 0 ? m_header + text : text;
+        m_position += text.size();
+        return true;
+    }
+    
+    // Bytes of the stream handed out in batches
+    qint64 position() const { return m_position; }
+    bool atEnd() const { return m_ended && m_pending.isEmpty(); }
+    bool failed() const { return m_failed; }
+
+private:
+    // Offset just past the last complete record, or -1. A CSV record ends
+    // at a line feed preceded by an even number of quotes, since the text
+    // starts on a record.
+    qsizetype cutPosition(const QByteArray& text) const
+    {
+        if (!m_csv) {
+            return text.lastIndexOf(m_separator);
+        }
+        qsizetype quotes = CsvScanner::countQuotes(text.constData(), text.size());
+        for (qsizetype i = text.size() - 1; i >= 0; --i) {
+            if (text[i] == '"') {
+                --quotes;
+            } else if (text[i] == '\n' && (quotes & 1) == 0) {
+                return i + 1;
+            }
+        }
+        return -1;
+    }
+    
+    QIODevice* m_stream;
+    bool m_csv;
+    char m_separator;
+    QByteArray m_header;
+    QByteArray m_pending;
+    qint64 m_position;
+    bool m_started;
+    bool m_ended;
+    bool m_failed;
+};
+
+// Identifies the first size bytes of a file by their head and tail
+QByteArray prefixFingerprint(QFile& file, qint64 size)
+{
+    QCryptographicHash hash(QCryptographicHash::Md5);
+    qint64 window = qMin(size, AppendCheckSize);
+    for (qint64 offset : {qint64(0), size - window}) {
+        if (!file.seek(offset)) {
+            return QByteArray();
+        }
+        QByteArray block = file.read(window);
+        if (block.size() != window) {
+            return QByteArray();
+        }
+        hash.addData(block);
+    }
+    return hash.result();
+}
+
+// Box in the {minLat, minLon, maxLat, maxLon} form of layer extents
+PackedRTree::Node boxNode(const QVariantMap& boundingBox)
+{
+    PackedRTree::Node box;
+    box.minX = boundingBox.value("minLon").toDouble();
+    box.minY = boundingBox.value("minLat").toDouble();
+    box.maxX = boundingBox.value("maxLon").toDouble();
+    box.maxY = boundingBox.value("maxLat").toDouble();
+    return box;
+}
+
+} // namespace
 
 FileDataLayer::FileDataLayer(const QString& id, const QString& name, const QString& filePath, const QString& type)
     : m_id(id)
     , m_name(name)
     , m_type(type)
     , m_filePath(filePath)
+    , m_format(dataFormat(filePath))
     , m_visible(true)
     , m_opacity(1.0)
     , m_dataLoaded(false)
+    , m_loading(false)
     , m_lastUpdated(QDateTime::currentDateTime())
+    , m_appendOffset(-1)
+    , m_csvHeaderEnd(-1)
 {
     QFileInfo fileInfo(filePath);
     m_description = QString("File layer: %1").arg(fileInfo.fileName());
@@ -38,6 +339,18 @@ FileDataLayer::~FileDataLayer()
 {
 }
 
+QString FileDataLayer::dataFormat(const QString& filePath)
+{
+    if (CompressedFile::compression(filePath) != CompressedFile::Zip) {
+        return QFileInfo(CompressedFile::strippedName(filePath)).suffix().toLower();
+    }
+    CompressedFile archive;
+    if (!archive.open(filePath, ArchiveFormats)) {
+        return QString();
+    }
+    return QFileInfo(archive.dataName()).suffix().toLower();
+}
+
 QIcon FileDataLayer::icon() const
 {
     // Return different icons based on layer type
@@ -49,10 +362,27 @@ QIcon FileDataLayer::icon() const
     return QIcon(":/icons/file-layer.png");
 }
 
+QVariantMap FileDataLayer::properties() const
+{
+    if (!m_pageCache) {
+        return m_properties;
+    }
+    
+    QVariantMap properties = m_properties;
+    properties["pageCacheBytes"] = m_pageCache->residentBytes();
+    properties["pageCacheHits"] = m_pageCache->hits();
+    properties["pageCacheMisses"] = m_pageCache->misses();
+    return properties;
+}
+
 void FileDataLayer::setVisible(bool visible)
 {
     if (m_visible != visible) {
         m_visible = visible;
+        // Layers imported metadata-only load their geometry once shown
+        if (visible) {
+            requireData();
+        }
         // In a real implementation, this would trigger a repaint
     }
 }
@@ -66,30 +396,195 @@ void FileDataLayer::setOpacity(double opacity)
     }
 }
 
+// Layers with a loader have no data until it is done, and dataUpdated()
+// then tells; others load on the calling thread
+bool FileDataLayer::requireData() const
+{
+    if (m_dataLoaded) {
+        return true;
+    }
+    FileDataLayer* self = const_cast<FileDataLayer*>(this);
+    if (m_loader) {
+        if (!m_loading) {
+            m_loader(self);
+        }
+        return false;
+    }
+    return self->loadFromFile();
+}
+
 QVariant FileDataLayer::data() const
 {
-    if (!m_dataLoaded) {
-        const_cast<FileDataLayer*>(this)->loadFromFile();
+    if (!requireData()) {
+        return QVariant();
+    }
+    
+    if (m_pageCache) {
+        // Would hold the whole file in memory, which is what paging avoids
+        qWarning() << "Paged layers are read by extent or page by page:" << m_id;
+        return QVariant();
+    }
+    
+    // Materialized on demand so the columnar store stays the only
+    // long-lived copy of the data
+    return m_features.toVariant();
+}
+
+bool FileDataLayer::forEachPage(const std::function<bool(const FeatureStore&)>& visit) const
+{
+    if (!m_pageCache) {
+        return visit(m_features);
+    }
+    
+    // The next pages are read while one is visited
+    for (qsizetype page = 0; page < m_pagedFile->pageCount(); ++page) {
+        QVector<qsizetype> next;
+        for (qsizetype ahead = page + 1; ahead < qMin(page + 1 + ReadAheadPages, m_pagedFile->pageCount()); ++ahead) {
+            next.append(ahead);
+        }
+        m_pageCache->readAhead(next);
+        
+        PageCache::PagePointer loaded = m_pageCache->page(page);
+        if (!loaded || !visit(loaded->features)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+QVariant FileDataLayer::dataInExtent(const QVariantMap& boundingBox) const
+{
+    // Compressed files cannot be searched in place and are loaded instead
+    if (m_format != "fgb" || CompressedFile::compression(m_filePath) != CompressedFile::None) {
+        if (boundingBox.isEmpty()) {
+            return data();
+        }
+        if (!requireData()) {
+            return QVariant();
+        }
+        
+        PackedRTree::Node box = boxNode(boundingBox);
+        QVariantList features;
+        if (m_pageCache) {
+            // Only the pages the box touches are read, then picked from by
+            // the bounds stored with their features. A box over more pages
+            // than the cache holds gets the first of them, so a query never
+            // builds more of the layer in memory than that.
+            QVector<qsizetype> pages = m_pagedFile->pagesIn(box);
+            qint64 pageBytes = 0;
+            bool truncated = false;
+            for (qsizetype i = 0; i < pages.size(); ++i) {
+                pageBytes += m_pagedFile->pageSize(pages[i]);
+                if (i > 0 && pageBytes > m_pageCache->maxBytes()) {
+                    pages.resize(i);
+                    truncated = true;
+                    break;
+                }
+            }
+            for (const PageCache::PagePointer& page : m_pageCache->pages(pages)) {
+                if (!page) {
+                    return QVariant();
+                }
+                for (qsizetype feature = 0; feature < page->bounds.size(); ++feature) {
+                    if (!page->bounds[feature].isEmpty() && page->bounds[feature].intersects(box)) {
+                        features.append(page->features.featureAt(feature));
+                    }
+                }
+            }
+            
+            // The surroundings of the box, where the next pan or zoom out
+            // goes, are read ahead
+            double width = box.maxX - box.minX;
+            double height = box.maxY - box.minY;
+            PackedRTree::Node around = box;
+            around.minX -= width;
+            around.minY -= height;
+            around.maxX += width;
+            around.maxY += height;
+            QVector<qsizetype> next;
+            for (qsizetype page : m_pagedFile->pagesIn(around)) {
+                if (!std::binary_search(pages.begin(), pages.end(), page)) {
+                    next.append(page);
+                }
+            }
+            m_pageCache->readAhead(next);
+            
+            QVariantMap collection;
+            collection["type"] = "FeatureCollection";
+            collection["features"] = features;
+            if (truncated) {
+                collection["truncated"] = true;
+            }
+            return collection;
+        }
+        
+        // Picked by the feature bounds computed when the layer loaded
+        for (qsizetype feature = 0; feature < m_featureBounds.size(); ++feature) {
+            if (!m_featureBounds[feature].isEmpty() && m_featureBounds[feature].intersects(box)) {
+                features.append(m_features.featureAt(feature));
+            }
+        }
+        QVariantMap collection = m_features.metadata();
+        collection["type"] = "FeatureCollection";
+        collection["features"] = features;
+        return collection;
+    }
+    
+    // Read through the spatial index, whether or not the layer is loaded
+    MappedFile file;
+    if (!file.open(m_filePath)) {
+        qWarning() << "Cannot open FlatGeobuf file:" << m_filePath;
+        return QVariant();
+    }
+    FeatureStore store;
+    FlatGeobufReader reader(file.data(), file.size());
+    reader.setFilter(boundingBox);
+    if (!reader.read(store)) {
+        qWarning() << "Invalid FlatGeobuf file:" << m_filePath << "Error:" << reader.errorString();
+        return QVariant();
     }
-    return m_cachedData;
+    return store.toVariant();
 }
 
-bool FileDataLayer::loadFromFile()
+bool FileDataLayer::loadFromFile(const IngestProgress& progress)
 {
     if (m_dataLoaded) {
         return true;
     }
+    if (m_importOptions.value("paged", false).toBool()) {
+        return loadPaged(progress);
+    }
     
     QFileInfo fileInfo(m_filePath);
-    QString extension = fileInfo.suffix().toLower();
+    QString extension = m_format;
+    
+    // FlatGeobuf and Arrow are already binary layouts that decode about as
+    // fast, and a Shapefile's attributes live in files the cache key does
+    // not cover, unless they are compressed
+    bool compressed = CompressedFile::compression(m_filePath) != CompressedFile::None;
+    bool useCache = m_importOptions.value("cache", true).toBool() && fileInfo.size() >= LayerCacheThreshold
+                    && (compressed || (extension != "fgb" && extension != "shp" && extension != "arrow" && extension != "feather"));
+    bool cached = false;
     
+    QVariantMap scannedBox = m_boundingBox;
+    m_boundingBox.clear();
     bool success = false;
-    if (extension == "json" || extension == "geojson") {
-        success = loadGeoJSON();
+    if (useCache && readLayerCache(progress)) {
+        success = cached = true;
+    } else if (extension == "json" || extension == "geojson") {
+        success = loadGeoJSON(progress);
+    } else if (extension == "geojsonl" || extension == "geojsons" || extension == "ndjson") {
+        success = loadGeoJsonSeq(progress);
     } else if (extension == "csv") {
-        success = loadCSV();
-    } else if (extension == "kml") {
-        success = loadKML();
+        success = loadCSV(progress);
+    } else if (extension == "kml" || extension == "kmz") {
+        success = loadKML(progress);
+    } else if (extension == "fgb") {
+        success = loadFlatGeobuf(progress);
+    } else if (extension == "shp") {
+        success = loadShapefile(progress);
+    } else if (extension == "arrow" || extension == "feather") {
+        success = loadArrow(progress);
     } else {
         qWarning() << "Unsupported file format:" << extension;
         return false;
@@ -97,153 +592,1272 @@ bool FileDataLayer::loadFromFile()
     
     if (success) {
         m_dataLoaded = true;
+        m_features.encodeDictionaries();
         calculateBoundingBox();
         extractProperties();
         m_lastUpdated = QDateTime::currentDateTime();
+        writeMetadataCache();
+        if (useCache && !cached) {
+            writeLayerCache();
+        }
+    } else {
+        m_boundingBox = scannedBox;
     }
     
     return success;
 }
 
-bool FileDataLayer::loadGeoJSON()
+bool FileDataLayer::loadGeoJSON(const IngestProgress& progress)
 {
-    QFile file(m_filePath);
-    if (!file.open(QIODevice::ReadOnly)) {
+    SourceData file;
+    if (!file.open(m_filePath)) {
         qWarning() << "Cannot open file:" << m_filePath;
         return false;
     }
     
-    QJsonParseError error;
-    QJsonDocument doc = QJsonDocument::fromJson(file.readAll(), &error);
-    if (doc.isNull()) {
-        qWarning() << "Invalid JSON in file:" << m_filePath << "Error:" << error.errorString();
+    // Parsed straight from the mapping, or from memory once decompressed;
+    // large files are also split across threads
+    int threads = m_importOptions.value("threads", 0).toInt();
+    ParallelGeoJsonReader reader(file.data(), file.size());
+    reader.setThreadCount(file.size() >= ParallelThreshold ? threads : 1);
+    
+    m_features.clear();
+    if (!reader.read(m_features, storedProgress(progress, file.compression()))) {
+        if (!reader.wasCancelled()) {
+            qWarning() << "Invalid GeoJSON in file:" << m_filePath << "Error:" << reader.errorString();
+        }
+        m_features.clear();
         return false;
     }
     
-    m_cachedData = doc.object().toVariantMap();
     m_type = "vector";
     return true;
 }
 
-bool FileDataLayer::loadCSV()
+bool FileDataLayer::loadGeoJsonSeq(const IngestProgress& progress)
 {
-    QFile file(m_filePath);
-    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
-        qWarning() << "Cannot open CSV file:" << m_filePath;
+    if (CompressedFile::compression(m_filePath) != CompressedFile::None) {
+        return loadStream(false, progress);
+    }
+    
+    MappedFile file;
+    if (!file.open(m_filePath)) {
+        qWarning() << "Cannot open file:" << m_filePath;
         return false;
     }
     
-    QTextStream in(&file);
-    QVariantList features;
-    QStringList headers;
-    bool firstLine = true;
+    int threads = m_importOptions.value("threads", 0).toInt();
+    GeoJsonSeqReader reader(file.data(), file.size());
+    reader.setThreadCount(file.size() >= ParallelThreshold ? threads : 1);
     
-    while (!in.atEnd()) {
-        QString line = in.readLine();
-        QStringList fields = line.split(',');
-        
-        if (firstLine) {
-            headers = fields;
-            firstLine = false;
-            continue;
-        }
-        
-        // Create a simple feature from CSV row
-        QVariantMap feature;
-        QVariantMap properties;
-        
-        for (int i = 0; i < qMin(headers.size(), fields.size()); ++i) {
-            properties[headers[i]] = fields[i];
+    m_features.clear();
+    if (!reader.read(m_features, progress)) {
+        if (!reader.wasCancelled()) {
+            qWarning() << "Invalid GeoJSON sequence in file:" << m_filePath << "Error:" << reader.errorString();
         }
-        
-        feature["properties"] = properties;
-        // For CSV, we'd need to detect lat/lon columns for geometry
-        // This is a simplified implementation
-        features.append(feature);
+        m_features.clear();
+        return false;
+    }
+    
+    trackAppendOffset(file.size());
+    m_type = "vector";
+    return true;
+}
+
+bool FileDataLayer::loadCSV(const IngestProgress& progress)
+{
+    if (CompressedFile::compression(m_filePath) != CompressedFile::None) {
+        return loadStream(true, progress);
+    }
+    
+    MappedFile file;
+    if (!file.open(m_filePath)) {
+        qWarning() << "Cannot open CSV file:" << m_filePath;
+        return false;
     }
     
-    QVariantMap geoData;
-    geoData["type"] = "FeatureCollection";
-    geoData["features"] = features;
+    int threads = m_importOptions.value("threads", 0).toInt();
+    CsvReader reader(file.data(), file.size());
+    reader.setThreadCount(file.size() >= ParallelThreshold ? threads : 1);
+    applyCsvOptions(reader);
+    
+    m_features.clear();
+    if (!reader.read(m_features, progress)) {
+        if (!reader.wasCancelled()) {
+            qWarning() << "Invalid CSV file:" << m_filePath << "Error:" << reader.errorString();
+        }
+        m_features.clear();
+        return false;
+    }
     
-    m_cachedData = geoData;
+    setGeometryFields(reader);
+    m_csvHeaderEnd = reader.headerEnd();
+    trackAppendOffset(file.size());
     m_type = "vector";
     return true;
 }
 
-bool FileDataLayer::loadKML()
+void FileDataLayer::applyCsvOptions(CsvReader& reader) const
 {
-    // KML loading would require XML parsing
-    // This is a placeholder implementation
-    qWarning() << "KML loading not implemented yet";
-    return false;
+    QString delimiter = m_importOptions.value("delimiter").toString();
+    if (!delimiter.isEmpty()) {
+        reader.setDelimiter(delimiter == "\\t" ? '\t' : delimiter.at(0).toLatin1());
+    }
+    reader.setCoordinateFields(m_importOptions.value("xField").toString(), m_importOptions.value("yField").toString());
+    reader.setWktField(m_importOptions.value("wktField").toString());
 }
 
-void FileDataLayer::calculateBoundingBox()
+void FileDataLayer::setGeometryFields(const CsvReader& reader)
 {
-    if (!m_dataLoaded || m_cachedData.isNull()) {
-        return;
+    if (!reader.wktField().isEmpty()) {
+        m_properties["geometryFields"] = QStringList{reader.wktField()};
+    } else if (!reader.xField().isEmpty()) {
+        m_properties["geometryFields"] = QStringList{reader.xField(), reader.yField()};
     }
+}
+
+// Remembers that the features cover the file up to offset, so rows written
+// after it can be appended, as long as that part ends on a line break
+void FileDataLayer::trackAppendOffset(qint64 offset)
+{
+    m_appendOffset = -1;
+    m_appendFingerprint.clear();
     
-    QVariantMap data = m_cachedData.toMap();
-    if (data["type"].toString() != "FeatureCollection") {
+    QFile file(m_filePath);
+    char last = 0;
+    if (offset <= 0 || !file.open(QIODevice::ReadOnly) || file.size() < offset
+        || !file.seek(offset - 1) || !file.getChar(&last) || last != '\n') {
         return;
     }
+    m_appendFingerprint = prefixFingerprint(file, offset);
+    if (!m_appendFingerprint.isEmpty()) {
+        m_appendOffset = offset;
+    }
+}
+
+// Reads the rows added to a CSV or GeoJSON sequence file since it was last
+// read. False when the file did not just grow or the new rows cannot be
+// read.
+bool FileDataLayer::appendFromFile()
+{
+    QFile file(m_filePath);
+    if (m_appendOffset < 0 || !file.open(QIODevice::ReadOnly) || file.size() < m_appendOffset
+        || prefixFingerprint(file, m_appendOffset) != m_appendFingerprint || !file.seek(m_appendOffset)) {
+        return false;
+    }
     
-    QVariantList features = data["features"].toList();
-    if (features.isEmpty()) {
-        return;
+    // Only whole lines are taken, a line still being written is left for
+    // the next change
+    QByteArray text = file.read(file.size() - m_appendOffset);
+    qsizetype end = text.lastIndexOf('\n') + 1;
+    if (end == 0) {
+        return true;
+    }
+    text.truncate(end);
+    
+    int threads = m_importOptions.value("threads", 0).toInt();
+    FeatureStore rows;
+    if (m_format == "csv") {
+        // The rows are read under the header record found by the first
+        // parse, which may span lines, so that they get the same columns
+        // and geometry
+        if (m_csvHeaderEnd <= 0 || m_csvHeaderEnd > m_appendOffset || !file.seek(0)) {
+            return false;
+        }
+        text.prepend(file.read(m_csvHeaderEnd));
+        CsvReader reader(text.constData(), text.size());
+        reader.setThreadCount(text.size() >= ParallelThreshold ? threads : 1);
+        applyCsvOptions(reader);
+        if (!reader.read(rows)) {
+            qWarning() << "Invalid rows appended to CSV file:" << m_filePath << "Error:" << reader.errorString();
+            return false;
+        }
+    } else {
+        GeoJsonSeqReader reader(text.constData(), text.size());
+        reader.setThreadCount(text.size() >= ParallelThreshold ? threads : 1);
+        if (!reader.read(rows)) {
+            qWarning() << "Invalid features appended to file:" << m_filePath << "Error:" << reader.errorString();
+            return false;
+        }
     }
     
-    double minLat = 90.0, maxLat = -90.0;
-    double minLon = 180.0, maxLon = -180.0;
-    bool hasCoordinates = false;
+    PackedRTree::Node extent;
+    m_featureBounds += FeatureBounds::compute(rows, extent, threads);
+    m_features.append(rows);
+    if (!extent.isEmpty()) {
+        bool first = m_boundingBox.isEmpty();
+        m_boundingBox["minLat"] = first ? extent.minY : qMin(m_boundingBox.value("minLat").toDouble(), extent.minY);
+        m_boundingBox["maxLat"] = first ? extent.maxY : qMax(m_boundingBox.value("maxLat").toDouble(), extent.maxY);
+        m_boundingBox["minLon"] = first ? extent.minX : qMin(m_boundingBox.value("minLon").toDouble(), extent.minX);
+        m_boundingBox["maxLon"] = first ? extent.maxX : qMax(m_boundingBox.value("maxLon").toDouble(), extent.maxX);
+    }
     
-    for (const QVariant& featureVar : features) {
-        QVariantMap feature = featureVar.toMap();
-        QVariantMap geometry = feature["geometry"].toMap();
-        
-        if (geometry["type"].toString() == "Point") {
-            QVariantList coords = geometry["coordinates"].toList();
-            if (coords.size() >= 2) {
-                double lon = coords[0].toDouble();
-                double lat = coords[1].toDouble();
-                
-                minLon = qMin(minLon, lon);
-                maxLon = qMax(maxLon, lon);
-                minLat = qMin(minLat, lat);
-                maxLat = qMax(maxLat, lat);
-                hasCoordinates = true;
-            }
+    m_appendOffset += end;
+    m_appendFingerprint = prefixFingerprint(file, m_appendOffset);
+    if (m_appendFingerprint.isEmpty()) {
+        m_appendOffset = -1;
+    }
+    extractProperties();
+    m_lastUpdated = QDateTime::currentDateTime();
+    return true;
+}
+
+bool FileDataLayer::loadKML(const IngestProgress& progress)
+{
+    ZipArchive archive;
+    CompressedFile compressed;
+    double compression = 1.0;
+    std::unique_ptr<QIODevice> device = openKmlDocument(archive, compressed, compression);
+    if (!device) {
+        return false;
+    }
+    
+    // Progress is reported in bytes of the file on disk
+    KmlReader reader(device.get());
+    m_features.clear();
+    if (!reader.read(m_features, storedProgress(progress, compression))) {
+        if (!reader.wasCancelled()) {
+            qWarning() << "Invalid KML file:" << m_filePath << "Error:" << reader.errorString();
+        }
+        m_features.clear();
+        return false;
+    }
+    
+    m_boundingBox = reader.boundingBox();
+    m_type = "vector";
+    return true;
+}
+
+bool FileDataLayer::loadFlatGeobuf(const IngestProgress& progress)
+{
+    SourceData file;
+    if (!file.open(m_filePath)) {
+        qWarning() << "Cannot open FlatGeobuf file:" << m_filePath;
+        return false;
+    }
+    
+    FlatGeobufReader reader(file.data(), file.size());
+    m_features.clear();
+    if (!reader.read(m_features, storedProgress(progress, file.compression()))) {
+        if (!reader.wasCancelled()) {
+            qWarning() << "Invalid FlatGeobuf file:" << m_filePath << "Error:" << reader.errorString();
         }
-        // TODO: Handle other geometry types
+        m_features.clear();
+        return false;
+    }
+    
+    m_boundingBox = reader.boundingBox();
+    m_type = "vector";
+    return true;
+}
+
+bool FileDataLayer::loadShapefile(const IngestProgress& progress)
+{
+    ShapefileParts parts;
+    if (!parts.open(m_filePath)) {
+        qWarning() << "Cannot open Shapefile:" << m_filePath;
+        return false;
     }
     
-    if (hasCoordinates) {
-        m_boundingBox["minLat"] = minLat;
-        m_boundingBox["maxLat"] = maxLat;
-        m_boundingBox["minLon"] = minLon;
-        m_boundingBox["maxLon"] = maxLon;
+    // Record ranges are decoded straight from the mappings, on several
+    // threads for large files
+    int threads = m_importOptions.value("threads", 0).toInt();
+    ShapefileReader reader(parts.shp.data(), parts.shp.size());
+    parts.attach(reader);
+    reader.setThreadCount(parts.shp.size() >= ParallelThreshold ? threads : 1);
+    
+    m_features.clear();
+    if (!reader.read(m_features, storedProgress(progress, parts.shp.compression()))) {
+        if (!reader.wasCancelled()) {
+            qWarning() << "Invalid Shapefile:" << m_filePath << "Error:" << reader.errorString();
+        }
+        m_features.clear();
+        return false;
     }
+    
+    m_boundingBox = reader.boundingBox();
+    m_type = "vector";
+    return true;
 }
 
-void FileDataLayer::extractProperties()
+bool FileDataLayer::loadArrow(const IngestProgress& progress)
 {
-    if (!m_dataLoaded || m_cachedData.isNull()) {
-        return;
+    SourceData file;
+    if (!file.open(m_filePath)) {
+        qWarning() << "Cannot open Arrow file:" << m_filePath;
+        return false;
+    }
+    
+    // Record batches are decoded straight from the mapping, on several
+    // threads for large files
+    int threads = m_importOptions.value("threads", 0).toInt();
+    ArrowReader reader(file.data(), file.size());
+    reader.setThreadCount(file.size() >= ParallelThreshold ? threads : 1);
+    
+    m_features.clear();
+    if (!reader.read(m_features, storedProgress(progress, file.compression()))) {
+        if (!reader.wasCancelled()) {
+            qWarning() << "Invalid Arrow file:" << m_filePath << "Error:" << reader.errorString();
+        }
+        m_features.clear();
+        return false;
+    }
+    
+    // Empty for WKB and WKT geometry, which calculateBoundingBox() covers
+    m_boundingBox = reader.boundingBox();
+    m_type = "vector";
+    return true;
+}
+
+// Compressed CSV files and GeoJSON sequences are decompressed on a
+// background thread and parsed in batches of whole records as the text
+// arrives, so decompression overlaps with parsing and only the batches
+// being parsed are held as text
+bool FileDataLayer::loadStream(bool csv, const IngestProgress& progress)
+{
+    CompressedFile file;
+    std::unique_ptr<QIODevice> stream;
+    if (!file.open(m_filePath, ArchiveFormats) || !(stream = file.openStream())) {
+        qWarning() << "Cannot decompress file:" << m_filePath << "Error:" << file.errorString();
+        return false;
     }
+    double compression = file.uncompressedSize() > 0 ? double(file.compressedSize()) / file.uncompressedSize() : 0.0;
     
-    QVariantMap data = m_cachedData.toMap();
-    if (data["type"].toString() == "FeatureCollection") {
-        QVariantList features = data["features"].toList();
-        m_properties["featureCount"] = features.size();
+    int threads = m_importOptions.value("threads", 0).toInt();
+    RecordBatches batches(stream.get(), csv);
+    QByteArray text;
+    m_features.clear();
+    while (batches.next(text, ParallelThreshold)) {
+        FeatureStore batch;
+        bool ok = false;
+        QString error;
+        if (csv) {
+            CsvReader reader(text.constData(), text.size());
+            reader.setThreadCount(text.size() >= ParallelThreshold ? threads : 1);
+            applyCsvOptions(reader);
+            ok = reader.read(batch);
+            error = reader.errorString();
+            if (ok && m_features.featureCount() == 0) {
+                setGeometryFields(reader);
+            }
+        } else {
+            GeoJsonSeqReader reader(text.constData(), text.size());
+            reader.setThreadCount(text.size() >= ParallelThreshold ? threads : 1);
+            ok = reader.read(batch);
+            error = reader.errorString();
+        }
+        if (!ok) {
+            qWarning() << "Invalid records in file:" << m_filePath << "Error:" << error;
+            m_features.clear();
+            return false;
+        }
+        m_features.append(batch);
         
-        // Extract data schema from first feature
-        if (!features.isEmpty()) {
-            QVariantMap firstFeature = features[0].toMap();
-            QVariantMap props = firstFeature["properties"].toMap();
-            QStringList fields = props.keys();
-            m_properties["fields"] = fields;
+        // Without a recorded size progress stays at the start until done
+        if (progress && !progress(qMin(qint64(batches.position() * compression), file.compressedSize()), m_features.featureCount())) {
+            m_features.clear();
+            return false;
+        }
+    }
+    if (batches.failed()) {
+        qWarning() << "Cannot decompress file:" << m_filePath << "Error:" << stream->errorString();
+        m_features.clear();
+        return false;
+    }
+    
+    m_type = "vector";
+    return true;
+}
+
+// Out-of-core mode: the features stay on disk in a page file built from
+// the source on first load, and reads only bring the pages they touch into
+// a cache of bounded size
+bool FileDataLayer::loadPaged(const IngestProgress& progress)
+{
+    QString pagePath = pagedFilePath();
+    if (pagePath.isEmpty()) {
+        qWarning() << "No cache directory to hold the pages of" << m_filePath;
+        return false;
+    }
+    
+    auto pagedFile = std::make_unique<PagedLayerFile>(pagePath);
+    if (pagedFile->open(m_filePath)) {
+        if (progress) {
+            progress(QFileInfo(m_filePath).size(), pagedFile->featureCount());
         }
+    } else if (!buildPagedFile(pagePath, progress) || !pagedFile->open(m_filePath)) {
+        return false;
+    }
+    
+    qint64 cacheSize = m_importOptions.value("pageCacheSize", DefaultPageCacheSize).toLongLong() * 1024 * 1024;
+    m_pagedFile = std::move(pagedFile);
+    m_pageCache = std::make_unique<PageCache>(*m_pagedFile, cacheSize);
+    m_features.clear();
+    m_featureBounds.clear();
+    m_dataLoaded = true;
+    m_type = "vector";
+    
+    PackedRTree::Node extent = m_pagedFile->extent();
+    m_boundingBox.clear();
+    if (!extent.isEmpty()) {
+        m_boundingBox["minLat"] = extent.minY;
+        m_boundingBox["maxLat"] = extent.maxY;
+        m_boundingBox["minLon"] = extent.minX;
+        m_boundingBox["maxLon"] = extent.maxX;
+    }
+    QVariantMap layer = m_pagedFile->layer();
+    if (layer.contains("geometryFields")) {
+        m_properties["geometryFields"] = layer.value("geometryFields");
+    }
+    
+    // The first page describes the layer the way a sample does for
+    // metadata-only imports, short of the fields and geometry types of all
+    // pages the page file lists
+    PageCache::PagePointer first = m_pagedFile->pageCount() > 0 ? m_pageCache->page(0) : PageCache::PagePointer();
+    if (first) {
+        describe(first->features);
+    } else {
+        describe(FeatureStore());
+    }
+    for (const char* key : {"fields", "geometryTypes"}) {
+        if (layer.contains(key)) {
+            m_properties[key] = layer.value(key);
+        }
+    }
+    m_properties["featureCount"] = m_pagedFile->featureCount();
+    m_properties["paged"] = true;
+    m_properties["pageCount"] = qint64(m_pagedFile->pageCount());
+    m_properties["pageCacheSize"] = cacheSize;
+    m_properties.remove("metadataOnly");
+    m_properties.remove("extentApproximate");
+    m_properties.remove("featureCountEstimated");
+    m_properties.remove("memoryBytes");
+    m_properties.remove("memoryAllocations");
+    m_lastUpdated = QDateTime::currentDateTime();
+    return true;
+}
+
+// Streams the source into a page file one batch of records at a time, so
+// memory use is bound by the batch size however large the file is. Only
+// line-oriented formats can be cut into batches without parsing them; files
+// in other formats are loaded whole once and paged from memory, and the
+// layer then reads them from its pages like any other.
+bool FileDataLayer::buildPagedFile(const QString& pagePath, const IngestProgress& progress)
+{
+    bool csv = m_format == "csv";
+    if (!csv && m_format != "geojsonl" && m_format != "geojsons" && m_format != "ndjson") {
+        return buildPagedFileFromLayer(pagePath, progress);
+    }
+    
+    // Compressed sources are decompressed on a background thread and cut
+    // into batches as they arrive
+    bool compressed = CompressedFile::compression(m_filePath) != CompressedFile::None;
+    MappedFile file;
+    CompressedFile compressedFile;
+    std::unique_ptr<QIODevice> stream;
+    bool opened = false;
+    if (compressed) {
+        opened = compressedFile.open(m_filePath, ArchiveFormats) && (stream = compressedFile.openStream()) != nullptr;
+    } else {
+        opened = file.open(m_filePath);
+    }
+    if (!opened) {
+        qWarning() << "Cannot open file:" << m_filePath;
+        return false;
+    }
+    PagedLayerWriter writer(pagePath);
+    if (!QDir().mkpath(QFileInfo(pagePath).absolutePath()) || !writer.open(m_filePath)) {
+        qWarning() << "Cannot write page file:" << pagePath << "Error:" << writer.errorString();
+        return false;
+    }
+    
+    // The fields and geometry types of the whole layer, which a page only
+    // holds some of
+    int threads = m_importOptions.value("threads", 0).toInt();
+    QStringList fields;
+    QStringList geometryTypes;
+    auto addBatch = [&](const char* text, qsizetype size, qint64 offset) {
+        FeatureStore batch;
+        bool ok = false;
+        QString error;
+        if (csv) {
+            CsvReader reader(text, size);
+            reader.setThreadCount(threads);
+            applyCsvOptions(reader);
+            ok = reader.read(batch);
+            error = reader.errorString();
+            if (ok && !m_properties.contains("geometryFields")) {
+                setGeometryFields(reader);
+            }
+        } else {
+            GeoJsonSeqReader reader(text, size);
+            reader.setThreadCount(threads);
+            ok = reader.read(batch);
+            error = reader.errorString();
+        }
+        if (!ok) {
+            qWarning() << "Invalid records in file:" << m_filePath << "at offset" << offset << "Error:" << error;
+            return false;
+        }
+        if (!writer.addBatch(batch, threads)) {
+            qWarning() << "Cannot write page file:" << pagePath << "Error:" << writer.errorString();
+            return false;
+        }
+        for (const QString& name : batch.columnNames()) {
+            if (!fields.contains(name)) {
+                fields.append(name);
+            }
+        }
+        FeatureStore::GeometryType last = FeatureStore::NoGeometry;
+        for (qsizetype feature = 0; feature < batch.featureCount(); ++feature) {
+            FeatureStore::GeometryType type = batch.geometryType(feature);
+            if (type != last && type != FeatureStore::NoGeometry) {
+                QString name = FeatureStore::geometryTypeName(type);
+                if (!geometryTypes.contains(name)) {
+                    geometryTypes.append(name);
+                }
+                last = type;
+            }
+        }
+        return true;
+    };
+    
+    if (compressed) {
+        double compression = compressedFile.uncompressedSize() > 0
+            ? double(compressedFile.compressedSize()) / compressedFile.uncompressedSize() : 0.0;
+        RecordBatches batches(stream.get(), csv);
+        QByteArray text;
+        qint64 offset = 0;
+        while (batches.next(text, PageBatchSize)) {
+            if (!addBatch(text.constData(), text.size(), offset)) {
+                writer.cancel();
+                return false;
+            }
+            offset = batches.position();
+            if (progress && !progress(qMin(qint64(offset * compression), compressedFile.compressedSize()), writer.featureCount())) {
+                writer.cancel();
+                return false;
+            }
+        }
+        if (batches.failed()) {
+            qWarning() << "Cannot decompress file:" << m_filePath << "Error:" << stream->errorString();
+            writer.cancel();
+            return false;
+        }
+    } else {
+        const char* data = file.data();
+        qsizetype size = file.size();
+        char separator = csv ? '\n' : GeoJsonSeqReader::separator(data, size);
+        
+        // CSV batches are parsed under a copy of the header line
+        QByteArray header;
+        qsizetype begin = 0;
+        if (csv) {
+            CsvScanner scanner(data, size);
+            QVector<QByteArrayView> fields;
+            scanner.nextRecord(fields);
+            begin = scanner.position();
+            header = QByteArray(data, begin);
+        }
+        
+        while (begin < size) {
+            qsizetype end = size;
+            if (size - begin > PageBatchSize) {
+                qsizetype target = begin + PageBatchSize;
+                if (csv) {
+                    // A batch starts on a record, so the quotes before the
+                    // target tell whether it falls inside a quoted field
+                    bool inQuotes = (CsvScanner::countQuotes(data + begin, target - begin) & 1) != 0;
+                    end = target;
+                    if (inQuotes || data[target - 1] != '\n') {
+                        CsvScanner probe(data + target, size - target, ',', inQuotes);
+                        QVector<QByteArrayView> skipped;
+                        probe.nextRecord(skipped);
+                        end = target + probe.position();
+                    }
+                } else {
+                    const char* found = static_cast<const char*>(std::memchr(data + target, separator, size - target));
+                    end = found ? found - data : size;
+                }
+            }
+            
+            bool ok = false;
+            if (csv) {
+                QByteArray text = header;
+                text.append(data + begin, end - begin);
+                ok = addBatch(text.constData(), text.size(), begin);
+            } else {
+                ok = addBatch(data + begin, end - begin, begin);
+            }
+            if (!ok) {
+                writer.cancel();
+                return false;
+            }
+            
+            begin = end;
+            if (progress && !progress(end, writer.featureCount())) {
+                writer.cancel();
+                return false;
+            }
+        }
+    }
+    
+    QVariantMap layer;
+    if (m_properties.contains("geometryFields")) {
+        layer["geometryFields"] = m_properties.value("geometryFields");
+    }
+    layer["fields"] = fields;
+    layer["geometryTypes"] = geometryTypes;
+    if (!writer.finish(layer)) {
+        qWarning() << "Cannot write page file:" << pagePath << "Error:" << writer.errorString();
+        return false;
+    }
+    return true;
+}
+
+bool FileDataLayer::buildPagedFileFromLayer(const QString& pagePath, const IngestProgress& progress)
+{
+    FileDataLayer source(m_id, m_name, m_filePath, m_type);
+    QVariantMap options = m_importOptions;
+    options.remove("paged");
+    source.setImportOptions(options);
+    if (!source.loadFromFile(progress)) {
+        return false;
+    }
+    
+    PagedLayerWriter writer(pagePath);
+    if (!QDir().mkpath(QFileInfo(pagePath).absolutePath()) || !writer.open(m_filePath)
+        || !writer.addBatch(source.m_features, options.value("threads", 0).toInt())) {
+        qWarning() << "Cannot write page file:" << pagePath << "Error:" << writer.errorString();
+        writer.cancel();
+        return false;
+    }
+    
+    QVariantMap layer;
+    for (const char* key : {"geometryFields", "fields", "geometryTypes"}) {
+        if (source.m_properties.contains(key)) {
+            layer[key] = source.m_properties.value(key);
+        }
+    }
+    if (!writer.finish(layer)) {
+        qWarning() << "Cannot write page file:" << pagePath << "Error:" << writer.errorString();
+        return false;
+    }
+    return true;
+}
+
+// Page files live next to the layer snapshots and are keyed the same way
+QString FileDataLayer::pagedFilePath() const
+{
+    QString directory = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+    if (directory.isEmpty()) {
+        return QString();
+    }
+    QByteArray key = (QFileInfo(m_filePath).absoluteFilePath() + '\n' + layerCacheVariant()).toUtf8();
+    return directory + "/pages/" + QString::fromLatin1(QCryptographicHash::hash(key, QCryptographicHash::Sha1).toHex()) + ".gwp";
+}
+
+// Opens the KML document of a .kml file, the main member of a KMZ archive
+// or the decompressed stream of a compressed KML file. XML is parsed from a
+// device rather than the mapping because the stream reader only decodes a
+// device incrementally. compression is set to the ratio of stored to
+// uncompressed size.
+std::unique_ptr<QIODevice> FileDataLayer::openKmlDocument(ZipArchive& archive, CompressedFile& compressed, double& compression) const
+{
+    compression = 1.0;
+    
+    if (CompressedFile::compression(m_filePath) != CompressedFile::None) {
+        std::unique_ptr<QIODevice> stream;
+        if (!compressed.open(m_filePath, {"kml"}) || !(stream = compressed.openStream())) {
+            qWarning() << "Cannot decompress KML file:" << m_filePath << "Error:" << compressed.errorString();
+            return nullptr;
+        }
+        if (compressed.uncompressedSize() > 0) {
+            compression = double(compressed.compressedSize()) / compressed.uncompressedSize();
+        }
+        return stream;
+    }
+    if (QFileInfo(m_filePath).suffix().toLower() != "kmz") {
+        auto file = std::make_unique<QFile>(m_filePath);
+        if (!file->open(QIODevice::ReadOnly)) {
+            qWarning() << "Cannot open KML file:" << m_filePath;
+            return nullptr;
+        }
+        return file;
+    }
+    
+    if (!archive.open(m_filePath)) {
+        qWarning() << "Cannot open KMZ file:" << m_filePath << "Error:" << archive.errorString();
+        return nullptr;
+    }
+    
+    // The main document is doc.kml by convention, otherwise the first
+    // .kml member
+    const ZipArchive::Entry* document = nullptr;
+    for (const ZipArchive::Entry& member : archive.entries()) {
+        if (member.name.compare("doc.kml", Qt::CaseInsensitive) == 0) {
+            document = &member;
+            break;
+        }
+        if (!document && member.name.endsWith(".kml", Qt::CaseInsensitive)) {
+            document = &member;
+        }
+    }
+    if (!document) {
+        qWarning() << "No KML document in KMZ file:" << m_filePath;
+        return nullptr;
+    }
+    
+    std::unique_ptr<QIODevice> entry = archive.openEntry(*document);
+    if (!entry) {
+        qWarning() << "Cannot read KMZ file:" << m_filePath << "Error:" << archive.errorString();
+        return nullptr;
+    }
+    if (document->uncompressedSize > 0) {
+        compression = double(document->compressedSize) / document->uncompressedSize;
+    }
+    return entry;
+}
+
+// Bounds of every feature, whatever its geometry type, and the layer extent
+// unless the reader already tracked it while parsing
+void FileDataLayer::calculateBoundingBox()
+{
+    m_featureBounds.clear();
+    if (!m_dataLoaded || m_features.featureCount() == 0) {
+        return;
+    }
+    
+    PackedRTree::Node extent;
+    m_featureBounds = FeatureBounds::compute(m_features, extent, m_importOptions.value("threads", 0).toInt());
+    if (m_boundingBox.isEmpty() && !extent.isEmpty()) {
+        m_boundingBox["minLat"] = extent.minY;
+        m_boundingBox["maxLat"] = extent.maxY;
+        m_boundingBox["minLon"] = extent.minX;
+        m_boundingBox["maxLon"] = extent.maxX;
+    }
+}
+
+void FileDataLayer::extractProperties()
+{
+    if (!m_dataLoaded) {
+        return;
+    }
+    
+    describe(m_features);
+    m_properties["featureCount"] = m_features.featureCount();
+    MemoryUsage usage = m_features.memoryUsage();
+    m_properties["memoryBytes"] = usage.bytes;
+    m_properties["memoryAllocations"] = usage.allocations;
+    m_properties.remove("metadataOnly");
+    m_properties.remove("extentApproximate");
+    m_properties.remove("featureCountEstimated");
+}
+
+// Fields, their schema and the geometry types of a store, which may be a
+// sample of the file
+void FileDataLayer::describe(const FeatureStore& store)
+{
+    QStringList geometryTypes;
+    FeatureStore::GeometryType last = FeatureStore::NoGeometry;
+    for (qsizetype feature = 0; feature < store.featureCount(); ++feature) {
+        FeatureStore::GeometryType type = store.geometryType(feature);
+        if (type != last && type != FeatureStore::NoGeometry) {
+            QString name = FeatureStore::geometryTypeName(type);
+            if (!geometryTypes.contains(name)) {
+                geometryTypes.append(name);
+            }
+            last = type;
+        }
+    }
+    
+    m_properties["fields"] = store.columnNames();
+    m_properties["schema"] = LayerSchema::infer(store, m_importOptions.value("threads", 0).toInt());
+    m_properties["geometryTypes"] = geometryTypes;
+}
+
+// The page cache goes before the page file it reads from
+void FileDataLayer::takeData(FileDataLayer& loaded)
+{
+    m_pageCache = std::move(loaded.m_pageCache);
+    m_pagedFile = std::move(loaded.m_pagedFile);
+    m_features = std::move(loaded.m_features);
+    m_featureBounds = std::move(loaded.m_featureBounds);
+    m_boundingBox = loaded.m_boundingBox;
+    m_properties = loaded.m_properties;
+    m_dataLoaded = loaded.m_dataLoaded;
+    m_lastUpdated = loaded.m_lastUpdated;
+    m_appendOffset = loaded.m_appendOffset;
+    m_appendFingerprint = loaded.m_appendFingerprint;
+    m_csvHeaderEnd = loaded.m_csvHeaderEnd;
+    m_loading = false;
+}
+
+bool FileDataLayer::loadMetadata()
+{
+    if (m_dataLoaded) {
+        return true;
+    }
+    if (readMetadataCache()) {
+        return true;
+    }
+    
+    QString extension = m_format;
+    bool success = false;
+    if (extension == "json" || extension == "geojson") {
+        success = scanGeoJSON();
+    } else if (extension == "geojsonl" || extension == "geojsons" || extension == "ndjson") {
+        success = scanGeoJsonSeq();
+    } else if (extension == "csv") {
+        success = scanCSV();
+    } else if (extension == "kml" || extension == "kmz") {
+        success = scanKML();
+    } else if (extension == "fgb") {
+        success = scanFlatGeobuf();
+    } else if (extension == "shp") {
+        success = scanShapefile();
+    } else if (extension == "arrow" || extension == "feather") {
+        success = scanArrow();
+    } else {
+        qWarning() << "Unsupported file format:" << extension;
+    }
+    
+    if (success) {
+        m_properties["metadataOnly"] = true;
+    }
+    return success;
+}
+
+// The structural scan gives the exact count and extent; the first features
+// give the schema
+bool FileDataLayer::scanGeoJSON()
+{
+    SourceData file;
+    if (!file.open(m_filePath)) {
+        qWarning() << "Cannot open file:" << m_filePath;
+        return false;
+    }
+    
+    GeoJsonScanner scanner(file.data(), file.size());
+    if (!scanner.scan()) {
+        qWarning() << "Invalid GeoJSON in file:" << m_filePath << "Error:" << scanner.errorString();
+        return false;
+    }
+    
+    FeatureStore sample;
+    GeoJsonReader reader(file.data(), file.size());
+    if (!reader.read(sample, [](qint64, qint64 features) { return features < SampleSize; })
+        && !reader.wasCancelled()) {
+        qWarning() << "Invalid GeoJSON in file:" << m_filePath << "Error:" << reader.errorString();
+        return false;
+    }
+    
+    describe(sample);
+    m_properties["featureCount"] = scanner.featureCount();
+    m_boundingBox = scanner.boundingBox();
+    m_type = "vector";
+    return true;
+}
+
+// Records are counted with the tokenizer alone; the schema, geometry
+// columns and an approximate extent come from the leading records
+bool FileDataLayer::scanCSV()
+{
+    if (CompressedFile::compression(m_filePath) != CompressedFile::None) {
+        return scanStreamHead(true);
+    }
+    
+    SourceData file;
+    if (!file.open(m_filePath)) {
+        qWarning() << "Cannot open CSV file:" << m_filePath;
+        return false;
+    }
+    
+    qsizetype prefix = file.size();
+    if (prefix > SamplePrefix) {
+        const char* lineEnd = static_cast<const char*>(std::memchr(file.data() + SamplePrefix, '\n', file.size() - SamplePrefix));
+        prefix = lineEnd ? lineEnd - file.data() + 1 : file.size();
+    }
+    
+    FeatureStore sample;
+    CsvReader reader(file.data(), prefix);
+    reader.setThreadCount(1);
+    applyCsvOptions(reader);
+    if (!reader.read(sample)) {
+        qWarning() << "Invalid CSV file:" << m_filePath << "Error:" << reader.errorString();
+        return false;
+    }
+    
+    qint64 records = 0;
+    CsvScanner scanner(file.data(), file.size());
+    QVector<QByteArrayView> fields;
+    while (scanner.nextRecord(fields)) {
+        if (fields.size() > 1 || !fields.first().isEmpty()) {
+            ++records;
+        }
+    }
+    
+    describe(sample);
+    setGeometryFields(reader);
+    m_properties["featureCount"] = qMax<qint64>(0, records - 1);
+    m_boundingBox = sampleBoundingBox(sample);
+    m_properties["extentApproximate"] = prefix < file.size();
+    m_type = "vector";
+    return true;
+}
+
+// Features are counted by their separators; the schema and an approximate
+// extent come from the leading features
+bool FileDataLayer::scanGeoJsonSeq()
+{
+    if (CompressedFile::compression(m_filePath) != CompressedFile::None) {
+        return scanStreamHead(false);
+    }
+    
+    SourceData file;
+    if (!file.open(m_filePath)) {
+        qWarning() << "Cannot open file:" << m_filePath;
+        return false;
+    }
+    
+    qsizetype prefix = file.size();
+    if (prefix > SamplePrefix) {
+        char separator = GeoJsonSeqReader::separator(file.data(), file.size());
+        const char* textEnd = static_cast<const char*>(std::memchr(file.data() + SamplePrefix, separator, file.size() - SamplePrefix));
+        prefix = textEnd ? textEnd - file.data() : file.size();
+    }
+    
+    FeatureStore sample;
+    GeoJsonSeqReader reader(file.data(), prefix);
+    reader.setThreadCount(1);
+    if (!reader.read(sample)) {
+        qWarning() << "Invalid GeoJSON sequence in file:" << m_filePath << "Error:" << reader.errorString();
+        return false;
+    }
+    
+    describe(sample);
+    m_properties["featureCount"] = GeoJsonSeqReader::countFeatures(file.data(), file.size());
+    m_boundingBox = sampleBoundingBox(sample);
+    m_properties["extentApproximate"] = prefix < file.size();
+    m_type = "vector";
+    return true;
+}
+
+// Compressed CSV files and GeoJSON sequences are not decompressed whole to
+// be described: the sample is the head of the stream, and unless that is
+// all of it the count is scaled from the head to the recorded uncompressed
+// size and marked as estimated
+bool FileDataLayer::scanStreamHead(bool csv)
+{
+    CompressedFile file;
+    std::unique_ptr<QIODevice> stream;
+    if (!file.open(m_filePath, ArchiveFormats) || !(stream = file.openStream())) {
+        qWarning() << "Cannot decompress file:" << m_filePath << "Error:" << file.errorString();
+        return false;
+    }
+    
+    RecordBatches batches(stream.get(), csv);
+    QByteArray head;
+    if (!batches.next(head, SamplePrefix) && batches.failed()) {
+        qWarning() << "Cannot decompress file:" << m_filePath << "Error:" << stream->errorString();
+        return false;
+    }
+    
+    FeatureStore sample;
+    if (csv) {
+        CsvReader reader(head.constData(), head.size());
+        reader.setThreadCount(1);
+        applyCsvOptions(reader);
+        if (!reader.read(sample)) {
+            qWarning() << "Invalid CSV file:" << m_filePath << "Error:" << reader.errorString();
+            return false;
+        }
+        setGeometryFields(reader);
+    } else {
+        GeoJsonSeqReader reader(head.constData(), head.size());
+        reader.setThreadCount(1);
+        if (!reader.read(sample)) {
+            qWarning() << "Invalid GeoJSON sequence in file:" << m_filePath << "Error:" << reader.errorString();
+            return false;
+        }
+    }
+    
+    // Gzip records the size modulo 4 GB, so it is at least the head
+    bool complete = batches.atEnd();
+    qint64 count = sample.featureCount();
+    if (!complete) {
+        qint64 size = qMax(file.uncompressedSize(), batches.position());
+        count = qint64(double(count) * size / batches.position());
+    }
+    
+    describe(sample);
+    m_properties["featureCount"] = count;
+    m_properties["featureCountEstimated"] = !complete;
+    m_boundingBox = sampleBoundingBox(sample);
+    m_properties["extentApproximate"] = !complete;
+    m_type = "vector";
+    return true;
+}
+
+// Placemarks of a plain KML file are counted by tag; the schema and an
+// approximate extent come from the leading placemarks
+bool FileDataLayer::scanKML()
+{
+    ZipArchive archive;
+    CompressedFile compressed;
+    double compression = 1.0;
+    std::unique_ptr<QIODevice> device = openKmlDocument(archive, compressed, compression);
+    if (!device) {
+        return false;
+    }
+    
+    FeatureStore sample;
+    KmlReader reader(device.get());
+    bool complete = reader.read(sample, [](qint64, qint64 features) { return features < SampleSize; });
+    if (!complete && !reader.wasCancelled()) {
+        qWarning() << "Invalid KML file:" << m_filePath << "Error:" << reader.errorString();
+        return false;
+    }
+    
+    describe(sample);
+    if (complete) {
+        m_properties["featureCount"] = sample.featureCount();
+    } else if (m_format == "kml" && compressed.compression() == CompressedFile::None) {
+        MappedFile file;
+        if (file.open(m_filePath)) {
+            QByteArrayView text(file.data(), file.size());
+            qint64 count = 0;
+            for (qsizetype pos = text.indexOf("<Placemark"); pos >= 0; pos = text.indexOf("<Placemark", pos + 10)) {
+                ++count;
+            }
+            m_properties["featureCount"] = count;
+        }
+    }
+    m_boundingBox = reader.boundingBox();
+    m_properties["extentApproximate"] = !complete;
+    m_type = "vector";
+    return true;
+}
+
+// The header records the count, extent and schema; the first features give
+// the geometry types of mixed files
+bool FileDataLayer::scanFlatGeobuf()
+{
+    SourceData file;
+    if (!file.open(m_filePath)) {
+        qWarning() << "Cannot open FlatGeobuf file:" << m_filePath;
+        return false;
+    }
+    
+    FeatureStore sample;
+    FlatGeobufReader reader(file.data(), file.size());
+    bool complete = reader.read(sample, [](qint64, qint64 features) { return features < SampleSize; });
+    if (!complete && !reader.wasCancelled()) {
+        qWarning() << "Invalid FlatGeobuf file:" << m_filePath << "Error:" << reader.errorString();
+        return false;
+    }
+    
+    describe(sample);
+    m_properties["featureCount"] = complete ? qint64(sample.featureCount()) : reader.featureCount();
+    m_boundingBox = reader.boundingBox();
+    if (m_boundingBox.isEmpty()) {
+        m_boundingBox = sampleBoundingBox(sample);
+        m_properties["extentApproximate"] = !complete;
+    }
+    m_type = "vector";
+    return true;
+}
+
+// The headers give the count, extent and fields; the first records give
+// the geometry types
+bool FileDataLayer::scanShapefile()
+{
+    ShapefileParts parts;
+    if (!parts.open(m_filePath)) {
+        qWarning() << "Cannot open Shapefile:" << m_filePath;
+        return false;
+    }
+    
+    FeatureStore sample;
+    ShapefileReader reader(parts.shp.data(), parts.shp.size());
+    parts.attach(reader);
+    if (!reader.readRecords(sample, 0, SampleSize)) {
+        qWarning() << "Invalid Shapefile:" << m_filePath << "Error:" << reader.errorString();
+        return false;
+    }
+    
+    describe(sample);
+    m_properties["featureCount"] = reader.recordCount();
+    m_boundingBox = reader.boundingBox();
+    m_type = "vector";
+    return true;
+}
+
+// The footer gives the count and schema and native geometry columns the
+// extent; the first rows give the geometry types
+bool FileDataLayer::scanArrow()
+{
+    SourceData file;
+    if (!file.open(m_filePath)) {
+        qWarning() << "Cannot open Arrow file:" << m_filePath;
+        return false;
+    }
+    
+    FeatureStore sample;
+    ArrowReader reader(file.data(), file.size());
+    if (!reader.readRecords(sample, 0, SampleSize)) {
+        qWarning() << "Invalid Arrow file:" << m_filePath << "Error:" << reader.errorString();
+        return false;
+    }
+    
+    describe(sample);
+    m_properties["featureCount"] = reader.featureCount();
+    m_boundingBox = reader.boundingBox();
+    if (m_boundingBox.isEmpty()) {
+        m_boundingBox = sampleBoundingBox(sample);
+        m_properties["extentApproximate"] = reader.featureCount() > sample.featureCount();
+    }
+    m_type = "vector";
+    return true;
+}
+
+QVariantMap FileDataLayer::sampleBoundingBox(const FeatureStore& sample)
+{
+    QVariantMap box;
+    if (sample.coordinateCount() == 0) {
+        return box;
+    }
+    
+    double minX = sample.x(0), maxX = minX;
+    double minY = sample.y(0), maxY = minY;
+    for (qsizetype coordinate = 1; coordinate < sample.coordinateCount(); ++coordinate) {
+        minX = qMin(minX, sample.x(coordinate));
+        maxX = qMax(maxX, sample.x(coordinate));
+        minY = qMin(minY, sample.y(coordinate));
+        maxY = qMax(maxY, sample.y(coordinate));
+    }
+    box["minLat"] = minY;
+    box["maxLat"] = maxY;
+    box["minLon"] = minX;
+    box["maxLon"] = maxX;
+    return box;
+}
+
+// Metadata of fully loaded files is remembered per path, CSV options, size
+// and modification time, so later metadata-only imports of the same file are
+// exact without scanning it
+QString FileDataLayer::metadataCachePath() const
+{
+    QString directory = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+    if (directory.isEmpty()) {
+        return QString();
+    }
+    QByteArray key = (QFileInfo(m_filePath).absoluteFilePath() + '\n' + layerCacheVariant()).toUtf8();
+    return directory + "/layer-metadata/" + QString::fromLatin1(QCryptographicHash::hash(key, QCryptographicHash::Sha1).toHex()) + ".json";
+}
+
+bool FileDataLayer::readMetadataCache()
+{
+    QString cachePath = metadataCachePath();
+    QFile file(cachePath);
+    if (cachePath.isEmpty() || !file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    
+    QJsonObject cached = QJsonDocument::fromJson(file.readAll()).object();
+    QFileInfo fileInfo(m_filePath);
+    if (cached.value("size").toInteger(-1) != fileInfo.size()
+        || cached.value("modified").toInteger(-1) != fileInfo.lastModified().toMSecsSinceEpoch()) {
+        return false;
+    }
+    
+    m_properties["featureCount"] = cached.value("featureCount").toInteger();
+    m_properties["fields"] = cached.value("fields").toVariant().toStringList();
+    m_properties["schema"] = cached.value("schema").toArray().toVariantList();
+    m_properties["geometryTypes"] = cached.value("geometryTypes").toVariant().toStringList();
+    if (cached.contains("geometryFields")) {
+        m_properties["geometryFields"] = cached.value("geometryFields").toVariant().toStringList();
+    }
+    m_boundingBox = cached.value("boundingBox").toObject().toVariantMap();
+    m_properties["metadataOnly"] = true;
+    m_type = "vector";
+    return true;
+}
+
+void FileDataLayer::writeMetadataCache() const
+{
+    QString cachePath = metadataCachePath();
+    if (cachePath.isEmpty() || !QDir().mkpath(QFileInfo(cachePath).absolutePath())) {
+        return;
+    }
+    
+    QFileInfo fileInfo(m_filePath);
+    QJsonObject cached;
+    cached["path"] = fileInfo.absoluteFilePath();
+    cached["size"] = fileInfo.size();
+    cached["modified"] = fileInfo.lastModified().toMSecsSinceEpoch();
+    cached["featureCount"] = qint64(m_features.featureCount());
+    cached["fields"] = QJsonArray::fromStringList(m_properties.value("fields").toStringList());
+    cached["schema"] = QJsonArray::fromVariantList(m_properties.value("schema").toList());
+    cached["geometryTypes"] = QJsonArray::fromStringList(m_properties.value("geometryTypes").toStringList());
+    if (m_properties.contains("geometryFields")) {
+        cached["geometryFields"] = QJsonArray::fromStringList(m_properties.value("geometryFields").toStringList());
+    }
+    cached["boundingBox"] = QJsonObject::fromVariantMap(m_boundingBox);
+    
+    QSaveFile file(cachePath);
+    if (file.open(QIODevice::WriteOnly)) {
+        file.write(QJsonDocument(cached).toJson(QJsonDocument::Compact));
+        file.commit();
+    }
+}
+
+// Parsed layers are also snapshotted whole, so importing an unchanged file
+// again only reads the snapshot. CSV options change what a parse produces
+// and are part of the cache key.
+QString FileDataLayer::layerCacheVariant() const
+{
+    QStringList variant;
+    for (const char* option : {"delimiter", "xField", "yField", "wktField"}) {
+        variant.append(m_importOptions.value(option).toString());
+    }
+    return variant.join('\n');
+}
+
+bool FileDataLayer::readLayerCache(const IngestProgress& progress)
+{
+    QVariantMap layer;
+    if (!LayerCache().load(m_filePath, layerCacheVariant(), m_features, layer)) {
+        return false;
+    }
+    
+    m_boundingBox = layer.value("boundingBox").toMap();
+    if (layer.contains("geometryFields")) {
+        m_properties["geometryFields"] = layer.value("geometryFields");
+    }
+    if (layer.contains("appendOffset")) {
+        trackAppendOffset(layer.value("appendOffset").toLongLong());
+    }
+    m_csvHeaderEnd = layer.value("csvHeaderEnd", -1).toLongLong();
+    m_type = "vector";
+    if (progress) {
+        progress(QFileInfo(m_filePath).size(), m_features.featureCount());
+    }
+    return true;
+}
+
+void FileDataLayer::writeLayerCache() const
+{
+    QVariantMap layer;
+    layer["boundingBox"] = m_boundingBox;
+    if (m_properties.contains("geometryFields")) {
+        layer["geometryFields"] = m_properties.value("geometryFields");
+    }
+    if (m_appendOffset >= 0) {
+        layer["appendOffset"] = m_appendOffset;
+    }
+    if (m_csvHeaderEnd >= 0) {
+        layer["csvHeaderEnd"] = m_csvHeaderEnd;
     }
+    LayerCache().save(m_filePath, layerCacheVariant(), m_features, layer);
 }
\ No newline at end of file
@@ -1,11 +1,21 @@
 #pragma once
 
 #include "IDataProvider.h"
+#include "FeatureStore.h"
+#include "PackedRTree.h"
 #include <QObject>
 #include <QJsonObject>
 #include <QVariantMap>
 #include <QDateTime>
 #include <QIcon>
+#include <memory>
+
+class CompressedFile;
+class CsvReader;
+class PageCache;
+class PagedLayerFile;
+class QIODevice;
+class ZipArchive;
 
 class FileDataLayer : public IDataLayer
 {
@@ -26,38 +36,123 @@ public:
     double opacity() const override { return m_opacity; }
     void setOpacity(double opacity) override;
     
-    QVariantMap properties() const override { return m_properties; }
+    QVariantMap properties() const override;
     QVariantMap style() const override { return m_style; }
     void setStyle(const QVariantMap& style) override { m_style = style; }
     
     QVariantMap boundingBox() const override { return m_boundingBox; }
     QVariant data() const override;
+    QVariant dataInExtent(const QVariantMap& boundingBox) const override;
     QDateTime lastUpdated() const override { return m_lastUpdated; }
     
     // File-specific methods
     QString filePath() const { return m_filePath; }
-    bool loadFromFile();
+    // Suffix of the format the file's data is in: its own suffix, or for a
+    // compressed file the one under the compression suffix (roads.csv.gz)
+    // or that of the data member of a zip archive
+    QString format() const { return m_format; }
+    static QString dataFormat(const QString& filePath);
+    bool loadFromFile(const IngestProgress& progress = IngestProgress());
+    // Describes the file without loading it: feature count, extent, fields
+    // and geometry types. The data is loaded on first access or when the
+    // layer is made visible.
+    bool loadMetadata();
+    // Adds the rows appended to a CSV file or GeoJSON sequence since it was
+    // last read, parsed on their own, to the loaded features. False when the
+    // file changed in any other way or the new rows cannot be read; it then
+    // has to be loaded again.
+    bool appendFromFile();
     bool isDataLoaded() const { return m_dataLoaded; }
+    // Paged layers keep their features on disk and read the pages a query
+    // touches into a bounded cache; features() is empty for them and data()
+    // fails rather than build the whole layer in memory
+    bool isPaged() const { return m_pagedFile != nullptr; }
+    // Visits the features one store at a time: the pages of a paged layer
+    // in turn, or the loaded features at once. This reads a paged layer
+    // whole in bounded memory. False when a page cannot be read or visit
+    // returns false, which stops the walk.
+    bool forEachPage(const std::function<bool(const FeatureStore&)>& visit) const;
+    void setImportOptions(const QVariantMap& options) { m_importOptions = options; }
+    const QVariantMap& importOptions() const { return m_importOptions; }
+    const FeatureStore& features() const { return m_features; }
+    // Bounds of each loaded feature, empty for features without geometry
+    const QVector<PackedRTree::Node>& featureBounds() const { return m_featureBounds; }
+    // Loads the data of a layer shown or queried before it is loaded, in
+    // place of loading it on the calling thread
+    void setLoader(const std::function<void(FileDataLayer*)>& loader) { m_loader = loader; }
+    // Set while the loader runs; data() is empty until it is done
+    bool isLoading() const { return m_loading; }
+    void setLoading(bool loading) { m_loading = loading; }
+    // Replaces the data with that of a layer loaded from the same file
+    void takeData(FileDataLayer& loaded);
 
 private:
+    bool requireData() const;
     void calculateBoundingBox();
     void extractProperties();
-    bool loadGeoJSON();
-    bool loadCSV();
-    bool loadKML();
+    bool loadGeoJSON(const IngestProgress& progress);
+    bool loadGeoJsonSeq(const IngestProgress& progress);
+    bool loadCSV(const IngestProgress& progress);
+    bool loadKML(const IngestProgress& progress);
+    bool loadFlatGeobuf(const IngestProgress& progress);
+    bool loadShapefile(const IngestProgress& progress);
+    bool loadArrow(const IngestProgress& progress);
+    bool loadStream(bool csv, const IngestProgress& progress);
+    bool loadPaged(const IngestProgress& progress);
+    bool buildPagedFile(const QString& pagePath, const IngestProgress& progress);
+    bool buildPagedFileFromLayer(const QString& pagePath, const IngestProgress& progress);
+    QString pagedFilePath() const;
+    std::unique_ptr<QIODevice> openKmlDocument(ZipArchive& archive, CompressedFile& compressed, double& compression) const;
+    void applyCsvOptions(CsvReader& reader) const;
+    void setGeometryFields(const CsvReader& reader);
+    void trackAppendOffset(qint64 offset);
+    
+    void describe(const FeatureStore& store);
+    bool scanGeoJSON();
+    bool scanGeoJsonSeq();
+    bool scanCSV();
+    bool scanKML();
+    bool scanFlatGeobuf();
+    bool scanShapefile();
+    bool scanArrow();
+    bool scanStreamHead(bool csv);
+    static QVariantMap sampleBoundingBox(const FeatureStore& sample);
+    QString metadataCachePath() const;
+    bool readMetadataCache();
+    void writeMetadataCache() const;
+    QString layerCacheVariant() const;
+    bool readLayerCache(const IngestProgress& progress);
+    void writeLayerCache() const;
     
     QString m_id;
     QString m_name;
     QString m_type;
     QString m_description;
     QString m_filePath;
+    QString m_format;
+    QVariantMap m_importOptions;
     bool m_visible;
     double m_opacity;
     
     QVariantMap m_properties;
     QVariantMap m_style;
     QVariantMap m_boundingBox;
-    mutable QVariant m_cachedData;
+    FeatureStore m_features;
+    QVector<PackedRTree::Node> m_featureBounds;
     mutable bool m_dataLoaded;
+    bool m_loading;
+    std::function<void(FileDataLayer*)> m_loader;
     QDateTime m_lastUpdated;
+    
+    // End of the part of the file the features were read from, when more
+    // rows can be appended after it, and a fingerprint of that part
+    qint64 m_appendOffset;
+    QByteArray m_appendFingerprint;
+    // End of the header record of a CSV file, parsed again above appended
+    // rows
+    qint64 m_csvHeaderEnd;
+    
+    // Set for paged layers; the cache refers to the file
+    std::unique_ptr<PagedLayerFile> m_pagedFile;
+    std::unique_ptr<PageCache> m_pageCache;
 };
\ No newline at end of file
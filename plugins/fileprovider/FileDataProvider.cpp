@@ -1,20 +1,58 @@
 #include "FileDataProvider.h"
+#include "ArrowWriter.h"
+#include "CsvWriter.h"
+#include "FileImportJob.h"
+#include "FlatGeobufWriter.h"
+#include "GeoJsonWriter.h"
 #include <QFileInfo>
+#include <QFileSystemWatcher>
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QJsonArray>
-#include <QTextStream>
 #include <QDebug>
 #include <QDir>
+#include <QTimer>
+
+namespace {
+
+// Writers append in bursts; changes within this many milliseconds are
+// handled together
+const int ReloadDelay = 250;
+
+struct AppendedRows {
+    QString layerId;
+    qint64 firstFeature;
+    qint64 featureCount;
+};
+
+} // namespace
 
 const QStringList FileDataProvider::s_supportedExtensions = {
-    "geojson", "json", "csv", "kml"
+    "geojson", "json", "geojsonl", "geojsons", "ndjson", "csv", "kml", "kmz", "fgb", "shp", "arrow", "feather"
+};
+
+// Files in any of the formats above, compressed
+const QStringList FileDataProvider::s_compressedExtensions = {
+#ifdef HAVE_ZSTD
+    "gz", "zst", "zip"
+#else
+    "gz", "zip"
+#endif
 };
 
 FileDataProvider::FileDataProvider(QObject* parent)
     : QObject(parent)
     , m_initialized(false)
+    , m_watcher(new QFileSystemWatcher(this))
+    , m_reloadTimer(new QTimer(this))
 {
+    m_reloadTimer->setSingleShot(true);
+    m_reloadTimer->setInterval(ReloadDelay);
+    connect(m_watcher, &QFileSystemWatcher::fileChanged, this, [this](const QString& path) {
+        m_changedFiles.insert(path);
+        m_reloadTimer->start();
+    });
+    connect(m_reloadTimer, &QTimer::timeout, this, &FileDataProvider::reloadChangedFiles);
 }
 
 FileDataProvider::~FileDataProvider()
@@ -34,7 +72,7 @@ QString FileDataProvider::name() const
 
 QString FileDataProvider::description() const
 {
-    return "Loads geospatial data from local files including GeoJSON, CSV, and KML formats";
+    return "Loads geospatial data from local files including GeoJSON, CSV, KML, FlatGeobuf, Shapefile and GeoArrow formats, plain or compressed";
 }
 
 QIcon FileDataProvider::icon() const
@@ -44,7 +82,7 @@ QIcon FileDataProvider::icon() const
 
 QStringList FileDataProvider::supportedTypes() const
 {
-    return s_supportedExtensions;
+    return s_supportedExtensions + s_compressedExtensions;
 }
 
 bool FileDataProvider::canCreateLayers() const
@@ -106,8 +144,21 @@ bool FileDataProvider::removeLayer(const QString& layerId)
         return false;
     }
     
+    if (FileImportJob* load = m_loads.take(layerId)) {
+        load->cancel();
+    }
+    QString filePath = it.value()->filePath();
     delete it.value();
     m_layers.erase(it);
+    
+    // Stop watching a file once no layer reads it
+    bool watched = false;
+    for (FileDataLayer* layer : m_layers.values()) {
+        watched = watched || layer->filePath() == filePath;
+    }
+    if (!watched && m_watcher->files().contains(filePath)) {
+        m_watcher->removePath(filePath);
+    }
     emit layerRemoved(layerId);
     
     qDebug() << "Removed layer:" << layerId;
@@ -115,17 +166,62 @@ bool FileDataProvider::removeLayer(const QString& layerId)
 }
 
 bool FileDataProvider::importData(const QString& filePath, const QVariantMap& options)
+{
+    FileDataLayer* layer = createImportLayer(filePath, options);
+    if (!layer) {
+        return false;
+    }
+    
+    // Lazy imports only describe the file, the data loads on first use
+    bool lazy = options.value("lazy", false).toBool();
+    if (!(lazy ? layer->loadMetadata() : layer->loadFromFile())) {
+        qWarning() << "Failed to load data from file:" << filePath;
+        delete layer;
+        return false;
+    }
+    
+    addLayer(layer);
+    qDebug() << "Imported file as layer:" << layer->id() << "from" << filePath;
+    return true;
+}
+
+IImportJob* FileDataProvider::importDataAsync(const QString& filePath, const QVariantMap& options)
+{
+    FileDataLayer* layer = createImportLayer(filePath, options);
+    if (!layer) {
+        return nullptr;
+    }
+    
+    FileImportJob* job = new FileImportJob(layer, QFileInfo(filePath).size(), this);
+    
+    // Connected before anyone else sees the job, so the layer is registered
+    // by the time other receivers get finished()
+    connect(job, &FileImportJob::finished, this, [this, job](bool success) {
+        if (!success) {
+            return;
+        }
+        FileDataLayer* loaded = job->takeLayer();
+        addLayer(loaded);
+        qDebug() << "Imported file as layer:" << loaded->id() << "from" << loaded->filePath();
+    });
+    
+    job->start();
+    return job;
+}
+
+FileDataLayer* FileDataProvider::createImportLayer(const QString& filePath, const QVariantMap& options) const
 {
     QFileInfo fileInfo(filePath);
     if (!fileInfo.exists()) {
         qWarning() << "File does not exist:" << filePath;
-        return false;
+        return nullptr;
     }
     
-    QString extension = fileInfo.suffix().toLower();
+    // Compressed files are taken by the format of the data they hold
+    QString extension = FileDataLayer::dataFormat(filePath);
     if (!s_supportedExtensions.contains(extension)) {
-        qWarning() << "Unsupported file format:" << extension;
-        return false;
+        qWarning() << "Unsupported file format:" << fileInfo.fileName();
+        return nullptr;
     }
     
     // Generate unique layer ID
@@ -133,22 +229,126 @@ bool FileDataProvider::importData(const QString& filePath, const QVariantMap& op
     QString layerName = options.value("name", fileInfo.baseName()).toString();
     QString layerType = detectFileType(filePath);
     
-    // Create the layer
     FileDataLayer* layer = new FileDataLayer(layerId, layerName, filePath, layerType);
-    
-    // Try to load the data
-    if (!layer->loadFromFile()) {
-        qWarning() << "Failed to load data from file:" << filePath;
-        delete layer;
-        return false;
+    layer->setImportOptions(options);
+    return layer;
+}
+
+void FileDataProvider::addLayer(FileDataLayer* layer)
+{
+    m_layers[layer->id()] = layer;
+    layer->setLoader([this](FileDataLayer* shown) {
+        loadLayerAsync(shown);
+    });
+    watchLayer(layer);
+    emit layerAdded(layer->id());
+}
+
+// Layers imported with the watch option follow changes to their file
+void FileDataProvider::watchLayer(FileDataLayer* layer)
+{
+    if (layer->importOptions().value("watch", false).toBool() && !m_watcher->files().contains(layer->filePath())) {
+        m_watcher->addPath(layer->filePath());
+    }
+}
+
+// Loads a layer's file on the thread pool: a lazily imported layer when it
+// is first shown or its data is asked for, and a watched layer whose file
+// changed other than by appending. The file is read into a layer of its own
+// that hands its data over once loaded, so the worker never touches the
+// registered layer, which keeps its data until then and if the load fails.
+// A load already running for the layer is superseded.
+void FileDataProvider::loadLayerAsync(FileDataLayer* layer)
+{
+    QString layerId = layer->id();
+    if (FileImportJob* running = m_loads.take(layerId)) {
+        running->cancel();
     }
     
-    // Store the layer
-    m_layers[layerId] = layer;
-    emit layerAdded(layerId);
+    QVariantMap options = layer->importOptions();
+    options.remove("lazy");
+    FileDataLayer* loading = new FileDataLayer(layerId, layer->name(), layer->filePath(), layer->type());
+    loading->setImportOptions(options);
     
-    qDebug() << "Imported file as layer:" << layerId << "from" << filePath;
-    return true;
+    FileImportJob* job = new FileImportJob(loading, QFileInfo(layer->filePath()).size(), this);
+    connect(job, &FileImportJob::finished, this, [this, job, layerId](bool success) {
+        if (m_loads.value(layerId) != job) {
+            return;
+        }
+        m_loads.remove(layerId);
+        FileDataLayer* layer = m_layers.value(layerId);
+        layer->setLoading(false);
+        if (!success) {
+            return;
+        }
+        
+        std::unique_ptr<FileDataLayer> loaded(job->takeLayer());
+        layer->takeData(*loaded);
+        emit dataUpdated(layerId);
+    });
+    
+    m_loads[layerId] = job;
+    layer->setLoading(true);
+    emit loadStarted(job);
+    job->start();
+}
+
+void FileDataProvider::reloadChangedFiles()
+{
+    QSet<QString> changed = m_changedFiles;
+    m_changedFiles.clear();
+    
+    QList<AppendedRows> appended;
+    QStringList described;
+    for (const QString& path : changed) {
+        // A file replaced by a rename drops out of the watcher; until it
+        // reappears the layers keep their data
+        if (!QFileInfo::exists(path)) {
+            continue;
+        }
+        if (!m_watcher->files().contains(path)) {
+            m_watcher->addPath(path);
+        }
+        
+        for (FileDataLayer* layer : m_layers.values()) {
+            if (layer->filePath() != path || !layer->importOptions().value("watch", false).toBool()) {
+                continue;
+            }
+            
+            // A load still running may have read the file before it changed
+            if (layer->isLoading()) {
+                loadLayerAsync(layer);
+                continue;
+            }
+            // Layers imported metadata-only are only described
+            if (!layer->isDataLoaded()) {
+                if (!layer->loadMetadata()) {
+                    qWarning() << "Failed to describe layer:" << layer->id() << "from" << path;
+                    continue;
+                }
+                described.append(layer->id());
+                continue;
+            }
+            
+            qsizetype first = layer->features().featureCount();
+            if (!layer->appendFromFile()) {
+                loadLayerAsync(layer);
+                continue;
+            }
+            qsizetype count = layer->features().featureCount() - first;
+            if (count > 0) {
+                appended.append({layer->id(), first, count});
+            }
+        }
+    }
+    
+    for (const AppendedRows& append : appended) {
+        emit dataAppended(append.layerId, append.firstFeature, append.featureCount);
+        emit dataUpdated(append.layerId);
+    }
+    for (const QString& layerId : described) {
+        emit dataUpdated(layerId);
+    }
 }
 
 bool FileDataProvider::exportLayer(const QString& layerId, const QString& filePath, const QVariantMap& options)
@@ -163,10 +363,15 @@ bool FileDataProvider::exportLayer(const QString& layerId, const QString& filePa
     QFileInfo fileInfo(filePath);
     QString extension = fileInfo.suffix().toLower();
     
-    if (extension == "geojson" || extension == "json") {
-        return exportGeoJSON(layer, filePath);
+    if (extension == "geojson" || extension == "json" || extension == "geojsonl" || extension == "geojsons"
+        || extension == "ndjson") {
+        return exportGeoJSON(layer, filePath, options);
     } else if (extension == "csv") {
-        return exportCSV(layer, filePath);
+        return exportCSV(layer, filePath, options);
+    } else if (extension == "fgb") {
+        return exportFlatGeobuf(layer, filePath, options);
+    } else if (extension == "arrow" || extension == "feather") {
+        return exportArrow(layer, filePath, options);
     } else {
         qWarning() << "Unsupported export format:" << extension;
         return false;
@@ -194,20 +399,35 @@ void FileDataProvider::shutdown()
     
     qDebug() << "Shutting down File Data Provider";
     
+    // Stop imports that are still running, their layers are discarded
+    qDeleteAll(findChildren<FileImportJob*>());
+    m_loads.clear();
+    
     // Delete all layers
     for (auto it = m_layers.begin(); it != m_layers.end(); ++it) {
         delete it.value();
     }
     m_layers.clear();
+    
+    m_reloadTimer->stop();
+    m_changedFiles.clear();
+    if (!m_watcher->files().isEmpty()) {
+        m_watcher->removePaths(m_watcher->files());
+    }
     m_initialized = false;
 }
 
 QString FileDataProvider::detectFileType(const QString& filePath) const
 {
-    QFileInfo fileInfo(filePath);
-    QString extension = fileInfo.suffix().toLower();
+    // The format under a compression suffix, as in roads.csv.gz, or of the
+    // data file in a zip archive
+    QString extension = FileDataLayer::dataFormat(filePath);
     
-    if (extension == "geojson" || extension == "json" || extension == "kml") {
+    if (extension == "geojson" || extension == "json" || extension == "kml" || extension == "kmz") {
+        return "vector";
+    } else if (extension == "geojsonl" || extension == "geojsons" || extension == "ndjson") {
+        return "vector";
+    } else if (extension == "fgb" || extension == "shp" || extension == "arrow" || extension == "feather") {
         return "vector";
     } else if (extension == "csv") {
         return "vector"; // CSV typically contains vector data
@@ -221,15 +441,25 @@ QString FileDataProvider::generateLayerId() const
     return QUuid::createUuid().toString(QUuid::WithoutBraces);
 }
 
-bool FileDataProvider::exportGeoJSON(FileDataLayer* layer, const QString& filePath) const
+// Layers imported metadata-only load on first use, and an export is one
+bool FileDataProvider::loadForExport(FileDataLayer* layer) const
 {
-    if (!layer || !layer->isDataLoaded()) {
+    if (!layer) {
         qWarning() << "Layer has no data to export";
         return false;
     }
-    
-    QVariant data = layer->data();
-    QJsonDocument doc = QJsonDocument::fromVariant(data);
+    if (!layer->isDataLoaded() && !layer->loadFromFile()) {
+        qWarning() << "Cannot load layer data to export:" << layer->filePath();
+        return false;
+    }
+    return true;
+}
+
+bool FileDataProvider::exportGeoJSON(FileDataLayer* layer, const QString& filePath, const QVariantMap& options) const
+{
+    if (!loadForExport(layer)) {
+        return false;
+    }
     
     QFile file(filePath);
     if (!file.open(QIODevice::WriteOnly)) {
@@ -237,58 +467,133 @@ bool FileDataProvider::exportGeoJSON(FileDataLayer* layer, const QString& filePa
         return false;
     }
     
-    file.write(doc.toJson());
+    // .geojsonl and .ndjson get a feature per line, .geojsons also the RS
+    // of a GeoJSON text sequence
+    QString extension = QFileInfo(filePath).suffix().toLower();
+    GeoJsonWriter writer(&file);
+    writer.setPrecision(options.value("precision", -1).toInt());
+    writer.setIndented(options.value("indented", true).toBool());
+    writer.setSequence(extension == "geojsonl" || extension == "geojsons" || extension == "ndjson", extension == "geojsons");
+    
+    // Page by page for paged layers; the collection takes the metadata of
+    // the first store
+    bool started = false;
+    bool written = layer->forEachPage([&writer, &started](const FeatureStore& page) {
+        if (!started) {
+            started = true;
+            if (!writer.begin(page.metadata())) {
+                return false;
+            }
+        }
+        return writer.writeFeatures(page);
+    });
+    if (!written || (!started && !writer.begin(QVariantMap())) || !writer.finish()) {
+        qWarning() << "Cannot export GeoJSON:" << filePath << "Error:" << writer.errorString();
+        return false;
+    }
+    
     qDebug() << "Exported layer to GeoJSON:" << filePath;
     return true;
 }
 
-bool FileDataProvider::exportCSV(FileDataLayer* layer, const QString& filePath) const
+bool FileDataProvider::exportCSV(FileDataLayer* layer, const QString& filePath, const QVariantMap& options) const
 {
-    if (!layer || !layer->isDataLoaded()) {
-        qWarning() << "Layer has no data to export";
+    if (!loadForExport(layer)) {
         return false;
     }
     
-    QVariant data = layer->data();
-    QVariantMap geoData = data.toMap();
+    QVariantMap properties = layer->properties();
+    if (properties.value("featureCount").toLongLong() == 0) {
+        qWarning() << "No features to export";
+        return false;
+    }
     
-    if (geoData["type"].toString() != "FeatureCollection") {
-        qWarning() << "Cannot export non-FeatureCollection to CSV";
+    QFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Cannot write to file:" << filePath;
         return false;
     }
     
-    QVariantList features = geoData["features"].toList();
-    if (features.isEmpty()) {
-        qWarning() << "No features to export";
+    CsvWriter writer(&file);
+    QString delimiter = options.value("delimiter").toString();
+    if (delimiter.size() == 1 && delimiter[0].unicode() < 0x80) {
+        writer.setDelimiter(delimiter[0].toLatin1());
+    }
+    writer.setGeometryFormat(CsvWriter::geometryFormatFromName(options.value("geometry").toString()));
+    writer.setThreadCount(options.value("threads", 0).toInt());
+    
+    // The header covers the fields of the whole layer, which the pages of a
+    // paged layer each hold some of
+    bool written = writer.begin(properties.value("fields").toStringList(), properties.value("geometryTypes").toStringList())
+                   && layer->forEachPage([&writer](const FeatureStore& page) {
+                          return writer.writeFeatures(page);
+                      });
+    if (!written) {
+        qWarning() << "Cannot export CSV:" << filePath << "Error:" << writer.errorString();
+        return false;
+    }
+    
+    qDebug() << "Exported layer to CSV:" << filePath;
+    return true;
+}
+
+bool FileDataProvider::exportFlatGeobuf(FileDataLayer* layer, const QString& filePath, const QVariantMap& options) const
+{
+    if (!loadForExport(layer)) {
+        return false;
+    }
+    if (layer->isPaged()) {
+        // The writer needs every feature at once
+        qWarning() << "Paged layers export to GeoJSON or CSV only:" << layer->id();
         return false;
     }
     
     QFile file(filePath);
-    if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+    if (!file.open(QIODevice::WriteOnly)) {
         qWarning() << "Cannot write to file:" << filePath;
         return false;
     }
     
-    QTextStream out(&file);
+    FlatGeobufWriter writer(&file);
+    writer.setName(layer->name());
+    if (!options.value("index", true).toBool()) {
+        writer.setIndexNodeSize(0);
+    }
+    if (!writer.write(layer->features())) {
+        qWarning() << "Cannot export FlatGeobuf:" << filePath << "Error:" << writer.errorString();
+        return false;
+    }
+    
+    qDebug() << "Exported layer to FlatGeobuf:" << filePath;
+    return true;
+}
+
+bool FileDataProvider::exportArrow(FileDataLayer* layer, const QString& filePath, const QVariantMap& options) const
+{
+    if (!loadForExport(layer)) {
+        return false;
+    }
+    if (layer->isPaged()) {
+        // The writer needs every feature at once
+        qWarning() << "Paged layers export to GeoJSON or CSV only:" << layer->id();
+        return false;
+    }
     
-    // Write header from first feature
-    QVariantMap firstFeature = features[0].toMap();
-    QVariantMap properties = firstFeature["properties"].toMap();
-    QStringList headers = properties.keys();
-    out << headers.join(",") << "\n";
+    QFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Cannot write to file:" << filePath;
+        return false;
+    }
     
-    // Write data rows
-    for (const QVariant& featureVar : features) {
-        QVariantMap feature = featureVar.toMap();
-        QVariantMap props = feature["properties"].toMap();
-        
-        QStringList values;
-        for (const QString& header : headers) {
-            values.append(props.value(header).toString());
-        }
-        out << values.join(",") << "\n";
+    ArrowWriter writer(&file);
+    if (options.contains("batchSize")) {
+        writer.setBatchSize(options.value("batchSize").toLongLong());
+    }
+    if (!writer.write(layer->features())) {
+        qWarning() << "Cannot export Arrow:" << filePath << "Error:" << writer.errorString();
+        return false;
     }
     
-    qDebug() << "Exported layer to CSV:" << filePath;
+    qDebug() << "Exported layer to Arrow:" << filePath;
     return true;
-}
\ No newline at end of file
+}
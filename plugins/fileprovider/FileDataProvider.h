@@ -4,17 +4,23 @@
 #include "FileDataLayer.h"
 #include <QObject>
 #include <QMap>
+#include <QSet>
 #include <QUuid>
 #include <memory>
 
+class FileImportJob;
+class QFileSystemWatcher;
+class QTimer;
+
 class FileDataProvider : public QObject, public IDataProvider
 {
     Q_OBJECT
+    Q_INTERFACES(IDataProvider)
 
 public:
     explicit FileDataProvider(QObject* parent = nullptr);
     ~FileDataProvider();
-
+    
     // IDataProvider interface
     QString providerId() const override;
     QString name() const override;
@@ -38,6 +44,8 @@ public:
                     const QVariantMap& options = QVariantMap()) override;
     bool exportLayer(const QString& layerId, const QString& filePath, 
                      const QVariantMap& options = QVariantMap()) override;
+    IImportJob* importDataAsync(const QString& filePath,
+                                const QVariantMap& options = QVariantMap()) override;
     
     bool initialize() override;
     void shutdown() override;
@@ -47,15 +55,38 @@ signals:
     void layerRemoved(const QString& layerId) override;
     void layerChanged(const QString& layerId) override;
     void dataUpdated(const QString& layerId) override;
+    // A layer's data started loading in the background, outside of an
+    // import; dataUpdated() follows once it is loaded
+    void loadStarted(IImportJob* job);
+    // Rows appended to the file of a watched layer were added as features
+    // firstFeature to firstFeature + featureCount - 1, which leaves the
+    // features before them as they were; dataUpdated() follows
+    void dataAppended(const QString& layerId, qint64 firstFeature, qint64 featureCount);
 
 private:
     QString detectFileType(const QString& filePath) const;
     QString generateLayerId() const;
-    bool exportGeoJSON(FileDataLayer* layer, const QString& filePath) const;
-    bool exportCSV(FileDataLayer* layer, const QString& filePath) const;
+    FileDataLayer* createImportLayer(const QString& filePath, const QVariantMap& options) const;
+    void addLayer(FileDataLayer* layer);
+    void watchLayer(FileDataLayer* layer);
+    void loadLayerAsync(FileDataLayer* layer);
+    void reloadChangedFiles();
+    bool loadForExport(FileDataLayer* layer) const;
+    bool exportGeoJSON(FileDataLayer* layer, const QString& filePath, const QVariantMap& options) const;
+    bool exportCSV(FileDataLayer* layer, const QString& filePath, const QVariantMap& options) const;
+    bool exportFlatGeobuf(FileDataLayer* layer, const QString& filePath, const QVariantMap& options) const;
+    bool exportArrow(FileDataLayer* layer, const QString& filePath, const QVariantMap& options) const;
     
     QMap<QString, FileDataLayer*> m_layers;
+    // Background loads of registered layers, by layer id
+    QMap<QString, FileImportJob*> m_loads;
     bool m_initialized;
     
+    // Files of layers imported with the watch option
+    QFileSystemWatcher* m_watcher;
+    QTimer* m_reloadTimer;
+    QSet<QString> m_changedFiles;
+    
     static const QStringList s_supportedExtensions;
+    static const QStringList s_compressedExtensions;
 };
\ No newline at end of file
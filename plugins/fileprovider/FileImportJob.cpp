@@ -0,0 +1,83 @@
+#include "FileImportJob.h"
+#include <QDebug>
+#include <QtConcurrentRun>
+
+namespace {
+
+// Keeps the receiving event loop from drowning in progress updates
+const qint64 ProgressInterval = 100;
+
+} // namespace
+
+FileImportJob::FileImportJob(FileDataLayer* layer, qint64 totalBytes, QObject* parent)
+    : QObject(parent)
+    , m_layer(layer)
+    , m_filePath(layer->filePath())
+    , m_totalBytes(totalBytes)
+    , m_bytes(0)
+    , m_features(0)
+    , m_cancelled(false)
+    , m_finished(false)
+{
+    connect(&m_watcher, &QFutureWatcher<bool>::finished, this, &FileImportJob::onLoadFinished);
+}
+
+FileImportJob::~FileImportJob()
+{
+    // The worker still references the layer
+    m_cancelled = true;
+    m_watcher.waitForFinished();
+}
+
+void FileImportJob::start()
+{
+    m_progressTimer.start();
+    FileDataLayer* layer = m_layer.get();
+    m_watcher.setFuture(QtConcurrent::run([this, layer]() {
+        if (layer->importOptions().value("lazy", false).toBool()) {
+            return layer->loadMetadata();
+        }
+        return layer->loadFromFile([this](qint64 bytes, qint64 features) {
+            return reportProgress(bytes, features);
+        });
+    }));
+}
+
+void FileImportJob::cancel()
+{
+    m_cancelled = true;
+}
+
+// Runs on the worker thread
+bool FileImportJob::reportProgress(qint64 bytes, qint64 features)
+{
+    m_bytes = bytes;
+    m_features = features;
+    if (m_progressTimer.elapsed() >= ProgressInterval) {
+        m_progressTimer.restart();
+        emit progressChanged(bytes, m_totalBytes, features);
+    }
+    return !m_cancelled;
+}
+
+void FileImportJob::onLoadFinished()
+{
+    bool success = m_watcher.result() && !m_cancelled;
+    m_finished = true;
+    
+    if (success) {
+        m_layerId = m_layer->id();
+        m_bytes = m_totalBytes;
+        m_features = m_layer->properties().value("featureCount").toLongLong();
+        emit progressChanged(m_totalBytes, m_totalBytes, m_features);
+    } else if (m_cancelled) {
+        m_error = "Import cancelled";
+        qDebug() << "Import cancelled:" << m_filePath;
+    } else {
+        m_error = QString("Failed to load data from file: %1").arg(m_filePath);
+        qWarning() << m_error;
+    }
+    
+    emit finished(success);
+    deleteLater();
+}
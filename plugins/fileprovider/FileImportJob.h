@@ -0,0 +1,59 @@
+#pragma once
+
+#include "IDataProvider.h"
+#include "FileDataLayer.h"
+#include <QElapsedTimer>
+#include <QFutureWatcher>
+#include <QObject>
+#include <atomic>
+#include <memory>
+
+// Loads a FileDataLayer on the global thread pool. Progress is reported
+// from the worker thread at most every ProgressInterval milliseconds; the
+// provider takes the layer over when finished(true) is emitted.
+class FileImportJob : public QObject, public IImportJob
+{
+    Q_OBJECT
+    Q_INTERFACES(IImportJob)
+
+public:
+    FileImportJob(FileDataLayer* layer, qint64 totalBytes, QObject* parent = nullptr);
+    ~FileImportJob();
+    
+    void start();
+    // Releases the loaded layer to the caller
+    FileDataLayer* takeLayer() { return m_layer.release(); }
+    
+    // IImportJob interface
+    QString filePath() const override { return m_filePath; }
+    qint64 totalBytes() const override { return m_totalBytes; }
+    qint64 bytesProcessed() const override { return m_bytes; }
+    qint64 featuresProcessed() const override { return m_features; }
+    
+    bool isFinished() const override { return m_finished; }
+    bool isCancelled() const override { return m_cancelled; }
+    QString layerId() const override { return m_layerId; }
+    QString errorString() const override { return m_error; }
+    
+    void cancel() override;
+
+signals:
+    void progressChanged(qint64 bytesProcessed, qint64 totalBytes, qint64 featuresProcessed) override;
+    void finished(bool success) override;
+
+private:
+    bool reportProgress(qint64 bytes, qint64 features);
+    void onLoadFinished();
+    
+    std::unique_ptr<FileDataLayer> m_layer;
+    QString m_filePath;
+    QString m_layerId;
+    QString m_error;
+    qint64 m_totalBytes;
+    std::atomic<qint64> m_bytes;
+    std::atomic<qint64> m_features;
+    std::atomic<bool> m_cancelled;
+    bool m_finished;
+    QElapsedTimer m_progressTimer;
+    QFutureWatcher<bool> m_watcher;
+};
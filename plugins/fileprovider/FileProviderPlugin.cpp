@@ -25,7 +25,7 @@ QString FileProviderPlugin::version() const
 
 QString FileProviderPlugin::description() const
 {
-    return "Provides geospatial data from local files including GeoJSON, CSV, and KML";
+    return "Provides geospatial data from local files including GeoJSON, CSV, KML, FlatGeobuf, Shapefile and GeoArrow";
 }
 
 QIcon FileProviderPlugin::icon() const
@@ -51,8 +51,8 @@ bool FileProviderPlugin::initialize()
         return false;
     }
     
-    // TODO: Register with DataProviderManager
-    // This would be done by the core application when the plugin is loaded
+    // Registered with the DataProviderManager by the application through
+    // dataProvider()
     
     m_initialized = true;
     qDebug() << "File Provider Plugin initialized successfully";
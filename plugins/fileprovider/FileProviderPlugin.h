@@ -30,6 +30,8 @@ public:
     
     // Access to the data provider
     FileDataProvider* getDataProvider() const { return m_dataProvider; }
+    // Same, looked up by the application to register it
+    Q_INVOKABLE QObject* dataProvider() const { return m_dataProvider; }
 
 private:
     FileDataProvider* m_dataProvider;
@@ -0,0 +1,268 @@
+#pragma once
+
+#include <QByteArray>
+#include <QVector>
+#include <QString>
+#include <QtEndian>
+#include <algorithm>
+#include <cstring>
+
+// Minimal FlatBuffers (https://flatbuffers.dev) support shared by the
+// FlatGeobuf and Arrow IPC readers and writers, whose schemas are written
+// out by hand as vtable slot numbers.
+
+// Bounds-checked view of a FlatBuffers table inside one buffer. Absent or
+// out of range fields read as their default.
+class FlatBufferTable
+{
+public:
+    FlatBufferTable()
+        : m_buffer(nullptr)
+        , m_size(0)
+        , m_pos(0)
+        , m_vtable(0)
+        , m_vtableSize(0)
+    {
+    }
+    
+    FlatBufferTable(const char* buffer, qsizetype size, qsizetype pos)
+        : FlatBufferTable()
+    {
+        if (pos < 0 || pos + 4 > size) {
+            return;
+        }
+        qsizetype vtable = pos - qFromLittleEndian<qint32>(buffer + pos);
+        if (vtable < 0 || vtable + 4 > size) {
+            return;
+        }
+        quint16 vtableSize = qFromLittleEndian<quint16>(buffer + vtable);
+        if (vtable + vtableSize > size || pos + qFromLittleEndian<quint16>(buffer + vtable + 2) > size) {
+            return;
+        }
+        m_buffer = buffer;
+        m_size = size;
+        m_pos = pos;
+        m_vtable = vtable;
+        m_vtableSize = vtableSize;
+    }
+    
+    // Table starting at the root offset of a buffer
+    static FlatBufferTable root(const char* buffer, qsizetype size)
+    {
+        return size >= 4 ? FlatBufferTable(buffer, size, qFromLittleEndian<quint32>(buffer)) : FlatBufferTable();
+    }
+    
+    bool isValid() const { return m_buffer != nullptr; }
+    
+    template<typename T>
+    T scalar(int field, T defaultValue) const
+    {
+        qsizetype pos = fieldPosition(field, sizeof(T));
+        return pos < 0 ? defaultValue : qFromLittleEndian<T>(m_buffer + pos);
+    }
+    
+    // Elements and length of a vector of elementSize-byte values or structs
+    const char* vector(int field, qsizetype elementSize, qsizetype& count) const
+    {
+        count = 0;
+        qsizetype pos = target(fieldPosition(field, 4));
+        if (pos < 0 || pos + 4 > m_size) {
+            return nullptr;
+        }
+        quint32 length = qFromLittleEndian<quint32>(m_buffer + pos);
+        if (qint64(length) * elementSize > m_size - pos - 4) {
+            return nullptr;
+        }
+        count = length;
+        return m_buffer + pos + 4;
+    }
+    
+    QString string(int field) const
+    {
+        qsizetype length = 0;
+        const char* text = vector(field, 1, length);
+        return text ? QString::fromUtf8(text, length) : QString();
+    }
+    
+    // Table field, or the value of a union field
+    FlatBufferTable table(int field) const
+    {
+        qsizetype pos = target(fieldPosition(field, 4));
+        return pos < 0 ? FlatBufferTable() : FlatBufferTable(m_buffer, m_size, pos);
+    }
+    
+    // Element of a vector of tables
+    FlatBufferTable tableAt(const char* elements, qsizetype index) const
+    {
+        qsizetype pos = elements - m_buffer + index * 4;
+        return FlatBufferTable(m_buffer, m_size, target(pos));
+    }
+
+private:
+    qsizetype fieldPosition(int field, qsizetype size) const
+    {
+        qsizetype slot = 4 + 2 * field;
+        if (!m_buffer || slot + 2 > m_vtableSize) {
+            return -1;
+        }
+        quint16 offset = qFromLittleEndian<quint16>(m_buffer + m_vtable + slot);
+        if (offset == 0 || m_pos + offset + size > m_size) {
+            return -1;
+        }
+        return m_pos + offset;
+    }
+    
+    // Follows the unsigned offset stored at pos
+    qsizetype target(qsizetype pos) const
+    {
+        if (pos < 0 || pos + 4 > m_size) {
+            return -1;
+        }
+        qsizetype result = pos + qFromLittleEndian<quint32>(m_buffer + pos);
+        return result < m_size ? result : -1;
+    }
+    
+    const char* m_buffer;
+    qsizetype m_size;
+    qsizetype m_pos;
+    qsizetype m_vtable;
+    quint16 m_vtableSize;
+};
+
+// Lays out one FlatBuffers table. FlatBuffers are normally built back to
+// front. Writing a table before the strings, vectors and tables it
+// references keeps every offset pointing forward as the format requires;
+// offset fields are reserved here and patched once their targets are
+// written. The static helpers append those targets to the buffer.
+class FlatBufferWriter
+{
+public:
+    template<typename T>
+    void add(int slot, T value)
+    {
+        Field field{slot, qsizetype(sizeof(T)), {}, -1};
+        qToLittleEndian(value, field.bytes);
+        m_fields.append(field);
+    }
+    
+    void addOffset(int slot)
+    {
+        m_fields.append({slot, 4, {}, -1});
+    }
+    
+    // Lays out the vtable and the table and returns the table position
+    qsizetype finish(QByteArray& buffer)
+    {
+        // Largest fields first keeps the padding down
+        std::stable_sort(m_fields.begin(), m_fields.end(), [](const Field& a, const Field& b) {
+            return a.size > b.size;
+        });
+        int slotCount = 0;
+        qsizetype tableSize = 4;
+        QVector<qsizetype> offsets;
+        for (const Field& field : m_fields) {
+            slotCount = qMax(slotCount, field.slot + 1);
+            tableSize = (tableSize + field.size - 1) / field.size * field.size;
+            offsets.append(tableSize);
+            tableSize += field.size;
+        }
+        
+        QVector<quint16> vtable(2 + slotCount, 0);
+        vtable[0] = quint16(vtable.size() * 2);
+        vtable[1] = quint16(tableSize);
+        for (qsizetype i = 0; i < m_fields.size(); ++i) {
+            vtable[2 + m_fields[i].slot] = quint16(offsets[i]);
+        }
+        pad(buffer, 2);
+        qsizetype vtablePos = buffer.size();
+        for (quint16 entry : vtable) {
+            appendLE(buffer, entry);
+        }
+        
+        // Tables start 8-aligned so every field is aligned to its size
+        pad(buffer, 8);
+        qsizetype tablePos = buffer.size();
+        buffer.append(tableSize, '\0');
+        qToLittleEndian(qint32(tablePos - vtablePos), buffer.data() + tablePos);
+        for (qsizetype i = 0; i < m_fields.size(); ++i) {
+            m_fields[i].position = tablePos + offsets[i];
+            std::memcpy(buffer.data() + m_fields[i].position, m_fields[i].bytes, m_fields[i].size);
+        }
+        return tablePos;
+    }
+    
+    qsizetype position(int slot) const
+    {
+        for (const Field& field : m_fields) {
+            if (field.slot == slot) {
+                return field.position;
+            }
+        }
+        return -1;
+    }
+    
+    static void pad(QByteArray& buffer, qsizetype alignment)
+    {
+        while (buffer.size() % alignment != 0) {
+            buffer.append('\0');
+        }
+    }
+    
+    // Points the unsigned offset at field to target
+    static void patch(QByteArray& buffer, qsizetype field, qsizetype target)
+    {
+        qToLittleEndian(quint32(target - field), buffer.data() + field);
+    }
+    
+    // Appends a vector of count elementSize-byte little-endian elements, with
+    // the elements aligned to their size (structs to 8 bytes). Without data
+    // the elements are zeroed. Returns the position of the vector.
+    static qsizetype appendVector(QByteArray& buffer, const char* data, qsizetype count, qsizetype elementSize)
+    {
+        pad(buffer, 4);
+        if (elementSize > 4 && (buffer.size() + 4) % 8 != 0) {
+            buffer.append(4, '\0');
+        }
+        qsizetype pos = buffer.size();
+        appendLE(buffer, quint32(count));
+        if (data) {
+            buffer.append(data, count * elementSize);
+        } else {
+            buffer.append(count * elementSize, '\0');
+        }
+        return pos;
+    }
+    
+    static qsizetype appendString(QByteArray& buffer, const QByteArray& utf8)
+    {
+        qsizetype pos = appendVector(buffer, utf8.constData(), utf8.size(), 1);
+        buffer.append('\0');
+        return pos;
+    }
+    
+    template<typename T>
+    static qsizetype appendScalars(QByteArray& buffer, const QVector<T>& values)
+    {
+        QByteArray bytes(values.size() * qsizetype(sizeof(T)), Qt::Uninitialized);
+        qToLittleEndian<T>(values.constData(), values.size(), bytes.data());
+        return appendVector(buffer, bytes.constData(), values.size(), sizeof(T));
+    }
+
+private:
+    struct Field {
+        int slot;
+        qsizetype size;
+        char bytes[8];
+        qsizetype position;
+    };
+    
+    template<typename T>
+    static void appendLE(QByteArray& buffer, T value)
+    {
+        char bytes[sizeof(T)];
+        qToLittleEndian(value, bytes);
+        buffer.append(bytes, sizeof(T));
+    }
+    
+    QVector<Field> m_fields;
+};
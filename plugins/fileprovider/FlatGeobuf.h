@@ -0,0 +1,80 @@
+#pragma once
+
+#include <QtGlobal>
+
+// Layout of the FlatGeobuf format (https://flatgeobuf.org) shared by the
+// reader and the writer. A file is the magic bytes, a size-prefixed
+// FlatBuffers header, an optional packed Hilbert R-tree (see PackedRTree)
+// and size-prefixed FlatBuffers features. Geometry type codes match
+// FeatureStore::GeometryType up to GeometryCollection; the field enums are
+// the vtable slots of the schema tables.
+class FlatGeobuf
+{
+public:
+    static constexpr char Magic[8] = {'f', 'g', 'b', 3, 'f', 'g', 'b', 0};
+    // Only the first four bytes identify the format, the last ones carry the
+    // patch version
+    static constexpr int MagicCheckSize = 4;
+    
+    enum ColumnType : quint8 {
+        Byte,
+        UByte,
+        Bool,
+        Short,
+        UShort,
+        Int,
+        UInt,
+        Long,
+        ULong,
+        Float,
+        Double,
+        String,
+        Json,
+        DateTime,
+        Binary
+    };
+    
+    enum HeaderField {
+        HeaderName,
+        HeaderEnvelope,
+        HeaderGeometryType,
+        HeaderHasZ,
+        HeaderHasM,
+        HeaderHasT,
+        HeaderHasTM,
+        HeaderColumns,
+        HeaderFeaturesCount,
+        HeaderIndexNodeSize,
+        HeaderCrs,
+        HeaderTitle,
+        HeaderDescription,
+        HeaderMetadata
+    };
+    
+    enum ColumnField {
+        ColumnName,
+        ColumnTypeField
+    };
+    
+    enum CrsField {
+        CrsOrg,
+        CrsCode
+    };
+    
+    enum GeometryField {
+        GeometryEnds,
+        GeometryXY,
+        GeometryZ,
+        GeometryM,
+        GeometryT,
+        GeometryTM,
+        GeometryTypeField,
+        GeometryParts
+    };
+    
+    enum FeatureField {
+        FeatureGeometry,
+        FeatureProperties,
+        FeatureColumns
+    };
+};
@@ -0,0 +1,470 @@
+#include "FlatGeobufReader.h"
+#include "FlatBuffers.h"
+#include "FlatGeobuf.h"
+#include <QtEndian>
+#include <cstring>
+#include <limits>
+
+namespace {
+
+// Progress is reported every this many features
+const qint64 ProgressInterval = 1024;
+// Geometry parts nest at most this deep; guards against offset cycles
+const int MaxGeometryDepth = 16;
+
+template<typename T>
+T readLE(const char* data)
+{
+    return qFromLittleEndian<T>(data);
+}
+
+FeatureStore::GeometryType geometryTypeFromCode(quint8 code)
+{
+    return code <= FeatureStore::GeometryCollection ? FeatureStore::GeometryType(code) : FeatureStore::NoGeometry;
+}
+
+void addCoordinates(FeatureStore& store, const char* xy, qsizetype first, qsizetype last)
+{
+    for (qsizetype i = first; i < last; ++i) {
+        store.addCoordinate(readLE<double>(xy + i * 16), readLE<double>(xy + i * 16 + 8));
+    }
+}
+
+// Adds one line or ring per entry of ends, which hold the end coordinate of
+// each; without ends the whole coordinate array is one
+bool addRings(FeatureStore& store, const FlatBufferTable& geometry, FeatureStore::GeometryType partType)
+{
+    qsizetype valueCount = 0;
+    const char* xy = geometry.vector(FlatGeobuf::GeometryXY, 8, valueCount);
+    qsizetype coordinateCount = valueCount / 2;
+    qsizetype endCount = 0;
+    const char* ends = geometry.vector(FlatGeobuf::GeometryEnds, 4, endCount);
+    
+    if (partType == FeatureStore::Polygon) {
+        store.beginPart(FeatureStore::Polygon);
+    }
+    qsizetype first = 0;
+    for (qsizetype ring = 0; ring < qMax<qsizetype>(1, endCount); ++ring) {
+        qsizetype last = endCount > 0 ? readLE<quint32>(ends + ring * 4) : coordinateCount;
+        if (last < first || last > coordinateCount) {
+            return false;
+        }
+        if (partType == FeatureStore::LineString) {
+            store.beginPart(FeatureStore::LineString);
+        }
+        store.beginRing();
+        addCoordinates(store, xy, first, last);
+        first = last;
+    }
+    return true;
+}
+
+bool readGeometry(FeatureStore& store, const FlatBufferTable& geometry, FeatureStore::GeometryType type, int depth = 0)
+{
+    qsizetype valueCount = 0;
+    const char* xy = geometry.vector(FlatGeobuf::GeometryXY, 8, valueCount);
+    qsizetype coordinateCount = valueCount / 2;
+    
+    switch (type) {
+    case FeatureStore::Point:
+        store.beginPart(FeatureStore::Point);
+        store.beginRing();
+        addCoordinates(store, xy, 0, qMin<qsizetype>(1, coordinateCount));
+        return true;
+    case FeatureStore::MultiPoint:
+        for (qsizetype coordinate = 0; coordinate < coordinateCount; ++coordinate) {
+            store.beginPart(FeatureStore::Point);
+            store.beginRing();
+            addCoordinates(store, xy, coordinate, coordinate + 1);
+        }
+        return true;
+    case FeatureStore::LineString:
+    case FeatureStore::MultiLineString:
+        return addRings(store, geometry, FeatureStore::LineString);
+    case FeatureStore::Polygon:
+        return addRings(store, geometry, FeatureStore::Polygon);
+    case FeatureStore::MultiPolygon:
+    case FeatureStore::GeometryCollection: {
+        qsizetype partCount = 0;
+        const char* parts = geometry.vector(FlatGeobuf::GeometryParts, 4, partCount);
+        for (qsizetype i = 0; i < partCount; ++i) {
+            FlatBufferTable part = geometry.tableAt(parts, i);
+            FeatureStore::GeometryType partType = type == FeatureStore::MultiPolygon
+                ? FeatureStore::Polygon
+                : geometryTypeFromCode(part.scalar<quint8>(FlatGeobuf::GeometryTypeField, 0));
+            if (!part.isValid() || depth >= MaxGeometryDepth || !readGeometry(store, part, partType, depth + 1)) {
+                return false;
+            }
+        }
+        return true;
+    }
+    case FeatureStore::NoGeometry:
+        break;
+    }
+    return true;
+}
+
+void expandBounds(const FlatBufferTable& geometry, PackedRTree::Node& bounds, int depth = 0)
+{
+    qsizetype valueCount = 0;
+    const char* xy = geometry.vector(FlatGeobuf::GeometryXY, 8, valueCount);
+    for (qsizetype i = 0; i + 1 < valueCount; i += 2) {
+        bounds.expand(readLE<double>(xy + i * 8), readLE<double>(xy + i * 8 + 8));
+    }
+    
+    qsizetype partCount = 0;
+    const char* parts = geometry.vector(FlatGeobuf::GeometryParts, 4, partCount);
+    for (qsizetype i = 0; i < partCount && depth < MaxGeometryDepth; ++i) {
+        expandBounds(geometry.tableAt(parts, i), bounds, depth + 1);
+    }
+}
+
+// Encoded size of a property value, -1 if it does not fit in available
+qsizetype valueSize(quint8 type, const char* value, qsizetype available)
+{
+    qsizetype size = -1;
+    switch (type) {
+    case FlatGeobuf::Byte:
+    case FlatGeobuf::UByte:
+    case FlatGeobuf::Bool:
+        size = 1;
+        break;
+    case FlatGeobuf::Short:
+    case FlatGeobuf::UShort:
+        size = 2;
+        break;
+    case FlatGeobuf::Int:
+    case FlatGeobuf::UInt:
+    case FlatGeobuf::Float:
+        size = 4;
+        break;
+    case FlatGeobuf::Long:
+    case FlatGeobuf::ULong:
+    case FlatGeobuf::Double:
+        size = 8;
+        break;
+    case FlatGeobuf::String:
+    case FlatGeobuf::Json:
+    case FlatGeobuf::DateTime:
+    case FlatGeobuf::Binary:
+        // Length-prefixed
+        if (available >= 4) {
+            size = 4 + qsizetype(readLE<quint32>(value));
+        }
+        break;
+    default:
+        break;
+    }
+    return size <= available ? size : -1;
+}
+
+void appendValue(PropertyColumn& column, quint8 type, const char* value)
+{
+    switch (type) {
+    case FlatGeobuf::Byte:
+        column.appendInt(qint8(*value));
+        break;
+    case FlatGeobuf::UByte:
+        column.appendInt(quint8(*value));
+        break;
+    case FlatGeobuf::Bool:
+        column.appendBool(*value != 0);
+        break;
+    case FlatGeobuf::Short:
+        column.appendInt(readLE<qint16>(value));
+        break;
+    case FlatGeobuf::UShort:
+        column.appendInt(readLE<quint16>(value));
+        break;
+    case FlatGeobuf::Int:
+        column.appendInt(readLE<qint32>(value));
+        break;
+    case FlatGeobuf::UInt:
+        column.appendInt(readLE<quint32>(value));
+        break;
+    case FlatGeobuf::Long:
+        column.appendInt(readLE<qint64>(value));
+        break;
+    case FlatGeobuf::ULong: {
+        quint64 number = readLE<quint64>(value);
+        if (number <= quint64(std::numeric_limits<qint64>::max())) {
+            column.appendInt(qint64(number));
+        } else {
+            column.appendDouble(double(number));
+        }
+        break;
+    }
+    case FlatGeobuf::Float:
+        column.appendDouble(readLE<float>(value));
+        break;
+    case FlatGeobuf::Double:
+        column.appendDouble(readLE<double>(value));
+        break;
+    case FlatGeobuf::Binary:
+        column.append(QByteArray(value + 4, readLE<quint32>(value)));
+        break;
+    default:
+        // String, Json and DateTime are UTF-8 text
+        column.appendString(QString::fromUtf8(value + 4, readLE<quint32>(value)));
+        break;
+    }
+}
+
+} // namespace
+
+FlatGeobufReader::FlatGeobufReader(const char* data, qsizetype size)
+    : m_data(data)
+    , m_size(size)
+    , m_headerRead(false)
+    , m_featureCount(0)
+    , m_geometryType(FeatureStore::NoGeometry)
+    , m_indexNodeSize(0)
+    , m_indexOffset(0)
+    , m_indexSize(0)
+    , m_featuresOffset(0)
+    , m_filtered(false)
+    , m_cancelled(false)
+{
+}
+
+bool FlatGeobufReader::readHeader()
+{
+    if (m_headerRead) {
+        return true;
+    }
+    
+    const qsizetype magicSize = sizeof(FlatGeobuf::Magic);
+    if (m_size < magicSize + 4 || std::memcmp(m_data, FlatGeobuf::Magic, FlatGeobuf::MagicCheckSize) != 0) {
+        m_error = "Not a FlatGeobuf file";
+        return false;
+    }
+    quint32 headerSize = readLE<quint32>(m_data + magicSize);
+    if (headerSize > m_size - magicSize - 4) {
+        m_error = "Truncated header";
+        return false;
+    }
+    
+    FlatBufferTable header = FlatBufferTable::root(m_data + magicSize + 4, headerSize);
+    if (!header.isValid()) {
+        m_error = "Malformed header";
+        return false;
+    }
+    
+    m_name = header.string(FlatGeobuf::HeaderName);
+    m_title = header.string(FlatGeobuf::HeaderTitle);
+    m_description = header.string(FlatGeobuf::HeaderDescription);
+    m_geometryType = geometryTypeFromCode(header.scalar<quint8>(FlatGeobuf::HeaderGeometryType, 0));
+    m_featureCount = qint64(header.scalar<quint64>(FlatGeobuf::HeaderFeaturesCount, 0));
+    m_indexNodeSize = header.scalar<quint16>(FlatGeobuf::HeaderIndexNodeSize, PackedRTree::DefaultNodeSize);
+    
+    qsizetype envelopeSize = 0;
+    const char* envelope = header.vector(FlatGeobuf::HeaderEnvelope, 8, envelopeSize);
+    if (envelopeSize >= 4) {
+        m_envelope.minX = readLE<double>(envelope);
+        m_envelope.minY = readLE<double>(envelope + 8);
+        m_envelope.maxX = readLE<double>(envelope + 16);
+        m_envelope.maxY = readLE<double>(envelope + 24);
+    }
+    
+    m_columns.clear();
+    qsizetype columnCount = 0;
+    const char* columns = header.vector(FlatGeobuf::HeaderColumns, 4, columnCount);
+    for (qsizetype i = 0; i < columnCount; ++i) {
+        FlatBufferTable column = header.tableAt(columns, i);
+        if (!column.isValid()) {
+            m_error = "Malformed column definition";
+            return false;
+        }
+        m_columns.append({column.string(FlatGeobuf::ColumnName), column.scalar<quint8>(FlatGeobuf::ColumnTypeField, FlatGeobuf::String), -1});
+    }
+    
+    m_indexOffset = magicSize + 4 + headerSize;
+    m_indexSize = 0;
+    if (m_featureCount > 0 && m_indexNodeSize >= 2) {
+        quint64 indexSize = PackedRTree::indexSize(quint64(m_featureCount), m_indexNodeSize);
+        if (indexSize > quint64(m_size - m_indexOffset)) {
+            m_error = "Truncated spatial index";
+            return false;
+        }
+        m_indexSize = qsizetype(indexSize);
+    }
+    m_featuresOffset = m_indexOffset + m_indexSize;
+    m_headerRead = true;
+    return true;
+}
+
+void FlatGeobufReader::setFilter(const QVariantMap& boundingBox)
+{
+    m_filtered = !boundingBox.isEmpty();
+    m_filter.minX = boundingBox.value("minLon").toDouble();
+    m_filter.minY = boundingBox.value("minLat").toDouble();
+    m_filter.maxX = boundingBox.value("maxLon").toDouble();
+    m_filter.maxY = boundingBox.value("maxLat").toDouble();
+}
+
+QStringList FlatGeobufReader::columnNames() const
+{
+    QStringList names;
+    for (const Column& column : m_columns) {
+        names.append(column.name);
+    }
+    return names;
+}
+
+QVariantMap FlatGeobufReader::boundingBox() const
+{
+    QVariantMap box;
+    if (!m_envelope.isEmpty()) {
+        box["minLat"] = m_envelope.minY;
+        box["maxLat"] = m_envelope.maxY;
+        box["minLon"] = m_envelope.minX;
+        box["maxLon"] = m_envelope.maxX;
+    }
+    return box;
+}
+
+bool FlatGeobufReader::read(FeatureStore& store, const IngestProgress& progress)
+{
+    m_cancelled = false;
+    m_error.clear();
+    if (!readHeader()) {
+        return false;
+    }
+    
+    QVariantMap metadata;
+    if (!m_name.isEmpty()) {
+        metadata["name"] = m_name;
+    }
+    if (!m_title.isEmpty()) {
+        metadata["title"] = m_title;
+    }
+    if (!m_description.isEmpty()) {
+        metadata["description"] = m_description;
+    }
+    store.setMetadata(metadata);
+    for (Column& column : m_columns) {
+        store.column(column.name);
+        column.storeIndex = store.columnIndex(column.name);
+    }
+    
+    // The index gives the offsets of the matching features directly
+    QVector<quint64> offsets;
+    bool indexed = m_filtered && hasIndex();
+    if (indexed) {
+        offsets = PackedRTree::search(m_data + m_indexOffset, quint64(m_featureCount), m_indexNodeSize, m_filter);
+        store.reserve(offsets.size(), 0);
+    } else if (m_featureCount > 0 && !m_filtered) {
+        store.reserve(m_featureCount, 0);
+    }
+    
+    qsizetype pos = m_featuresOffset;
+    for (qint64 i = 0;; ++i) {
+        if (indexed) {
+            if (i >= offsets.size()) {
+                break;
+            }
+            if (offsets[i] >= quint64(m_size - m_featuresOffset)) {
+                m_error = "Spatial index points past the end of the file";
+                return false;
+            }
+            pos = m_featuresOffset + qsizetype(offsets[i]);
+        } else if (m_featureCount > 0 && i >= m_featureCount) {
+            break;
+        } else if (pos >= m_size) {
+            // A file cut off between two features
+            if (m_featureCount > 0) {
+                m_error = QString("File ends after %1 of %2 features").arg(i).arg(m_featureCount);
+                return false;
+            }
+            break;
+        }
+        
+        qsizetype next = 0;
+        if (!readFeature(pos, store, next)) {
+            if (m_error.isEmpty()) {
+                m_error = QString("Malformed feature at offset %1").arg(pos);
+            }
+            return false;
+        }
+        pos = next;
+        
+        if (progress && (i + 1) % ProgressInterval == 0 && !progress(pos, store.featureCount())) {
+            m_cancelled = true;
+            return false;
+        }
+    }
+    
+    if (progress && !progress(m_size, store.featureCount())) {
+        m_cancelled = true;
+        return false;
+    }
+    return true;
+}
+
+// Decodes the size-prefixed feature at pos and sets next to the position
+// after it. Features outside the filter are skipped when there is no index
+// to have excluded them.
+bool FlatGeobufReader::readFeature(qsizetype pos, FeatureStore& store, qsizetype& next)
+{
+    if (pos + 4 > m_size) {
+        return false;
+    }
+    quint32 size = readLE<quint32>(m_data + pos);
+    if (size > m_size - pos - 4) {
+        return false;
+    }
+    next = pos + 4 + size;
+    
+    FlatBufferTable feature = FlatBufferTable::root(m_data + pos + 4, size);
+    if (!feature.isValid()) {
+        return false;
+    }
+    FlatBufferTable geometry = feature.table(FlatGeobuf::FeatureGeometry);
+    
+    if (m_filtered && !hasIndex()) {
+        PackedRTree::Node bounds;
+        if (geometry.isValid()) {
+            expandBounds(geometry, bounds);
+        }
+        if (bounds.isEmpty() || !bounds.intersects(m_filter)) {
+            return true;
+        }
+    }
+    
+    FeatureStore::GeometryType type = m_geometryType;
+    if (type == FeatureStore::NoGeometry && geometry.isValid()) {
+        type = geometryTypeFromCode(geometry.scalar<quint8>(FlatGeobuf::GeometryTypeField, 0));
+    }
+    store.beginFeature(geometry.isValid() ? type : FeatureStore::NoGeometry);
+    if (geometry.isValid() && !readGeometry(store, geometry, type)) {
+        return false;
+    }
+    
+    // Properties are a run of column index and value pairs
+    qsizetype length = 0;
+    const char* properties = feature.vector(FlatGeobuf::FeatureProperties, 1, length);
+    qsizetype offset = 0;
+    while (offset + 2 <= length) {
+        quint16 index = readLE<quint16>(properties + offset);
+        offset += 2;
+        if (index >= m_columns.size()) {
+            m_error = "Property of an unknown column";
+            return false;
+        }
+        
+        const Column& column = m_columns[index];
+        qsizetype bytes = valueSize(column.type, properties + offset, length - offset);
+        if (bytes < 0) {
+            m_error = "Truncated feature properties";
+            return false;
+        }
+        PropertyColumn& target = store.columnAt(column.storeIndex);
+        if (target.size() < store.featureCount()) {
+            appendValue(target, column.type, properties + offset);
+        }
+        offset += bytes;
+    }
+    
+    store.endFeature();
+    return true;
+}
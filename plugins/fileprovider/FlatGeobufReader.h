@@ -0,0 +1,69 @@
+#pragma once
+
+#include "FeatureStore.h"
+#include "PackedRTree.h"
+#include <QString>
+#include <QVariantMap>
+#include <QVector>
+
+// Reads FlatGeobuf features straight from an in-memory (usually mapped)
+// file. With a filter set only the features whose bounds intersect it are
+// decoded: files with a spatial index are searched through it and only the
+// matching features are touched, other files are scanned feature by feature
+// without decoding the ones outside. Z, M and time ordinates are dropped.
+class FlatGeobufReader
+{
+public:
+    FlatGeobufReader(const char* data, qsizetype size);
+    
+    // Parses the magic bytes and the header; read() does this as needed
+    bool readHeader();
+    
+    // Box in the {minLat, minLon, maxLat, maxLon} form of layer extents
+    void setFilter(const QVariantMap& boundingBox);
+    
+    bool read(FeatureStore& store, const IngestProgress& progress = IngestProgress());
+    bool wasCancelled() const { return m_cancelled; }
+    QString errorString() const { return m_error; }
+    
+    // Header information, valid after readHeader()
+    QString name() const { return m_name; }
+    // Zero when the writer did not record the count
+    qint64 featureCount() const { return m_featureCount; }
+    FeatureStore::GeometryType geometryType() const { return m_geometryType; }
+    QStringList columnNames() const;
+    bool hasIndex() const { return m_indexSize > 0; }
+    // Extent recorded in the header, empty if there is none
+    QVariantMap boundingBox() const;
+
+private:
+    struct Column {
+        QString name;
+        quint8 type;
+        int storeIndex;
+    };
+    
+    bool readFeature(qsizetype pos, FeatureStore& store, qsizetype& next);
+    
+    const char* m_data;
+    qsizetype m_size;
+    bool m_headerRead;
+    
+    QString m_name;
+    QString m_title;
+    QString m_description;
+    qint64 m_featureCount;
+    FeatureStore::GeometryType m_geometryType;
+    QVector<Column> m_columns;
+    PackedRTree::Node m_envelope;
+    quint16 m_indexNodeSize;
+    qsizetype m_indexOffset;
+    qsizetype m_indexSize;
+    qsizetype m_featuresOffset;
+    
+    bool m_filtered;
+    PackedRTree::Node m_filter;
+    
+    bool m_cancelled;
+    QString m_error;
+};
@@ -0,0 +1,341 @@
+#include "FlatGeobufWriter.h"
+#include "FeatureBounds.h"
+#include "FlatBuffers.h"
+#include "FlatGeobuf.h"
+#include <QIODevice>
+#include <QJsonDocument>
+#include <QtEndian>
+#include <algorithm>
+#include <numeric>
+
+namespace {
+
+// Zeros written at a time while reserving the index
+const qint64 ReserveChunk = 1024 * 1024;
+
+template<typename T>
+void appendLE(QByteArray& buffer, T value)
+{
+    char bytes[sizeof(T)];
+    qToLittleEndian(value, bytes);
+    buffer.append(bytes, sizeof(T));
+}
+
+// Geometry of one feature in FlatGeobuf terms: simple geometries keep their
+// coordinates in xy with the end of each line or ring in ends; MultiPolygons
+// and GeometryCollections are made of parts
+struct Geometry {
+    FeatureStore::GeometryType type = FeatureStore::NoGeometry;
+    QVector<double> xy;
+    QVector<quint32> ends;
+    QVector<Geometry> parts;
+};
+
+void appendPart(const FeatureStore& store, qsizetype part, Geometry& geometry)
+{
+    for (qsizetype ring = store.ringBegin(part); ring < store.ringEnd(part); ++ring) {
+        for (qsizetype coordinate = store.coordinateBegin(ring); coordinate < store.coordinateEnd(ring); ++coordinate) {
+            geometry.xy.append(store.x(coordinate));
+            geometry.xy.append(store.y(coordinate));
+        }
+        geometry.ends.append(quint32(geometry.xy.size() / 2));
+    }
+}
+
+Geometry featureGeometry(const FeatureStore& store, qsizetype feature)
+{
+    Geometry geometry;
+    geometry.type = store.geometryType(feature);
+    qsizetype first = store.partBegin(feature);
+    qsizetype last = store.partEnd(feature);
+    
+    switch (geometry.type) {
+    case FeatureStore::Point:
+    case FeatureStore::LineString:
+    case FeatureStore::Polygon:
+        if (first < last) {
+            appendPart(store, first, geometry);
+        }
+        if (geometry.type == FeatureStore::Point) {
+            geometry.xy.resize(qMin<qsizetype>(2, geometry.xy.size()));
+        }
+        break;
+    case FeatureStore::MultiPoint:
+    case FeatureStore::MultiLineString:
+        for (qsizetype part = first; part < last; ++part) {
+            appendPart(store, part, geometry);
+        }
+        break;
+    case FeatureStore::MultiPolygon:
+    case FeatureStore::GeometryCollection:
+        for (qsizetype part = first; part < last; ++part) {
+            Geometry member;
+            member.type = store.partType(part);
+            appendPart(store, part, member);
+            geometry.parts.append(member);
+        }
+        break;
+    case FeatureStore::NoGeometry:
+        break;
+    }
+    
+    // Ends are only meaningful, and only needed, for several lines or rings
+    bool multiLine = geometry.type == FeatureStore::MultiLineString || geometry.type == FeatureStore::Polygon;
+    if (!multiLine || geometry.ends.size() < 2) {
+        geometry.ends.clear();
+    }
+    for (Geometry& part : geometry.parts) {
+        if (part.type != FeatureStore::Polygon || part.ends.size() < 2) {
+            part.ends.clear();
+        }
+    }
+    return geometry;
+}
+
+// Writes geometry and points the offset at field to it
+void appendGeometry(QByteArray& buffer, qsizetype field, const Geometry& geometry)
+{
+    FlatBufferWriter table;
+    if (!geometry.ends.isEmpty()) {
+        table.addOffset(FlatGeobuf::GeometryEnds);
+    }
+    if (!geometry.xy.isEmpty()) {
+        table.addOffset(FlatGeobuf::GeometryXY);
+    }
+    if (!geometry.parts.isEmpty()) {
+        table.addOffset(FlatGeobuf::GeometryParts);
+    }
+    table.add<quint8>(FlatGeobuf::GeometryTypeField, geometry.type);
+    FlatBufferWriter::patch(buffer, field, table.finish(buffer));
+    
+    if (!geometry.ends.isEmpty()) {
+        FlatBufferWriter::patch(buffer, table.position(FlatGeobuf::GeometryEnds), FlatBufferWriter::appendScalars(buffer, geometry.ends));
+    }
+    if (!geometry.xy.isEmpty()) {
+        FlatBufferWriter::patch(buffer, table.position(FlatGeobuf::GeometryXY), FlatBufferWriter::appendScalars(buffer, geometry.xy));
+    }
+    if (!geometry.parts.isEmpty()) {
+        qsizetype parts = FlatBufferWriter::appendVector(buffer, nullptr, geometry.parts.size(), 4);
+        FlatBufferWriter::patch(buffer, table.position(FlatGeobuf::GeometryParts), parts);
+        for (qsizetype i = 0; i < geometry.parts.size(); ++i) {
+            appendGeometry(buffer, parts + 4 + i * 4, geometry.parts[i]);
+        }
+    }
+}
+
+FlatGeobuf::ColumnType columnType(PropertyColumn::Type type)
+{
+    switch (type) {
+    case PropertyColumn::Bool:
+        return FlatGeobuf::Bool;
+    case PropertyColumn::Int:
+        return FlatGeobuf::Long;
+    case PropertyColumn::Double:
+        return FlatGeobuf::Double;
+    case PropertyColumn::Null:
+    case PropertyColumn::String:
+    case PropertyColumn::Variant:
+        break;
+    }
+    return FlatGeobuf::String;
+}
+
+// Mixed-type values are written as text, nested maps and lists as JSON
+QByteArray textValue(const QVariant& value)
+{
+    if (value.typeId() == QMetaType::QVariantMap || value.typeId() == QMetaType::QVariantList) {
+        return QJsonDocument::fromVariant(value).toJson(QJsonDocument::Compact);
+    }
+    return value.toString().toUtf8();
+}
+
+} // namespace
+
+FlatGeobufWriter::FlatGeobufWriter(QIODevice* device)
+    : m_device(device)
+    , m_indexNodeSize(PackedRTree::DefaultNodeSize)
+{
+}
+
+bool FlatGeobufWriter::write(const FeatureStore& store)
+{
+    m_error.clear();
+    qsizetype count = store.featureCount();
+    bool indexed = m_indexNodeSize >= 2 && count > 0;
+    
+    PackedRTree::Node extent;
+    QVector<PackedRTree::Node> bounds = FeatureBounds::compute(store, extent);
+    
+    QVector<qsizetype> order(count);
+    std::iota(order.begin(), order.end(), 0);
+    if (indexed) {
+        QVector<quint32> hilbert(count);
+        for (qsizetype feature = 0; feature < count; ++feature) {
+            hilbert[feature] = PackedRTree::hilbertValue(bounds[feature], extent);
+        }
+        std::stable_sort(order.begin(), order.end(), [&hilbert](qsizetype a, qsizetype b) {
+            return hilbert[a] > hilbert[b];
+        });
+    }
+    
+    QByteArray header = encodeHeader(store, extent, indexed);
+    QByteArray prefix(FlatGeobuf::Magic, sizeof(FlatGeobuf::Magic));
+    appendLE(prefix, quint32(header.size()));
+    if (!writeBlock(prefix) || !writeBlock(header)) {
+        return false;
+    }
+    
+    // Reserved now, written once the feature offsets are known
+    qint64 indexPos = m_device->pos();
+    qint64 indexSize = indexed ? qint64(PackedRTree::indexSize(count, m_indexNodeSize)) : 0;
+    for (qint64 reserved = 0; reserved < indexSize; reserved += ReserveChunk) {
+        if (!writeBlock(QByteArray(qMin(ReserveChunk, indexSize - reserved), '\0'))) {
+            return false;
+        }
+    }
+    
+    qint64 featuresPos = m_device->pos();
+    QVector<PackedRTree::Node> leaves;
+    leaves.reserve(indexed ? count : 0);
+    for (qsizetype feature : order) {
+        if (indexed) {
+            PackedRTree::Node leaf = bounds[feature];
+            leaf.offset = quint64(m_device->pos() - featuresPos);
+            leaves.append(leaf);
+        }
+        QByteArray data = encodeFeature(store, feature);
+        QByteArray size;
+        appendLE(size, quint32(data.size()));
+        if (!writeBlock(size) || !writeBlock(data)) {
+            return false;
+        }
+    }
+    
+    if (indexed) {
+        qint64 end = m_device->pos();
+        if (!m_device->seek(indexPos) || !writeBlock(PackedRTree::build(leaves, m_indexNodeSize)) || !m_device->seek(end)) {
+            m_error = QString("Cannot write the spatial index: %1").arg(m_device->errorString());
+            return false;
+        }
+    }
+    return true;
+}
+
+bool FlatGeobufWriter::writeBlock(const QByteArray& data)
+{
+    if (m_device->write(data) != data.size()) {
+        m_error = m_device->errorString();
+        return false;
+    }
+    return true;
+}
+
+QByteArray FlatGeobufWriter::encodeHeader(const FeatureStore& store, const PackedRTree::Node& extent, bool indexed) const
+{
+    // A single geometry type is recorded in the header, otherwise every
+    // feature carries its own
+    FeatureStore::GeometryType geometryType = store.featureCount() > 0 ? store.geometryType(0) : FeatureStore::NoGeometry;
+    for (qsizetype feature = 1; feature < store.featureCount(); ++feature) {
+        if (store.geometryType(feature) != geometryType) {
+            geometryType = FeatureStore::NoGeometry;
+            break;
+        }
+    }
+    
+    QByteArray buffer(4, '\0');
+    const QVector<PropertyColumn>& columns = store.columns();
+    FlatBufferWriter header;
+    if (!m_name.isEmpty()) {
+        header.addOffset(FlatGeobuf::HeaderName);
+    }
+    if (!extent.isEmpty()) {
+        header.addOffset(FlatGeobuf::HeaderEnvelope);
+    }
+    header.add<quint8>(FlatGeobuf::HeaderGeometryType, geometryType);
+    if (!columns.isEmpty()) {
+        header.addOffset(FlatGeobuf::HeaderColumns);
+    }
+    header.add<quint64>(FlatGeobuf::HeaderFeaturesCount, store.featureCount());
+    header.add<quint16>(FlatGeobuf::HeaderIndexNodeSize, indexed ? m_indexNodeSize : 0);
+    header.addOffset(FlatGeobuf::HeaderCrs);
+    FlatBufferWriter::patch(buffer, 0, header.finish(buffer));
+    
+    if (!m_name.isEmpty()) {
+        FlatBufferWriter::patch(buffer, header.position(FlatGeobuf::HeaderName), FlatBufferWriter::appendString(buffer, m_name.toUtf8()));
+    }
+    if (!extent.isEmpty()) {
+        QVector<double> envelope{extent.minX, extent.minY, extent.maxX, extent.maxY};
+        FlatBufferWriter::patch(buffer, header.position(FlatGeobuf::HeaderEnvelope), FlatBufferWriter::appendScalars(buffer, envelope));
+    }
+    if (!columns.isEmpty()) {
+        qsizetype vector = FlatBufferWriter::appendVector(buffer, nullptr, columns.size(), 4);
+        FlatBufferWriter::patch(buffer, header.position(FlatGeobuf::HeaderColumns), vector);
+        for (qsizetype i = 0; i < columns.size(); ++i) {
+            FlatBufferWriter column;
+            column.addOffset(FlatGeobuf::ColumnName);
+            column.add<quint8>(FlatGeobuf::ColumnTypeField, columnType(columns[i].type()));
+            FlatBufferWriter::patch(buffer, vector + 4 + i * 4, column.finish(buffer));
+            FlatBufferWriter::patch(buffer, column.position(FlatGeobuf::ColumnName), FlatBufferWriter::appendString(buffer, columns[i].name().toUtf8()));
+        }
+    }
+    
+    // Coordinates are always WGS 84 longitude and latitude
+    FlatBufferWriter crs;
+    crs.addOffset(FlatGeobuf::CrsOrg);
+    crs.add<qint32>(FlatGeobuf::CrsCode, 4326);
+    FlatBufferWriter::patch(buffer, header.position(FlatGeobuf::HeaderCrs), crs.finish(buffer));
+    FlatBufferWriter::patch(buffer, crs.position(FlatGeobuf::CrsOrg), FlatBufferWriter::appendString(buffer, "EPSG"));
+    return buffer;
+}
+
+QByteArray FlatGeobufWriter::encodeFeature(const FeatureStore& store, qsizetype feature) const
+{
+    // Properties are a run of column index and value pairs; nulls are left out
+    QByteArray properties;
+    const QVector<PropertyColumn>& columns = store.columns();
+    for (qsizetype i = 0; i < columns.size(); ++i) {
+        const PropertyColumn& column = columns[i];
+        if (column.isNull(feature)) {
+            continue;
+        }
+        QVariant value = column.value(feature);
+        appendLE(properties, quint16(i));
+        switch (columnType(column.type())) {
+        case FlatGeobuf::Bool:
+            properties.append(char(value.toBool() ? 1 : 0));
+            break;
+        case FlatGeobuf::Long:
+            appendLE(properties, qint64(value.toLongLong()));
+            break;
+        case FlatGeobuf::Double:
+            appendLE(properties, value.toDouble());
+            break;
+        default: {
+            QByteArray text = textValue(value);
+            appendLE(properties, quint32(text.size()));
+            properties.append(text);
+            break;
+        }
+        }
+    }
+    
+    QByteArray buffer(4, '\0');
+    bool hasGeometry = store.geometryType(feature) != FeatureStore::NoGeometry;
+    FlatBufferWriter table;
+    if (hasGeometry) {
+        table.addOffset(FlatGeobuf::FeatureGeometry);
+    }
+    if (!properties.isEmpty()) {
+        table.addOffset(FlatGeobuf::FeatureProperties);
+    }
+    FlatBufferWriter::patch(buffer, 0, table.finish(buffer));
+    
+    if (hasGeometry) {
+        appendGeometry(buffer, table.position(FlatGeobuf::FeatureGeometry), featureGeometry(store, feature));
+    }
+    if (!properties.isEmpty()) {
+        qsizetype vector = FlatBufferWriter::appendVector(buffer, properties.constData(), properties.size(), 1);
+        FlatBufferWriter::patch(buffer, table.position(FlatGeobuf::FeatureProperties), vector);
+    }
+    return buffer;
+}
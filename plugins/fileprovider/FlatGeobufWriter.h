@@ -0,0 +1,36 @@
+#pragma once
+
+#include "FeatureStore.h"
+#include "PackedRTree.h"
+#include <QString>
+
+class QIODevice;
+
+// Writes a FeatureStore as a FlatGeobuf file. Unless the index is disabled
+// the features are written in Hilbert order of their bounds, followed by a
+// packed R-tree over them so readers can fetch a viewport without scanning
+// the file. The index precedes the features, so its space is reserved and
+// filled in once every feature offset is known; the device must be
+// seekable. Feature ids are not part of the format and are dropped.
+class FlatGeobufWriter
+{
+public:
+    explicit FlatGeobufWriter(QIODevice* device);
+    
+    void setName(const QString& name) { m_name = name; }
+    // Children per index node; 0 writes no index
+    void setIndexNodeSize(quint16 nodeSize) { m_indexNodeSize = nodeSize; }
+    
+    bool write(const FeatureStore& store);
+    QString errorString() const { return m_error; }
+
+private:
+    QByteArray encodeHeader(const FeatureStore& store, const PackedRTree::Node& extent, bool indexed) const;
+    QByteArray encodeFeature(const FeatureStore& store, qsizetype feature) const;
+    bool writeBlock(const QByteArray& data);
+    
+    QIODevice* m_device;
+    QString m_name;
+    quint16 m_indexNodeSize;
+    QString m_error;
+};
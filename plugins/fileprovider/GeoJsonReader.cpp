@@ -0,0 +1,408 @@
+#include "GeoJsonReader.h"
+
+namespace {
+
+const qint64 ProgressInterval = 1024;
+const int MaxCoordinateDepth = 8;
+
+enum Member {
+    OtherMember,
+    TypeMember,
+    FeaturesMember,
+    GeometryMember,
+    PropertiesMember,
+    IdMember,
+    CoordinatesMember,
+    GeometriesMember
+};
+
+// Classifies a member name before the reader advances past it
+Member classify(QByteArrayView name)
+{
+    if (name == "type") {
+        return TypeMember;
+    } else if (name == "features") {
+        return FeaturesMember;
+    } else if (name == "geometry") {
+        return GeometryMember;
+    } else if (name == "properties") {
+        return PropertiesMember;
+    } else if (name == "id") {
+        return IdMember;
+    } else if (name == "coordinates") {
+        return CoordinatesMember;
+    } else if (name == "geometries") {
+        return GeometriesMember;
+    }
+    return OtherMember;
+}
+
+} // namespace
+
+GeoJsonReader::GeoJsonReader(QIODevice* device)
+    : m_json(device)
+    , m_cancelled(false)
+{
+}
+
+GeoJsonReader::GeoJsonReader(const char* data, qsizetype size)
+    : m_json(data, size)
+    , m_cancelled(false)
+{
+}
+
+QString GeoJsonReader::errorString() const
+{
+    return m_error.isEmpty() ? m_json.errorString() : m_error;
+}
+
+bool GeoJsonReader::read(FeatureStore& store, const IngestProgress& progress)
+{
+    m_cancelled = false;
+    m_error.clear();
+    
+    if (m_json.next() != JsonReader::BeginObject) {
+        if (!m_json.hasError()) {
+            m_error = "GeoJSON document must be an object";
+        }
+        return false;
+    }
+    
+    QString rootType;
+    QString geometryType;
+    FeatureStore::GeometryType featureGeometry = FeatureStore::NoGeometry;
+    bool featureStarted = false;
+    bool hasCoordinates = false;
+    QVariantMap metadata;
+    qint64 featureCount = 0;
+    
+    while (m_json.next() == JsonReader::Name) {
+        Member member = classify(m_json.utf8());
+        
+        if (member == TypeMember) {
+            if (m_json.next() == JsonReader::String) {
+                rootType = m_json.string();
+            } else if (!m_json.skipValue()) {
+                return false;
+            }
+        } else if (member == FeaturesMember) {
+            if (m_json.next() != JsonReader::BeginArray) {
+                if (!m_json.skipValue()) {
+                    return false;
+                }
+                continue;
+            }
+            for (JsonReader::Token token = m_json.next(); token != JsonReader::EndArray; token = m_json.next()) {
+                if (token != JsonReader::BeginObject) {
+                    if (!m_json.skipValue()) {
+                        return false;
+                    }
+                    continue;
+                }
+                if (!readFeature(store)) {
+                    return false;
+                }
+                if (progress && ++featureCount % ProgressInterval == 0
+                    && !progress(m_json.position(), featureCount)) {
+                    m_cancelled = true;
+                    return false;
+                }
+            }
+        } else if (member == GeometryMember || member == PropertiesMember || member == IdMember) {
+            // The root object is a single Feature
+            if (!featureStarted) {
+                store.beginFeature();
+                featureStarted = true;
+            }
+            if (!readFeatureMember(store, m_json.utf8(), featureGeometry)) {
+                return false;
+            }
+        } else if (member == CoordinatesMember || member == GeometriesMember) {
+            // The root object is a bare geometry
+            if (!featureStarted) {
+                store.beginFeature();
+                featureStarted = true;
+                m_geometry.clear();
+            }
+            if (!readGeometryMember(store, m_json.utf8(), geometryType, hasCoordinates)) {
+                return false;
+            }
+        } else {
+            QString key = memberName();
+            m_json.next();
+            metadata.insert(key, m_json.readValue());
+        }
+    }
+    
+    if (m_json.hasError() || m_json.next() == JsonReader::Invalid) {
+        return false;
+    }
+    
+    if (rootType == "FeatureCollection") {
+        store.setMetadata(metadata);
+    } else if (rootType == "Feature") {
+        if (!featureStarted) {
+            store.beginFeature();
+        }
+        store.setGeometryType(featureGeometry);
+        store.endFeature();
+        ++featureCount;
+    } else if (FeatureStore::geometryTypeFromName(rootType) != FeatureStore::NoGeometry) {
+        featureGeometry = FeatureStore::geometryTypeFromName(rootType);
+        if (!featureStarted) {
+            store.beginFeature();
+        }
+        if (hasCoordinates) {
+            m_geometry.write(store, featureGeometry);
+        }
+        store.setGeometryType(featureGeometry);
+        store.endFeature();
+        ++featureCount;
+    } else {
+        m_error = QString("Unsupported GeoJSON type: %1").arg(rootType);
+        return false;
+    }
+    
+    if (progress) {
+        progress(m_json.position(), featureCount);
+    }
+    return true;
+}
+
+bool GeoJsonReader::readFeatureSequence(FeatureStore& store, const IngestProgress& progress)
+{
+    m_cancelled = false;
+    m_error.clear();
+    m_json.setValueSequence(true);
+    
+    qint64 featureCount = 0;
+    for (JsonReader::Token token = m_json.next(); token != JsonReader::EndOfDocument; token = m_json.next()) {
+        if (token != JsonReader::BeginObject) {
+            if (!m_json.skipValue()) {
+                return false;
+            }
+            continue;
+        }
+        if (!readFeature(store)) {
+            return false;
+        }
+        if (progress && ++featureCount % ProgressInterval == 0
+            && !progress(m_json.position(), featureCount)) {
+            m_cancelled = true;
+            return false;
+        }
+    }
+    
+    if (progress) {
+        progress(m_json.position(), featureCount);
+    }
+    return true;
+}
+
+bool GeoJsonReader::readFeature(FeatureStore& store)
+{
+    store.beginFeature();
+    FeatureStore::GeometryType type = FeatureStore::NoGeometry;
+    
+    while (m_json.next() == JsonReader::Name) {
+        if (!readFeatureMember(store, m_json.utf8(), type)) {
+            return false;
+        }
+    }
+    if (m_json.hasError()) {
+        return false;
+    }
+    
+    store.setGeometryType(type);
+    store.endFeature();
+    return true;
+}
+
+bool GeoJsonReader::readFeatureMember(FeatureStore& store, QByteArrayView name, FeatureStore::GeometryType& type)
+{
+    Member member = classify(name);
+    JsonReader::Token token = m_json.next();
+    
+    if (member == GeometryMember && token == JsonReader::BeginObject) {
+        return readGeometry(store, type);
+    }
+    if (member == PropertiesMember && token == JsonReader::BeginObject) {
+        return readProperties(store);
+    }
+    if (member == IdMember && token == JsonReader::String) {
+        store.setFeatureId(m_json.string());
+        return true;
+    }
+    if (member == IdMember && token == JsonReader::Number) {
+        store.setFeatureId(m_json.isInteger() ? QVariant(qlonglong(m_json.integer())) : QVariant(m_json.number()));
+        return true;
+    }
+    return m_json.skipValue();
+}
+
+bool GeoJsonReader::readGeometry(FeatureStore& store, FeatureStore::GeometryType& type)
+{
+    QString typeName;
+    bool hasCoordinates = false;
+    m_geometry.clear();
+    
+    while (m_json.next() == JsonReader::Name) {
+        if (!readGeometryMember(store, m_json.utf8(), typeName, hasCoordinates)) {
+            return false;
+        }
+    }
+    if (m_json.hasError()) {
+        return false;
+    }
+    
+    type = FeatureStore::geometryTypeFromName(typeName);
+    if (hasCoordinates) {
+        m_geometry.write(store, type);
+    }
+    return true;
+}
+
+bool GeoJsonReader::readGeometryMember(FeatureStore& store, QByteArrayView name, QString& type, bool& hasCoordinates)
+{
+    Member member = classify(name);
+    JsonReader::Token token = m_json.next();
+    
+    if (member == TypeMember && token == JsonReader::String) {
+        type = m_json.string();
+        return true;
+    }
+    if (member == CoordinatesMember && token == JsonReader::BeginArray) {
+        hasCoordinates = true;
+        return readCoordinates();
+    }
+    if (member == GeometriesMember && token == JsonReader::BeginArray) {
+        // Members of a GeometryCollection become parts of the current feature;
+        // Multi* and collection members add their simple parts
+        for (token = m_json.next(); token != JsonReader::EndArray; token = m_json.next()) {
+            if (token == JsonReader::BeginObject) {
+                FeatureStore::GeometryType memberType;
+                if (!readGeometry(store, memberType)) {
+                    return false;
+                }
+            } else if (!m_json.skipValue()) {
+                return false;
+            }
+        }
+        return true;
+    }
+    return m_json.skipValue();
+}
+
+// Reads a coordinates array of any depth into the geometry buffer. An array
+// of numbers is a position (height 1), an array of positions a line
+// (height 2), an array of lines a polygon (height 3).
+bool GeoJsonReader::readCoordinates()
+{
+    struct Frame {
+        qsizetype coordinateStart;
+        qsizetype lineStart;
+        int height;
+        int numbers;
+        double xy[2];
+    };
+    
+    Frame frames[MaxCoordinateDepth];
+    int depth = 0;
+    frames[0] = Frame{m_geometry.coordinateCount(), m_geometry.lineCount(), 0, 0, {0.0, 0.0}};
+    
+    while (true) {
+        switch (m_json.next()) {
+        case JsonReader::Number: {
+            Frame& frame = frames[depth];
+            if (frame.numbers < 2) {
+                frame.xy[frame.numbers] = m_json.number();
+            }
+            ++frame.numbers;
+            frame.height = qMax(frame.height, 1);
+            break;
+        }
+        case JsonReader::BeginArray:
+            if (++depth >= MaxCoordinateDepth) {
+                m_error = "Coordinates are nested too deeply";
+                return false;
+            }
+            frames[depth] = Frame{m_geometry.coordinateCount(), m_geometry.lineCount(), 0, 0, {0.0, 0.0}};
+            break;
+        case JsonReader::EndArray: {
+            const Frame& frame = frames[depth];
+            if (frame.height == 1 && frame.numbers >= 2) {
+                m_geometry.addCoordinate(frame.xy[0], frame.xy[1]);
+            } else if (frame.height == 2) {
+                m_geometry.addLine(frame.coordinateStart);
+            } else if (frame.height == 3) {
+                m_geometry.addPolygon(frame.lineStart);
+            }
+            if (depth == 0) {
+                return true;
+            }
+            --depth;
+            frames[depth].height = qMax(frames[depth].height, frame.height + 1);
+            break;
+        }
+        case JsonReader::Invalid:
+            return false;
+        default:
+            if (!m_json.skipValue()) {
+                return false;
+            }
+            break;
+        }
+    }
+}
+
+bool GeoJsonReader::readProperties(FeatureStore& store)
+{
+    while (m_json.next() == JsonReader::Name) {
+        PropertyColumn& column = store.column(memberName());
+        JsonReader::Token token = m_json.next();
+        
+        // Duplicate keys keep their first value
+        if (column.size() >= store.featureCount()) {
+            if (!m_json.skipValue()) {
+                return false;
+            }
+            continue;
+        }
+        
+        switch (token) {
+        case JsonReader::String:
+            column.appendString(m_strings.intern(m_json.utf8()));
+            break;
+        case JsonReader::Number:
+            if (m_json.isInteger()) {
+                column.appendInt(m_json.integer());
+            } else {
+                column.appendDouble(m_json.number());
+            }
+            break;
+        case JsonReader::True:
+            column.appendBool(true);
+            break;
+        case JsonReader::False:
+            column.appendBool(false);
+            break;
+        case JsonReader::Null:
+            column.appendNull();
+            break;
+        case JsonReader::BeginObject:
+        case JsonReader::BeginArray:
+            column.append(m_json.readValue());
+            break;
+        default:
+            return false;
+        }
+    }
+    return !m_json.hasError();
+}
+
+// Member names repeat for every feature and short values often do, so both
+// are decoded once per distinct string
+QString GeoJsonReader::memberName()
+{
+    return m_strings.intern(m_json.utf8());
+}
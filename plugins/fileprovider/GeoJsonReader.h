@@ -0,0 +1,44 @@
+#pragma once
+
+#include "FeatureStore.h"
+#include "GeometryBuffer.h"
+#include "JsonReader.h"
+#include "StringPool.h"
+
+// Streaming GeoJSON reader. Features are appended to a FeatureStore one at a
+// time as they are tokenized, so the document itself is never held in
+// memory. Accepts a FeatureCollection, a single Feature or a bare geometry.
+// Multi* and collection members of a GeometryCollection are flattened into
+// its simple parts.
+class GeoJsonReader
+{
+public:
+    explicit GeoJsonReader(QIODevice* device);
+    GeoJsonReader(const char* data, qsizetype size);
+    
+    bool read(FeatureStore& store, const IngestProgress& progress = IngestProgress());
+    
+    // Reads a comma or whitespace separated run of Feature objects, such as
+    // a slice of a "features" array
+    bool readFeatureSequence(FeatureStore& store, const IngestProgress& progress = IngestProgress());
+    
+    bool wasCancelled() const { return m_cancelled; }
+    QString errorString() const;
+
+private:
+    bool readFeature(FeatureStore& store);
+    bool readFeatureMember(FeatureStore& store, QByteArrayView name, FeatureStore::GeometryType& type);
+    bool readGeometry(FeatureStore& store, FeatureStore::GeometryType& type);
+    bool readGeometryMember(FeatureStore& store, QByteArrayView name, QString& type, bool& hasCoordinates);
+    bool readCoordinates();
+    bool readProperties(FeatureStore& store);
+    QString memberName();
+    
+    JsonReader m_json;
+    
+    GeometryBuffer m_geometry;
+    
+    StringPool m_strings;
+    bool m_cancelled;
+    QString m_error;
+};
@@ -0,0 +1,147 @@
+#include "GeoJsonScanner.h"
+#include "JsonReader.h"
+#include <charconv>
+#include <limits>
+
+GeoJsonScanner::GeoJsonScanner(const char* data, qsizetype size)
+    : m_data(data)
+    , m_size(size)
+    , m_featureCount(0)
+    , m_minX(std::numeric_limits<double>::max())
+    , m_minY(std::numeric_limits<double>::max())
+    , m_maxX(std::numeric_limits<double>::lowest())
+    , m_maxY(std::numeric_limits<double>::lowest())
+{
+}
+
+QVariantMap GeoJsonScanner::boundingBox() const
+{
+    QVariantMap box;
+    if (m_minX <= m_maxX) {
+        box["minLat"] = m_minY;
+        box["maxLat"] = m_maxY;
+        box["minLon"] = m_minX;
+        box["maxLon"] = m_maxX;
+    }
+    return box;
+}
+
+bool GeoJsonScanner::scan()
+{
+    m_error.clear();
+    m_featureCount = 0;
+    
+    int depth = 0;
+    // Depth inside the root "features" array, 0 when not in it
+    int featuresDepth = 0;
+    bool hasFeatures = false;
+    
+    for (qsizetype i = 0; i < m_size; ++i) {
+        switch (m_data[i]) {
+        case '"': {
+            qsizetype end = JsonReader::stringEnd(m_data, m_size, i);
+            if (end < 0) {
+                m_error = "Unterminated string";
+                return false;
+            }
+            QByteArrayView name(m_data + i + 1, end - i - 1);
+            qsizetype next = skipSpace(end + 1);
+            if (next >= m_size || m_data[next] != ':') {
+                // A string value
+                i = end;
+                break;
+            }
+            
+            qsizetype value = skipSpace(next + 1);
+            if (value < m_size && m_data[value] == '[') {
+                if (name == "coordinates") {
+                    i = scanCoordinates(value);
+                    if (i < 0) {
+                        m_error = "Malformed coordinates";
+                        return false;
+                    }
+                    break;
+                }
+                if (name == "features" && depth == 1) {
+                    featuresDepth = depth + 1;
+                    hasFeatures = true;
+                }
+            }
+            i = value - 1;
+            break;
+        }
+        case '{':
+            if (featuresDepth > 0 && depth == featuresDepth) {
+                ++m_featureCount;
+            }
+            ++depth;
+            break;
+        case '[':
+            ++depth;
+            break;
+        case '}':
+        case ']':
+            if (depth == featuresDepth) {
+                featuresDepth = 0;
+            }
+            --depth;
+            break;
+        default:
+            break;
+        }
+    }
+    
+    // A bare Feature or geometry describes a single feature
+    if (!hasFeatures) {
+        m_featureCount = 1;
+    }
+    return true;
+}
+
+// Scans the coordinates array opening at pos and returns the offset of its
+// closing bracket. Positions are the innermost arrays; their first two
+// numbers are x and y.
+qsizetype GeoJsonScanner::scanCoordinates(qsizetype pos)
+{
+    int depth = 0;
+    int index = 0;
+    double x = 0.0;
+    
+    for (; pos < m_size; ++pos) {
+        char c = m_data[pos];
+        if (c == '[') {
+            ++depth;
+            index = 0;
+        } else if (c == ']') {
+            if (--depth == 0) {
+                return pos;
+            }
+        } else if (c == ',') {
+            ++index;
+        } else if (c == '-' || (c >= '0' && c <= '9')) {
+            double value = 0.0;
+            auto result = std::from_chars(m_data + pos, m_data + m_size, value);
+            if (result.ec != std::errc()) {
+                return -1;
+            }
+            pos = result.ptr - m_data - 1;
+            if (index == 0) {
+                x = value;
+            } else if (index == 1) {
+                m_minX = qMin(m_minX, x);
+                m_maxX = qMax(m_maxX, x);
+                m_minY = qMin(m_minY, value);
+                m_maxY = qMax(m_maxY, value);
+            }
+        }
+    }
+    return -1;
+}
+
+qsizetype GeoJsonScanner::skipSpace(qsizetype pos) const
+{
+    while (pos < m_size && (m_data[pos] == ' ' || m_data[pos] == '\n' || m_data[pos] == '\r' || m_data[pos] == '\t')) {
+        ++pos;
+    }
+    return pos;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <QString>
+#include <QVariantMap>
+
+// Single structural pass over an in-memory GeoJSON document that counts the
+// features and computes the extent of every coordinate without tokenizing
+// property values or building any geometry. Used to describe a layer before
+// it is fully loaded; it trusts the input to be well formed.
+class GeoJsonScanner
+{
+public:
+    GeoJsonScanner(const char* data, qsizetype size);
+    
+    bool scan();
+    
+    qint64 featureCount() const { return m_featureCount; }
+    // Extent of the coordinates seen, empty if there were none
+    QVariantMap boundingBox() const;
+    
+    QString errorString() const { return m_error; }
+
+private:
+    qsizetype scanCoordinates(qsizetype pos);
+    qsizetype skipSpace(qsizetype pos) const;
+    
+    const char* m_data;
+    qsizetype m_size;
+    qint64 m_featureCount;
+    double m_minX;
+    double m_minY;
+    double m_maxX;
+    double m_maxY;
+    QString m_error;
+};
@@ -0,0 +1,174 @@
+#include "GeoJsonSeqReader.h"
+#include "GeoJsonReader.h"
+#include <QFuture>
+#include <QThread>
+#include <QThreadPool>
+#include <QtConcurrentRun>
+#include <atomic>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+const qsizetype MinChunkSize = 1 << 20;
+const qsizetype ChunksPerThread = 4;
+const char RecordSeparator = '\x1E';
+
+struct ChunkResult {
+    FeatureStore store;
+    bool ok = false;
+    QString error;
+    std::atomic<bool> done{false};
+};
+
+bool isSpace(char c)
+{
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t' || c == RecordSeparator;
+}
+
+// Offset of the next separator at or after pos, or size
+qsizetype findSeparator(const char* data, qsizetype size, qsizetype pos, char separator)
+{
+    const char* found = static_cast<const char*>(std::memchr(data + pos, separator, size - pos));
+    return found ? found - data : size;
+}
+
+} // namespace
+
+GeoJsonSeqReader::GeoJsonSeqReader(const char* data, qsizetype size)
+    : m_data(data)
+    , m_size(size)
+    , m_threads(0)
+    , m_cancelled(false)
+{
+}
+
+int GeoJsonSeqReader::threadCount() const
+{
+    return m_threads > 0 ? m_threads : QThread::idealThreadCount();
+}
+
+char GeoJsonSeqReader::separator(const char* data, qsizetype size)
+{
+    qsizetype pos = size >= 3 && std::memcmp(data, "\xEF\xBB\xBF", 3) == 0 ? 3 : 0;
+    while (pos < size && data[pos] != RecordSeparator && isSpace(data[pos])) {
+        ++pos;
+    }
+    return pos < size && data[pos] == RecordSeparator ? RecordSeparator : '\n';
+}
+
+qint64 GeoJsonSeqReader::countFeatures(const char* data, qsizetype size)
+{
+    char split = separator(data, size);
+    qint64 count = 0;
+    qsizetype begin = 0;
+    while (begin < size) {
+        qsizetype end = findSeparator(data, size, begin, split);
+        for (qsizetype i = begin; i < end; ++i) {
+            if (!isSpace(data[i])) {
+                ++count;
+                break;
+            }
+        }
+        begin = end + 1;
+    }
+    return count;
+}
+
+bool GeoJsonSeqReader::read(FeatureStore& store, const IngestProgress& progress, QThreadPool* pool)
+{
+    m_cancelled = false;
+    m_error.clear();
+    
+    int threads = threadCount();
+    if (threads <= 1 || m_size < 2 * MinChunkSize) {
+        return readSequential(store, progress);
+    }
+    
+    // Texts never contain their separator: newline-delimited texts are
+    // single lines and JSON strings cannot hold a raw RS
+    char split = separator(m_data, m_size);
+    qsizetype chunkSize = qMax(MinChunkSize, m_size / (threads * ChunksPerThread));
+    QVector<qsizetype> bounds{0};
+    while (bounds.last() + chunkSize < m_size) {
+        qsizetype end = findSeparator(m_data, m_size, bounds.last() + chunkSize, split);
+        if (end >= m_size) {
+            break;
+        }
+        bounds.append(end);
+    }
+    bounds.append(m_size);
+    
+    qsizetype chunkCount = bounds.size() - 1;
+    std::vector<ChunkResult> results(chunkCount);
+    std::atomic<qsizetype> nextChunk(0);
+    std::atomic<bool> stop(false);
+    auto parseChunk = [this, &bounds, &results, &stop](qsizetype chunk) {
+        ChunkResult& result = results[chunk];
+        GeoJsonReader reader(m_data + bounds[chunk], bounds[chunk + 1] - bounds[chunk]);
+        result.ok = reader.readFeatureSequence(result.store, [&stop](qint64, qint64) {
+            return !stop.load(std::memory_order_relaxed);
+        });
+        if (!result.ok) {
+            result.error = reader.errorString();
+        }
+        result.done.store(true, std::memory_order_release);
+    };
+    auto parseChunks = [&parseChunk, &nextChunk, &stop, chunkCount]() {
+        for (qsizetype chunk = nextChunk++; chunk < chunkCount && !stop.load(std::memory_order_relaxed); chunk = nextChunk++) {
+            parseChunk(chunk);
+        }
+    };
+    
+    // Merge in file order while later slices are still being parsed
+    bool ok = true;
+    qsizetype merged = 0;
+    auto mergeParsed = [&]() {
+        for (; ok && merged < chunkCount && results[merged].done.load(std::memory_order_acquire); ++merged) {
+            ChunkResult& result = results[merged];
+            if (!result.ok) {
+                m_error = QString("%1 (in features starting at offset %2)").arg(result.error).arg(bounds[merged]);
+                stop = true;
+                ok = false;
+                break;
+            }
+            
+            store.append(result.store);
+            result.store.clear();
+            if (progress && !progress(bounds[merged + 1], store.featureCount())) {
+                m_cancelled = true;
+                stop = true;
+                ok = false;
+            }
+        }
+    };
+    
+    // The calling thread and threads - 1 pool tasks take slices in turn
+    // until none are left, so a busy pool only slows the read down. The
+    // calling thread merges what has been parsed after each of its slices.
+    if (!pool) {
+        pool = QThreadPool::globalInstance();
+    }
+    QVector<QFuture<void>> futures;
+    for (qsizetype worker = 1; worker < qMin<qsizetype>(threads, chunkCount); ++worker) {
+        futures.append(QtConcurrent::run(pool, parseChunks));
+    }
+    for (qsizetype chunk = nextChunk++; chunk < chunkCount && !stop.load(std::memory_order_relaxed); chunk = nextChunk++) {
+        parseChunk(chunk);
+        mergeParsed();
+    }
+    for (QFuture<void>& future : futures) {
+        future.waitForFinished();
+    }
+    mergeParsed();
+    return ok;
+}
+
+bool GeoJsonSeqReader::readSequential(FeatureStore& store, const IngestProgress& progress)
+{
+    GeoJsonReader reader(m_data, m_size);
+    bool ok = reader.readFeatureSequence(store, progress);
+    m_cancelled = reader.wasCancelled();
+    m_error = ok ? QString() : reader.errorString();
+    return ok;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "FeatureStore.h"
+#include <QString>
+
+class QThreadPool;
+
+// Reads newline-delimited GeoJSON (.geojsonl, .ndjson) and GeoJSON text
+// sequences (RFC 8142, .geojsons), which also start every text with an RS
+// character, from memory. Each text is one Feature; blank lines are
+// skipped. Texts stand on their own, so the input is split at line breaks,
+// or at RS characters when it uses them, and the slices are parsed on
+// several threads and merged back in file order.
+class GeoJsonSeqReader
+{
+public:
+    GeoJsonSeqReader(const char* data, qsizetype size);
+    
+    // 0 picks QThread::idealThreadCount()
+    void setThreadCount(int threads) { m_threads = threads; }
+    int threadCount() const;
+    
+    // Slices are parsed on the calling thread and on pool (the global pool
+    // unless given)
+    bool read(FeatureStore& store, const IngestProgress& progress = IngestProgress(), QThreadPool* pool = nullptr);
+    
+    bool wasCancelled() const { return m_cancelled; }
+    QString errorString() const { return m_error; }
+    
+    // Texts in the input, counted from its separators without parsing
+    static qint64 countFeatures(const char* data, qsizetype size);
+    // Separator the texts of the input are split at, RS or a line break
+    static char separator(const char* data, qsizetype size);
+
+private:
+    bool readSequential(FeatureStore& store, const IngestProgress& progress);
+    
+    const char* m_data;
+    qsizetype m_size;
+    int m_threads;
+    bool m_cancelled;
+    QString m_error;
+};
@@ -0,0 +1,510 @@
+#include "GeoJsonWriter.h"
+#include <QIODevice>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonValue>
+#include <charconv>
+#include <cmath>
+#include <limits>
+
+namespace {
+
+const qsizetype BufferSize = 1 << 20;
+
+void appendEscaped(QByteArray& out, const QByteArray& utf8)
+{
+    static const char hex[] = "0123456789abcdef";
+    out.append('"');
+    const char* text = utf8.constData();
+    qsizetype size = utf8.size();
+    qsizetype start = 0;
+    for (qsizetype i = 0; i < size; ++i) {
+        unsigned char c = static_cast<unsigned char>(text[i]);
+        if (c >= 0x20 && c != '"' && c != '\\') {
+            continue;
+        }
+        out.append(text + start, i - start);
+        start = i + 1;
+        switch (c) {
+        case '"':
+            out.append("\\\"", 2);
+            break;
+        case '\\':
+            out.append("\\\\", 2);
+            break;
+        case '\n':
+            out.append("\\n", 2);
+            break;
+        case '\r':
+            out.append("\\r", 2);
+            break;
+        case '\t':
+            out.append("\\t", 2);
+            break;
+        case '\b':
+            out.append("\\b", 2);
+            break;
+        case '\f':
+            out.append("\\f", 2);
+            break;
+        default: {
+            char escape[6] = { '\\', 'u', '0', '0', hex[c >> 4], hex[c & 15] };
+            out.append(escape, 6);
+            break;
+        }
+        }
+    }
+    out.append(text + start, size - start);
+    out.append('"');
+}
+
+QByteArray quoted(const QString& text)
+{
+    QByteArray key;
+    appendEscaped(key, text.toUtf8());
+    return key;
+}
+
+} // namespace
+
+GeoJsonWriter::GeoJsonWriter(QIODevice* device)
+    : m_device(device)
+    , m_precision(-1)
+    , m_indented(true)
+    , m_sequence(false)
+    , m_recordSeparators(false)
+    , m_featureCount(0)
+{
+}
+
+bool GeoJsonWriter::write(const FeatureStore& store)
+{
+    return begin(store.metadata()) && writeFeatures(store) && finish();
+}
+
+bool GeoJsonWriter::begin(const QVariantMap& metadata)
+{
+    m_error.clear();
+    m_buffer.clear();
+    m_buffer.reserve(BufferSize + BufferSize / 4);
+    m_featureCount = 0;
+    if (m_sequence) {
+        return true;
+    }
+    
+    m_buffer.append('{');
+    writeKey("\"type\"", 1, true);
+    m_buffer.append("\"FeatureCollection\"");
+    for (auto it = metadata.constBegin(); it != metadata.constEnd(); ++it) {
+        if (it.key() == "type" || it.key() == "features") {
+            continue;
+        }
+        writeKey(quoted(it.key()), 1, false);
+        writeVariant(it.value());
+    }
+    writeKey("\"features\"", 1, false);
+    m_buffer.append('[');
+    return flushIfFull();
+}
+
+bool GeoJsonWriter::writeFeatures(const FeatureStore& store)
+{
+    m_keys.clear();
+    for (const PropertyColumn& column : store.columns()) {
+        m_keys.append(quoted(column.name()));
+    }
+    if (m_sequence) {
+        return writeSequence(store);
+    }
+    
+    for (qsizetype feature = 0; feature < store.featureCount(); ++feature) {
+        if (m_featureCount++ > 0) {
+            m_buffer.append(',');
+        }
+        writeNewline(2);
+        writeFeature(store, feature);
+        if (!flushIfFull()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool GeoJsonWriter::finish()
+{
+    if (!m_sequence) {
+        if (m_featureCount > 0) {
+            writeNewline(1);
+        }
+        m_buffer.append(']');
+        writeNewline(0);
+        m_buffer.append('}');
+        if (m_indented) {
+            m_buffer.append('\n');
+        }
+    }
+    return flush();
+}
+
+bool GeoJsonWriter::writeSequence(const FeatureStore& store)
+{
+    // Every feature has to stay on its line
+    bool indented = m_indented;
+    m_indented = false;
+    bool ok = true;
+    for (qsizetype feature = 0; ok && feature < store.featureCount(); ++feature) {
+        if (m_recordSeparators) {
+            m_buffer.append('\x1E');
+        }
+        writeFeature(store, feature);
+        m_buffer.append('\n');
+        ok = flushIfFull();
+    }
+    m_indented = indented;
+    return ok;
+}
+
+void GeoJsonWriter::writeFeature(const FeatureStore& store, qsizetype feature)
+{
+    m_buffer.append('{');
+    writeKey("\"type\"", 3, true);
+    m_buffer.append("\"Feature\"");
+    const PropertyColumn& ids = store.featureIds();
+    if (feature < ids.size() && !ids.isNull(feature)) {
+        writeKey("\"id\"", 3, false);
+        writeValue(ids, feature);
+    }
+    writeKey("\"geometry\"", 3, false);
+    writeGeometry(store, feature);
+    
+    writeKey("\"properties\"", 3, false);
+    m_buffer.append('{');
+    const QVector<PropertyColumn>& columns = store.columns();
+    bool first = true;
+    for (qsizetype i = 0; i < columns.size(); ++i) {
+        if (columns[i].isNull(feature)) {
+            continue;
+        }
+        writeKey(m_keys[i], 4, first);
+        writeValue(columns[i], feature);
+        first = false;
+    }
+    if (!first) {
+        writeNewline(3);
+    }
+    m_buffer.append('}');
+    writeNewline(2);
+    m_buffer.append('}');
+}
+
+void GeoJsonWriter::writeGeometry(const FeatureStore& store, qsizetype feature)
+{
+    FeatureStore::GeometryType type = store.geometryType(feature);
+    if (type == FeatureStore::NoGeometry) {
+        m_buffer.append("null");
+        return;
+    }
+    
+    qsizetype firstPart = store.partBegin(feature);
+    qsizetype lastPart = store.partEnd(feature);
+    const char* separator = m_indented ? ", " : ",";
+    
+    switch (type) {
+    case FeatureStore::Point:
+    case FeatureStore::LineString:
+    case FeatureStore::Polygon:
+        if (firstPart < lastPart) {
+            writePart(store, firstPart);
+            return;
+        }
+        break;
+    default:
+        break;
+    }
+    
+    writeGeometryStart(type);
+    if (type == FeatureStore::GeometryCollection) {
+        writeMember("\"geometries\"");
+        m_buffer.append('[');
+        for (qsizetype part = firstPart; part < lastPart; ++part) {
+            if (part > firstPart) {
+                m_buffer.append(separator);
+            }
+            writePart(store, part);
+        }
+        m_buffer.append("]}");
+        return;
+    }
+    
+    writeMember("\"coordinates\"");
+    m_buffer.append('[');
+    if (type == FeatureStore::MultiPoint || type == FeatureStore::MultiLineString || type == FeatureStore::MultiPolygon) {
+        for (qsizetype part = firstPart; part < lastPart; ++part) {
+            if (part > firstPart) {
+                m_buffer.append(separator);
+            }
+            writePartCoordinates(store, part);
+        }
+    }
+    m_buffer.append("]}");
+}
+
+void GeoJsonWriter::writePart(const FeatureStore& store, qsizetype part)
+{
+    writeGeometryStart(store.partType(part));
+    writeMember("\"coordinates\"");
+    writePartCoordinates(store, part);
+    m_buffer.append('}');
+}
+
+void GeoJsonWriter::writeGeometryStart(FeatureStore::GeometryType type)
+{
+    m_buffer.append('{');
+    writeMember("\"type\"");
+    m_buffer.append('"').append(FeatureStore::geometryTypeName(type).toLatin1()).append('"');
+    m_buffer.append(m_indented ? ", " : ",");
+}
+
+void GeoJsonWriter::writeMember(const char* key)
+{
+    m_buffer.append(key);
+    m_buffer.append(m_indented ? ": " : ":");
+}
+
+void GeoJsonWriter::writePartCoordinates(const FeatureStore& store, qsizetype part)
+{
+    qsizetype firstRing = store.ringBegin(part);
+    qsizetype lastRing = store.ringEnd(part);
+    switch (store.partType(part)) {
+    case FeatureStore::Point:
+        if (firstRing < lastRing && store.coordinateBegin(firstRing) < store.coordinateEnd(firstRing)) {
+            qsizetype coordinate = store.coordinateBegin(firstRing);
+            m_buffer.append('[');
+            writeNumber(store.x(coordinate), m_precision);
+            m_buffer.append(m_indented ? ", " : ",");
+            writeNumber(store.y(coordinate), m_precision);
+            m_buffer.append(']');
+        } else {
+            m_buffer.append("[]");
+        }
+        break;
+    case FeatureStore::LineString:
+        if (firstRing < lastRing) {
+            writeRing(store, firstRing);
+        } else {
+            m_buffer.append("[]");
+        }
+        break;
+    default:
+        m_buffer.append('[');
+        for (qsizetype ring = firstRing; ring < lastRing; ++ring) {
+            if (ring > firstRing) {
+                m_buffer.append(m_indented ? ", " : ",");
+            }
+            writeRing(store, ring);
+        }
+        m_buffer.append(']');
+        break;
+    }
+}
+
+void GeoJsonWriter::writeRing(const FeatureStore& store, qsizetype ring)
+{
+    const double* xy = store.coordinates();
+    qsizetype begin = store.coordinateBegin(ring);
+    qsizetype end = store.coordinateEnd(ring);
+    const char* separator = m_indented ? ", " : ",";
+    m_buffer.append('[');
+    for (qsizetype i = begin; i < end; ++i) {
+        if (i > begin) {
+            m_buffer.append(separator);
+        }
+        m_buffer.append('[');
+        writeNumber(xy[i * 2], m_precision);
+        m_buffer.append(separator);
+        writeNumber(xy[i * 2 + 1], m_precision);
+        m_buffer.append(']');
+    }
+    m_buffer.append(']');
+}
+
+void GeoJsonWriter::writeValue(const PropertyColumn& column, qsizetype row)
+{
+    // Typed columns are formatted without going through QVariant
+    switch (column.type()) {
+    case PropertyColumn::Bool:
+        m_buffer.append(column.boolAt(row) ? "true" : "false");
+        break;
+    case PropertyColumn::Int:
+        writeInteger(column.intAt(row));
+        break;
+    case PropertyColumn::Double:
+        writeNumber(column.doubleAt(row));
+        break;
+    case PropertyColumn::String:
+        writeString(column.stringAt(row));
+        break;
+    default:
+        writeVariant(column.value(row));
+        break;
+    }
+}
+
+void GeoJsonWriter::writeVariant(const QVariant& value)
+{
+    switch (value.metaType().id()) {
+    case QMetaType::UnknownType:
+    case QMetaType::Nullptr:
+        m_buffer.append("null");
+        return;
+    case QMetaType::Bool:
+        m_buffer.append(value.toBool() ? "true" : "false");
+        return;
+    case QMetaType::Int:
+    case QMetaType::UInt:
+    case QMetaType::Long:
+    case QMetaType::LongLong:
+    case QMetaType::Short:
+    case QMetaType::UShort:
+        writeInteger(value.toLongLong());
+        return;
+    case QMetaType::ULongLong:
+        if (value.toULongLong() <= quint64(std::numeric_limits<qint64>::max())) {
+            writeInteger(value.toLongLong());
+        } else {
+            writeNumber(value.toDouble());
+        }
+        return;
+    case QMetaType::Double:
+    case QMetaType::Float:
+        writeNumber(value.toDouble());
+        return;
+    case QMetaType::QString:
+        writeString(value.toString());
+        return;
+    case QMetaType::QVariantMap: {
+        QVariantMap map = value.toMap();
+        m_buffer.append('{');
+        for (auto it = map.constBegin(); it != map.constEnd(); ++it) {
+            if (it != map.constBegin()) {
+                m_buffer.append(',');
+            }
+            writeString(it.key());
+            m_buffer.append(':');
+            writeVariant(it.value());
+        }
+        m_buffer.append('}');
+        return;
+    }
+    case QMetaType::QVariantList:
+    case QMetaType::QStringList: {
+        QVariantList list = value.toList();
+        m_buffer.append('[');
+        for (qsizetype i = 0; i < list.size(); ++i) {
+            if (i > 0) {
+                m_buffer.append(',');
+            }
+            writeVariant(list[i]);
+        }
+        m_buffer.append(']');
+        return;
+    }
+    default:
+        break;
+    }
+    
+    // Anything else is written the way QJsonDocument would
+    QJsonValue json = QJsonValue::fromVariant(value);
+    if (json.isString()) {
+        writeString(json.toString());
+    } else if (json.isDouble()) {
+        writeNumber(json.toDouble());
+    } else if (json.isBool()) {
+        m_buffer.append(json.toBool() ? "true" : "false");
+    } else if (json.isObject()) {
+        m_buffer.append(QJsonDocument(json.toObject()).toJson(QJsonDocument::Compact));
+    } else if (json.isArray()) {
+        m_buffer.append(QJsonDocument(json.toArray()).toJson(QJsonDocument::Compact));
+    } else {
+        m_buffer.append("null");
+    }
+}
+
+void GeoJsonWriter::writeNumber(double value, int precision)
+{
+    if (!std::isfinite(value)) {
+        m_buffer.append("null");
+        return;
+    }
+    
+    // Fixed notation of the largest doubles takes 309 digits before the point
+    char text[350];
+    if (precision < 0) {
+        std::to_chars_result result = std::to_chars(text, text + sizeof(text), value);
+        m_buffer.append(text, result.ptr - text);
+        return;
+    }
+    std::to_chars_result result = std::to_chars(text, text + sizeof(text), value, std::chars_format::fixed, precision);
+    char* end = result.ptr;
+    if (precision > 0) {
+        while (end[-1] == '0') {
+            --end;
+        }
+        if (end[-1] == '.') {
+            --end;
+        }
+    }
+    if (end - text == 2 && text[0] == '-' && text[1] == '0') {
+        // Negative values rounded to zero
+        m_buffer.append('0');
+        return;
+    }
+    m_buffer.append(text, end - text);
+}
+
+void GeoJsonWriter::writeInteger(qint64 value)
+{
+    char text[24];
+    std::to_chars_result result = std::to_chars(text, text + sizeof(text), value);
+    m_buffer.append(text, result.ptr - text);
+}
+
+void GeoJsonWriter::writeString(QStringView text)
+{
+    appendEscaped(m_buffer, text.toUtf8());
+}
+
+void GeoJsonWriter::writeKey(const QByteArray& key, int level, bool first)
+{
+    if (!first) {
+        m_buffer.append(',');
+    }
+    writeNewline(level);
+    m_buffer.append(key);
+    m_buffer.append(m_indented ? ": " : ":");
+}
+
+void GeoJsonWriter::writeNewline(int level)
+{
+    if (m_indented) {
+        m_buffer.append('\n');
+        m_buffer.append(level * 4, ' ');
+    }
+}
+
+bool GeoJsonWriter::flushIfFull()
+{
+    return m_buffer.size() < BufferSize || flush();
+}
+
+bool GeoJsonWriter::flush()
+{
+    if (m_device->write(m_buffer) != m_buffer.size()) {
+        m_error = m_device->errorString();
+        return false;
+    }
+    // Keeps the capacity for the next batch of features
+    m_buffer.resize(0);
+    return true;
+}
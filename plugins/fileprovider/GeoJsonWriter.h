@@ -0,0 +1,81 @@
+#pragma once
+
+#include "FeatureStore.h"
+#include <QByteArray>
+#include <QString>
+#include <QVariantMap>
+#include <QVector>
+
+class QIODevice;
+
+// Writes a FeatureStore as a GeoJSON FeatureCollection. Features are
+// serialized straight from the columns into a fixed-size buffer that is
+// flushed to the device as it fills, so memory use does not grow with the
+// layer. Numbers are formatted with std::to_chars: coordinates either in
+// their shortest round-trip form or with a fixed number of decimals, with
+// trailing zeros dropped. Non-finite numbers are written as null. Layer
+// metadata becomes members of the collection. The features can also be
+// written as a sequence, one per line, without a collection around them.
+class GeoJsonWriter
+{
+public:
+    explicit GeoJsonWriter(QIODevice* device);
+    
+    // Decimals of the coordinates, -1 for the shortest exact form
+    void setPrecision(int decimals) { m_precision = qBound(-1, decimals, 17); }
+    // Indents members and puts each feature on its own lines; geometries
+    // stay on one line either way
+    void setIndented(bool indented) { m_indented = indented; }
+    // Writes newline-delimited GeoJSON, or with record separators a GeoJSON
+    // text sequence (RFC 8142) whose lines start with RS. Features are not
+    // indented and layer metadata is left out.
+    void setSequence(bool sequence, bool recordSeparators = false)
+    {
+        m_sequence = sequence;
+        m_recordSeparators = recordSeparators;
+    }
+    
+    bool write(const FeatureStore& store);
+    // Writes a layer in parts, such as the pages of a paged layer: begin()
+    // opens the collection with the layer metadata, each writeFeatures()
+    // adds the features of a store and finish() closes the collection
+    bool begin(const QVariantMap& metadata);
+    bool writeFeatures(const FeatureStore& store);
+    bool finish();
+    QString errorString() const { return m_error; }
+
+private:
+    bool writeSequence(const FeatureStore& store);
+    void writeFeature(const FeatureStore& store, qsizetype feature);
+    void writeGeometry(const FeatureStore& store, qsizetype feature);
+    void writePart(const FeatureStore& store, qsizetype part);
+    // Opens a geometry object up to its type member
+    void writeGeometryStart(FeatureStore::GeometryType type);
+    void writePartCoordinates(const FeatureStore& store, qsizetype part);
+    void writeRing(const FeatureStore& store, qsizetype ring);
+    void writeValue(const PropertyColumn& column, qsizetype row);
+    void writeVariant(const QVariant& value);
+    void writeNumber(double value, int precision = -1);
+    void writeInteger(qint64 value);
+    void writeString(QStringView text);
+    // Starts a member; the key is escaped and quoted, level is the indentation
+    void writeKey(const QByteArray& key, int level, bool first);
+    // Member of a geometry, which stays on one line
+    void writeMember(const char* key);
+    void writeNewline(int level);
+    // Flushes the buffer once it holds at least a buffer's worth of bytes
+    bool flushIfFull();
+    bool flush();
+    
+    QIODevice* m_device;
+    int m_precision;
+    bool m_indented;
+    bool m_sequence;
+    bool m_recordSeparators;
+    
+    QByteArray m_buffer;
+    qint64 m_featureCount;
+    // Escaped property names with their quotes
+    QVector<QByteArray> m_keys;
+    QString m_error;
+};
@@ -0,0 +1,67 @@
+#include "GeometryBuffer.h"
+
+void GeometryBuffer::clear()
+{
+    m_coordinates.clear();
+    m_lineStarts.clear();
+    m_polygonStarts.clear();
+}
+
+void GeometryBuffer::write(FeatureStore& store, FeatureStore::GeometryType type) const
+{
+    qsizetype coordinateCount = m_coordinates.size() / 2;
+    qsizetype lineCount = m_lineStarts.size();
+    qsizetype polygonCount = m_polygonStarts.size();
+    
+    auto lineEnd = [&](qsizetype line) {
+        return line + 1 < lineCount ? m_lineStarts[line + 1] : coordinateCount;
+    };
+    
+    switch (type) {
+    case FeatureStore::Point:
+        store.beginPart(FeatureStore::Point);
+        writeRing(store, 0, qMin<qsizetype>(1, coordinateCount));
+        break;
+    case FeatureStore::LineString:
+        store.beginPart(FeatureStore::LineString);
+        writeRing(store, 0, coordinateCount);
+        break;
+    case FeatureStore::MultiPoint:
+        for (qsizetype coordinate = 0; coordinate < coordinateCount; ++coordinate) {
+            store.beginPart(FeatureStore::Point);
+            writeRing(store, coordinate, coordinate + 1);
+        }
+        break;
+    case FeatureStore::Polygon:
+        store.beginPart(FeatureStore::Polygon);
+        for (qsizetype line = 0; line < lineCount; ++line) {
+            writeRing(store, m_lineStarts[line], lineEnd(line));
+        }
+        break;
+    case FeatureStore::MultiLineString:
+        for (qsizetype line = 0; line < lineCount; ++line) {
+            store.beginPart(FeatureStore::LineString);
+            writeRing(store, m_lineStarts[line], lineEnd(line));
+        }
+        break;
+    case FeatureStore::MultiPolygon:
+        for (qsizetype polygon = 0; polygon < polygonCount; ++polygon) {
+            qsizetype lastLine = polygon + 1 < polygonCount ? m_polygonStarts[polygon + 1] : lineCount;
+            store.beginPart(FeatureStore::Polygon);
+            for (qsizetype line = m_polygonStarts[polygon]; line < lastLine; ++line) {
+                writeRing(store, m_lineStarts[line], lineEnd(line));
+            }
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+void GeometryBuffer::writeRing(FeatureStore& store, qsizetype first, qsizetype last) const
+{
+    store.beginRing();
+    for (qsizetype coordinate = first; coordinate < last; ++coordinate) {
+        store.addCoordinate(m_coordinates[coordinate * 2], m_coordinates[coordinate * 2 + 1]);
+    }
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "FeatureStore.h"
+#include <QVector>
+
+// Scratch space for the coordinates of one geometry while it is parsed.
+// Readers often see coordinates before they know the geometry type, so the
+// nesting is recorded as start offsets (lines into coordinates, polygons
+// into lines) and replayed into the store as parts and rings by write().
+class GeometryBuffer
+{
+public:
+    void clear();
+    
+    qsizetype coordinateCount() const { return m_coordinates.size() / 2; }
+    qsizetype lineCount() const { return m_lineStarts.size(); }
+    
+    void addCoordinate(double x, double y) { m_coordinates.append(x); m_coordinates.append(y); }
+    // Closes a line made of the coordinates from firstCoordinate on
+    void addLine(qsizetype firstCoordinate) { m_lineStarts.append(firstCoordinate); }
+    // Closes a polygon made of the lines from firstLine on
+    void addPolygon(qsizetype firstLine) { m_polygonStarts.append(firstLine); }
+    
+    // Adds the buffered geometry to the current feature of the store
+    void write(FeatureStore& store, FeatureStore::GeometryType type) const;
+
+private:
+    void writeRing(FeatureStore& store, qsizetype first, qsizetype last) const;
+    
+    QVector<double> m_coordinates;
+    QVector<qsizetype> m_lineStarts;
+    QVector<qsizetype> m_polygonStarts;
+};
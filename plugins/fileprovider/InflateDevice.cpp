@@ -0,0 +1,108 @@
+#include "InflateDevice.h"
+#include <climits>
+
+namespace {
+
+// zlib counts in uInt, larger inputs are fed in slices
+const qsizetype MaxSlice = 1 << 30;
+
+} // namespace
+
+InflateDevice::InflateDevice(const char* data, qsizetype size, Format format)
+    : m_data(data)
+    , m_size(size)
+    , m_offset(0)
+    , m_format(format)
+    , m_stream()
+    , m_initialized(false)
+    , m_finished(false)
+{
+}
+
+InflateDevice::~InflateDevice()
+{
+    close();
+}
+
+bool InflateDevice::open(OpenMode mode)
+{
+    if (mode != ReadOnly) {
+        setErrorString("Compressed data can only be read");
+        return false;
+    }
+    
+    m_stream = z_stream();
+    int windowBits = m_format == Raw ? -MAX_WBITS : (m_format == Gzip ? 16 + MAX_WBITS : MAX_WBITS);
+    if (inflateInit2(&m_stream, windowBits) != Z_OK) {
+        setErrorString("Cannot initialize decompression");
+        return false;
+    }
+    m_initialized = true;
+    m_finished = false;
+    m_offset = 0;
+    return QIODevice::open(mode);
+}
+
+void InflateDevice::close()
+{
+    if (m_initialized) {
+        inflateEnd(&m_stream);
+        m_initialized = false;
+    }
+    if (isOpen()) {
+        QIODevice::close();
+    }
+}
+
+bool InflateDevice::atEnd() const
+{
+    return m_finished && QIODevice::bytesAvailable() == 0;
+}
+
+qint64 InflateDevice::readData(char* data, qint64 maxSize)
+{
+    if (!m_initialized || m_finished) {
+        return 0;
+    }
+    
+    uInt capacity = uInt(qMin<qint64>(maxSize, UINT_MAX));
+    m_stream.next_out = reinterpret_cast<Bytef*>(data);
+    m_stream.avail_out = capacity;
+    
+    while (m_stream.avail_out > 0 && !m_finished) {
+        if (m_stream.avail_in == 0) {
+            if (m_offset >= m_size) {
+                setErrorString("Compressed data is truncated");
+                break;
+            }
+            qsizetype slice = qMin(m_size - m_offset, MaxSlice);
+            m_stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(m_data + m_offset));
+            m_stream.avail_in = uInt(slice);
+            m_offset += slice;
+        }
+        
+        int status = inflate(&m_stream, Z_NO_FLUSH);
+        if (status == Z_STREAM_END) {
+            bool moreInput = m_stream.avail_in > 0 || m_offset < m_size;
+            if (m_format == Gzip && moreInput) {
+                inflateReset(&m_stream);
+            } else {
+                m_finished = true;
+            }
+        } else if (status != Z_OK && status != Z_BUF_ERROR) {
+            setErrorString(m_stream.msg ? QString::fromLatin1(m_stream.msg) : QString("Corrupt compressed data"));
+            break;
+        }
+    }
+    
+    qint64 produced = capacity - m_stream.avail_out;
+    if (produced == 0 && !m_finished) {
+        return -1;
+    }
+    return produced;
+}
+
+qint64 InflateDevice::writeData(const char*, qint64)
+{
+    return -1;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <QIODevice>
+#include <zlib.h>
+
+// Sequential device that inflates a deflate stream held in memory as it is
+// read, so compressed members and files can be parsed without ever holding
+// the whole decompressed document. Concatenated gzip members are read as
+// one stream.
+class InflateDevice : public QIODevice
+{
+public:
+    enum Format {
+        Raw,    // bare deflate data, as stored in zip archives
+        Zlib,
+        Gzip
+    };
+    
+    InflateDevice(const char* data, qsizetype size, Format format = Raw);
+    ~InflateDevice() override;
+    
+    bool open(OpenMode mode) override;
+    void close() override;
+    bool isSequential() const override { return true; }
+    bool atEnd() const override;
+    
+    // Compressed bytes consumed so far
+    qint64 compressedPosition() const { return m_offset - qint64(m_stream.avail_in); }
+
+protected:
+    qint64 readData(char* data, qint64 maxSize) override;
+    qint64 writeData(const char* data, qint64 maxSize) override;
+
+private:
+    Q_DISABLE_COPY(InflateDevice)
+    
+    const char* m_data;
+    qsizetype m_size;
+    qsizetype m_offset;
+    Format m_format;
+    z_stream m_stream;
+    bool m_initialized;
+    bool m_finished;
+};
@@ -0,0 +1,484 @@
+#include "JsonReader.h"
+#include <QIODevice>
+#include <QVariantMap>
+#include <QVariantList>
+#include <charconv>
+#include <cstring>
+
+namespace {
+
+const qsizetype ChunkSize = 1 << 20;
+
+void appendUtf8(QByteArray& out, uint codePoint)
+{
+    if (codePoint < 0x80) {
+        out.append(char(codePoint));
+    } else if (codePoint < 0x800) {
+        out.append(char(0xC0 | (codePoint >> 6)));
+        out.append(char(0x80 | (codePoint & 0x3F)));
+    } else if (codePoint < 0x10000) {
+        out.append(char(0xE0 | (codePoint >> 12)));
+        out.append(char(0x80 | ((codePoint >> 6) & 0x3F)));
+        out.append(char(0x80 | (codePoint & 0x3F)));
+    } else {
+        out.append(char(0xF0 | (codePoint >> 18)));
+        out.append(char(0x80 | ((codePoint >> 12) & 0x3F)));
+        out.append(char(0x80 | ((codePoint >> 6) & 0x3F)));
+        out.append(char(0x80 | (codePoint & 0x3F)));
+    }
+}
+
+int hexValue(char c)
+{
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+bool parseHex4(const char* data, uint& value)
+{
+    value = 0;
+    for (int i = 0; i < 4; ++i) {
+        int digit = hexValue(data[i]);
+        if (digit < 0) {
+            return false;
+        }
+        value = (value << 4) | uint(digit);
+    }
+    return true;
+}
+
+} // namespace
+
+JsonReader::JsonReader(QIODevice* device)
+    : m_device(device)
+    , m_data(nullptr)
+    , m_size(0)
+    , m_pos(0)
+    , m_base(0)
+    , m_sequence(false)
+    , m_state(ExpectValue)
+    , m_token(Invalid)
+    , m_isInteger(false)
+    , m_integer(0)
+    , m_number(0.0)
+{
+}
+
+JsonReader::JsonReader(const char* data, qsizetype size)
+    : m_device(nullptr)
+    , m_data(data)
+    , m_size(size)
+    , m_pos(0)
+    , m_base(0)
+    , m_sequence(false)
+    , m_state(ExpectValue)
+    , m_token(Invalid)
+    , m_isInteger(false)
+    , m_integer(0)
+    , m_number(0.0)
+{
+}
+
+JsonReader::Token JsonReader::next()
+{
+    if (hasError()) {
+        return Invalid;
+    }
+    
+    // Skip a UTF-8 byte order mark at the very start
+    if (position() == 0 && require(3) && std::memcmp(m_data, "\xEF\xBB\xBF", 3) == 0) {
+        m_pos += 3;
+    }
+    
+    if (!skipWhitespace()) {
+        if (m_state == Done || (m_sequence && m_state == ExpectValue && m_stack.isEmpty())) {
+            return m_token = EndOfDocument;
+        }
+        return fail("Unexpected end of document");
+    }
+    
+    char c = m_data[m_pos];
+    switch (m_state) {
+    case Done:
+        return fail("Unexpected data after document");
+    case ExpectColon:
+        if (c != ':') {
+            return fail("Expected ':'");
+        }
+        ++m_pos;
+        m_state = ExpectValue;
+        return next();
+    case ExpectSeparator:
+        if (c == ',') {
+            ++m_pos;
+            m_state = m_stack.last() == '{' ? ExpectName : ExpectValue;
+            return next();
+        }
+        if ((c == '}' && m_stack.last() == '{') || (c == ']' && m_stack.last() == '[')) {
+            ++m_pos;
+            m_stack.removeLast();
+            afterValue();
+            return m_token = (c == '}') ? EndObject : EndArray;
+        }
+        return fail("Expected ',' or end of container");
+    case ExpectNameOrEnd:
+        if (c == '}') {
+            ++m_pos;
+            m_stack.removeLast();
+            afterValue();
+            return m_token = EndObject;
+        }
+        [[fallthrough]];
+    case ExpectName:
+        if (c != '"') {
+            return fail("Expected object member name");
+        }
+        return lexString(Name);
+    case ExpectValueOrEnd:
+        if (c == ']') {
+            ++m_pos;
+            m_stack.removeLast();
+            afterValue();
+            return m_token = EndArray;
+        }
+        [[fallthrough]];
+    case ExpectValue:
+        if (m_sequence && m_stack.isEmpty() && (c == ',' || c == '\x1E')) {
+            ++m_pos;
+            return next();
+        }
+        return lexValue();
+    }
+    
+    return fail("Invalid reader state");
+}
+
+qsizetype JsonReader::stringEnd(const char* data, qsizetype size, qsizetype begin)
+{
+    qsizetype i = begin + 1;
+    while (i < size) {
+        const char* quote = static_cast<const char*>(std::memchr(data + i, '"', size - i));
+        if (!quote) {
+            return -1;
+        }
+        qsizetype end = quote - data;
+        qsizetype escapes = 0;
+        while (end - escapes - 1 > begin && data[end - escapes - 1] == '\\') {
+            ++escapes;
+        }
+        if (escapes % 2 == 0) {
+            return end;
+        }
+        i = end + 1;
+    }
+    return -1;
+}
+
+bool JsonReader::skipValue()
+{
+    if (m_token == BeginObject || m_token == BeginArray) {
+        int target = depth() - 1;
+        while (depth() > target) {
+            if (next() == Invalid) {
+                return false;
+            }
+        }
+    }
+    return !hasError();
+}
+
+QVariant JsonReader::readValue()
+{
+    switch (m_token) {
+    case BeginObject: {
+        QVariantMap map;
+        while (next() == Name) {
+            QString key = string();
+            next();
+            map.insert(key, readValue());
+        }
+        return hasError() ? QVariant() : QVariant(map);
+    }
+    case BeginArray: {
+        QVariantList list;
+        for (Token token = next(); token != EndArray && token != Invalid; token = next()) {
+            list.append(readValue());
+        }
+        return hasError() ? QVariant() : QVariant(list);
+    }
+    case String:
+        return string();
+    case Number:
+        return m_isInteger ? QVariant(qlonglong(m_integer)) : QVariant(m_number);
+    case True:
+        return true;
+    case False:
+        return false;
+    default:
+        break;
+    }
+    return QVariant();
+}
+
+// Makes sure at least count bytes are available from the current position,
+// compacting the buffer and reading more from the device when streaming.
+bool JsonReader::require(qsizetype count)
+{
+    if (m_pos + count <= m_size) {
+        return true;
+    }
+    if (!m_device) {
+        return false;
+    }
+    
+    qsizetype remaining = m_size - m_pos;
+    if (m_pos > 0) {
+        std::memmove(m_buffer.data(), m_buffer.constData() + m_pos, remaining);
+        m_base += m_pos;
+        m_pos = 0;
+    }
+    
+    while (remaining < count) {
+        m_buffer.resize(remaining + qMax(ChunkSize, count - remaining));
+        qint64 bytesRead = m_device->read(m_buffer.data() + remaining, m_buffer.size() - remaining);
+        if (bytesRead <= 0) {
+            break;
+        }
+        remaining += bytesRead;
+    }
+    
+    m_buffer.resize(remaining);
+    m_data = m_buffer.constData();
+    m_size = remaining;
+    return count <= remaining;
+}
+
+bool JsonReader::skipWhitespace()
+{
+    while (true) {
+        while (m_pos < m_size) {
+            char c = m_data[m_pos];
+            if (c != ' ' && c != '\n' && c != '\r' && c != '\t') {
+                return true;
+            }
+            ++m_pos;
+        }
+        if (!require(1)) {
+            return false;
+        }
+    }
+}
+
+JsonReader::Token JsonReader::lexValue()
+{
+    char c = m_data[m_pos];
+    switch (c) {
+    case '{':
+        ++m_pos;
+        m_stack.append('{');
+        m_state = ExpectNameOrEnd;
+        return m_token = BeginObject;
+    case '[':
+        ++m_pos;
+        m_stack.append('[');
+        m_state = ExpectValueOrEnd;
+        return m_token = BeginArray;
+    case '"':
+        return lexString(String);
+    case 't':
+        return lexLiteral("true", True);
+    case 'f':
+        return lexLiteral("false", False);
+    case 'n':
+        return lexLiteral("null", Null);
+    default:
+        if (c == '-' || (c >= '0' && c <= '9')) {
+            return lexNumber();
+        }
+        break;
+    }
+    return fail(QString("Unexpected character '%1'").arg(QChar(c)));
+}
+
+JsonReader::Token JsonReader::lexString(Token kind)
+{
+    qsizetype end = -1;
+    qsizetype i = 1;
+    bool escaped = false;
+    
+    while (end < 0) {
+        if (!require(i + 1)) {
+            return fail("Unterminated string");
+        }
+        const char* data = m_data + m_pos;
+        qsizetype available = m_size - m_pos;
+        while (i < available) {
+            char c = data[i];
+            if (c == '"') {
+                end = i;
+                break;
+            }
+            if (c == '\\') {
+                escaped = true;
+                i += 2;
+            } else {
+                ++i;
+            }
+        }
+    }
+    
+    const char* begin = m_data + m_pos + 1;
+    if (escaped) {
+        if (!unescape(begin, end - 1)) {
+            return fail("Invalid escape sequence");
+        }
+        m_string = QByteArrayView(m_unescaped);
+    } else {
+        m_string = QByteArrayView(begin, end - 1);
+    }
+    m_pos += end + 1;
+    
+    if (kind == Name) {
+        m_state = ExpectColon;
+    } else {
+        afterValue();
+    }
+    return m_token = kind;
+}
+
+bool JsonReader::unescape(const char* data, qsizetype size)
+{
+    m_unescaped.clear();
+    m_unescaped.reserve(size);
+    
+    for (qsizetype i = 0; i < size; ++i) {
+        char c = data[i];
+        if (c != '\\') {
+            m_unescaped.append(c);
+            continue;
+        }
+        if (++i >= size) {
+            return false;
+        }
+        switch (data[i]) {
+        case '"':
+        case '\\':
+        case '/':
+            m_unescaped.append(data[i]);
+            break;
+        case 'b':
+            m_unescaped.append('\b');
+            break;
+        case 'f':
+            m_unescaped.append('\f');
+            break;
+        case 'n':
+            m_unescaped.append('\n');
+            break;
+        case 'r':
+            m_unescaped.append('\r');
+            break;
+        case 't':
+            m_unescaped.append('\t');
+            break;
+        case 'u': {
+            uint codePoint = 0;
+            if (i + 4 >= size || !parseHex4(data + i + 1, codePoint)) {
+                return false;
+            }
+            i += 4;
+            // Combine UTF-16 surrogate pairs
+            if (codePoint >= 0xD800 && codePoint <= 0xDBFF && i + 6 < size
+                && data[i + 1] == '\\' && data[i + 2] == 'u') {
+                uint low = 0;
+                if (parseHex4(data + i + 3, low) && low >= 0xDC00 && low <= 0xDFFF) {
+                    codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (low - 0xDC00);
+                    i += 6;
+                }
+            }
+            appendUtf8(m_unescaped, codePoint);
+            break;
+        }
+        default:
+            return false;
+        }
+    }
+    return true;
+}
+
+JsonReader::Token JsonReader::lexNumber()
+{
+    qsizetype i = 0;
+    m_isInteger = true;
+    
+    while (m_pos + i < m_size || require(i + 1)) {
+        char c = m_data[m_pos + i];
+        if (c >= '0' && c <= '9') {
+            ++i;
+        } else if (c == '-' || c == '+') {
+            ++i;
+        } else if (c == '.' || c == 'e' || c == 'E') {
+            m_isInteger = false;
+            ++i;
+        } else {
+            break;
+        }
+    }
+    
+    const char* begin = m_data + m_pos;
+    const char* end = begin + i;
+    if (m_isInteger) {
+        auto result = std::from_chars(begin, end, m_integer);
+        if (result.ec == std::errc() && result.ptr == end) {
+            m_number = double(m_integer);
+        } else {
+            m_isInteger = false;
+        }
+    }
+    if (!m_isInteger) {
+        auto result = std::from_chars(begin, end, m_number);
+        if (result.ec != std::errc() || result.ptr != end) {
+            return fail("Invalid number");
+        }
+    }
+    
+    m_pos += i;
+    afterValue();
+    return m_token = Number;
+}
+
+JsonReader::Token JsonReader::lexLiteral(const char* literal, Token kind)
+{
+    qsizetype length = qsizetype(std::strlen(literal));
+    if (!require(length) || std::memcmp(m_data + m_pos, literal, length) != 0) {
+        return fail("Invalid literal");
+    }
+    m_pos += length;
+    afterValue();
+    return m_token = kind;
+}
+
+JsonReader::Token JsonReader::fail(const QString& message)
+{
+    if (m_error.isEmpty()) {
+        m_error = QString("%1 at offset %2").arg(message).arg(position());
+    }
+    return m_token = Invalid;
+}
+
+void JsonReader::afterValue()
+{
+    if (m_stack.isEmpty()) {
+        m_state = m_sequence ? ExpectValue : Done;
+    } else {
+        m_state = ExpectSeparator;
+    }
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <QByteArray>
+#include <QByteArrayView>
+#include <QString>
+#include <QVariant>
+#include <QVector>
+
+class QIODevice;
+
+// Event-driven JSON tokenizer. The reader either streams from a QIODevice
+// through a bounded buffer or walks an in-memory range, so callers can
+// consume arbitrarily large documents one token at a time without building a
+// DOM. The value of the current token stays valid until the next call to
+// next().
+class JsonReader
+{
+public:
+    enum Token {
+        Invalid,
+        BeginObject,
+        EndObject,
+        BeginArray,
+        EndArray,
+        Name,
+        String,
+        Number,
+        True,
+        False,
+        Null,
+        EndOfDocument
+    };
+    
+    explicit JsonReader(QIODevice* device);
+    JsonReader(const char* data, qsizetype size);
+    
+    // Accept a sequence of top-level values separated by whitespace, commas
+    // or RS characters (RFC 7464) instead of a single document
+    void setValueSequence(bool sequence) { m_sequence = sequence; }
+    
+    Token next();
+    Token token() const { return m_token; }
+    
+    // Current Name or String token as UTF-8 (escapes already decoded)
+    QByteArrayView utf8() const { return m_string; }
+    QString string() const { return QString::fromUtf8(m_string); }
+    
+    // Current Number token
+    bool isInteger() const { return m_isInteger; }
+    qint64 integer() const { return m_integer; }
+    double number() const { return m_number; }
+    
+    // Skips or materializes the value whose first token is the current one
+    bool skipValue();
+    QVariant readValue();
+    
+    int depth() const { return m_stack.size(); }
+    qint64 position() const { return m_base + m_pos; }
+    bool hasError() const { return !m_error.isEmpty(); }
+    QString errorString() const { return m_error; }
+    
+    // Offset of the closing quote of the string opening at begin, or -1.
+    // Lets structural scans skip strings without tokenizing them.
+    static qsizetype stringEnd(const char* data, qsizetype size, qsizetype begin);
+
+private:
+    enum State {
+        ExpectValue,
+        ExpectValueOrEnd,
+        ExpectName,
+        ExpectNameOrEnd,
+        ExpectColon,
+        ExpectSeparator,
+        Done
+    };
+    
+    bool require(qsizetype count);
+    bool skipWhitespace();
+    Token lexValue();
+    Token lexString(Token kind);
+    bool unescape(const char* data, qsizetype size);
+    Token lexNumber();
+    Token lexLiteral(const char* literal, Token kind);
+    Token fail(const QString& message);
+    void afterValue();
+    
+    QIODevice* m_device;
+    QByteArray m_buffer;
+    const char* m_data;
+    qsizetype m_size;
+    qsizetype m_pos;
+    qint64 m_base;
+    
+    QVector<char> m_stack;
+    bool m_sequence;
+    State m_state;
+    Token m_token;
+    
+    QByteArrayView m_string;
+    QByteArray m_unescaped;
+    bool m_isInteger;
+    qint64 m_integer;
+    double m_number;
+    QString m_error;
+};
@@ -0,0 +1,389 @@
+#include "KmlReader.h"
+#include <QIODevice>
+#include <charconv>
+#include <limits>
+
+namespace {
+
+const qint64 ProgressInterval = 1024;
+
+enum Element {
+    OtherElement,
+    PointElement,
+    LineStringElement,
+    LinearRingElement,
+    PolygonElement,
+    MultiGeometryElement
+};
+
+Element classify(QStringView name)
+{
+    if (name == u"Point") {
+        return PointElement;
+    } else if (name == u"LineString") {
+        return LineStringElement;
+    } else if (name == u"LinearRing") {
+        return LinearRingElement;
+    } else if (name == u"Polygon") {
+        return PolygonElement;
+    } else if (name == u"MultiGeometry") {
+        return MultiGeometryElement;
+    }
+    return OtherElement;
+}
+
+FeatureStore::GeometryType simpleType(FeatureStore::GeometryType type)
+{
+    switch (type) {
+    case FeatureStore::MultiPoint:
+        return FeatureStore::Point;
+    case FeatureStore::MultiLineString:
+        return FeatureStore::LineString;
+    case FeatureStore::MultiPolygon:
+        return FeatureStore::Polygon;
+    default:
+        return type;
+    }
+}
+
+FeatureStore::GeometryType multiType(FeatureStore::GeometryType type)
+{
+    switch (type) {
+    case FeatureStore::Point:
+        return FeatureStore::MultiPoint;
+    case FeatureStore::LineString:
+        return FeatureStore::MultiLineString;
+    case FeatureStore::Polygon:
+        return FeatureStore::MultiPolygon;
+    default:
+        return type;
+    }
+}
+
+bool isSpace(char16_t c)
+{
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+bool isNumberChar(char16_t c)
+{
+    return (c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E';
+}
+
+} // namespace
+
+KmlReader::KmlReader(QIODevice* device)
+    : m_xml(device)
+    , m_minX(std::numeric_limits<double>::max())
+    , m_minY(std::numeric_limits<double>::max())
+    , m_maxX(std::numeric_limits<double>::lowest())
+    , m_maxY(std::numeric_limits<double>::lowest())
+    , m_cancelled(false)
+{
+}
+
+QVariantMap KmlReader::boundingBox() const
+{
+    QVariantMap box;
+    if (m_minX <= m_maxX) {
+        box["minLat"] = m_minY;
+        box["maxLat"] = m_maxY;
+        box["minLon"] = m_minX;
+        box["maxLon"] = m_maxX;
+    }
+    return box;
+}
+
+bool KmlReader::read(FeatureStore& store, const IngestProgress& progress)
+{
+    m_cancelled = false;
+    m_error.clear();
+    
+    QVariantMap metadata;
+    qint64 featureCount = 0;
+    
+    while (!m_xml.atEnd()) {
+        QXmlStreamReader::TokenType token = m_xml.readNext();
+        
+        if (token == QXmlStreamReader::EndElement) {
+            QStringView name = m_xml.name();
+            if (!m_containers.isEmpty() && (name == u"Document" || name == u"Folder")) {
+                m_containers.removeLast();
+                updateFolderPath();
+            }
+            continue;
+        }
+        if (token != QXmlStreamReader::StartElement) {
+            continue;
+        }
+        
+        QStringView name = m_xml.name();
+        if (name == u"Placemark") {
+            readPlacemark(store);
+            if (progress && ++featureCount % ProgressInterval == 0
+                && !progress(m_xml.device()->pos(), featureCount)) {
+                m_cancelled = true;
+                return false;
+            }
+        } else if (name == u"Document" || name == u"Folder") {
+            m_containers.append(Container{name == u"Folder", QString()});
+        } else if (name == u"name" && !m_containers.isEmpty()) {
+            Container& container = m_containers.last();
+            container.name = m_xml.readElementText(QXmlStreamReader::IncludeChildElements);
+            if (container.folder) {
+                updateFolderPath();
+            } else if (!metadata.contains("name")) {
+                metadata["name"] = container.name;
+            }
+        } else if (name == u"description" && m_containers.size() == 1 && !m_containers.last().folder) {
+            metadata["description"] = m_xml.readElementText(QXmlStreamReader::IncludeChildElements);
+        } else if (name == u"Style" || name == u"StyleMap" || name == u"Schema" || name == u"NetworkLink") {
+            // Styling and schema definitions carry no features
+            m_xml.skipCurrentElement();
+        }
+    }
+    
+    if (m_xml.hasError()) {
+        m_error = QString("%1 at line %2, column %3")
+                      .arg(m_xml.errorString())
+                      .arg(m_xml.lineNumber())
+                      .arg(m_xml.columnNumber());
+        return false;
+    }
+    
+    store.setMetadata(metadata);
+    if (progress) {
+        progress(m_xml.device()->pos(), featureCount);
+    }
+    return true;
+}
+
+void KmlReader::readPlacemark(FeatureStore& store)
+{
+    store.beginFeature();
+    FeatureStore::GeometryType type = FeatureStore::NoGeometry;
+    
+    QStringView id = m_xml.attributes().value("id");
+    if (!id.isEmpty()) {
+        store.setFeatureId(id.toString());
+    }
+    if (!m_folderPath.isEmpty()) {
+        store.setProperty("folder", m_folderPath);
+    }
+    
+    while (m_xml.readNextStartElement()) {
+        QStringView name = m_xml.name();
+        if (name == u"name" || name == u"description" || name == u"address" || name == u"styleUrl") {
+            QString key = name.toString();
+            store.setProperty(key, m_xml.readElementText(QXmlStreamReader::IncludeChildElements));
+        } else if (name == u"ExtendedData") {
+            readExtendedData(store);
+        } else if (name == u"TimeStamp" || name == u"TimeSpan") {
+            readTime(store);
+        } else if (classify(name) != OtherElement) {
+            FeatureStore::GeometryType geometry = readGeometry(store);
+            if (geometry != FeatureStore::NoGeometry) {
+                type = type == FeatureStore::NoGeometry ? geometry : FeatureStore::GeometryCollection;
+            }
+        } else {
+            m_xml.skipCurrentElement();
+        }
+    }
+    
+    store.setGeometryType(type);
+    store.endFeature();
+}
+
+// Reads the geometry element at the current position and writes its parts
+// to the current feature
+FeatureStore::GeometryType KmlReader::readGeometry(FeatureStore& store)
+{
+    Element element = classify(m_xml.name());
+    
+    if (element == MultiGeometryElement) {
+        FeatureStore::GeometryType type = FeatureStore::NoGeometry;
+        while (m_xml.readNextStartElement()) {
+            if (classify(m_xml.name()) == OtherElement) {
+                m_xml.skipCurrentElement();
+                continue;
+            }
+            FeatureStore::GeometryType member = readGeometry(store);
+            if (member == FeatureStore::NoGeometry) {
+                continue;
+            }
+            // Homogeneous members make a Multi* geometry, anything else a
+            // GeometryCollection
+            if (type == FeatureStore::NoGeometry) {
+                type = multiType(simpleType(member));
+            } else if (member == FeatureStore::GeometryCollection || simpleType(member) != simpleType(type)) {
+                type = FeatureStore::GeometryCollection;
+            }
+        }
+        return type;
+    }
+    
+    m_geometry.clear();
+    while (m_xml.readNextStartElement()) {
+        QStringView name = m_xml.name();
+        if (name == u"coordinates" && element != PolygonElement) {
+            readCoordinates();
+        } else if ((name == u"outerBoundaryIs" || name == u"innerBoundaryIs") && element == PolygonElement) {
+            readBoundary();
+        } else {
+            m_xml.skipCurrentElement();
+        }
+    }
+    if (m_geometry.coordinateCount() == 0) {
+        return FeatureStore::NoGeometry;
+    }
+    
+    FeatureStore::GeometryType type = FeatureStore::LineString;
+    if (element == PointElement) {
+        type = FeatureStore::Point;
+    } else if (element == PolygonElement) {
+        type = FeatureStore::Polygon;
+    }
+    m_geometry.write(store, type);
+    return type;
+}
+
+// The outer boundary precedes the inner ones in KML, so rings arrive in the
+// order the store expects
+void KmlReader::readBoundary()
+{
+    while (m_xml.readNextStartElement()) {
+        if (m_xml.name() != u"LinearRing") {
+            m_xml.skipCurrentElement();
+            continue;
+        }
+        while (m_xml.readNextStartElement()) {
+            if (m_xml.name() == u"coordinates") {
+                readCoordinates();
+            } else {
+                m_xml.skipCurrentElement();
+            }
+        }
+    }
+}
+
+// Reads whitespace separated "lon,lat[,alt]" tuples into a new line of the
+// geometry buffer
+void KmlReader::readCoordinates()
+{
+    QString text = m_xml.readElementText();
+    const char16_t* p = reinterpret_cast<const char16_t*>(text.utf16());
+    const char16_t* end = p + text.size();
+    
+    qsizetype firstCoordinate = m_geometry.coordinateCount();
+    double xy[2] = {0.0, 0.0};
+    int count = 0;
+    
+    while (true) {
+        while (p < end && isSpace(*p)) {
+            ++p;
+        }
+        if (p == end) {
+            break;
+        }
+        
+        char number[64];
+        int length = 0;
+        if (*p == '+') {
+            ++p;
+        }
+        while (p < end && length < int(sizeof(number)) && isNumberChar(*p)) {
+            number[length++] = char(*p++);
+        }
+        double value = 0.0;
+        if (length == 0 || length == int(sizeof(number))
+            || std::from_chars(number, number + length, value).ec != std::errc()) {
+            // Drop the malformed tuple
+            while (p < end && !isSpace(*p)) {
+                ++p;
+            }
+            count = 0;
+            continue;
+        }
+        if (count < 2) {
+            xy[count] = value;
+        }
+        ++count;
+        
+        // A comma continues the tuple, anything else ends it
+        while (p < end && isSpace(*p)) {
+            ++p;
+        }
+        if (p < end && *p == ',') {
+            ++p;
+            continue;
+        }
+        if (count >= 2) {
+            m_geometry.addCoordinate(xy[0], xy[1]);
+            m_minX = qMin(m_minX, xy[0]);
+            m_maxX = qMax(m_maxX, xy[0]);
+            m_minY = qMin(m_minY, xy[1]);
+            m_maxY = qMax(m_maxY, xy[1]);
+        }
+        count = 0;
+    }
+    
+    if (m_geometry.coordinateCount() > firstCoordinate) {
+        m_geometry.addLine(firstCoordinate);
+    }
+}
+
+// <Data name="..."><value>...</value></Data> and typed
+// <SchemaData><SimpleData name="...">...</SimpleData></SchemaData>
+void KmlReader::readExtendedData(FeatureStore& store)
+{
+    while (m_xml.readNextStartElement()) {
+        QStringView name = m_xml.name();
+        if (name == u"Data") {
+            QString key = m_xml.attributes().value("name").toString();
+            while (m_xml.readNextStartElement()) {
+                if (m_xml.name() == u"value" && !key.isEmpty()) {
+                    store.setProperty(key, m_xml.readElementText(QXmlStreamReader::IncludeChildElements));
+                } else {
+                    m_xml.skipCurrentElement();
+                }
+            }
+        } else if (name == u"SchemaData") {
+            while (m_xml.readNextStartElement()) {
+                QString key = m_xml.attributes().value("name").toString();
+                if (m_xml.name() == u"SimpleData" && !key.isEmpty()) {
+                    store.setProperty(key, m_xml.readElementText(QXmlStreamReader::IncludeChildElements));
+                } else {
+                    m_xml.skipCurrentElement();
+                }
+            }
+        } else {
+            m_xml.skipCurrentElement();
+        }
+    }
+}
+
+void KmlReader::readTime(FeatureStore& store)
+{
+    while (m_xml.readNextStartElement()) {
+        QStringView name = m_xml.name();
+        if (name == u"when") {
+            store.setProperty("timestamp", m_xml.readElementText());
+        } else if (name == u"begin" || name == u"end") {
+            QString key = name.toString();
+            store.setProperty(key, m_xml.readElementText());
+        } else {
+            m_xml.skipCurrentElement();
+        }
+    }
+}
+
+void KmlReader::updateFolderPath()
+{
+    QStringList folders;
+    for (const Container& container : m_containers) {
+        if (container.folder && !container.name.isEmpty()) {
+            folders.append(container.name);
+        }
+    }
+    m_folderPath = folders.join('/');
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "FeatureStore.h"
+#include "GeometryBuffer.h"
+#include <QString>
+#include <QVariantMap>
+#include <QVector>
+#include <QXmlStreamReader>
+
+class QIODevice;
+
+// Streams the Placemarks of a KML document into a FeatureStore with a pull
+// parser, so no DOM is built and memory stays proportional to the store.
+// Point, LineString, LinearRing, Polygon and MultiGeometry are read, nested
+// MultiGeometries flattened into their simple parts; the extent of all
+// coordinates is tracked while parsing. Placemark name, description,
+// styleUrl, time primitives and ExtendedData become columns.
+class KmlReader
+{
+public:
+    explicit KmlReader(QIODevice* device);
+    
+    bool read(FeatureStore& store, const IngestProgress& progress = IngestProgress());
+    
+    // Extent of the coordinates read, empty if there were none
+    QVariantMap boundingBox() const;
+    
+    bool wasCancelled() const { return m_cancelled; }
+    QString errorString() const { return m_error; }
+
+private:
+    struct Container {
+        bool folder;
+        QString name;
+    };
+    
+    void readPlacemark(FeatureStore& store);
+    FeatureStore::GeometryType readGeometry(FeatureStore& store);
+    void readBoundary();
+    void readCoordinates();
+    void readExtendedData(FeatureStore& store);
+    void readTime(FeatureStore& store);
+    void updateFolderPath();
+    
+    QXmlStreamReader m_xml;
+    GeometryBuffer m_geometry;
+    QVector<Container> m_containers;
+    QString m_folderPath;
+    double m_minX;
+    double m_minY;
+    double m_maxX;
+    double m_maxY;
+    bool m_cancelled;
+    QString m_error;
+};
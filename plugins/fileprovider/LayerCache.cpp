@@ -0,0 +1,210 @@
+#include "LayerCache.h"
+#include "MappedFile.h"
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QSysInfo>
+#include <QDebug>
+#include <cstring>
+
+namespace {
+
+// Bumped whenever the snapshot layout or the parsers' output changes
+const quint32 FormatVersion = 2;
+const char Magic[8] = {'G', 'W', 'L', 'A', 'Y', 'E', 'R', '\0'};
+
+const qint64 DefaultMaxSize = qint64(2) * 1024 * 1024 * 1024;
+
+// Files up to this size are hashed whole; larger ones are sampled
+const qint64 FullHashLimit = 4 * 1024 * 1024;
+const qint64 EdgeBlockSize = 1024 * 1024;
+const qint64 SampleBlockSize = 64 * 1024;
+const int SampleBlocks = 32;
+
+struct Header {
+    char magic[8];
+    quint32 version;
+    quint32 byteOrder;
+    qint64 sourceSize;
+    qint64 sourceModified;
+    char fingerprint[16];
+    quint64 layerSize;
+};
+
+} // namespace
+
+LayerCache::LayerCache(const QString& directory)
+    : m_directory(directory)
+    , m_maxSize(DefaultMaxSize)
+{
+}
+
+QString LayerCache::defaultDirectory()
+{
+    QString directory = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+    return directory.isEmpty() ? QString() : directory + "/layers";
+}
+
+QString LayerCache::entryPath(const QString& filePath, const QString& variant) const
+{
+    QByteArray key = (QFileInfo(filePath).absoluteFilePath() + '\n' + variant).toUtf8();
+    return m_directory + "/" + QString::fromLatin1(QCryptographicHash::hash(key, QCryptographicHash::Sha1).toHex()) + ".gwl";
+}
+
+// Hashing multi-gigabyte sources on every import would cost as much as
+// parsing them, so beyond FullHashLimit only the first and last megabyte and
+// evenly spaced blocks in between are hashed. Together with the size and
+// modification time this catches rewrites and in-place edits of the sampled
+// ranges.
+QByteArray LayerCache::fingerprint(QFile& file)
+{
+    QCryptographicHash hash(QCryptographicHash::Md5);
+    qint64 size = file.size();
+    
+    auto addBlock = [&](qint64 offset, qint64 length) {
+        if (!file.seek(offset)) {
+            return false;
+        }
+        QByteArray block = file.read(length);
+        hash.addData(block);
+        return block.size() == length;
+    };
+    
+    bool complete = true;
+    if (size <= FullHashLimit) {
+        complete = addBlock(0, size);
+    } else {
+        complete = addBlock(0, EdgeBlockSize) && addBlock(size - EdgeBlockSize, EdgeBlockSize);
+        qint64 step = (size - 2 * EdgeBlockSize - SampleBlockSize) / SampleBlocks;
+        for (int i = 0; complete && i < SampleBlocks; ++i) {
+            complete = addBlock(EdgeBlockSize + i * step, SampleBlockSize);
+        }
+    }
+    return complete ? hash.result() : QByteArray();
+}
+
+bool LayerCache::load(const QString& filePath, const QString& variant, FeatureStore& store, QVariantMap& layer)
+{
+    if (!isEnabled()) {
+        return false;
+    }
+    
+    QString cachePath = entryPath(filePath, variant);
+    MappedFile entry;
+    if (!QFile::exists(cachePath) || !entry.open(cachePath)) {
+        return false;
+    }
+    
+    Header header;
+    QFile source(filePath);
+    bool valid = entry.size() >= qsizetype(sizeof(header)) && source.open(QIODevice::ReadOnly);
+    if (valid) {
+        std::memcpy(&header, entry.data(), sizeof(header));
+        QFileInfo sourceInfo(filePath);
+        valid = std::memcmp(header.magic, Magic, sizeof(Magic)) == 0
+            && header.version == FormatVersion
+            && header.byteOrder == quint32(QSysInfo::ByteOrder)
+            && header.sourceSize == sourceInfo.size()
+            && header.sourceModified == sourceInfo.lastModified().toMSecsSinceEpoch()
+            && header.layerSize <= quint64(entry.size()) - sizeof(header);
+    }
+    if (valid) {
+        QByteArray expected = fingerprint(source);
+        valid = expected.size() == sizeof(header.fingerprint)
+            && std::memcmp(header.fingerprint, expected.constData(), sizeof(header.fingerprint)) == 0;
+    }
+    
+    if (valid) {
+        const char* data = entry.data() + sizeof(header);
+        QDataStream stream(QByteArray::fromRawData(data, qsizetype(header.layerSize)));
+        stream >> layer;
+        // The store starts at the next 8-byte boundary of the mapping
+        qsizetype offset = qsizetype(sizeof(header) + header.layerSize + 7) & ~qsizetype(7);
+        valid = stream.status() == QDataStream::Ok
+            && offset <= entry.size()
+            && store.readBinary(entry.data() + offset, entry.size() - offset);
+    }
+    
+    // The store copies its arrays out, so the mapping only spares reading
+    // the entry into a buffer; closing it lets eviction remove the file
+    entry.close();
+    if (!valid) {
+        qDebug() << "Discarding stale layer cache entry for" << filePath;
+        QFile::remove(cachePath);
+        layer.clear();
+        return false;
+    }
+    
+    // Reads count as use for eviction
+    QFile touched(cachePath);
+    if (touched.open(QIODevice::ReadOnly)) {
+        touched.setFileTime(QDateTime::currentDateTime(), QFileDevice::FileModificationTime);
+    }
+    return true;
+}
+
+bool LayerCache::save(const QString& filePath, const QString& variant, const FeatureStore& store, const QVariantMap& layer)
+{
+    if (!isEnabled() || !QDir().mkpath(m_directory)) {
+        return false;
+    }
+    
+    QFile source(filePath);
+    if (!source.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    QByteArray sourceFingerprint = fingerprint(source);
+    QFileInfo sourceInfo(filePath);
+    
+    QByteArray layerData;
+    QDataStream stream(&layerData, QIODevice::WriteOnly);
+    stream << layer;
+    
+    Header header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, Magic, sizeof(Magic));
+    header.version = FormatVersion;
+    header.byteOrder = quint32(QSysInfo::ByteOrder);
+    header.sourceSize = sourceInfo.size();
+    header.sourceModified = sourceInfo.lastModified().toMSecsSinceEpoch();
+    if (sourceFingerprint.size() != sizeof(header.fingerprint)) {
+        return false;
+    }
+    std::memcpy(header.fingerprint, sourceFingerprint.constData(), sizeof(header.fingerprint));
+    header.layerSize = layerData.size();
+    
+    QSaveFile file(entryPath(filePath, variant));
+    qint64 padding = (8 - (qint64(sizeof(header)) + layerData.size()) % 8) % 8;
+    if (!file.open(QIODevice::WriteOnly)
+        || file.write(reinterpret_cast<const char*>(&header), sizeof(header)) != qint64(sizeof(header))
+        || file.write(layerData) != layerData.size()
+        || file.write(QByteArray(padding, '\0')) != padding
+        || !store.writeBinary(&file)
+        || !file.commit()) {
+        qWarning() << "Cannot write layer cache for" << filePath << "Error:" << file.errorString();
+        return false;
+    }
+    
+    evict();
+    return true;
+}
+
+void LayerCache::evict()
+{
+    QDir directory(m_directory);
+    QFileInfoList entries = directory.entryInfoList({"*.gwl"}, QDir::Files, QDir::Time);
+    
+    // Newest first, so everything past the cap is the least recently used
+    qint64 total = 0;
+    for (const QFileInfo& entry : entries) {
+        total += entry.size();
+        if (total > m_maxSize) {
+            QFile::remove(entry.absoluteFilePath());
+        }
+    }
+}
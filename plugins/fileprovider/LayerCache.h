@@ -0,0 +1,45 @@
+#pragma once
+
+#include "FeatureStore.h"
+#include <QByteArray>
+#include <QString>
+#include <QVariantMap>
+
+class QFile;
+
+// Persistent binary snapshots of parsed layers, one file per source path
+// and parse variant (the options that change what a parse produces). An
+// entry is only used while the source keeps the size, modification time and
+// content fingerprint it had when the entry was written; snapshots are read
+// back from a mapping, so loading an unchanged file costs little more than
+// reading the snapshot. Entries beyond the size cap are evicted least
+// recently used first.
+class LayerCache
+{
+public:
+    explicit LayerCache(const QString& directory = defaultDirectory());
+    
+    void setMaxSize(qint64 bytes) { m_maxSize = bytes; }
+    qint64 maxSize() const { return m_maxSize; }
+    bool isEnabled() const { return !m_directory.isEmpty(); }
+    
+    // Fills store and the layer map saved with it from the entry of
+    // filePath. Stale or unreadable entries are removed.
+    bool load(const QString& filePath, const QString& variant, FeatureStore& store, QVariantMap& layer);
+    bool save(const QString& filePath, const QString& variant, const FeatureStore& store, const QVariantMap& layer);
+    
+    // Removes the least recently used entries until the cache fits its cap
+    void evict();
+    
+    static QString defaultDirectory();
+    
+    // MD5 of the file's content, sampled for large files; empty when the
+    // file cannot be read
+    static QByteArray fingerprint(QFile& file);
+
+private:
+    QString entryPath(const QString& filePath, const QString& variant) const;
+    
+    QString m_directory;
+    qint64 m_maxSize;
+};
@@ -0,0 +1,349 @@
+#include "LayerSchema.h"
+#include <QFuture>
+#include <QHash>
+#include <QThread>
+#include <QThreadPool>
+#include <QVariantMap>
+#include <QtConcurrentRun>
+#include <atomic>
+#include <cmath>
+
+namespace {
+
+// Stores with fewer cells are described faster than threads start
+const qsizetype ParallelCells = 1 << 20;
+const int ChunksPerThread = 4;
+// String columns with more distinct values are not categorical
+const qsizetype MaxCategories = 64;
+
+enum IsoKind {
+    NotIso,
+    IsoDate,
+    IsoTimestamp
+};
+
+struct ColumnStats {
+    qsizetype nullCount = 0;
+    bool hasValue = false;
+    qint64 minInt = 0;
+    qint64 maxInt = 0;
+    double minDouble = 0.0;
+    double maxDouble = 0.0;
+    QString minString;
+    QString maxString;
+    // String refinements, kept until a value rules them out
+    bool dates = true;
+    bool timestamps = true;
+    QHash<QString, qsizetype> categories;
+    bool manyValues = false;
+};
+
+bool digitsAt(QStringView text, qsizetype pos, qsizetype count, int& value)
+{
+    value = 0;
+    for (qsizetype i = pos; i < pos + count; ++i) {
+        char16_t c = text[i].unicode();
+        if (c < '0' || c > '9') {
+            return false;
+        }
+        value = value * 10 + (c - '0');
+    }
+    return true;
+}
+
+// Matches YYYY-MM-DD, optionally followed by T or a space, hh:mm, optional
+// seconds and fraction, and a Z or numeric UTC offset
+IsoKind isoKind(QStringView text)
+{
+    qsizetype size = text.size();
+    int year = 0;
+    int month = 0;
+    int day = 0;
+    if (size < 10 || !digitsAt(text, 0, 4, year) || text[4] != QChar('-') || !digitsAt(text, 5, 2, month)
+        || text[7] != QChar('-') || !digitsAt(text, 8, 2, day)) {
+        return NotIso;
+    }
+    if (month < 1 || month > 12 || day < 1 || day > 31) {
+        return NotIso;
+    }
+    if (size == 10) {
+        return IsoDate;
+    }
+    
+    int hour = 0;
+    int minute = 0;
+    if (size < 16 || (text[10] != QChar('T') && text[10] != QChar(' ')) || !digitsAt(text, 11, 2, hour)
+        || text[13] != QChar(':') || !digitsAt(text, 14, 2, minute) || hour > 24 || minute > 59) {
+        return NotIso;
+    }
+    qsizetype pos = 16;
+    int second = 0;
+    if (pos < size && text[pos] == QChar(':')) {
+        if (pos + 3 > size || !digitsAt(text, pos + 1, 2, second) || second > 60) {
+            return NotIso;
+        }
+        pos += 3;
+        if (pos < size && (text[pos] == QChar('.') || text[pos] == QChar(','))) {
+            qsizetype fraction = ++pos;
+            while (pos < size && text[pos].unicode() >= '0' && text[pos].unicode() <= '9') {
+                ++pos;
+            }
+            if (pos == fraction) {
+                return NotIso;
+            }
+        }
+    }
+    
+    if (pos == size || (text[pos] == QChar('Z') && pos + 1 == size)) {
+        return IsoTimestamp;
+    }
+    int offset = 0;
+    if (text[pos] != QChar('+') && text[pos] != QChar('-')) {
+        return NotIso;
+    }
+    qsizetype rest = size - pos - 1;
+    bool valid = (rest == 2 && digitsAt(text, pos + 1, 2, offset))
+        || (rest == 4 && digitsAt(text, pos + 1, 4, offset))
+        || (rest == 5 && text[pos + 3] == QChar(':') && digitsAt(text, pos + 1, 2, offset) && digitsAt(text, pos + 4, 2, offset));
+    return valid ? IsoTimestamp : NotIso;
+}
+
+void addString(ColumnStats& stats, QStringView value, qsizetype count = 1)
+{
+    if (!stats.hasValue || value < QStringView(stats.minString)) {
+        stats.minString = value.toString();
+    }
+    if (!stats.hasValue || QStringView(stats.maxString) < value) {
+        stats.maxString = value.toString();
+    }
+    if (stats.dates || stats.timestamps) {
+        IsoKind kind = isoKind(value);
+        stats.dates = stats.dates && kind == IsoDate;
+        stats.timestamps = stats.timestamps && kind != NotIso;
+    }
+    if (!stats.manyValues) {
+        stats.categories[value.toString()] += count;
+        stats.manyValues = stats.categories.size() > MaxCategories;
+        if (stats.manyValues) {
+            stats.categories.clear();
+        }
+    }
+}
+
+ColumnStats describeRows(const PropertyColumn& column, qsizetype first, qsizetype last)
+{
+    ColumnStats stats;
+    if (column.isDictionaryEncoded()) {
+        // Rows are counted per code and each distinct string looked at once
+        QVector<qsizetype> counts(column.dictionary().size(), 0);
+        for (qsizetype row = first; row < last; ++row) {
+            if (column.isNull(row)) {
+                ++stats.nullCount;
+            } else {
+                ++counts[column.codeAt(row)];
+            }
+        }
+        for (qsizetype code = 0; code < counts.size(); ++code) {
+            if (counts[code] > 0) {
+                addString(stats, column.dictionary()[code], counts[code]);
+                stats.hasValue = true;
+            }
+        }
+        return stats;
+    }
+    
+    for (qsizetype row = first; row < last; ++row) {
+        if (column.isNull(row)) {
+            ++stats.nullCount;
+            continue;
+        }
+        switch (column.type()) {
+        case PropertyColumn::Bool:
+        case PropertyColumn::Int: {
+            qint64 value = column.intAt(row);
+            if (!stats.hasValue || value < stats.minInt) {
+                stats.minInt = value;
+            }
+            if (!stats.hasValue || value > stats.maxInt) {
+                stats.maxInt = value;
+            }
+            break;
+        }
+        case PropertyColumn::Double: {
+            double value = column.doubleAt(row);
+            if (std::isnan(value)) {
+                continue;
+            }
+            if (!stats.hasValue || value < stats.minDouble) {
+                stats.minDouble = value;
+            }
+            if (!stats.hasValue || value > stats.maxDouble) {
+                stats.maxDouble = value;
+            }
+            break;
+        }
+        case PropertyColumn::String:
+            addString(stats, column.stringAt(row));
+            break;
+        default:
+            break;
+        }
+        stats.hasValue = true;
+    }
+    return stats;
+}
+
+// Folds the statistics of a later row range into those of an earlier one
+void merge(ColumnStats& stats, const ColumnStats& other)
+{
+    stats.nullCount += other.nullCount;
+    if (!other.hasValue) {
+        return;
+    }
+    if (!stats.hasValue) {
+        qsizetype nullCount = stats.nullCount;
+        stats = other;
+        stats.nullCount = nullCount;
+        return;
+    }
+    
+    stats.minInt = qMin(stats.minInt, other.minInt);
+    stats.maxInt = qMax(stats.maxInt, other.maxInt);
+    stats.minDouble = qMin(stats.minDouble, other.minDouble);
+    stats.maxDouble = qMax(stats.maxDouble, other.maxDouble);
+    if (other.minString < stats.minString) {
+        stats.minString = other.minString;
+    }
+    if (stats.maxString < other.maxString) {
+        stats.maxString = other.maxString;
+    }
+    stats.dates = stats.dates && other.dates;
+    stats.timestamps = stats.timestamps && other.timestamps;
+    stats.manyValues = stats.manyValues || other.manyValues;
+    if (!stats.manyValues) {
+        for (auto it = other.categories.constBegin(); it != other.categories.constEnd(); ++it) {
+            stats.categories[it.key()] += it.value();
+        }
+        stats.manyValues = stats.categories.size() > MaxCategories;
+    }
+    if (stats.manyValues) {
+        stats.categories.clear();
+    }
+}
+
+QVector<ColumnStats> describeRange(const FeatureStore& store, qsizetype first, qsizetype last)
+{
+    QVector<ColumnStats> stats;
+    stats.reserve(store.columns().size());
+    for (const PropertyColumn& column : store.columns()) {
+        stats.append(describeRows(column, first, last));
+    }
+    return stats;
+}
+
+QVariantMap fieldSchema(const PropertyColumn& column, const ColumnStats& stats, qsizetype rows)
+{
+    QVariantMap field;
+    field["name"] = column.name();
+    field["nullable"] = stats.nullCount > 0;
+    field["nullCount"] = qint64(stats.nullCount);
+    
+    QString type = PropertyColumn::typeName(column.type());
+    switch (column.type()) {
+    case PropertyColumn::Bool:
+        if (stats.hasValue) {
+            field["min"] = stats.minInt != 0;
+            field["max"] = stats.maxInt != 0;
+        }
+        break;
+    case PropertyColumn::Int:
+        if (stats.hasValue) {
+            field["min"] = qint64(stats.minInt);
+            field["max"] = qint64(stats.maxInt);
+        }
+        break;
+    case PropertyColumn::Double:
+        if (stats.hasValue) {
+            field["min"] = stats.minDouble;
+            field["max"] = stats.maxDouble;
+        }
+        break;
+    case PropertyColumn::String: {
+        if (!stats.hasValue) {
+            break;
+        }
+        field["min"] = stats.minString;
+        field["max"] = stats.maxString;
+        qsizetype values = rows - stats.nullCount;
+        if (stats.dates) {
+            type = "date";
+        } else if (stats.timestamps) {
+            type = "timestamp";
+        } else if (!stats.manyValues && values >= 2 * stats.categories.size()) {
+            // Worth a lookup table only when values repeat
+            type = "categorical";
+            QVariantMap categories;
+            for (auto it = stats.categories.constBegin(); it != stats.categories.constEnd(); ++it) {
+                categories[it.key()] = qint64(it.value());
+            }
+            field["categories"] = categories;
+        }
+        break;
+    }
+    default:
+        break;
+    }
+    field["type"] = type;
+    return field;
+}
+
+} // namespace
+
+QVariantList LayerSchema::infer(const FeatureStore& store, int threads, QThreadPool* pool)
+{
+    qsizetype rows = store.featureCount();
+    if (threads <= 0) {
+        threads = QThread::idealThreadCount();
+    }
+    
+    QVector<ColumnStats> stats;
+    if (threads < 2 || rows * store.columns().size() < ParallelCells) {
+        stats = describeRange(store, 0, rows);
+    } else {
+        // Each range is described on its own and the results merged in
+        // order. The calling thread and threads - 1 pool tasks take ranges
+        // in turn until none are left, so a busy pool only slows this down.
+        if (!pool) {
+            pool = QThreadPool::globalInstance();
+        }
+        qsizetype chunkCount = qMin<qsizetype>(rows, threads * ChunksPerThread);
+        QVector<QVector<ColumnStats>> ranges(chunkCount);
+        std::atomic<qsizetype> nextChunk(0);
+        auto describeChunks = [&store, &ranges, &nextChunk, rows, chunkCount]() {
+            for (qsizetype chunk = nextChunk++; chunk < chunkCount; chunk = nextChunk++) {
+                ranges[chunk] = describeRange(store, rows * chunk / chunkCount, rows * (chunk + 1) / chunkCount);
+            }
+        };
+        QVector<QFuture<void>> futures;
+        futures.reserve(threads - 1);
+        for (int worker = 1; worker < threads; ++worker) {
+            futures.append(QtConcurrent::run(pool, describeChunks));
+        }
+        describeChunks();
+        for (QFuture<void>& future : futures) {
+            future.waitForFinished();
+        }
+        stats = ranges[0];
+        for (qsizetype chunk = 1; chunk < chunkCount; ++chunk) {
+            for (qsizetype column = 0; column < stats.size(); ++column) {
+                merge(stats[column], ranges[chunk][column]);
+            }
+        }
+    }
+    
+    QVariantList schema;
+    for (qsizetype column = 0; column < stats.size(); ++column) {
+        schema.append(fieldSchema(store.columns()[column], stats[column], rows));
+    }
+    return schema;
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include "FeatureStore.h"
+#include <QVariantList>
+
+class QThreadPool;
+
+// Schema of the property columns of a FeatureStore, from a pass over every
+// row. Each field is described by a map with its name, type, nullability
+// and null count, and the minimum and maximum of its values. Integer,
+// double and boolean types come from the column; string columns are
+// refined to "date" or "timestamp" when every value is ISO 8601, and to
+// "categorical" when they hold few distinct values, which are then listed
+// under "categories". Rows are split across threads for large stores, the
+// calling one and others from a shared pool.
+class LayerSchema
+{
+public:
+    // 0 threads picks QThread::idealThreadCount(); pool is the global pool
+    // unless given
+    static QVariantList infer(const FeatureStore& store, int threads = 0, QThreadPool* pool = nullptr);
+};
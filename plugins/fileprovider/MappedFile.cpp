@@ -0,0 +1,51 @@
+#include "MappedFile.h"
+
+MappedFile::MappedFile()
+    : m_map(nullptr)
+    , m_data(nullptr)
+    , m_size(0)
+{
+}
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+bool MappedFile::open(const QString& filePath)
+{
+    close();
+    
+    m_file.setFileName(filePath);
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    
+    qint64 size = m_file.size();
+    if (size > 0) {
+        m_map = m_file.map(0, size);
+    }
+    
+    if (m_map) {
+        m_data = reinterpret_cast<const char*>(m_map);
+        m_size = size;
+    } else {
+        // Empty files, pipes and file systems without mmap support
+        m_buffer = m_file.readAll();
+        m_data = m_buffer.constData();
+        m_size = m_buffer.size();
+    }
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (m_map) {
+        m_file.unmap(m_map);
+        m_map = nullptr;
+    }
+    m_file.close();
+    m_buffer.clear();
+    m_data = nullptr;
+    m_size = 0;
+}
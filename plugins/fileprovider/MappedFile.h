@@ -0,0 +1,32 @@
+#pragma once
+
+#include <QByteArray>
+#include <QFile>
+#include <QString>
+
+// Read-only view of a whole file. Regular files are memory mapped so
+// readers parse straight from the page cache without copying; anything
+// that cannot be mapped is read into memory once instead.
+class MappedFile
+{
+public:
+    MappedFile();
+    ~MappedFile();
+    
+    bool open(const QString& filePath);
+    void close();
+    
+    const char* data() const { return m_data; }
+    qsizetype size() const { return m_size; }
+    bool isMapped() const { return m_map != nullptr; }
+    QString errorString() const { return m_file.errorString(); }
+
+private:
+    Q_DISABLE_COPY(MappedFile)
+    
+    QFile m_file;
+    uchar* m_map;
+    QByteArray m_buffer;
+    const char* m_data;
+    qsizetype m_size;
+};
@@ -0,0 +1,220 @@
+#include "PackedRTree.h"
+#include <QMap>
+#include <QtEndian>
+#include <cmath>
+
+namespace {
+
+// Hilbert coordinates are 16 bits per axis
+const quint32 HilbertMax = (1u << 16) - 1;
+
+PackedRTree::Node readNode(const char* data)
+{
+    PackedRTree::Node node;
+    node.minX = qFromLittleEndian<double>(data);
+    node.minY = qFromLittleEndian<double>(data + 8);
+    node.maxX = qFromLittleEndian<double>(data + 16);
+    node.maxY = qFromLittleEndian<double>(data + 24);
+    node.offset = qFromLittleEndian<quint64>(data + 32);
+    return node;
+}
+
+void writeNode(char* data, const PackedRTree::Node& node)
+{
+    qToLittleEndian(node.minX, data);
+    qToLittleEndian(node.minY, data + 8);
+    qToLittleEndian(node.maxX, data + 16);
+    qToLittleEndian(node.maxY, data + 24);
+    qToLittleEndian(node.offset, data + 32);
+}
+
+} // namespace
+
+void PackedRTree::Node::expand(const Node& other)
+{
+    minX = qMin(minX, other.minX);
+    minY = qMin(minY, other.minY);
+    maxX = qMax(maxX, other.maxX);
+    maxY = qMax(maxY, other.maxY);
+}
+
+void PackedRTree::Node::expand(double x, double y)
+{
+    minX = qMin(minX, x);
+    minY = qMin(minY, y);
+    maxX = qMax(maxX, x);
+    maxY = qMax(maxY, y);
+}
+
+bool PackedRTree::Node::intersects(const Node& other) const
+{
+    return !(maxX < other.minX || maxY < other.minY || minX > other.maxX || minY > other.maxY);
+}
+
+// Start and end node of every level, leaves first. A tree always has a
+// root above its leaves, even over a single item.
+QVector<QPair<quint64, quint64>> PackedRTree::levelBounds(quint64 itemCount, quint16 nodeSize)
+{
+    QVector<quint64> levelNodes{itemCount};
+    quint64 nodes = itemCount;
+    quint64 count = itemCount;
+    do {
+        count = (count + nodeSize - 1) / nodeSize;
+        nodes += count;
+        levelNodes.append(count);
+    } while (count != 1);
+    
+    QVector<QPair<quint64, quint64>> bounds;
+    for (quint64 size : levelNodes) {
+        nodes -= size;
+        bounds.append(qMakePair(nodes, nodes + size));
+    }
+    return bounds;
+}
+
+quint64 PackedRTree::nodeCount(quint64 itemCount, quint16 nodeSize)
+{
+    if (itemCount == 0 || nodeSize < 2) {
+        return 0;
+    }
+    return levelBounds(itemCount, nodeSize).first().second;
+}
+
+QByteArray PackedRTree::build(const QVector<Node>& leaves, quint16 nodeSize)
+{
+    if (leaves.isEmpty() || nodeSize < 2) {
+        return QByteArray();
+    }
+    
+    QVector<QPair<quint64, quint64>> bounds = levelBounds(leaves.size(), nodeSize);
+    QVector<Node> nodes(qsizetype(bounds.first().second));
+    std::copy(leaves.begin(), leaves.end(), nodes.begin() + bounds.first().first);
+    
+    // Each parent covers the next nodeSize nodes of the level below
+    for (qsizetype level = 0; level + 1 < bounds.size(); ++level) {
+        quint64 pos = bounds[level].first;
+        quint64 end = bounds[level].second;
+        quint64 parent = bounds[level + 1].first;
+        while (pos < end) {
+            Node node;
+            node.offset = pos;
+            for (quint16 child = 0; child < nodeSize && pos < end; ++child) {
+                node.expand(nodes[pos++]);
+            }
+            nodes[parent++] = node;
+        }
+    }
+    
+    QByteArray index(nodes.size() * NodeBytes, Qt::Uninitialized);
+    for (qsizetype i = 0; i < nodes.size(); ++i) {
+        writeNode(index.data() + i * NodeBytes, nodes[i]);
+    }
+    return index;
+}
+
+QVector<quint64> PackedRTree::search(const char* index, quint64 itemCount, quint16 nodeSize, const Node& box)
+{
+    QVector<quint64> results;
+    if (itemCount == 0 || nodeSize < 2) {
+        return results;
+    }
+    
+    QVector<QPair<quint64, quint64>> bounds = levelBounds(itemCount, nodeSize);
+    quint64 firstLeaf = bounds.first().first;
+    
+    // Visited in node order, so leaves and their offsets come out ascending
+    QMap<quint64, qsizetype> queue;
+    queue.insert(0, bounds.size() - 1);
+    while (!queue.isEmpty()) {
+        quint64 nodeIndex = queue.firstKey();
+        qsizetype level = queue.take(nodeIndex);
+        quint64 end = qMin<quint64>(nodeIndex + nodeSize, bounds[level].second);
+        bool leaf = nodeIndex >= firstLeaf;
+        
+        for (quint64 pos = nodeIndex; pos < end; ++pos) {
+            Node node = readNode(index + pos * NodeBytes);
+            if (!box.intersects(node)) {
+                continue;
+            }
+            if (leaf) {
+                results.append(node.offset);
+            } else if (level > 0 && node.offset < bounds[level - 1].second) {
+                queue.insert(node.offset, level - 1);
+            }
+        }
+    }
+    return results;
+}
+
+quint32 PackedRTree::hilbertValue(const Node& node, const Node& extent)
+{
+    double width = extent.maxX - extent.minX;
+    double height = extent.maxY - extent.minY;
+    quint32 x = 0;
+    quint32 y = 0;
+    if (!node.isEmpty() && width > 0) {
+        x = quint32(std::floor(HilbertMax * ((node.minX + node.maxX) / 2 - extent.minX) / width));
+    }
+    if (!node.isEmpty() && height > 0) {
+        y = quint32(std::floor(HilbertMax * ((node.minY + node.maxY) / 2 - extent.minY) / height));
+    }
+    return hilbert(x, y);
+}
+
+// Fast Hilbert curve index of a 16-bit coordinate pair, after
+// http://threadlocalmutex.com/?p=126
+quint32 PackedRTree::hilbert(quint32 x, quint32 y)
+{
+    quint32 a = x ^ y;
+    quint32 b = 0xFFFF ^ a;
+    quint32 c = 0xFFFF ^ (x | y);
+    quint32 d = x & (y ^ 0xFFFF);
+    
+    quint32 A = a | (b >> 1);
+    quint32 B = (a >> 1) ^ a;
+    quint32 C = ((c >> 1) ^ (b & (d >> 1))) ^ c;
+    quint32 D = ((a & (c >> 1)) ^ (d >> 1)) ^ d;
+    
+    a = A;
+    b = B;
+    c = C;
+    d = D;
+    A = (a & (a >> 2)) ^ (b & (b >> 2));
+    B = (a & (b >> 2)) ^ (b & ((a ^ b) >> 2));
+    C ^= (a & (c >> 2)) ^ (b & (d >> 2));
+    D ^= (b & (c >> 2)) ^ ((a ^ b) & (d >> 2));
+    
+    a = A;
+    b = B;
+    c = C;
+    d = D;
+    A = (a & (a >> 4)) ^ (b & (b >> 4));
+    B = (a & (b >> 4)) ^ (b & ((a ^ b) >> 4));
+    C ^= (a & (c >> 4)) ^ (b & (d >> 4));
+    D ^= (b & (c >> 4)) ^ ((a ^ b) & (d >> 4));
+    
+    a = A;
+    b = B;
+    c = C;
+    d = D;
+    C ^= (a & (c >> 8)) ^ (b & (d >> 8));
+    D ^= (b & (c >> 8)) ^ ((a ^ b) & (d >> 8));
+    
+    a = C ^ (C >> 1);
+    b = D ^ (D >> 1);
+    
+    quint32 i0 = x ^ y;
+    quint32 i1 = b | (0xFFFF ^ (i0 | a));
+    
+    i0 = (i0 | (i0 << 8)) & 0x00FF00FF;
+    i0 = (i0 | (i0 << 4)) & 0x0F0F0F0F;
+    i0 = (i0 | (i0 << 2)) & 0x33333333;
+    i0 = (i0 | (i0 << 1)) & 0x55555555;
+    
+    i1 = (i1 | (i1 << 8)) & 0x00FF00FF;
+    i1 = (i1 | (i1 << 4)) & 0x0F0F0F0F;
+    i1 = (i1 | (i1 << 2)) & 0x33333333;
+    i1 = (i1 | (i1 << 1)) & 0x55555555;
+    
+    return (i1 << 1) | i0;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <QByteArray>
+#include <QPair>
+#include <QVector>
+#include <limits>
+
+// Static packed Hilbert R-tree as stored in FlatGeobuf files. Nodes are laid
+// out level by level from the root down, each node holding up to nodeSize
+// children; leaves carry the byte offset of their feature and inner nodes
+// the index of their first child. The tree is built bottom-up over items
+// already sorted along the Hilbert curve and searched in place.
+class PackedRTree
+{
+public:
+    static const quint16 DefaultNodeSize = 16;
+    
+    struct Node {
+        double minX = std::numeric_limits<double>::infinity();
+        double minY = std::numeric_limits<double>::infinity();
+        double maxX = -std::numeric_limits<double>::infinity();
+        double maxY = -std::numeric_limits<double>::infinity();
+        quint64 offset = 0;
+        
+        bool isEmpty() const { return minX > maxX; }
+        void expand(const Node& other);
+        void expand(double x, double y);
+        bool intersects(const Node& other) const;
+    };
+    // Size of a node on disk: four doubles and the offset
+    static const qint64 NodeBytes = 40;
+    
+    // Number of nodes and size in bytes of the index over itemCount items
+    static quint64 nodeCount(quint64 itemCount, quint16 nodeSize);
+    static quint64 indexSize(quint64 itemCount, quint16 nodeSize) { return nodeCount(itemCount, nodeSize) * NodeBytes; }
+    
+    // Builds the whole tree, root first, over leaves in Hilbert order and
+    // writes it in the on-disk little-endian layout
+    static QByteArray build(const QVector<Node>& leaves, quint16 nodeSize);
+    
+    // Offsets of the leaves intersecting box, in ascending order. index
+    // holds indexSize(itemCount, nodeSize) bytes.
+    static QVector<quint64> search(const char* index, quint64 itemCount, quint16 nodeSize, const Node& box);
+    
+    // Position of the centre of node along a Hilbert curve over extent
+    static quint32 hilbertValue(const Node& node, const Node& extent);
+
+private:
+    static QVector<QPair<quint64, quint64>> levelBounds(quint64 itemCount, quint16 nodeSize);
+    static quint32 hilbert(quint32 x, quint32 y);
+};
@@ -0,0 +1,182 @@
+#include "PageCache.h"
+#include <QFuture>
+#include <QThread>
+#include <QtConcurrentRun>
+#include <atomic>
+
+namespace {
+
+// Background readers; reads ahead are bound by the disk, not the cores
+const int ReadAheadThreads = 2;
+
+qint64 pageBytes(const PagedLayerFile::Page& page)
+{
+    return page.features.memoryUsage().bytes + page.bounds.capacity() * qint64(sizeof(PackedRTree::Node));
+}
+
+} // namespace
+
+PageCache::PageCache(const PagedLayerFile& file, qint64 maxBytes)
+    : m_file(file)
+    , m_maxBytes(maxBytes)
+    , m_useCount(0)
+    , m_residentBytes(0)
+    , m_hits(0)
+    , m_misses(0)
+{
+    m_readAhead.setMaxThreadCount(ReadAheadThreads);
+}
+
+PageCache::~PageCache()
+{
+    m_readAhead.clear();
+    m_readAhead.waitForDone();
+}
+
+PageCache::PagePointer PageCache::page(qsizetype index)
+{
+    return load(index, true);
+}
+
+QVector<PageCache::PagePointer> PageCache::pages(const QVector<qsizetype>& indexes, QThreadPool* pool)
+{
+    QVector<PagePointer> result(indexes.size());
+    QVector<qsizetype> missing;
+    {
+        QMutexLocker locker(&m_mutex);
+        for (qsizetype i = 0; i < indexes.size(); ++i) {
+            auto it = m_entries.find(indexes[i]);
+            if (it != m_entries.end()) {
+                it->lastUse = ++m_useCount;
+                result[i] = it->page;
+                ++m_hits;
+            } else {
+                missing.append(i);
+            }
+        }
+    }
+    if (missing.size() < 2) {
+        for (qsizetype i : missing) {
+            result[i] = load(indexes[i], true);
+        }
+        return result;
+    }
+    if (!pool) {
+        pool = QThreadPool::globalInstance();
+    }
+    
+    // The calling thread and pool tasks take missing pages in turn until
+    // none are left, so a busy pool only slows the query down
+    std::atomic<qsizetype> next(0);
+    auto loadMissing = [this, &indexes, &result, &missing, &next]() {
+        for (qsizetype i = next++; i < missing.size(); i = next++) {
+            result[missing[i]] = load(indexes[missing[i]], true);
+        }
+    };
+    qsizetype threads = qMin<qsizetype>(QThread::idealThreadCount(), missing.size());
+    QVector<QFuture<void>> futures;
+    futures.reserve(threads - 1);
+    for (qsizetype worker = 1; worker < threads; ++worker) {
+        futures.append(QtConcurrent::run(pool, loadMissing));
+    }
+    loadMissing();
+    for (QFuture<void>& future : futures) {
+        future.waitForFinished();
+    }
+    return result;
+}
+
+void PageCache::readAhead(const QVector<qsizetype>& indexes)
+{
+    QMutexLocker locker(&m_mutex);
+    qint64 budget = m_maxBytes / 4;
+    for (qsizetype index : indexes) {
+        if (m_entries.contains(index) || m_loading.contains(index)) {
+            continue;
+        }
+        // Sizes in the file stand in for the decoded sizes
+        budget -= m_file.pageSize(index);
+        if (budget < 0) {
+            break;
+        }
+        m_readAhead.start([this, index]() {
+            load(index, false);
+        });
+    }
+}
+
+qint64 PageCache::residentBytes() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_residentBytes;
+}
+
+qint64 PageCache::hits() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_hits;
+}
+
+qint64 PageCache::misses() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_misses;
+}
+
+// Returns the cached page or reads it. A page being read by another thread
+// is waited for rather than read twice.
+PageCache::PagePointer PageCache::load(qsizetype index, bool counted)
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        while (m_loading.contains(index)) {
+            m_loaded.wait(&m_mutex);
+        }
+        auto it = m_entries.find(index);
+        if (it != m_entries.end()) {
+            it->lastUse = ++m_useCount;
+            if (counted) {
+                ++m_hits;
+            }
+            return it->page;
+        }
+        if (counted) {
+            ++m_misses;
+        }
+        m_loading.insert(index);
+    }
+    
+    auto page = std::make_shared<PagedLayerFile::Page>();
+    bool ok = m_file.readPage(index, *page);
+    
+    QMutexLocker locker(&m_mutex);
+    m_loading.remove(index);
+    m_loaded.wakeAll();
+    if (!ok) {
+        return PagePointer();
+    }
+    Entry entry;
+    entry.page = page;
+    entry.bytes = pageBytes(*page);
+    entry.lastUse = ++m_useCount;
+    m_entries.insert(index, entry);
+    m_residentBytes += entry.bytes;
+    evict();
+    return page;
+}
+
+// Drops least recently used pages until the cache fits its budget, always
+// keeping the page used last
+void PageCache::evict()
+{
+    while (m_residentBytes > m_maxBytes && m_entries.size() > 1) {
+        auto oldest = m_entries.begin();
+        for (auto it = m_entries.begin(); it != m_entries.end(); ++it) {
+            if (it->lastUse < oldest->lastUse) {
+                oldest = it;
+            }
+        }
+        m_residentBytes -= oldest->bytes;
+        m_entries.erase(oldest);
+    }
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "PagedLayerFile.h"
+#include <QHash>
+#include <QMutex>
+#include <QSet>
+#include <QThreadPool>
+#include <QVector>
+#include <QWaitCondition>
+#include <memory>
+
+// Decoded pages of a PagedLayerFile, held in memory up to a byte budget.
+// Pages are read on first use and the least recently used ones are evicted
+// once the budget is exceeded; callers keep the pages they were handed
+// alive until they drop them. Pages can also be read ahead of use on a
+// small background pool. Safe to use from several threads.
+class PageCache
+{
+public:
+    using PagePointer = std::shared_ptr<const PagedLayerFile::Page>;
+    
+    PageCache(const PagedLayerFile& file, qint64 maxBytes);
+    ~PageCache();
+    
+    // Null when the page cannot be read
+    PagePointer page(qsizetype index);
+    // Several pages in the given order, the missing ones read concurrently
+    // on the calling thread and pool (the global pool unless given)
+    QVector<PagePointer> pages(const QVector<qsizetype>& indexes, QThreadPool* pool = nullptr);
+    // Starts reading pages that are not cached yet, as long as they fit in
+    // a quarter of the budget
+    void readAhead(const QVector<qsizetype>& indexes);
+    
+    qint64 maxBytes() const { return m_maxBytes; }
+    qint64 residentBytes() const;
+    qint64 hits() const;
+    qint64 misses() const;
+
+private:
+    struct Entry {
+        PagePointer page;
+        qint64 bytes = 0;
+        quint64 lastUse = 0;
+    };
+    
+    PagePointer load(qsizetype index, bool counted);
+    void evict();
+    
+    const PagedLayerFile& m_file;
+    qint64 m_maxBytes;
+    
+    mutable QMutex m_mutex;
+    QWaitCondition m_loaded;
+    QHash<qsizetype, Entry> m_entries;
+    QSet<qsizetype> m_loading;
+    quint64 m_useCount;
+    qint64 m_residentBytes;
+    qint64 m_hits;
+    qint64 m_misses;
+    
+    QThreadPool m_readAhead;
+};
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <QtGlobal>
+
+// Layout of the page files of out-of-core layers, shared by
+// PagedLayerWriter and PagedLayerFile. A file is a run of pages, the page
+// table, the layer map (a QDataStream'd QVariantMap) and a fixed-size
+// trailer. A page holds the bounds of its features, four doubles each,
+// followed by their FeatureStore::writeBinary() snapshot. Like layer
+// snapshots the layout is native endian, and the trailer identifies the
+// source the file was built from.
+class PagedLayer
+{
+public:
+    static constexpr char Magic[8] = {'G', 'W', 'P', 'A', 'G', 'E', 'S', '\0'};
+    // Bumped whenever the layout or the parsers' output changes
+    static constexpr quint32 FormatVersion = 1;
+    
+    struct PageEntry {
+        double minX;
+        double minY;
+        double maxX;
+        double maxY;
+        qint64 offset;
+        qint64 size;
+        qint64 firstFeature;
+        qint64 featureCount;
+    };
+    
+    struct Trailer {
+        char magic[8];
+        quint32 version;
+        quint32 byteOrder;
+        qint64 sourceSize;
+        qint64 sourceModified;
+        char fingerprint[16];
+        qint64 featureCount;
+        qint64 pageCount;
+        qint64 tableOffset;
+        qint64 layerOffset;
+        qint64 layerSize;
+    };
+    
+    // Bytes of feature bounds at the start of a page
+    static constexpr qint64 BoundsBytes = 4 * sizeof(double);
+};
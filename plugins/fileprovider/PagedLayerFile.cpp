@@ -0,0 +1,152 @@
+#include "PagedLayerFile.h"
+#include "LayerCache.h"
+#include <QDataStream>
+#include <QDateTime>
+#include <QFile>
+#include <QFileInfo>
+#include <QSysInfo>
+#include <QDebug>
+#include <algorithm>
+#include <cstring>
+
+PagedLayerFile::PagedLayerFile(const QString& filePath)
+    : m_filePath(filePath)
+    , m_featureCount(0)
+{
+}
+
+bool PagedLayerFile::open(const QString& sourcePath)
+{
+    QFile file(m_filePath);
+    if (!file.exists() || !file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    
+    PagedLayer::Trailer trailer;
+    qint64 end = file.size() - qint64(sizeof(trailer));
+    if (end < 0 || !file.seek(end)
+        || file.read(reinterpret_cast<char*>(&trailer), sizeof(trailer)) != qint64(sizeof(trailer))) {
+        return false;
+    }
+    
+    QFileInfo sourceInfo(sourcePath);
+    qint64 entrySize = sizeof(PagedLayer::PageEntry);
+    qint64 tableSize = qBound<qint64>(0, trailer.pageCount, end / entrySize) * entrySize;
+    bool valid = std::memcmp(trailer.magic, PagedLayer::Magic, sizeof(PagedLayer::Magic)) == 0
+        && trailer.version == PagedLayer::FormatVersion
+        && trailer.byteOrder == quint32(QSysInfo::ByteOrder)
+        && trailer.sourceSize == sourceInfo.size()
+        && trailer.sourceModified == sourceInfo.lastModified().toMSecsSinceEpoch()
+        && trailer.pageCount >= 0 && trailer.pageCount <= end / entrySize
+        && trailer.tableOffset >= 0 && trailer.tableOffset <= end && trailer.layerOffset == trailer.tableOffset + tableSize
+        && trailer.layerSize >= 0 && trailer.layerOffset + trailer.layerSize == end;
+    if (!valid) {
+        return false;
+    }
+    
+    QFile source(sourcePath);
+    QByteArray fingerprint = source.open(QIODevice::ReadOnly) ? LayerCache::fingerprint(source) : QByteArray();
+    if (fingerprint.size() != sizeof(trailer.fingerprint)
+        || std::memcmp(trailer.fingerprint, fingerprint.constData(), sizeof(trailer.fingerprint)) != 0) {
+        return false;
+    }
+    
+    QVector<PagedLayer::PageEntry> pages(trailer.pageCount);
+    if (!file.seek(trailer.tableOffset)
+        || file.read(reinterpret_cast<char*>(pages.data()), tableSize) != tableSize) {
+        return false;
+    }
+    QDataStream stream(file.read(trailer.layerSize));
+    QVariantMap layer;
+    stream >> layer;
+    if (stream.status() != QDataStream::Ok) {
+        return false;
+    }
+    
+    // Pages must lie in front of the table and follow each other's features
+    qint64 features = 0;
+    PackedRTree::Node extent;
+    for (const PagedLayer::PageEntry& page : pages) {
+        if (page.offset < 0 || page.size < 0 || page.offset + page.size > trailer.tableOffset
+            || page.firstFeature != features || page.featureCount < 0
+            || page.featureCount > page.size / PagedLayer::BoundsBytes) {
+            return false;
+        }
+        features += page.featureCount;
+        if (page.minX <= page.maxX) {
+            extent.expand(page.minX, page.minY);
+            extent.expand(page.maxX, page.maxY);
+        }
+    }
+    if (features != trailer.featureCount) {
+        return false;
+    }
+    
+    // The index is built over the pages in Hilbert order, with the page
+    // number as the offset of each leaf
+    QVector<PackedRTree::Node> leaves;
+    leaves.reserve(pages.size());
+    for (qsizetype page = 0; page < pages.size(); ++page) {
+        PackedRTree::Node leaf;
+        if (pages[page].minX <= pages[page].maxX) {
+            leaf.expand(pages[page].minX, pages[page].minY);
+            leaf.expand(pages[page].maxX, pages[page].maxY);
+        }
+        leaf.offset = quint64(page);
+        leaves.append(leaf);
+    }
+    std::stable_sort(leaves.begin(), leaves.end(), [&extent](const PackedRTree::Node& a, const PackedRTree::Node& b) {
+        return PackedRTree::hilbertValue(a, extent) < PackedRTree::hilbertValue(b, extent);
+    });
+    
+    m_pages = pages;
+    m_index = leaves.isEmpty() ? QByteArray() : PackedRTree::build(leaves, PackedRTree::DefaultNodeSize);
+    m_extent = extent;
+    m_layer = layer;
+    m_featureCount = features;
+    return true;
+}
+
+QVector<qsizetype> PagedLayerFile::pagesIn(const PackedRTree::Node& box) const
+{
+    QVector<qsizetype> pages;
+    for (quint64 page : PackedRTree::search(m_index.constData(), m_pages.size(), PackedRTree::DefaultNodeSize, box)) {
+        pages.append(qsizetype(page));
+    }
+    std::sort(pages.begin(), pages.end());
+    return pages;
+}
+
+bool PagedLayerFile::readPage(qsizetype page, Page& result) const
+{
+    const PagedLayer::PageEntry& entry = m_pages[page];
+    QFile file(m_filePath);
+    QByteArray data;
+    if (file.open(QIODevice::ReadOnly) && file.seek(entry.offset)) {
+        data = file.read(entry.size);
+    }
+    if (data.size() != entry.size) {
+        qWarning() << "Cannot read page" << page << "of" << m_filePath;
+        return false;
+    }
+    
+    qint64 boundsSize = entry.featureCount * PagedLayer::BoundsBytes;
+    QVector<double> bounds(entry.featureCount * 4);
+    std::memcpy(bounds.data(), data.constData(), boundsSize);
+    result.bounds.resize(entry.featureCount);
+    for (qsizetype feature = 0; feature < result.bounds.size(); ++feature) {
+        PackedRTree::Node& node = result.bounds[feature];
+        node.minX = bounds[feature * 4];
+        node.minY = bounds[feature * 4 + 1];
+        node.maxX = bounds[feature * 4 + 2];
+        node.maxY = bounds[feature * 4 + 3];
+    }
+    
+    if (!result.features.readBinary(data.constData() + boundsSize, data.size() - boundsSize)
+        || result.features.featureCount() != entry.featureCount) {
+        qWarning() << "Invalid page" << page << "in" << m_filePath;
+        result.features.clear();
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "FeatureStore.h"
+#include "PagedLayer.h"
+#include "PackedRTree.h"
+#include <QByteArray>
+#include <QString>
+#include <QVariantMap>
+#include <QVector>
+
+// Page file of an out-of-core layer, written by PagedLayerWriter. Opening
+// reads only the page table and the layer map and indexes the extent of
+// every page in a packed Hilbert R-tree; pages are read on demand, from
+// any thread.
+class PagedLayerFile
+{
+public:
+    struct Page {
+        FeatureStore features;
+        // Bounds of each feature, empty for features without geometry
+        QVector<PackedRTree::Node> bounds;
+    };
+    
+    explicit PagedLayerFile(const QString& filePath);
+    
+    // Fails when the file is missing or damaged, or was built from another
+    // version of sourcePath
+    bool open(const QString& sourcePath);
+    
+    qint64 featureCount() const { return m_featureCount; }
+    qsizetype pageCount() const { return m_pages.size(); }
+    // Bytes a page takes up in the file
+    qint64 pageSize(qsizetype page) const { return m_pages[page].size; }
+    PackedRTree::Node extent() const { return m_extent; }
+    QVariantMap layer() const { return m_layer; }
+    
+    // Pages whose extent intersects box, in file order
+    QVector<qsizetype> pagesIn(const PackedRTree::Node& box) const;
+    bool readPage(qsizetype page, Page& result) const;
+
+private:
+    QString m_filePath;
+    QVector<PagedLayer::PageEntry> m_pages;
+    QByteArray m_index;
+    PackedRTree::Node m_extent;
+    QVariantMap m_layer;
+    qint64 m_featureCount;
+};
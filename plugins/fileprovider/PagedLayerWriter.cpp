@@ -0,0 +1,162 @@
+#include "PagedLayerWriter.h"
+#include "FeatureBounds.h"
+#include "LayerCache.h"
+#include <QDataStream>
+#include <QDateTime>
+#include <QFile>
+#include <QFileInfo>
+#include <QSysInfo>
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+
+namespace {
+
+// A page ends at whichever limit it reaches first
+const qsizetype PageFeatures = 4096;
+const qsizetype PageCoordinates = 1 << 16;
+
+} // namespace
+
+PagedLayerWriter::PagedLayerWriter(const QString& filePath)
+    : m_file(filePath)
+    , m_featureCount(0)
+{
+    std::memset(&m_trailer, 0, sizeof(m_trailer));
+}
+
+bool PagedLayerWriter::open(const QString& sourcePath)
+{
+    QFile source(sourcePath);
+    if (!source.open(QIODevice::ReadOnly)) {
+        m_error = source.errorString();
+        return false;
+    }
+    QByteArray fingerprint = LayerCache::fingerprint(source);
+    if (fingerprint.size() != sizeof(m_trailer.fingerprint)) {
+        m_error = "Cannot fingerprint the source file";
+        return false;
+    }
+    
+    QFileInfo sourceInfo(sourcePath);
+    std::memcpy(m_trailer.magic, PagedLayer::Magic, sizeof(PagedLayer::Magic));
+    m_trailer.version = PagedLayer::FormatVersion;
+    m_trailer.byteOrder = quint32(QSysInfo::ByteOrder);
+    m_trailer.sourceSize = sourceInfo.size();
+    m_trailer.sourceModified = sourceInfo.lastModified().toMSecsSinceEpoch();
+    std::memcpy(m_trailer.fingerprint, fingerprint.constData(), sizeof(m_trailer.fingerprint));
+    
+    if (!m_file.open(QIODevice::WriteOnly)) {
+        m_error = m_file.errorString();
+        return false;
+    }
+    return true;
+}
+
+bool PagedLayerWriter::addBatch(const FeatureStore& batch, int threads)
+{
+    qsizetype count = batch.featureCount();
+    PackedRTree::Node extent;
+    QVector<PackedRTree::Node> bounds = FeatureBounds::compute(batch, extent, threads);
+    
+    QVector<quint32> hilbert(count);
+    for (qsizetype feature = 0; feature < count; ++feature) {
+        hilbert[feature] = PackedRTree::hilbertValue(bounds[feature], extent);
+    }
+    QVector<qsizetype> order(count);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&hilbert](qsizetype a, qsizetype b) {
+        return hilbert[a] < hilbert[b];
+    });
+    
+    qsizetype next = 0;
+    while (next < count) {
+        // Every page gets the batch's columns in the batch's order
+        FeatureStore page;
+        for (const PropertyColumn& column : batch.columns()) {
+            page.column(column.name());
+        }
+        QVector<PackedRTree::Node> pageBounds;
+        while (next < count && page.featureCount() < PageFeatures && page.coordinateCount() < PageCoordinates) {
+            page.appendFeature(batch, order[next]);
+            pageBounds.append(bounds[order[next]]);
+            ++next;
+        }
+        page.setMetadata(batch.metadata());
+        page.encodeDictionaries();
+        if (!writePage(page, pageBounds)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool PagedLayerWriter::writePage(const FeatureStore& page, const QVector<PackedRTree::Node>& bounds)
+{
+    PagedLayer::PageEntry entry;
+    PackedRTree::Node extent;
+    QVector<double> boundsData;
+    boundsData.reserve(bounds.size() * 4);
+    for (const PackedRTree::Node& node : bounds) {
+        extent.expand(node);
+        boundsData << node.minX << node.minY << node.maxX << node.maxY;
+    }
+    entry.minX = extent.minX;
+    entry.minY = extent.minY;
+    entry.maxX = extent.maxX;
+    entry.maxY = extent.maxY;
+    entry.offset = m_file.pos();
+    entry.firstFeature = m_featureCount;
+    entry.featureCount = page.featureCount();
+    
+    if (!writeBlock(reinterpret_cast<const char*>(boundsData.constData()), boundsData.size() * qint64(sizeof(double)))) {
+        return false;
+    }
+    if (!page.writeBinary(&m_file)) {
+        m_error = m_file.errorString();
+        return false;
+    }
+    entry.size = m_file.pos() - entry.offset;
+    m_pages.append(entry);
+    m_featureCount += page.featureCount();
+    return true;
+}
+
+bool PagedLayerWriter::finish(const QVariantMap& layer)
+{
+    QByteArray layerData;
+    QDataStream stream(&layerData, QIODevice::WriteOnly);
+    stream << layer;
+    
+    m_trailer.featureCount = m_featureCount;
+    m_trailer.pageCount = m_pages.size();
+    m_trailer.tableOffset = m_file.pos();
+    m_trailer.layerOffset = m_trailer.tableOffset + m_pages.size() * qint64(sizeof(PagedLayer::PageEntry));
+    m_trailer.layerSize = layerData.size();
+    if (!writeBlock(reinterpret_cast<const char*>(m_pages.constData()), m_pages.size() * qint64(sizeof(PagedLayer::PageEntry)))
+        || !writeBlock(layerData.constData(), layerData.size())
+        || !writeBlock(reinterpret_cast<const char*>(&m_trailer), sizeof(m_trailer))) {
+        return false;
+    }
+    if (!m_file.commit()) {
+        m_error = m_file.errorString();
+        return false;
+    }
+    return true;
+}
+
+void PagedLayerWriter::cancel()
+{
+    m_file.cancelWriting();
+    m_file.commit();
+}
+
+bool PagedLayerWriter::writeBlock(const char* data, qint64 size)
+{
+    if (m_file.write(data, size) != size) {
+        m_error = m_file.errorString();
+        m_file.cancelWriting();
+        return false;
+    }
+    return true;
+}
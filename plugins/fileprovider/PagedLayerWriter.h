@@ -0,0 +1,42 @@
+#pragma once
+
+#include "FeatureStore.h"
+#include "PagedLayer.h"
+#include "PackedRTree.h"
+#include <QSaveFile>
+#include <QString>
+#include <QVariantMap>
+#include <QVector>
+
+// Writes the page file of an out-of-core layer. Features arrive in batches
+// that are each ordered along a Hilbert curve over their extent and cut
+// into pages, so features close to each other share pages and a viewport
+// touches few of them. Only the batch being written is held in memory.
+class PagedLayerWriter
+{
+public:
+    explicit PagedLayerWriter(const QString& filePath);
+    
+    // Starts the file and records the size, modification time and
+    // fingerprint of the source it is built from
+    bool open(const QString& sourcePath);
+    bool addBatch(const FeatureStore& batch, int threads = 0);
+    // Writes the page table, the layer map and the trailer and replaces
+    // any previous file
+    bool finish(const QVariantMap& layer);
+    // Drops the partly written file
+    void cancel();
+    
+    qint64 featureCount() const { return m_featureCount; }
+    QString errorString() const { return m_error; }
+
+private:
+    bool writePage(const FeatureStore& page, const QVector<PackedRTree::Node>& bounds);
+    bool writeBlock(const char* data, qint64 size);
+    
+    QSaveFile m_file;
+    PagedLayer::Trailer m_trailer;
+    QVector<PagedLayer::PageEntry> m_pages;
+    qint64 m_featureCount;
+    QString m_error;
+};
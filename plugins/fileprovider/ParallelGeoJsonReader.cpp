@@ -0,0 +1,274 @@
+#include "ParallelGeoJsonReader.h"
+#include "GeoJsonReader.h"
+#include "JsonReader.h"
+#include <QFuture>
+#include <QThread>
+#include <QThreadPool>
+#include <QtConcurrentRun>
+#include <atomic>
+#include <vector>
+
+namespace {
+
+const qsizetype MinChunkSize = 1 << 20;
+const qsizetype ChunksPerThread = 4;
+
+struct ChunkResult {
+    FeatureStore store;
+    bool ok = false;
+    QString error;
+    std::atomic<bool> done{false};
+};
+
+bool isWhitespace(char c)
+{
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+// Characters of a number or literal
+bool isScalar(char c)
+{
+    return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '-' || c == '+' || c == '.';
+}
+
+// Walks the features array from just after its '[' and returns the offset
+// just past the matching ']', or -1 if the array is not terminated or its
+// elements are not separated by exactly one comma each. Slices are parsed
+// as value sequences, which would skip extra commas, so the separators are
+// checked here. Whenever the current slice has grown past chunkSize the
+// offset after the next top-level comma is recorded as a split point.
+qsizetype scanFeatureArray(const char* data, qsizetype size, qsizetype begin, qsizetype chunkSize,
+                           QVector<qsizetype>& splits)
+{
+    int depth = 0;
+    qsizetype chunkStart = begin;
+    bool expectValue = true;
+    bool empty = true;
+    
+    for (qsizetype i = begin; i < size; ++i) {
+        char c = data[i];
+        if (depth == 0 && !isWhitespace(c) && c != ',' && c != '}' && c != ']') {
+            // A new element must follow a comma; a number or literal
+            // continues until whitespace or a separator
+            bool continues = !expectValue && isScalar(c) && isScalar(data[i - 1]);
+            if (!expectValue && !continues) {
+                return -1;
+            }
+            if (c != '"' && c != '{' && c != '[' && !isScalar(c)) {
+                return -1;
+            }
+            expectValue = false;
+            empty = false;
+        }
+        
+        switch (c) {
+        case '"':
+            i = JsonReader::stringEnd(data, size, i);
+            if (i < 0) {
+                return -1;
+            }
+            break;
+        case '{':
+        case '[':
+            ++depth;
+            break;
+        case '}':
+        case ']':
+            if (depth-- == 0) {
+                return c == ']' && (!expectValue || empty) ? i + 1 : -1;
+            }
+            break;
+        case ',':
+            if (depth == 0) {
+                if (expectValue) {
+                    return -1;
+                }
+                expectValue = true;
+                if (i + 1 - chunkStart >= chunkSize) {
+                    chunkStart = i + 1;
+                    splits.append(chunkStart);
+                }
+            }
+            break;
+        default:
+            break;
+        }
+    }
+    return -1;
+}
+
+// Reads a root member other than "features"; the current token is its name
+bool readRootMember(JsonReader& json, QString& rootType, QVariantMap& metadata)
+{
+    bool isType = json.utf8() == "type";
+    QString key = json.string();
+    
+    if (json.next() == JsonReader::String && isType) {
+        rootType = json.string();
+        return true;
+    }
+    metadata.insert(key, json.readValue());
+    return !json.hasError();
+}
+
+} // namespace
+
+ParallelGeoJsonReader::ParallelGeoJsonReader(const char* data, qsizetype size)
+    : m_data(data)
+    , m_size(size)
+    , m_threads(0)
+    , m_cancelled(false)
+{
+}
+
+int ParallelGeoJsonReader::threadCount() const
+{
+    return m_threads > 0 ? m_threads : QThread::idealThreadCount();
+}
+
+bool ParallelGeoJsonReader::read(FeatureStore& store, const IngestProgress& progress, QThreadPool* pool)
+{
+    m_cancelled = false;
+    m_error.clear();
+    
+    int threads = threadCount();
+    if (threads <= 1) {
+        return readSequential(store, progress);
+    }
+    
+    // Read the root members up to the start of the features array
+    JsonReader json(m_data, m_size);
+    if (json.next() != JsonReader::BeginObject) {
+        return readSequential(store, progress);
+    }
+    
+    QString rootType;
+    QVariantMap metadata;
+    qsizetype arrayStart = -1;
+    while (json.next() == JsonReader::Name) {
+        if (json.utf8() == "features") {
+            if (json.next() == JsonReader::BeginArray) {
+                arrayStart = json.position();
+            }
+            break;
+        }
+        if (!readRootMember(json, rootType, metadata)) {
+            break;
+        }
+    }
+    if (arrayStart < 0 || (!rootType.isEmpty() && rootType != "FeatureCollection")) {
+        // Not a FeatureCollection we can split, let the streaming reader
+        // handle it or report the error
+        return readSequential(store, progress);
+    }
+    
+    qsizetype chunkSize = qMax(MinChunkSize, (m_size - arrayStart) / (threads * ChunksPerThread));
+    QVector<qsizetype> bounds{arrayStart};
+    qsizetype arrayEnd = scanFeatureArray(m_data, m_size, arrayStart, chunkSize, bounds);
+    if (arrayEnd < 0 || !readTrailer(arrayEnd, rootType, metadata) || rootType != "FeatureCollection") {
+        return readSequential(store, progress);
+    }
+    bounds.append(arrayEnd - 1);
+    
+    qsizetype chunkCount = bounds.size() - 1;
+    std::vector<ChunkResult> results(chunkCount);
+    std::atomic<qsizetype> nextChunk(0);
+    std::atomic<bool> stop(false);
+    auto parseChunk = [this, &bounds, &results, &stop](qsizetype chunk) {
+        ChunkResult& result = results[chunk];
+        GeoJsonReader reader(m_data + bounds[chunk], bounds[chunk + 1] - bounds[chunk]);
+        result.ok = reader.readFeatureSequence(result.store, [&stop](qint64, qint64) {
+            return !stop.load(std::memory_order_relaxed);
+        });
+        if (!result.ok) {
+            result.error = reader.errorString();
+        }
+        result.done.store(true, std::memory_order_release);
+    };
+    auto parseChunks = [&parseChunk, &nextChunk, &stop, chunkCount]() {
+        for (qsizetype chunk = nextChunk++; chunk < chunkCount && !stop.load(std::memory_order_relaxed); chunk = nextChunk++) {
+            parseChunk(chunk);
+        }
+    };
+    
+    // Merge in file order while later slices are still being parsed
+    bool ok = true;
+    qsizetype merged = 0;
+    auto mergeParsed = [&]() {
+        for (; ok && merged < chunkCount && results[merged].done.load(std::memory_order_acquire); ++merged) {
+            ChunkResult& result = results[merged];
+            if (!result.ok) {
+                m_error = QString("%1 (in features starting at offset %2)").arg(result.error).arg(bounds[merged]);
+                stop = true;
+                ok = false;
+                break;
+            }
+            
+            store.append(result.store);
+            result.store.clear();
+            if (progress && !progress(bounds[merged + 1], store.featureCount())) {
+                m_cancelled = true;
+                stop = true;
+                ok = false;
+            }
+        }
+    };
+    
+    // The calling thread and threads - 1 pool tasks take slices in turn
+    // until none are left, so a busy pool only slows the read down. The
+    // calling thread merges what has been parsed after each of its slices.
+    if (!pool) {
+        pool = QThreadPool::globalInstance();
+    }
+    QVector<QFuture<void>> futures;
+    for (qsizetype worker = 1; worker < qMin<qsizetype>(threads, chunkCount); ++worker) {
+        futures.append(QtConcurrent::run(pool, parseChunks));
+    }
+    for (qsizetype chunk = nextChunk++; chunk < chunkCount && !stop.load(std::memory_order_relaxed); chunk = nextChunk++) {
+        parseChunk(chunk);
+        mergeParsed();
+    }
+    for (QFuture<void>& future : futures) {
+        future.waitForFinished();
+    }
+    mergeParsed();
+    
+    if (ok) {
+        store.setMetadata(metadata);
+    }
+    return ok;
+}
+
+bool ParallelGeoJsonReader::readSequential(FeatureStore& store, const IngestProgress& progress)
+{
+    GeoJsonReader reader(m_data, m_size);
+    bool ok = reader.read(store, progress);
+    m_cancelled = reader.wasCancelled();
+    m_error = ok ? QString() : reader.errorString();
+    return ok;
+}
+
+// Reads the root members following the features array. They are usually
+// few and small, so they are copied into a standalone object and parsed.
+bool ParallelGeoJsonReader::readTrailer(qsizetype offset, QString& rootType, QVariantMap& metadata)
+{
+    qsizetype pos = offset;
+    while (pos < m_size && (m_data[pos] == ' ' || m_data[pos] == '\n' || m_data[pos] == '\r' || m_data[pos] == '\t')) {
+        ++pos;
+    }
+    if (pos < m_size && m_data[pos] == ',') {
+        ++pos;
+    }
+    
+    QByteArray trailer = "{" + QByteArray(m_data + pos, m_size - pos);
+    JsonReader json(trailer.constData(), trailer.size());
+    if (json.next() != JsonReader::BeginObject) {
+        return false;
+    }
+    while (json.next() == JsonReader::Name) {
+        if (!readRootMember(json, rootType, metadata)) {
+            return false;
+        }
+    }
+    return !json.hasError() && json.next() == JsonReader::EndOfDocument;
+}
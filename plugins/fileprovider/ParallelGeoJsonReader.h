@@ -0,0 +1,38 @@
+#pragma once
+
+#include "FeatureStore.h"
+#include <QString>
+
+class QThreadPool;
+
+// Parses a GeoJSON FeatureCollection held in memory on several threads. A
+// quick structural scan splits the top-level "features" array at feature
+// boundaries, the slices are parsed concurrently into private stores and
+// merged back in file order. Documents that are not a FeatureCollection
+// fall back to the single-threaded GeoJsonReader.
+class ParallelGeoJsonReader
+{
+public:
+    ParallelGeoJsonReader(const char* data, qsizetype size);
+    
+    // 0 picks QThread::idealThreadCount()
+    void setThreadCount(int threads) { m_threads = threads; }
+    int threadCount() const;
+    
+    // Slices are parsed on the calling thread and on pool (the global pool
+    // unless given)
+    bool read(FeatureStore& store, const IngestProgress& progress = IngestProgress(), QThreadPool* pool = nullptr);
+    
+    bool wasCancelled() const { return m_cancelled; }
+    QString errorString() const { return m_error; }
+
+private:
+    bool readSequential(FeatureStore& store, const IngestProgress& progress);
+    bool readTrailer(qsizetype offset, QString& rootType, QVariantMap& metadata);
+    
+    const char* m_data;
+    qsizetype m_size;
+    int m_threads;
+    bool m_cancelled;
+    QString m_error;
+};
@@ -0,0 +1,135 @@
+#include "ReadAheadDevice.h"
+#include <cstring>
+
+namespace {
+
+// Up to 32 MB are read ahead, enough to fill the next parse batch while
+// the current one is parsed
+const qint64 BlockSize = 1024 * 1024;
+const qsizetype QueuedBlocks = 32;
+
+} // namespace
+
+ReadAheadDevice::ReadAheadDevice(std::unique_ptr<QIODevice> source)
+    : m_source(std::move(source))
+    , m_blockOffset(0)
+    , m_finished(false)
+    , m_failed(false)
+    , m_stopping(false)
+{
+    m_producer.setMaxThreadCount(1);
+}
+
+ReadAheadDevice::~ReadAheadDevice()
+{
+    close();
+}
+
+bool ReadAheadDevice::open(OpenMode mode)
+{
+    if (mode != ReadOnly) {
+        setErrorString("Read-ahead devices can only be read");
+        return false;
+    }
+    if (!m_source || !m_source->isReadable()) {
+        setErrorString("Source device is not open");
+        return false;
+    }
+    
+    m_blocks.clear();
+    m_blockOffset = 0;
+    m_finished = false;
+    m_failed = false;
+    m_stopping = false;
+    if (!QIODevice::open(mode)) {
+        return false;
+    }
+    m_producer.start([this]() {
+        produce();
+    });
+    return true;
+}
+
+void ReadAheadDevice::close()
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        m_stopping = true;
+        m_changed.wakeAll();
+    }
+    m_producer.waitForDone();
+    m_blocks.clear();
+    if (isOpen()) {
+        QIODevice::close();
+    }
+}
+
+bool ReadAheadDevice::atEnd() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_finished && !m_failed && m_blocks.isEmpty() && QIODevice::bytesAvailable() == 0;
+}
+
+qint64 ReadAheadDevice::readData(char* data, qint64 maxSize)
+{
+    QMutexLocker locker(&m_mutex);
+    while (m_blocks.isEmpty() && !m_finished) {
+        m_changed.wait(&m_mutex);
+    }
+    if (m_blocks.isEmpty()) {
+        if (m_failed) {
+            setErrorString(m_sourceError);
+            return -1;
+        }
+        return 0;
+    }
+    
+    qint64 copied = 0;
+    while (copied < maxSize && !m_blocks.isEmpty()) {
+        const QByteArray& block = m_blocks.head();
+        qint64 count = qMin(maxSize - copied, qint64(block.size() - m_blockOffset));
+        std::memcpy(data + copied, block.constData() + m_blockOffset, count);
+        copied += count;
+        m_blockOffset += count;
+        if (m_blockOffset == block.size()) {
+            m_blocks.dequeue();
+            m_blockOffset = 0;
+        }
+    }
+    m_changed.wakeAll();
+    return copied;
+}
+
+qint64 ReadAheadDevice::writeData(const char*, qint64)
+{
+    return -1;
+}
+
+// Runs on the background thread until the source is exhausted or fails,
+// or the device is closed
+void ReadAheadDevice::produce()
+{
+    while (true) {
+        QByteArray block(BlockSize, Qt::Uninitialized);
+        qint64 read = m_source->read(block.data(), BlockSize);
+        
+        QMutexLocker locker(&m_mutex);
+        if (read > 0) {
+            block.truncate(read);
+            while (m_blocks.size() >= QueuedBlocks && !m_stopping) {
+                m_changed.wait(&m_mutex);
+            }
+            if (!m_stopping) {
+                m_blocks.enqueue(block);
+                m_changed.wakeAll();
+                continue;
+            }
+        } else if (read < 0 || !m_source->atEnd()) {
+            m_failed = true;
+            m_sourceError = m_source->errorString();
+        }
+        m_finished = true;
+        m_changed.wakeAll();
+        return;
+    }
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <QByteArray>
+#include <QIODevice>
+#include <QMutex>
+#include <QQueue>
+#include <QThreadPool>
+#include <QWaitCondition>
+#include <memory>
+
+// Sequential device that reads another device on a background thread and
+// queues what it read, a bounded number of blocks ahead of its own reader.
+// Producing the data, such as decompressing it, then overlaps with parsing
+// it. The source is only touched by the background thread once opened.
+class ReadAheadDevice : public QIODevice
+{
+public:
+    // source must already be open for reading
+    explicit ReadAheadDevice(std::unique_ptr<QIODevice> source);
+    ~ReadAheadDevice() override;
+    
+    bool open(OpenMode mode) override;
+    void close() override;
+    bool isSequential() const override { return true; }
+    bool atEnd() const override;
+
+protected:
+    // Waits until a block is queued or the source is exhausted
+    qint64 readData(char* data, qint64 maxSize) override;
+    qint64 writeData(const char* data, qint64 maxSize) override;
+
+private:
+    Q_DISABLE_COPY(ReadAheadDevice)
+    
+    void produce();
+    
+    std::unique_ptr<QIODevice> m_source;
+    QThreadPool m_producer;
+    
+    mutable QMutex m_mutex;
+    QWaitCondition m_changed;
+    QQueue<QByteArray> m_blocks;
+    qsizetype m_blockOffset;
+    bool m_finished;
+    bool m_failed;
+    bool m_stopping;
+    QString m_sourceError;
+};
@@ -0,0 +1,571 @@
+#include "ShapefileReader.h"
+#include <QFuture>
+#include <QThread>
+#include <QThreadPool>
+#include <QtConcurrentRun>
+#include <QtEndian>
+#include <atomic>
+#include <charconv>
+#include <vector>
+
+namespace {
+
+const qsizetype HeaderSize = 100;
+const qint32 FileCode = 9994;
+const qsizetype RecordHeaderSize = 8;
+const qsizetype IndexEntrySize = 8;
+
+const qint64 ProgressInterval = 65536;
+const qint64 MinChunkRecords = 16384;
+const qsizetype ChunksPerThread = 4;
+
+// Shape types of the .shp records
+enum ShapeType {
+    NullShape = 0,
+    PointShape = 1,
+    PolyLineShape = 3,
+    PolygonShape = 5,
+    MultiPointShape = 8
+};
+
+struct ChunkResult {
+    FeatureStore store;
+    bool ok = false;
+    QString error;
+    std::atomic<bool> done{false};
+};
+
+template<typename T>
+T readLE(const char* data)
+{
+    return qFromLittleEndian<T>(data);
+}
+
+template<typename T>
+T readBE(const char* data)
+{
+    return qFromBigEndian<T>(data);
+}
+
+// Z and M variants (PointZ = 11, PointM = 21, ...) share the 2D layout up
+// to the end of the XY points
+int baseShapeType(qint32 type)
+{
+    switch (type) {
+    case 11:
+    case 21:
+        return PointShape;
+    case 13:
+    case 23:
+        return PolyLineShape;
+    case 15:
+    case 25:
+        return PolygonShape;
+    case 18:
+    case 28:
+        return MultiPointShape;
+    }
+    return type;
+}
+
+// Twice the signed area; negative for clockwise rings
+double ringArea(const char* points, qint32 first, qint32 last)
+{
+    double area = 0.0;
+    for (qint32 i = first; i + 1 < last; ++i) {
+        const char* point = points + qsizetype(i) * 16;
+        area += readLE<double>(point) * readLE<double>(point + 24) - readLE<double>(point + 16) * readLE<double>(point + 8);
+    }
+    return area;
+}
+
+QByteArrayView trimmed(QByteArrayView value)
+{
+    qsizetype begin = 0;
+    qsizetype end = value.size();
+    while (begin < end && (value[begin] == ' ' || value[begin] == '\0')) {
+        ++begin;
+    }
+    while (end > begin && (value[end - 1] == ' ' || value[end - 1] == '\0')) {
+        --end;
+    }
+    return value.sliced(begin, end - begin);
+}
+
+} // namespace
+
+ShapefileReader::ShapefileReader(const char* shp, qsizetype shpSize)
+    : m_shp(shp)
+    , m_shpSize(shpSize)
+    , m_shx(nullptr)
+    , m_shxSize(0)
+    , m_dbf(nullptr)
+    , m_dbfSize(0)
+    , m_utf8(false)
+    , m_threads(1)
+    , m_headerRead(false)
+    , m_bounds{0, 0, 0, 0}
+    , m_dbfRecords(0)
+    , m_dbfHeaderSize(0)
+    , m_dbfRecordSize(0)
+    , m_cancelled(false)
+{
+}
+
+void ShapefileReader::setIndex(const char* shx, qsizetype shxSize)
+{
+    m_shx = shx;
+    m_shxSize = shxSize;
+}
+
+void ShapefileReader::setAttributes(const char* dbf, qsizetype dbfSize, const QByteArray& codePage)
+{
+    m_dbf = dbf;
+    m_dbfSize = dbfSize;
+    QByteArray name = codePage.trimmed().toUpper();
+    m_utf8 = name == "UTF-8" || name == "UTF8" || name == "65001";
+}
+
+int ShapefileReader::threadCount() const
+{
+    return m_threads > 0 ? m_threads : QThread::idealThreadCount();
+}
+
+QStringList ShapefileReader::fieldNames() const
+{
+    QStringList names;
+    for (const Field& field : m_fields) {
+        names.append(field.name);
+    }
+    return names;
+}
+
+QVariantMap ShapefileReader::boundingBox() const
+{
+    QVariantMap box;
+    if (m_offsets.isEmpty()) {
+        return box;
+    }
+    box["minLat"] = m_bounds[1];
+    box["maxLat"] = m_bounds[3];
+    box["minLon"] = m_bounds[0];
+    box["maxLon"] = m_bounds[2];
+    return box;
+}
+
+bool ShapefileReader::readHeader()
+{
+    if (m_headerRead) {
+        return true;
+    }
+    if (m_shpSize < HeaderSize || readBE<qint32>(m_shp) != FileCode) {
+        m_error = "Not a shapefile";
+        return false;
+    }
+    // The header records the file length in 16-bit words
+    if (qsizetype(readBE<quint32>(m_shp + 24)) * 2 > m_shpSize) {
+        m_error = "Shapefile is truncated";
+        return false;
+    }
+    for (int i = 0; i < 4; ++i) {
+        m_bounds[i] = readLE<double>(m_shp + 36 + i * 8);
+    }
+    if (!readOffsets() || !readFields()) {
+        return false;
+    }
+    m_headerRead = true;
+    return true;
+}
+
+// Record offsets from the .shx, which must be complete and agree with the
+// .shp in size; otherwise the record headers of the .shp are walked
+bool ShapefileReader::readOffsets()
+{
+    m_offsets.clear();
+    if (m_shx && m_shxSize >= HeaderSize && readBE<qint32>(m_shx) == FileCode
+        && qsizetype(readBE<quint32>(m_shx + 24)) * 2 <= m_shxSize) {
+        qsizetype count = (m_shxSize - HeaderSize) / IndexEntrySize;
+        m_offsets.reserve(count);
+        for (qsizetype i = 0; i < count; ++i) {
+            qsizetype offset = qsizetype(readBE<quint32>(m_shx + HeaderSize + i * IndexEntrySize)) * 2;
+            if (offset < HeaderSize || offset + RecordHeaderSize > m_shpSize) {
+                m_offsets.clear();
+                break;
+            }
+            m_offsets.append(offset);
+        }
+        if (m_offsets.size() == count) {
+            return true;
+        }
+    }
+    
+    qsizetype pos = HeaderSize;
+    while (pos + RecordHeaderSize <= m_shpSize) {
+        m_offsets.append(pos);
+        pos += RecordHeaderSize + qsizetype(readBE<quint32>(m_shp + pos + 4)) * 2;
+    }
+    return true;
+}
+
+bool ShapefileReader::readFields()
+{
+    m_fields.clear();
+    m_dbfRecords = 0;
+    if (!m_dbf) {
+        return true;
+    }
+    if (m_dbfSize < 32) {
+        m_error = "Invalid .dbf header";
+        return false;
+    }
+    
+    m_dbfRecords = readLE<quint32>(m_dbf + 4);
+    m_dbfHeaderSize = readLE<quint16>(m_dbf + 8);
+    m_dbfRecordSize = readLE<quint16>(m_dbf + 10);
+    
+    // Field descriptors of 32 bytes follow the header up to a 0x0D byte;
+    // every record starts with its deletion flag
+    int offset = 1;
+    for (qsizetype pos = 32; pos + 32 <= qMin(m_dbfHeaderSize, m_dbfSize) && m_dbf[pos] != 0x0D; pos += 32) {
+        Field field;
+        field.name = decodeText(trimmed(QByteArrayView(m_dbf + pos, qstrnlen(m_dbf + pos, 11))));
+        field.type = m_dbf[pos + 11];
+        field.length = quint8(m_dbf[pos + 16]);
+        field.decimals = quint8(m_dbf[pos + 17]);
+        field.offset = offset;
+        offset += field.length;
+        m_fields.append(field);
+    }
+    if (offset > m_dbfRecordSize || m_dbfHeaderSize > m_dbfSize) {
+        m_error = "Invalid .dbf field descriptors";
+        return false;
+    }
+    return true;
+}
+
+bool ShapefileReader::read(FeatureStore& store, const IngestProgress& progress, QThreadPool* pool)
+{
+    m_cancelled = false;
+    if (!readHeader()) {
+        return false;
+    }
+    
+    if (threadCount() > 1 && recordCount() >= 2 * MinChunkRecords) {
+        return readParallel(store, progress, pool);
+    }
+    
+    prepareColumns(store);
+    if (!readRange(store, 0, recordCount(), progress)) {
+        return false;
+    }
+    if (progress) {
+        progress(m_shpSize, store.featureCount());
+    }
+    return true;
+}
+
+bool ShapefileReader::readRecords(FeatureStore& store, qint64 first, qint64 last)
+{
+    m_cancelled = false;
+    if (!readHeader()) {
+        return false;
+    }
+    prepareColumns(store);
+    return readRange(store, qBound<qint64>(0, first, recordCount()), qBound<qint64>(0, last, recordCount()),
+                     IngestProgress());
+}
+
+void ShapefileReader::prepareColumns(FeatureStore& store)
+{
+    m_columns.clear();
+    for (const Field& field : m_fields) {
+        store.column(field.name);
+        m_columns.append(store.columnIndex(field.name));
+    }
+}
+
+bool ShapefileReader::readRange(FeatureStore& store, qint64 first, qint64 last, const IngestProgress& progress)
+{
+    for (qint64 record = first; record < last; ++record) {
+        if (!readRecord(store, record)) {
+            return false;
+        }
+        if (progress && (record - first + 1) % ProgressInterval == 0
+            && !progress(m_offsets[record], store.featureCount())) {
+            m_cancelled = true;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool ShapefileReader::readRecord(FeatureStore& store, qint64 record)
+{
+    const char* row = nullptr;
+    if (record < m_dbfRecords) {
+        qsizetype rowOffset = m_dbfHeaderSize + qsizetype(record) * m_dbfRecordSize;
+        if (rowOffset + m_dbfRecordSize <= m_dbfSize) {
+            row = m_dbf + rowOffset;
+        }
+    }
+    if (row && row[0] == '*') {
+        return true;
+    }
+    
+    qsizetype offset = m_offsets[record];
+    qsizetype contentSize = qsizetype(readBE<quint32>(m_shp + offset + 4)) * 2;
+    if (offset + RecordHeaderSize + contentSize > m_shpSize) {
+        m_error = QString("Record %1 extends past the end of the file").arg(record);
+        return false;
+    }
+    
+    store.beginFeature();
+    if (!readGeometry(store, m_shp + offset + RecordHeaderSize, contentSize)) {
+        m_error = QString("Invalid geometry in record %1").arg(record);
+        return false;
+    }
+    if (row) {
+        for (int i = 0; i < m_fields.size(); ++i) {
+            PropertyColumn& target = store.columnAt(m_columns[i]);
+            // Repeated field names keep the first value
+            if (target.size() < store.featureCount()) {
+                const Field& field = m_fields[i];
+                appendValue(target, field, trimmed(QByteArrayView(row + field.offset, field.length)));
+            }
+        }
+    }
+    store.endFeature();
+    return true;
+}
+
+bool ShapefileReader::readGeometry(FeatureStore& store, const char* content, qsizetype size)
+{
+    if (size < 4) {
+        return size == 0;
+    }
+    
+    switch (baseShapeType(readLE<qint32>(content))) {
+    case NullShape:
+        return true;
+    case PointShape:
+        if (size < 20) {
+            return false;
+        }
+        store.setGeometryType(FeatureStore::Point);
+        store.beginPart(FeatureStore::Point);
+        store.beginRing();
+        store.addCoordinate(readLE<double>(content + 4), readLE<double>(content + 12));
+        return true;
+    case MultiPointShape: {
+        if (size < 40) {
+            return false;
+        }
+        qint32 pointCount = readLE<qint32>(content + 36);
+        if (pointCount < 0 || 40 + qsizetype(pointCount) * 16 > size) {
+            return false;
+        }
+        store.setGeometryType(FeatureStore::MultiPoint);
+        for (qint32 i = 0; i < pointCount; ++i) {
+            const char* point = content + 40 + qsizetype(i) * 16;
+            store.beginPart(FeatureStore::Point);
+            store.beginRing();
+            store.addCoordinate(readLE<double>(point), readLE<double>(point + 8));
+        }
+        return true;
+    }
+    case PolyLineShape:
+    case PolygonShape: {
+        if (size < 44) {
+            return false;
+        }
+        bool polygon = baseShapeType(readLE<qint32>(content)) == PolygonShape;
+        qint32 partCount = readLE<qint32>(content + 36);
+        qint32 pointCount = readLE<qint32>(content + 40);
+        if (partCount < 0 || pointCount < 0 || 44 + qsizetype(partCount) * 4 + qsizetype(pointCount) * 16 > size) {
+            return false;
+        }
+        const char* parts = content + 44;
+        const char* points = parts + qsizetype(partCount) * 4;
+        
+        int polygons = 0;
+        for (qint32 part = 0; part < partCount; ++part) {
+            qint32 first = readLE<qint32>(parts + part * 4);
+            qint32 last = part + 1 < partCount ? readLE<qint32>(parts + (part + 1) * 4) : pointCount;
+            if (first < 0 || last < first || last > pointCount) {
+                return false;
+            }
+            if (!polygon) {
+                store.beginPart(FeatureStore::LineString);
+            } else if (polygons == 0 || ringArea(points, first, last) < 0.0) {
+                store.beginPart(FeatureStore::Polygon);
+                ++polygons;
+            }
+            store.beginRing();
+            for (qint32 i = first; i < last; ++i) {
+                const char* point = points + qsizetype(i) * 16;
+                store.addCoordinate(readLE<double>(point), readLE<double>(point + 8));
+            }
+        }
+        if (polygon) {
+            store.setGeometryType(polygons > 1 ? FeatureStore::MultiPolygon : FeatureStore::Polygon);
+        } else if (partCount > 0) {
+            store.setGeometryType(partCount > 1 ? FeatureStore::MultiLineString : FeatureStore::LineString);
+        }
+        return true;
+    }
+    }
+    
+    // MultiPatch and unknown shapes are read as features without geometry
+    return true;
+}
+
+void ShapefileReader::appendValue(PropertyColumn& column, const Field& field, QByteArrayView value)
+{
+    if (value.isEmpty()) {
+        column.appendNull();
+        return;
+    }
+    
+    switch (field.type) {
+    case 'N':
+    case 'F': {
+        // Overflowed numbers are written as asterisks and read as null
+        if (field.type == 'N' && field.decimals == 0) {
+            qint64 integer = 0;
+            auto result = std::from_chars(value.data(), value.data() + value.size(), integer);
+            if (result.ec == std::errc() && result.ptr == value.data() + value.size()) {
+                column.appendInt(integer);
+                return;
+            }
+        }
+        double number = 0.0;
+        auto result = std::from_chars(value.data(), value.data() + value.size(), number);
+        if (result.ec == std::errc() && result.ptr == value.data() + value.size()) {
+            column.appendDouble(number);
+        } else {
+            column.appendNull();
+        }
+        return;
+    }
+    case 'L':
+        switch (value[0]) {
+        case 'T':
+        case 't':
+        case 'Y':
+        case 'y':
+            column.appendBool(true);
+            return;
+        case 'F':
+        case 'f':
+        case 'N':
+        case 'n':
+            column.appendBool(false);
+            return;
+        }
+        column.appendNull();
+        return;
+    case 'D':
+        // YYYYMMDD, written out in ISO 8601 form
+        if (value.size() == 8) {
+            QString date = decodeText(value);
+            column.appendString(date.left(4) + '-' + date.mid(4, 2) + '-' + date.right(2));
+            return;
+        }
+        break;
+    }
+    column.appendString(decodeText(value));
+}
+
+// ASCII is the same in both encodings, so only Latin-1 text with high bytes
+// bypasses the pool
+QString ShapefileReader::decodeText(QByteArrayView text)
+{
+    if (!m_utf8) {
+        for (char c : text) {
+            if (c & 0x80) {
+                return QString::fromLatin1(text);
+            }
+        }
+    }
+    return m_strings.intern(text);
+}
+
+// Splits the records into ranges that are read on a thread pool into
+// separate stores and appended in file order. The calling thread and
+// threads - 1 pool tasks take ranges in turn until none are left, so a busy
+// pool only slows the read down.
+bool ShapefileReader::readParallel(FeatureStore& store, const IngestProgress& progress, QThreadPool* pool)
+{
+    int threads = threadCount();
+    qint64 records = recordCount();
+    qsizetype chunkCount = qBound<qsizetype>(1, records / MinChunkRecords, threads * ChunksPerThread);
+    QVector<qint64> bounds;
+    for (qsizetype chunk = 0; chunk <= chunkCount; ++chunk) {
+        bounds.append(records * chunk / chunkCount);
+    }
+    
+    prepareColumns(store);
+    std::vector<ChunkResult> results(chunkCount);
+    std::atomic<qsizetype> nextChunk(0);
+    std::atomic<bool> stop(false);
+    auto readChunk = [this, &bounds, &results, &stop](qsizetype chunk) {
+        ChunkResult& result = results[chunk];
+        ShapefileReader reader(*this);
+        reader.prepareColumns(result.store);
+        result.ok = reader.readRange(result.store, bounds[chunk], bounds[chunk + 1], [&stop](qint64, qint64) {
+            return !stop.load(std::memory_order_relaxed);
+        });
+        if (!result.ok) {
+            result.error = reader.errorString();
+        }
+        result.done.store(true, std::memory_order_release);
+    };
+    auto readChunks = [&readChunk, &nextChunk, &stop, chunkCount]() {
+        for (qsizetype chunk = nextChunk++; chunk < chunkCount && !stop.load(std::memory_order_relaxed); chunk = nextChunk++) {
+            readChunk(chunk);
+        }
+    };
+    
+    // Merge in file order while later ranges are still being read; the
+    // calling thread does so after each of its own ranges
+    bool ok = true;
+    qsizetype merged = 0;
+    auto mergeRead = [&]() {
+        for (; ok && merged < chunkCount && results[merged].done.load(std::memory_order_acquire); ++merged) {
+            ChunkResult& result = results[merged];
+            if (!result.ok) {
+                m_error = result.error;
+                m_cancelled = m_error.isEmpty();
+                stop = true;
+                ok = false;
+                break;
+            }
+            
+            store.append(result.store);
+            result.store.clear();
+            qsizetype bytes = merged + 1 < chunkCount ? m_offsets[bounds[merged + 1]] : m_shpSize;
+            if (progress && !progress(bytes, store.featureCount())) {
+                m_cancelled = true;
+                stop = true;
+                ok = false;
+            }
+        }
+    };
+    
+    if (!pool) {
+        pool = QThreadPool::globalInstance();
+    }
+    QVector<QFuture<void>> futures;
+    for (qsizetype worker = 1; worker < qMin<qsizetype>(threads, chunkCount); ++worker) {
+        futures.append(QtConcurrent::run(pool, readChunks));
+    }
+    for (qsizetype chunk = nextChunk++; chunk < chunkCount && !stop.load(std::memory_order_relaxed); chunk = nextChunk++) {
+        readChunk(chunk);
+        mergeRead();
+    }
+    for (QFuture<void>& future : futures) {
+        future.waitForFinished();
+    }
+    mergeRead();
+    return ok;
+}
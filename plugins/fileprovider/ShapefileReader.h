@@ -0,0 +1,93 @@
+#pragma once
+
+#include "FeatureStore.h"
+#include "StringPool.h"
+#include <QByteArray>
+#include <QString>
+#include <QVariantMap>
+#include <QVector>
+
+class QThreadPool;
+
+// Reads an ESRI Shapefile from its in-memory (usually mapped) .shp, .shx and
+// .dbf parts. Record offsets come from the .shx index, or from a walk over
+// the record headers when there is none, so any range of records can be
+// decoded on its own: large files are split into record ranges parsed on
+// several threads and merged in file order. Attributes come from the .dbf
+// when present and records marked deleted there are skipped. Polygon rings
+// are grouped by orientation (clockwise rings start a polygon, the others
+// are its holes); Z, M and MultiPatch geometry are not read.
+class ShapefileReader
+{
+public:
+    ShapefileReader(const char* shp, qsizetype shpSize);
+    
+    // Optional parts; the .dbf text is decoded as UTF-8 when the .cpg code
+    // page says so and as Latin-1 otherwise
+    void setIndex(const char* shx, qsizetype shxSize);
+    void setAttributes(const char* dbf, qsizetype dbfSize, const QByteArray& codePage = QByteArray());
+    
+    // Records are split across this many threads; 0 picks
+    // QThread::idealThreadCount()
+    void setThreadCount(int threads) { m_threads = threads; }
+    int threadCount() const;
+    
+    // Parses the headers and locates the records; read() does this as needed
+    bool readHeader();
+    
+    // Large files are read on the calling thread and on pool (the global
+    // pool unless given)
+    bool read(FeatureStore& store, const IngestProgress& progress = IngestProgress(), QThreadPool* pool = nullptr);
+    // Reads only the records in [first, last)
+    bool readRecords(FeatureStore& store, qint64 first, qint64 last);
+    
+    bool wasCancelled() const { return m_cancelled; }
+    QString errorString() const { return m_error; }
+    
+    // Header information, valid after readHeader()
+    qint64 recordCount() const { return m_offsets.size(); }
+    QStringList fieldNames() const;
+    // Extent recorded in the .shp header, empty when there are no records
+    QVariantMap boundingBox() const;
+
+private:
+    struct Field {
+        QString name;
+        char type;
+        int offset;
+        int length;
+        int decimals;
+    };
+    
+    bool readOffsets();
+    bool readFields();
+    void prepareColumns(FeatureStore& store);
+    bool readRange(FeatureStore& store, qint64 first, qint64 last, const IngestProgress& progress);
+    bool readRecord(FeatureStore& store, qint64 record);
+    bool readGeometry(FeatureStore& store, const char* content, qsizetype size);
+    void appendValue(PropertyColumn& column, const Field& field, QByteArrayView value);
+    QString decodeText(QByteArrayView text);
+    bool readParallel(FeatureStore& store, const IngestProgress& progress, QThreadPool* pool);
+    
+    const char* m_shp;
+    qsizetype m_shpSize;
+    const char* m_shx;
+    qsizetype m_shxSize;
+    const char* m_dbf;
+    qsizetype m_dbfSize;
+    bool m_utf8;
+    int m_threads;
+    bool m_headerRead;
+    
+    double m_bounds[4];
+    QVector<qsizetype> m_offsets;
+    QVector<Field> m_fields;
+    qint64 m_dbfRecords;
+    qsizetype m_dbfHeaderSize;
+    qsizetype m_dbfRecordSize;
+    QVector<int> m_columns;
+    
+    StringPool m_strings;
+    bool m_cancelled;
+    QString m_error;
+};
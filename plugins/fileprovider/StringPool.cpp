@@ -0,0 +1,27 @@
+#include "StringPool.h"
+
+StringPool::StringPool(qsizetype maxLength, qsizetype maxEntries)
+    : m_maxLength(maxLength)
+    , m_maxEntries(maxEntries)
+{
+}
+
+QString StringPool::intern(QByteArrayView utf8)
+{
+    if (utf8.size() > m_maxLength) {
+        return QString::fromUtf8(utf8);
+    }
+    
+    // Look up through a non-owning key so hits never allocate
+    QByteArray key = QByteArray::fromRawData(utf8.data(), utf8.size());
+    auto it = m_strings.constFind(key);
+    if (it != m_strings.constEnd()) {
+        return it.value();
+    }
+    
+    QString value = QString::fromUtf8(utf8);
+    if (m_strings.size() < m_maxEntries) {
+        m_strings.insert(QByteArray(utf8.data(), utf8.size()), value);
+    }
+    return value;
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <QByteArray>
+#include <QByteArrayView>
+#include <QHash>
+#include <QString>
+
+// Interns UTF-8 strings as shared QStrings. Readers pass every member name
+// and short property value through a pool, so a value that repeats across
+// features is decoded once and all rows share a single string buffer.
+// Long or unbounded sets of values (descriptions, unique ids) are decoded
+// directly once the pool is full to keep lookups cheap.
+class StringPool
+{
+public:
+    explicit StringPool(qsizetype maxLength = 64, qsizetype maxEntries = 1 << 16);
+    
+    QString intern(QByteArrayView utf8);
+    
+    qsizetype size() const { return m_strings.size(); }
+    void clear() { m_strings.clear(); }
+
+private:
+    qsizetype m_maxLength;
+    qsizetype m_maxEntries;
+    QHash<QByteArray, QString> m_strings;
+};
@@ -0,0 +1,194 @@
+#include "WkbReader.h"
+#include <QtEndian>
+#include <cmath>
+
+namespace {
+
+const int MaxDepth = 8;
+
+// Extended WKB dimension and SRID flags of the type code
+const quint32 EwkbZFlag = 0x80000000;
+const quint32 EwkbMFlag = 0x40000000;
+const quint32 EwkbSridFlag = 0x20000000;
+
+template<typename T>
+T readValue(const char* data, bool littleEndian)
+{
+    return littleEndian ? qFromLittleEndian<T>(data) : qFromBigEndian<T>(data);
+}
+
+} // namespace
+
+WkbReader::WkbReader(QByteArrayView wkb)
+    : m_wkb(wkb)
+    , m_pos(0)
+    , m_minX(0)
+    , m_minY(0)
+    , m_maxX(0)
+    , m_maxY(0)
+{
+}
+
+bool WkbReader::read(FeatureStore& store)
+{
+    m_pos = 0;
+    m_minX = m_minY = INFINITY;
+    m_maxX = m_maxY = -INFINITY;
+    FeatureStore::GeometryType type = FeatureStore::NoGeometry;
+    if (!readGeometry(&store, type, 0)) {
+        store.clearGeometry();
+        return false;
+    }
+    store.setGeometryType(type);
+    return true;
+}
+
+bool WkbReader::bounds(double& minX, double& minY, double& maxX, double& maxY)
+{
+    m_pos = 0;
+    m_minX = m_minY = INFINITY;
+    m_maxX = m_maxY = -INFINITY;
+    FeatureStore::GeometryType type;
+    if (!readGeometry(nullptr, type, 0) || m_minX > m_maxX) {
+        return false;
+    }
+    minX = m_minX;
+    minY = m_minY;
+    maxX = m_maxX;
+    maxY = m_maxY;
+    return true;
+}
+
+// Reads one geometry; with a null store only the extent is accumulated
+bool WkbReader::readGeometry(FeatureStore* store, FeatureStore::GeometryType& type, int depth)
+{
+    if (depth > MaxDepth || m_pos + 5 > m_wkb.size()) {
+        return false;
+    }
+    bool littleEndian = m_wkb[m_pos] == 1;
+    quint32 code = readValue<quint32>(m_wkb.data() + m_pos + 1, littleEndian);
+    m_pos += 5;
+    
+    int dimensions = 2;
+    if (code & (EwkbZFlag | EwkbMFlag | EwkbSridFlag)) {
+        dimensions += (code & EwkbZFlag ? 1 : 0) + (code & EwkbMFlag ? 1 : 0);
+        if (code & EwkbSridFlag) {
+            m_pos += 4;
+        }
+        code &= 0x0fffffff;
+    } else {
+        // ISO codes add 1000 for Z, 2000 for M and 3000 for ZM
+        dimensions += code / 1000 == 3 ? 2 : (code / 1000 > 0 ? 1 : 0);
+        code %= 1000;
+    }
+    if (code < FeatureStore::Point || code > FeatureStore::GeometryCollection) {
+        return false;
+    }
+    type = FeatureStore::GeometryType(code);
+    
+    quint32 count = 0;
+    switch (type) {
+    case FeatureStore::Point: {
+        if (m_pos + dimensions * 8 > m_wkb.size()) {
+            return false;
+        }
+        // Empty points are written with NaN coordinates
+        double x = readValue<double>(m_wkb.data() + m_pos, littleEndian);
+        double y = readValue<double>(m_wkb.data() + m_pos + 8, littleEndian);
+        if (std::isnan(x) || std::isnan(y)) {
+            m_pos += dimensions * 8;
+            return true;
+        }
+        if (store) {
+            store->beginPart(FeatureStore::Point);
+            store->beginRing();
+        }
+        return readPoints(store, 1, dimensions, littleEndian);
+    }
+    case FeatureStore::LineString:
+        if (!readCount(count, littleEndian)) {
+            return false;
+        }
+        if (store && count > 0) {
+            store->beginPart(FeatureStore::LineString);
+            store->beginRing();
+        }
+        return readPoints(store, count, dimensions, littleEndian);
+    case FeatureStore::Polygon: {
+        quint32 rings = 0;
+        if (!readCount(rings, littleEndian)) {
+            return false;
+        }
+        if (store && rings > 0) {
+            store->beginPart(FeatureStore::Polygon);
+        }
+        for (quint32 ring = 0; ring < rings; ++ring) {
+            if (!readCount(count, littleEndian)) {
+                return false;
+            }
+            if (store) {
+                store->beginRing();
+            }
+            if (!readPoints(store, count, dimensions, littleEndian)) {
+                return false;
+            }
+        }
+        return true;
+    }
+    case FeatureStore::MultiPoint:
+    case FeatureStore::MultiLineString:
+    case FeatureStore::MultiPolygon:
+    case FeatureStore::GeometryCollection:
+        // Members are full geometries and become parts of the feature;
+        // collection members of any type are flattened into simple parts
+        if (!readCount(count, littleEndian)) {
+            return false;
+        }
+        for (quint32 member = 0; member < count; ++member) {
+            FeatureStore::GeometryType memberType;
+            if (!readGeometry(store, memberType, depth + 1)) {
+                return false;
+            }
+            if (type != FeatureStore::GeometryCollection && memberType != type - 3) {
+                return false;
+            }
+        }
+        return true;
+    case FeatureStore::NoGeometry:
+        break;
+    }
+    return false;
+}
+
+bool WkbReader::readPoints(FeatureStore* store, quint32 count, int dimensions, bool littleEndian)
+{
+    qsizetype stride = dimensions * 8;
+    if (qsizetype(count) > (m_wkb.size() - m_pos) / stride) {
+        return false;
+    }
+    
+    const char* data = m_wkb.data() + m_pos;
+    for (quint32 i = 0; i < count; ++i, data += stride) {
+        double x = readValue<double>(data, littleEndian);
+        double y = readValue<double>(data + 8, littleEndian);
+        if (store) {
+            store->addCoordinate(x, y);
+        }
+        m_minX = qMin(m_minX, x);
+        m_minY = qMin(m_minY, y);
+        m_maxX = qMax(m_maxX, x);
+        m_maxY = qMax(m_maxY, y);
+    }
+    m_pos += qsizetype(count) * stride;
+    return true;
+}
+
+bool WkbReader::readCount(quint32& count, bool littleEndian)
+{
+    if (m_pos + 4 > m_wkb.size()) {
+        return false;
+    }
+    count = readValue<quint32>(m_wkb.data() + m_pos, littleEndian);
+    m_pos += 4;
+    return true;
+}
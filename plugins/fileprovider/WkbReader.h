@@ -0,0 +1,36 @@
+#pragma once
+
+#include "FeatureStore.h"
+#include <QByteArrayView>
+
+// Parses OGC Well-Known Binary into the current feature of a FeatureStore.
+// ISO and extended (PostGIS) WKB dimension codes are accepted; Z and M
+// ordinates are dropped. Empty points are written as NaN coordinates and
+// read as a feature without parts. Multi* and collection members of a
+// GeometryCollection are flattened into its simple parts.
+class WkbReader
+{
+public:
+    explicit WkbReader(QByteArrayView wkb);
+    
+    // Adds the geometry's parts to the current feature and sets its type.
+    // Invalid geometry leaves the feature without geometry and returns false.
+    bool read(FeatureStore& store);
+    
+    // Extent of the geometry without decoding it; false if it is empty
+    bool bounds(double& minX, double& minY, double& maxX, double& maxY);
+
+private:
+    bool readGeometry(FeatureStore* store, FeatureStore::GeometryType& type, int depth);
+    bool readPoints(FeatureStore* store, quint32 count, int dimensions, bool littleEndian);
+    bool readCount(quint32& count, bool littleEndian);
+    
+    QByteArrayView m_wkb;
+    qsizetype m_pos;
+    
+    // Extent accumulated while the geometry is walked
+    double m_minX;
+    double m_minY;
+    double m_maxX;
+    double m_maxY;
+};
@@ -0,0 +1,207 @@
+#include "WktReader.h"
+#include <charconv>
+
+namespace {
+
+const int MaxDepth = 8;
+
+bool isLetter(char c)
+{
+    return (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z');
+}
+
+bool equalsIgnoreCase(QByteArrayView word, const char* keyword)
+{
+    qsizetype i = 0;
+    for (; i < word.size() && keyword[i]; ++i) {
+        char c = word[i];
+        if (c >= 'a' && c <= 'z') {
+            c = char(c - 'a' + 'A');
+        }
+        if (c != keyword[i]) {
+            return false;
+        }
+    }
+    return i == word.size() && !keyword[i];
+}
+
+FeatureStore::GeometryType typeFromKeyword(QByteArrayView word)
+{
+    static const struct {
+        const char* keyword;
+        FeatureStore::GeometryType type;
+    } types[] = {
+        {"POINT", FeatureStore::Point},
+        {"LINESTRING", FeatureStore::LineString},
+        {"POLYGON", FeatureStore::Polygon},
+        {"MULTIPOINT", FeatureStore::MultiPoint},
+        {"MULTILINESTRING", FeatureStore::MultiLineString},
+        {"MULTIPOLYGON", FeatureStore::MultiPolygon},
+        {"GEOMETRYCOLLECTION", FeatureStore::GeometryCollection}
+    };
+    for (const auto& entry : types) {
+        if (equalsIgnoreCase(word, entry.keyword)) {
+            return entry.type;
+        }
+    }
+    return FeatureStore::NoGeometry;
+}
+
+} // namespace
+
+WktReader::WktReader(QByteArrayView text)
+    : m_text(text)
+    , m_pos(0)
+{
+}
+
+bool WktReader::read(FeatureStore& store)
+{
+    // Skip the SRID prefix of EWKT
+    skipSpace();
+    if (m_text.sliced(m_pos).startsWith("SRID=")) {
+        qsizetype separator = m_text.indexOf(';', m_pos);
+        if (separator < 0) {
+            return false;
+        }
+        m_pos = separator + 1;
+    }
+    
+    FeatureStore::GeometryType type = FeatureStore::NoGeometry;
+    bool valid = readGeometry(store, type, 0);
+    skipSpace();
+    if (!valid || m_pos != m_text.size()) {
+        store.clearGeometry();
+        return false;
+    }
+    store.setGeometryType(type);
+    return true;
+}
+
+bool WktReader::readGeometry(FeatureStore& store, FeatureStore::GeometryType& type, int depth)
+{
+    type = typeFromKeyword(readWord());
+    if (type == FeatureStore::NoGeometry || depth > MaxDepth) {
+        return false;
+    }
+    
+    // Optional dimension marker (Z, M or ZM), then EMPTY or the coordinates
+    QByteArrayView word = readWord();
+    if (equalsIgnoreCase(word, "Z") || equalsIgnoreCase(word, "M") || equalsIgnoreCase(word, "ZM")) {
+        word = readWord();
+    }
+    if (equalsIgnoreCase(word, "EMPTY")) {
+        return true;
+    }
+    if (!word.isEmpty()) {
+        return false;
+    }
+    
+    if (type == FeatureStore::GeometryCollection) {
+        // Members become parts of the current feature; Multi* and collection
+        // members add their simple parts
+        if (!consume('(')) {
+            return false;
+        }
+        do {
+            FeatureStore::GeometryType memberType;
+            if (!readGeometry(store, memberType, depth + 1)) {
+                return false;
+            }
+        } while (consume(','));
+        return consume(')');
+    }
+    
+    m_geometry.clear();
+    if (readList(0) < 0) {
+        return false;
+    }
+    m_geometry.write(store, type);
+    return true;
+}
+
+// Reads a parenthesized list into the geometry buffer and returns its
+// height: 1 for a list of positions, 2 for a list of those and so on, or -1
+// on a syntax error. MULTIPOINT members may or may not be parenthesized.
+int WktReader::readList(int depth)
+{
+    if (depth > MaxDepth || !consume('(')) {
+        return -1;
+    }
+    
+    skipSpace();
+    if (m_pos < m_text.size() && m_text[m_pos] == '(') {
+        qsizetype firstLine = m_geometry.lineCount();
+        int height = 0;
+        do {
+            height = qMax(height, readList(depth + 1));
+            if (height < 0) {
+                return -1;
+            }
+        } while (consume(','));
+        if (height == 1) {
+            m_geometry.addPolygon(firstLine);
+        }
+        return consume(')') ? height + 1 : -1;
+    }
+    
+    qsizetype firstCoordinate = m_geometry.coordinateCount();
+    do {
+        double x = 0.0;
+        double y = 0.0;
+        if (!readNumber(x) || !readNumber(y)) {
+            return -1;
+        }
+        // Drop Z and M
+        double extra = 0.0;
+        while (readNumber(extra)) {
+        }
+        m_geometry.addCoordinate(x, y);
+    } while (consume(','));
+    m_geometry.addLine(firstCoordinate);
+    return consume(')') ? 1 : -1;
+}
+
+bool WktReader::readNumber(double& value)
+{
+    skipSpace();
+    const char* begin = m_text.data() + m_pos;
+    const char* end = m_text.data() + m_text.size();
+    if (begin < end && *begin == '+') {
+        ++begin;
+    }
+    auto result = std::from_chars(begin, end, value);
+    if (result.ec != std::errc()) {
+        return false;
+    }
+    m_pos = result.ptr - m_text.data();
+    return true;
+}
+
+QByteArrayView WktReader::readWord()
+{
+    skipSpace();
+    qsizetype start = m_pos;
+    while (m_pos < m_text.size() && isLetter(m_text[m_pos])) {
+        ++m_pos;
+    }
+    return m_text.sliced(start, m_pos - start);
+}
+
+bool WktReader::consume(char c)
+{
+    skipSpace();
+    if (m_pos < m_text.size() && m_text[m_pos] == c) {
+        ++m_pos;
+        return true;
+    }
+    return false;
+}
+
+void WktReader::skipSpace()
+{
+    while (m_pos < m_text.size() && (m_text[m_pos] == ' ' || m_text[m_pos] == '\t'
+                                      || m_text[m_pos] == '\n' || m_text[m_pos] == '\r')) {
+        ++m_pos;
+    }
+}
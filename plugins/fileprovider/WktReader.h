@@ -0,0 +1,31 @@
+#pragma once
+
+#include "FeatureStore.h"
+#include "GeometryBuffer.h"
+#include <QByteArrayView>
+
+// Parses OGC Well-Known Text into the current feature of a FeatureStore.
+// All simple and Multi* types as well as GeometryCollections are supported,
+// collection members flattened into simple parts; Z and M ordinates are
+// accepted and dropped.
+class WktReader
+{
+public:
+    explicit WktReader(QByteArrayView text);
+    
+    // Adds the geometry's parts to the current feature and sets its type.
+    // Invalid text leaves the feature without geometry and returns false.
+    bool read(FeatureStore& store);
+
+private:
+    bool readGeometry(FeatureStore& store, FeatureStore::GeometryType& type, int depth);
+    int readList(int depth);
+    bool readNumber(double& value);
+    QByteArrayView readWord();
+    bool consume(char c);
+    void skipSpace();
+    
+    QByteArrayView m_text;
+    qsizetype m_pos;
+    GeometryBuffer m_geometry;
+};
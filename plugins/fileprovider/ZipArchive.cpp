@@ -0,0 +1,192 @@
+#include "ZipArchive.h"
+#include "InflateDevice.h"
+#include <QBuffer>
+#include <QtEndian>
+
+namespace {
+
+const quint32 LocalHeaderSignature = 0x04034b50;
+const quint32 CentralHeaderSignature = 0x02014b50;
+const quint32 EndOfDirectorySignature = 0x06054b50;
+const quint32 Zip64EndOfDirectorySignature = 0x06064b50;
+const quint32 Zip64LocatorSignature = 0x07064b50;
+
+const qsizetype LocalHeaderSize = 30;
+const qsizetype CentralHeaderSize = 46;
+const qsizetype EndOfDirectorySize = 22;
+const qsizetype Zip64EndOfDirectorySize = 56;
+const qsizetype Zip64LocatorSize = 20;
+const qsizetype MaxCommentSize = 0xffff;
+
+const quint16 EncryptedFlag = 0x0001;
+const quint16 Utf8Flag = 0x0800;
+const quint16 Zip64ExtraId = 0x0001;
+
+enum Method : quint16 {
+    Stored = 0,
+    Deflated = 8
+};
+
+template<typename T>
+T readLE(const char* data)
+{
+    return qFromLittleEndian<T>(data);
+}
+
+// Replaces the 32-bit fields saturated at 0xffffffff with the values from
+// a zip64 extended information field
+void readZip64Extra(const char* extra, qsizetype size, ZipArchive::Entry& entry)
+{
+    qsizetype pos = 0;
+    while (pos + 4 <= size) {
+        quint16 id = readLE<quint16>(extra + pos);
+        quint16 length = readLE<quint16>(extra + pos + 2);
+        pos += 4;
+        if (pos + length > size) {
+            return;
+        }
+        if (id == Zip64ExtraId) {
+            qsizetype field = pos;
+            qsizetype end = pos + length;
+            qint64* values[] = {&entry.uncompressedSize, &entry.compressedSize, &entry.headerOffset};
+            for (qint64* value : values) {
+                if (*value == 0xffffffff && field + 8 <= end) {
+                    *value = qint64(readLE<quint64>(extra + field));
+                    field += 8;
+                }
+            }
+            return;
+        }
+        pos += length;
+    }
+}
+
+} // namespace
+
+bool ZipArchive::open(const QString& filePath)
+{
+    m_entries.clear();
+    m_error.clear();
+    
+    if (!m_file.open(filePath)) {
+        m_error = m_file.errorString();
+        return false;
+    }
+    return readCentralDirectory();
+}
+
+bool ZipArchive::readCentralDirectory()
+{
+    const char* data = m_file.data();
+    qsizetype size = m_file.size();
+    
+    // The end of central directory record sits behind an optional comment
+    qsizetype end = -1;
+    qsizetype lowest = qMax<qsizetype>(0, size - EndOfDirectorySize - MaxCommentSize);
+    for (qsizetype pos = size - EndOfDirectorySize; pos >= lowest; --pos) {
+        if (readLE<quint32>(data + pos) == EndOfDirectorySignature) {
+            end = pos;
+            break;
+        }
+    }
+    if (end < 0) {
+        m_error = "Not a zip archive";
+        return false;
+    }
+    
+    qint64 entryCount = readLE<quint16>(data + end + 10);
+    qint64 directorySize = readLE<quint32>(data + end + 12);
+    qint64 directoryOffset = readLE<quint32>(data + end + 16);
+    
+    qsizetype locator = end - Zip64LocatorSize;
+    if (locator >= 0 && readLE<quint32>(data + locator) == Zip64LocatorSignature) {
+        qint64 record = qint64(readLE<quint64>(data + locator + 8));
+        if (record < 0 || record + Zip64EndOfDirectorySize > size
+            || readLE<quint32>(data + record) != Zip64EndOfDirectorySignature) {
+            m_error = "Corrupt zip64 end of central directory";
+            return false;
+        }
+        entryCount = qint64(readLE<quint64>(data + record + 32));
+        directorySize = qint64(readLE<quint64>(data + record + 40));
+        directoryOffset = qint64(readLE<quint64>(data + record + 48));
+    }
+    
+    if (directoryOffset < 0 || directorySize < 0 || directoryOffset + directorySize > size) {
+        m_error = "Corrupt zip central directory";
+        return false;
+    }
+    
+    m_entries.reserve(qMin<qint64>(entryCount, directorySize / CentralHeaderSize));
+    qsizetype pos = directoryOffset;
+    qsizetype directoryEnd = directoryOffset + directorySize;
+    for (qint64 i = 0; i < entryCount; ++i) {
+        if (pos + CentralHeaderSize > directoryEnd || readLE<quint32>(data + pos) != CentralHeaderSignature) {
+            m_error = "Corrupt zip central directory";
+            return false;
+        }
+        
+        Entry entry;
+        entry.flags = readLE<quint16>(data + pos + 8);
+        entry.method = readLE<quint16>(data + pos + 10);
+        entry.compressedSize = readLE<quint32>(data + pos + 20);
+        entry.uncompressedSize = readLE<quint32>(data + pos + 24);
+        quint16 nameLength = readLE<quint16>(data + pos + 28);
+        quint16 extraLength = readLE<quint16>(data + pos + 30);
+        quint16 commentLength = readLE<quint16>(data + pos + 32);
+        entry.headerOffset = readLE<quint32>(data + pos + 42);
+        
+        const char* name = data + pos + CentralHeaderSize;
+        pos += CentralHeaderSize + nameLength + extraLength + commentLength;
+        if (pos > directoryEnd) {
+            m_error = "Corrupt zip central directory";
+            return false;
+        }
+        
+        entry.name = entry.flags & Utf8Flag ? QString::fromUtf8(name, nameLength) : QString::fromLatin1(name, nameLength);
+        readZip64Extra(name + nameLength, extraLength, entry);
+        m_entries.append(entry);
+    }
+    return true;
+}
+
+std::unique_ptr<QIODevice> ZipArchive::openEntry(const Entry& entry)
+{
+    const char* data = m_file.data();
+    qsizetype size = m_file.size();
+    
+    if (entry.flags & EncryptedFlag) {
+        m_error = QString("%1 is encrypted").arg(entry.name);
+        return nullptr;
+    }
+    if (entry.headerOffset < 0 || entry.headerOffset + LocalHeaderSize > size
+        || readLE<quint32>(data + entry.headerOffset) != LocalHeaderSignature) {
+        m_error = QString("Corrupt local header for %1").arg(entry.name);
+        return nullptr;
+    }
+    
+    // The local header repeats the name but may carry a different extra field
+    qint64 begin = entry.headerOffset + LocalHeaderSize + readLE<quint16>(data + entry.headerOffset + 26)
+        + readLE<quint16>(data + entry.headerOffset + 28);
+    if (entry.compressedSize < 0 || begin + entry.compressedSize > size) {
+        m_error = QString("%1 is truncated").arg(entry.name);
+        return nullptr;
+    }
+    
+    std::unique_ptr<QIODevice> device;
+    if (entry.method == Stored) {
+        auto buffer = std::make_unique<QBuffer>();
+        buffer->setData(QByteArray::fromRawData(data + begin, entry.compressedSize));
+        device = std::move(buffer);
+    } else if (entry.method == Deflated) {
+        device = std::make_unique<InflateDevice>(data + begin, entry.compressedSize);
+    } else {
+        m_error = QString("Unsupported compression method %1 for %2").arg(entry.method).arg(entry.name);
+        return nullptr;
+    }
+    
+    if (!device->open(QIODevice::ReadOnly)) {
+        m_error = device->errorString();
+        return nullptr;
+    }
+    return device;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "MappedFile.h"
+#include <QIODevice>
+#include <QString>
+#include <QVector>
+#include <memory>
+
+// Read-only access to the members of a zip archive such as a KMZ. Only the
+// central directory is parsed up front; members are read straight from the
+// mapped archive and deflated ones are inflated as they are consumed.
+class ZipArchive
+{
+public:
+    struct Entry {
+        QString name;
+        quint16 flags = 0;
+        quint16 method = 0;
+        qint64 compressedSize = 0;
+        qint64 uncompressedSize = 0;
+        qint64 headerOffset = 0;
+    };
+    
+    bool open(const QString& filePath);
+    const QVector<Entry>& entries() const { return m_entries; }
+    
+    // Returns an open device streaming the uncompressed member, or nullptr
+    std::unique_ptr<QIODevice> openEntry(const Entry& entry);
+    
+    QString errorString() const { return m_error; }
+
+private:
+    bool readCentralDirectory();
+    
+    MappedFile m_file;
+    QVector<Entry> m_entries;
+    QString m_error;
+};
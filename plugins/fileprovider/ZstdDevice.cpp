@@ -0,0 +1,102 @@
+#include "ZstdDevice.h"
+
+ZstdDevice::ZstdDevice(const char* data, qsizetype size)
+    : m_data(data)
+    , m_size(size)
+    , m_stream(nullptr)
+    , m_input()
+    , m_frameDone(true)
+    , m_finished(false)
+{
+}
+
+ZstdDevice::~ZstdDevice()
+{
+    close();
+}
+
+bool ZstdDevice::open(OpenMode mode)
+{
+    if (mode != ReadOnly) {
+        setErrorString("Compressed data can only be read");
+        return false;
+    }
+    
+    if (!m_stream) {
+        m_stream = ZSTD_createDStream();
+    }
+    if (!m_stream || ZSTD_isError(ZSTD_initDStream(m_stream))) {
+        setErrorString("Cannot initialize decompression");
+        return false;
+    }
+    m_input.src = m_data;
+    m_input.size = size_t(m_size);
+    m_input.pos = 0;
+    m_frameDone = true;
+    m_finished = m_size == 0;
+    return QIODevice::open(mode);
+}
+
+void ZstdDevice::close()
+{
+    if (m_stream) {
+        ZSTD_freeDStream(m_stream);
+        m_stream = nullptr;
+    }
+    if (isOpen()) {
+        QIODevice::close();
+    }
+}
+
+bool ZstdDevice::atEnd() const
+{
+    return m_finished && QIODevice::bytesAvailable() == 0;
+}
+
+qint64 ZstdDevice::contentSize(const char* data, qsizetype size)
+{
+    unsigned long long content = ZSTD_getFrameContentSize(data, size_t(size));
+    if (content == ZSTD_CONTENTSIZE_UNKNOWN || content == ZSTD_CONTENTSIZE_ERROR) {
+        return -1;
+    }
+    return qint64(content);
+}
+
+qint64 ZstdDevice::readData(char* data, qint64 maxSize)
+{
+    if (!m_stream || m_finished) {
+        return 0;
+    }
+    
+    ZSTD_outBuffer output = {data, size_t(maxSize), 0};
+    while (output.pos < output.size) {
+        bool inputLeft = m_input.pos < m_input.size;
+        if (!inputLeft && m_frameDone) {
+            m_finished = true;
+            break;
+        }
+        // Without input left the decoder may still flush what it holds
+        size_t produced = output.pos;
+        size_t status = ZSTD_decompressStream(m_stream, &output, &m_input);
+        if (ZSTD_isError(status)) {
+            setErrorString(QString::fromLatin1(ZSTD_getErrorName(status)));
+            break;
+        }
+        m_frameDone = status == 0;
+        if (!inputLeft && !m_frameDone && output.pos == produced) {
+            // A stream may only end between frames
+            setErrorString("Compressed data is truncated");
+            break;
+        }
+    }
+    
+    if (output.pos == 0 && !m_finished) {
+        return -1;
+    }
+    return qint64(output.pos);
+}
+
+qint64 ZstdDevice::writeData(const char*, qint64)
+{
+    return -1;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <QIODevice>
+#include <zstd.h>
+
+// Sequential device that decompresses Zstandard data held in memory as it
+// is read, the counterpart of InflateDevice for .zst files. Concatenated
+// frames are read as one stream.
+class ZstdDevice : public QIODevice
+{
+public:
+    ZstdDevice(const char* data, qsizetype size);
+    ~ZstdDevice() override;
+    
+    bool open(OpenMode mode) override;
+    void close() override;
+    bool isSequential() const override { return true; }
+    bool atEnd() const override;
+    
+    // Decompressed size recorded in the first frame's header, or -1
+    static qint64 contentSize(const char* data, qsizetype size);
+
+protected:
+    qint64 readData(char* data, qint64 maxSize) override;
+    qint64 writeData(const char* data, qint64 maxSize) override;
+
+private:
+    Q_DISABLE_COPY(ZstdDevice)
+    
+    const char* m_data;
+    qsizetype m_size;
+    ZSTD_DStream* m_stream;
+    ZSTD_inBuffer m_input;
+    // Whether the last frame read was complete
+    bool m_frameDone;
+    bool m_finished;
+};
@@ -0,0 +1,149 @@
+// Measures GeoJSON ingest throughput against the number of worker threads.
+//
+// Usage: geojson_ingest_bench [file.geojson] [--features N] [--max-threads N] [--repeat N]
+//
+// Without a file a synthetic FeatureCollection of mixed points and polygons
+// with a handful of properties is generated in memory.
+
+#include "FeatureStore.h"
+#include "MappedFile.h"
+#include "ParallelGeoJsonReader.h"
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QTextStream>
+#include <QThread>
+
+namespace {
+
+QByteArray generateCollection(int featureCount)
+{
+    QByteArray json;
+    json.reserve(qsizetype(featureCount) * 300);
+    json += "{\"type\":\"FeatureCollection\",\"name\":\"bench\",\"features\":[\n";
+    
+    for (int i = 0; i < featureCount; ++i) {
+        double x = -180.0 + (i % 3600) * 0.1;
+        double y = -80.0 + (i / 3600 % 1600) * 0.1;
+        if (i > 0) {
+            json += ",\n";
+        }
+        json += "{\"type\":\"Feature\",\"id\":" + QByteArray::number(i) + ",\"geometry\":";
+        if (i % 4 == 0) {
+            json += "{\"type\":\"Polygon\",\"coordinates\":[[";
+            json += "[" + QByteArray::number(x, 'f', 6) + "," + QByteArray::number(y, 'f', 6) + "],";
+            json += "[" + QByteArray::number(x + 0.05, 'f', 6) + "," + QByteArray::number(y, 'f', 6) + "],";
+            json += "[" + QByteArray::number(x + 0.05, 'f', 6) + "," + QByteArray::number(y + 0.05, 'f', 6) + "],";
+            json += "[" + QByteArray::number(x, 'f', 6) + "," + QByteArray::number(y, 'f', 6) + "]]]}";
+        } else {
+            json += "{\"type\":\"Point\",\"coordinates\":[" + QByteArray::number(x, 'f', 6) + ","
+                + QByteArray::number(y, 'f', 6) + "]}";
+        }
+        json += ",\"properties\":{\"name\":\"feature " + QByteArray::number(i) + "\",\"population\":"
+            + QByteArray::number(i * 7 % 100000) + ",\"elevation\":" + QByteArray::number(i * 0.25, 'f', 2)
+            + ",\"active\":" + (i % 2 ? "true" : "false") + ",\"category\":\"class-" + QByteArray::number(i % 16)
+            + "\"}}";
+    }
+    
+    json += "\n]}\n";
+    return json;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+    QTextStream out(stdout);
+    
+    QString filePath;
+    int featureCount = 500000;
+    int maxThreads = QThread::idealThreadCount();
+    int repeat = 3;
+    
+    QStringList args = app.arguments();
+    for (int i = 1; i < args.size(); ++i) {
+        if (args[i] == "--features" && i + 1 < args.size()) {
+            featureCount = args[++i].toInt();
+        } else if (args[i] == "--max-threads" && i + 1 < args.size()) {
+            maxThreads = args[++i].toInt();
+        } else if (args[i] == "--repeat" && i + 1 < args.size()) {
+            repeat = args[++i].toInt();
+        } else {
+            filePath = args[i];
+        }
+    }
+    
+    MappedFile file;
+    QByteArray generated;
+    const char* data = nullptr;
+    qsizetype size = 0;
+    
+    if (!filePath.isEmpty()) {
+        if (!file.open(filePath)) {
+            out << "Cannot open " << filePath << ": " << file.errorString() << Qt::endl;
+            return 1;
+        }
+        data = file.data();
+        size = file.size();
+    } else {
+        generated = generateCollection(featureCount);
+        data = generated.constData();
+        size = generated.size();
+    }
+    
+    double megabytes = double(size) / (1024.0 * 1024.0);
+    out << QString("Input: %1 MB, best of %2 runs").arg(megabytes, 0, 'f', 1).arg(repeat) << Qt::endl;
+    out << QString("%1 %2 %3 %4 %5 %6")
+               .arg("threads", 8)
+               .arg("features", 10)
+               .arg("seconds", 9)
+               .arg("MB/s", 9)
+               .arg("speedup", 8)
+               .arg("efficiency", 11)
+        << Qt::endl;
+    
+    double baseline = 0.0;
+    QList<int> threadCounts;
+    for (int threads = 1; threads < maxThreads; threads *= 2) {
+        threadCounts.append(threads);
+    }
+    threadCounts.append(maxThreads);
+    
+    for (int threads : threadCounts) {
+        double best = -1.0;
+        qsizetype features = 0;
+        
+        for (int run = 0; run < repeat; ++run) {
+            FeatureStore store;
+            ParallelGeoJsonReader reader(data, size);
+            reader.setThreadCount(threads);
+            
+            QElapsedTimer timer;
+            timer.start();
+            if (!reader.read(store)) {
+                out << "Parse failed: " << reader.errorString() << Qt::endl;
+                return 1;
+            }
+            double seconds = timer.nsecsElapsed() / 1e9;
+            if (best < 0.0 || seconds < best) {
+                best = seconds;
+            }
+            features = store.featureCount();
+        }
+        
+        if (threads == 1) {
+            baseline = best;
+        }
+        double speedup = baseline / best;
+        out << QString("%1 %2 %3 %4 %5 %6")
+                   .arg(threads, 8)
+                   .arg(features, 10)
+                   .arg(best, 9, 'f', 3)
+                   .arg(megabytes / best, 9, 'f', 1)
+                   .arg(speedup, 8, 'f', 2)
+                   .arg(QString("%1%").arg(100.0 * speedup / threads, 0, 'f', 0), 11)
+            << Qt::endl;
+    }
+    
+    return 0;
+}
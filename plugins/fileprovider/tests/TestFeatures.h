@@ -0,0 +1,94 @@
+#pragma once
+
+#include "FeatureStore.h"
+#include <QString>
+
+// Deterministic sample layers shared by the reader and writer tests
+
+// Coordinate in [-180, 180) x [-90, 90) derived from a feature and a vertex
+// number, so every test builds the same layer
+inline void addSampleCoordinate(FeatureStore& store, int feature, int vertex)
+{
+    quint32 seed = quint32(feature) * 2654435761u + quint32(vertex) * 40503u;
+    seed ^= seed >> 15;
+    seed *= 2246822519u;
+    seed ^= seed >> 13;
+    double x = -180.0 + 360.0 * double(seed & 0xFFFF) / 65536.0;
+    double y = -90.0 + 180.0 * double(seed >> 16) / 65536.0;
+    store.addCoordinate(x + vertex * 0.125, y + vertex * 0.0625);
+}
+
+inline void addSampleRing(FeatureStore& store, int feature, int firstVertex, int vertices, bool closed)
+{
+    store.beginRing();
+    for (int vertex = 0; vertex < vertices; ++vertex) {
+        addSampleCoordinate(store, feature, firstVertex + vertex);
+    }
+    if (closed) {
+        addSampleCoordinate(store, feature, firstVertex);
+    }
+}
+
+// Geometry of a given type for a feature; NoGeometry adds nothing
+inline void addSampleGeometry(FeatureStore& store, int id, FeatureStore::GeometryType type)
+{
+    switch (type) {
+    case FeatureStore::Point:
+        store.beginPart(FeatureStore::Point);
+        addSampleRing(store, id, 0, 1, false);
+        break;
+    case FeatureStore::LineString:
+        store.beginPart(FeatureStore::LineString);
+        addSampleRing(store, id, 0, 2 + id % 5, false);
+        break;
+    case FeatureStore::Polygon:
+        store.beginPart(FeatureStore::Polygon);
+        addSampleRing(store, id, 0, 4, true);
+        if (id % 2) {
+            addSampleRing(store, id, 8, 3, true);
+        }
+        break;
+    case FeatureStore::MultiPoint:
+        for (int part = 0; part < 3; ++part) {
+            store.beginPart(FeatureStore::Point);
+            addSampleRing(store, id, part, 1, false);
+        }
+        break;
+    case FeatureStore::MultiLineString:
+        for (int part = 0; part < 2; ++part) {
+            store.beginPart(FeatureStore::LineString);
+            addSampleRing(store, id, part * 4, 3, false);
+        }
+        break;
+    case FeatureStore::MultiPolygon:
+        for (int part = 0; part < 2; ++part) {
+            store.beginPart(FeatureStore::Polygon);
+            addSampleRing(store, id, part * 8, 3, true);
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+// Features cycling through every simple and Multi* geometry type and
+// features without geometry. Properties cover each column type: "id"
+// (unique integer), "name" (text with a delimiter, quotes, a line break and
+// non-ASCII characters), "value" (double, null on every fifth feature) and
+// "flag" (boolean).
+inline FeatureStore sampleFeatures(int count)
+{
+    FeatureStore store;
+    for (int id = 0; id < count; ++id) {
+        FeatureStore::GeometryType type = FeatureStore::GeometryType(id % 7);
+        store.beginFeature(type);
+        addSampleGeometry(store, id, type);
+        
+        store.setProperty("id", qint64(id));
+        store.setProperty("name", QString("feature %1, \"ü\"\nnext line").arg(id));
+        store.setProperty("value", id % 5 ? QVariant(id * 0.5 - 100.25) : QVariant());
+        store.setProperty("flag", id % 3 == 0);
+        store.endFeature();
+    }
+    return store;
+}
@@ -0,0 +1,250 @@
+#include "ArrowReader.h"
+#include "ArrowWriter.h"
+#include "TestFeatures.h"
+#include "WktReader.h"
+#include <QBuffer>
+#include <QObject>
+#include <QTest>
+#include <QThread>
+#include <QThreadPool>
+
+namespace {
+
+QByteArray writeArrow(const FeatureStore& store, qsizetype batchSize = 65536)
+{
+    QByteArray data;
+    QBuffer buffer(&data);
+    buffer.open(QIODevice::WriteOnly);
+    ArrowWriter writer(&buffer);
+    writer.setBatchSize(batchSize);
+    return writer.write(store) ? data : QByteArray();
+}
+
+// Features of one geometry type, every fourth without geometry, with an
+// integer and a text property
+FeatureStore singleTypeFeatures(FeatureStore::GeometryType type, int count)
+{
+    FeatureStore store;
+    for (int id = 0; id < count; ++id) {
+        FeatureStore::GeometryType featureType = id % 4 == 3 ? FeatureStore::NoGeometry : type;
+        store.beginFeature(featureType);
+        addSampleGeometry(store, id, featureType);
+        store.setProperty("id", qint64(id));
+        store.setProperty("name", QString("feature %1").arg(id));
+        store.endFeature();
+    }
+    return store;
+}
+
+// Features as read back: feature ids are not written
+QVariantMap withoutId(const FeatureStore& store, qsizetype feature)
+{
+    QVariantMap map = store.featureAt(feature);
+    map.remove("id");
+    return map;
+}
+
+} // namespace
+
+class TestArrow : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void roundTripsMixedGeometryAsWkb();
+    void flattensNestedCollections();
+    void roundTripsNativeEncodings();
+    void widensSingleGeometriesToMulti();
+    void roundTripsAcrossBatchesAndThreads();
+    void readsRecordRanges();
+    void rejectsTruncatedFiles();
+    void survivesCorruptedBytes();
+};
+
+void TestArrow::roundTripsMixedGeometryAsWkb()
+{
+    FeatureStore store = sampleFeatures(300);
+    QByteArray data = writeArrow(store);
+    QVERIFY(!data.isEmpty());
+    
+    ArrowReader reader(data.constData(), data.size());
+    FeatureStore read;
+    QVERIFY(reader.read(read));
+    QCOMPARE(reader.geometryEncoding(), QString("geoarrow.wkb"));
+    QCOMPARE(reader.featureCount(), qint64(300));
+    QCOMPARE(read.columnNames(), store.columnNames());
+    QCOMPARE(read.featureCount(), store.featureCount());
+    for (qsizetype feature = 0; feature < store.featureCount(); ++feature) {
+        QCOMPARE(withoutId(read, feature), withoutId(store, feature));
+    }
+}
+
+void TestArrow::flattensNestedCollections()
+{
+    // A collection with Multi* and collection members keeps every part
+    // through WKB
+    FeatureStore store;
+    store.beginFeature();
+    QVERIFY(WktReader("GEOMETRYCOLLECTION (MULTIPOINT ((3 4), (5 6)), GEOMETRYCOLLECTION (POINT (1 2), "
+                      "MULTILINESTRING ((7 8, 9 10), (11 12, 13 14))), POLYGON ((0 0, 4 0, 4 4, 0 0)))").read(store));
+    store.endFeature();
+    QCOMPARE(store.geometryType(0), FeatureStore::GeometryCollection);
+    QCOMPARE(store.partEnd(0) - store.partBegin(0), qsizetype(6));
+    
+    QByteArray data = writeArrow(store);
+    QVERIFY(!data.isEmpty());
+    ArrowReader reader(data.constData(), data.size());
+    FeatureStore read;
+    QVERIFY(reader.read(read));
+    QCOMPARE(reader.geometryEncoding(), QString("geoarrow.wkb"));
+    QCOMPARE(read.featureAt(0), store.featureAt(0));
+}
+
+void TestArrow::roundTripsNativeEncodings()
+{
+    static const char* const Encodings[] = {"geoarrow.point", "geoarrow.linestring", "geoarrow.polygon",
+                                            "geoarrow.multipoint", "geoarrow.multilinestring", "geoarrow.multipolygon"};
+    for (int type = FeatureStore::Point; type <= FeatureStore::MultiPolygon; ++type) {
+        FeatureStore store = singleTypeFeatures(FeatureStore::GeometryType(type), 101);
+        QByteArray data = writeArrow(store, 16);
+        QVERIFY(!data.isEmpty());
+        
+        ArrowReader reader(data.constData(), data.size());
+        FeatureStore read;
+        QVERIFY(reader.read(read));
+        QCOMPARE(reader.geometryEncoding(), QString(Encodings[type - 1]));
+        QCOMPARE(read.featureCount(), store.featureCount());
+        for (qsizetype feature = 0; feature < store.featureCount(); ++feature) {
+            QCOMPARE(withoutId(read, feature), withoutId(store, feature));
+        }
+    }
+}
+
+void TestArrow::widensSingleGeometriesToMulti()
+{
+    // Points and multipoints share the multipoint encoding, so points come
+    // back as multipoints with one part and the same coordinates
+    FeatureStore store;
+    for (int id = 0; id < 50; ++id) {
+        FeatureStore::GeometryType type = id % 2 ? FeatureStore::MultiPoint : FeatureStore::Point;
+        store.beginFeature(type);
+        addSampleGeometry(store, id, type);
+        store.setProperty("id", qint64(id));
+        store.endFeature();
+    }
+    QByteArray data = writeArrow(store);
+    QVERIFY(!data.isEmpty());
+    
+    ArrowReader reader(data.constData(), data.size());
+    FeatureStore read;
+    QVERIFY(reader.read(read));
+    QCOMPARE(reader.geometryEncoding(), QString("geoarrow.multipoint"));
+    QCOMPARE(read.featureCount(), store.featureCount());
+    for (qsizetype feature = 0; feature < read.featureCount(); ++feature) {
+        QCOMPARE(read.geometryType(feature), FeatureStore::MultiPoint);
+        QCOMPARE(read.partEnd(feature) - read.partBegin(feature), store.partEnd(feature) - store.partBegin(feature));
+    }
+    QCOMPARE(read.coordinateCount(), store.coordinateCount());
+    for (qsizetype coordinate = 0; coordinate < store.coordinateCount(); ++coordinate) {
+        QCOMPARE(read.x(coordinate), store.x(coordinate));
+        QCOMPARE(read.y(coordinate), store.y(coordinate));
+    }
+}
+
+void TestArrow::roundTripsAcrossBatchesAndThreads()
+{
+    // Enough rows in small batches for the reader to split the file, which
+    // must not change the features or their order
+    FeatureStore store = sampleFeatures(140000);
+    QByteArray data = writeArrow(store, 5000);
+    QVERIFY(!data.isEmpty());
+    
+    for (int threads : {1, 4}) {
+        ArrowReader reader(data.constData(), data.size());
+        reader.setThreadCount(threads);
+        FeatureStore read;
+        QVERIFY(reader.read(read));
+        QCOMPARE(read.featureCount(), store.featureCount());
+        QCOMPARE(read.coordinateCount(), store.coordinateCount());
+        for (qsizetype feature = 0; feature < store.featureCount(); feature += 997) {
+            QCOMPARE(withoutId(read, feature), withoutId(store, feature));
+        }
+        QCOMPARE(withoutId(read, store.featureCount() - 1), withoutId(store, store.featureCount() - 1));
+    }
+    
+    // The calling thread reads runs too, so a pool that never runs the
+    // read's tasks does not stall it
+    QThreadPool pool;
+    pool.setMaxThreadCount(1);
+    pool.start([]() { QThread::msleep(200); });
+    ArrowReader reader(data.constData(), data.size());
+    reader.setThreadCount(4);
+    FeatureStore read;
+    QVERIFY(reader.read(read, IngestProgress(), &pool));
+    QCOMPARE(read.featureCount(), store.featureCount());
+    QCOMPARE(withoutId(read, store.featureCount() - 1), withoutId(store, store.featureCount() - 1));
+    pool.waitForDone();
+}
+
+void TestArrow::readsRecordRanges()
+{
+    // Ranges within a batch, across batch boundaries and past the end
+    FeatureStore store = sampleFeatures(100);
+    QByteArray data = writeArrow(store, 7);
+    QVERIFY(!data.isEmpty());
+    
+    const QList<QPair<qint64, qint64>> ranges = {{0, 100}, {0, 1}, {3, 5}, {5, 30}, {7, 14}, {99, 100}, {90, 200}, {50, 50}};
+    for (const auto& range : ranges) {
+        ArrowReader reader(data.constData(), data.size());
+        FeatureStore read;
+        QVERIFY(reader.readRecords(read, range.first, range.second));
+        qint64 last = qMin<qint64>(range.second, store.featureCount());
+        QCOMPARE(read.featureCount(), qsizetype(last - range.first));
+        for (qsizetype feature = 0; feature < read.featureCount(); ++feature) {
+            QCOMPARE(withoutId(read, feature), withoutId(store, range.first + feature));
+        }
+    }
+}
+
+void TestArrow::rejectsTruncatedFiles()
+{
+    // The footer is at the end, so every cut-off file must fail to read
+    for (FeatureStore store : {sampleFeatures(40), singleTypeFeatures(FeatureStore::Polygon, 40)}) {
+        QByteArray data = writeArrow(store, 8);
+        QVERIFY(!data.isEmpty());
+        for (qsizetype size = 0; size < data.size(); ++size) {
+            QByteArray truncated = data.left(size);
+            ArrowReader reader(truncated.constData(), truncated.size());
+            FeatureStore read;
+            QVERIFY(!reader.read(read));
+            QVERIFY(!reader.errorString().isEmpty());
+        }
+    }
+}
+
+void TestArrow::survivesCorruptedBytes()
+{
+    // Damaged files may or may not read, but must stay within their bytes
+    for (FeatureStore store : {sampleFeatures(40), singleTypeFeatures(FeatureStore::MultiPolygon, 40)}) {
+        QByteArray data = writeArrow(store, 8);
+        QVERIFY(!data.isEmpty());
+        quint32 seed = 1;
+        for (int round = 0; round < 2000; ++round) {
+            QByteArray corrupted = data;
+            for (int flip = 0; flip < 4; ++flip) {
+                seed = seed * 1103515245 + 12345;
+                corrupted[qsizetype((seed >> 8) % quint32(corrupted.size()))] = char(seed >> 24);
+            }
+            ArrowReader reader(corrupted.constData(), corrupted.size());
+            FeatureStore read;
+            if (round % 2) {
+                reader.readRecords(read, round % 40, 40);
+            } else {
+                reader.read(read);
+            }
+        }
+    }
+}
+
+QTEST_GUILESS_MAIN(TestArrow)
+#include "tst_arrow.moc"
@@ -0,0 +1,549 @@
+#include "CompressedFile.h"
+#include "InflateDevice.h"
+#include "ReadAheadDevice.h"
+#include "ZipArchive.h"
+#include <QBuffer>
+#include <QFile>
+#include <QObject>
+#include <QTemporaryDir>
+#include <QTest>
+#include <QtEndian>
+#include <zlib.h>
+#ifdef HAVE_ZSTD
+#include "ZstdDevice.h"
+#include <zstd.h>
+#endif
+
+namespace {
+
+const quint16 EncryptedFlag = 0x0001;
+const quint16 Utf8Flag = 0x0800;
+
+bool writeFile(const QString& path, const QByteArray& data)
+{
+    QFile file(path);
+    return file.open(QIODevice::WriteOnly) && file.write(data) == data.size();
+}
+
+// Rows of text that compress about as well as a CSV file
+QByteArray sampleText(qsizetype size)
+{
+    QByteArray text;
+    quint32 seed = 1;
+    for (int id = 0; text.size() < size; ++id) {
+        seed = seed * 1103515245 + 12345;
+        text.append(QByteArray::number(id) + ",road " + QByteArray::number(int(seed >> 20)) + ","
+                    + QByteArray::number(double(seed % 100000) / 1000) + "\n");
+    }
+    text.truncate(size);
+    return text;
+}
+
+// Deflate data with the zlib windowBits of the wanted format: negative for
+// raw deflate, 16 more for gzip
+QByteArray deflateData(const QByteArray& data, int windowBits)
+{
+    z_stream stream = z_stream();
+    if (deflateInit2(&stream, 6, Z_DEFLATED, windowBits, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return QByteArray();
+    }
+    QByteArray out(qsizetype(deflateBound(&stream, uLong(data.size()))), Qt::Uninitialized);
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.constData()));
+    stream.avail_in = uInt(data.size());
+    stream.next_out = reinterpret_cast<Bytef*>(out.data());
+    stream.avail_out = uInt(out.size());
+    int status = deflate(&stream, Z_FINISH);
+    out.truncate(qsizetype(stream.total_out));
+    deflateEnd(&stream);
+    return status == Z_STREAM_END ? out : QByteArray();
+}
+
+QByteArray gzipData(const QByteArray& data)
+{
+    return deflateData(data, 16 + MAX_WBITS);
+}
+
+// Everything the device gives in reads of chunk bytes; ok is cleared when
+// a read fails
+QByteArray readDevice(QIODevice& device, qint64 chunk, bool& ok)
+{
+    QByteArray data;
+    QByteArray buffer(chunk, Qt::Uninitialized);
+    ok = true;
+    while (!device.atEnd()) {
+        qint64 read = device.read(buffer.data(), chunk);
+        if (read <= 0) {
+            ok = read == 0;
+            break;
+        }
+        data.append(buffer.constData(), read);
+    }
+    return data;
+}
+
+template<typename T>
+void appendLE(QByteArray& data, T value)
+{
+    char bytes[sizeof(T)];
+    qToLittleEndian(value, bytes);
+    data.append(bytes, sizeof(T));
+}
+
+struct ZipMember {
+    QByteArray name;
+    QByteArray data;
+    bool deflated = true;
+    quint16 flags = 0;
+    quint16 method = 0;
+};
+
+// A zip archive of the members in order, optionally with zip64 sizes,
+// offsets and end of central directory records, and a comment after the
+// end of the central directory
+QByteArray zipArchive(const QList<ZipMember>& members, bool zip64 = false, const QByteArray& comment = QByteArray())
+{
+    QByteArray archive;
+    QByteArray directory;
+    for (const ZipMember& member : members) {
+        QByteArray stored = member.deflated ? deflateData(member.data, -MAX_WBITS) : member.data;
+        quint16 method = member.method ? member.method : (member.deflated ? 8 : 0);
+        quint32 crc = quint32(crc32(0, reinterpret_cast<const Bytef*>(member.data.constData()), uInt(member.data.size())));
+        quint32 offset = quint32(archive.size());
+        
+        appendLE<quint32>(archive, 0x04034b50);
+        appendLE<quint16>(archive, 20);
+        appendLE<quint16>(archive, member.flags);
+        appendLE<quint16>(archive, method);
+        appendLE<quint32>(archive, 0);
+        appendLE<quint32>(archive, crc);
+        appendLE<quint32>(archive, quint32(stored.size()));
+        appendLE<quint32>(archive, quint32(member.data.size()));
+        appendLE<quint16>(archive, quint16(member.name.size()));
+        appendLE<quint16>(archive, 0);
+        archive.append(member.name);
+        archive.append(stored);
+        
+        QByteArray extra;
+        if (zip64) {
+            appendLE<quint16>(extra, 0x0001);
+            appendLE<quint16>(extra, 24);
+            appendLE<quint64>(extra, quint64(member.data.size()));
+            appendLE<quint64>(extra, quint64(stored.size()));
+            appendLE<quint64>(extra, offset);
+        }
+        appendLE<quint32>(directory, 0x02014b50);
+        appendLE<quint16>(directory, 45);
+        appendLE<quint16>(directory, zip64 ? 45 : 20);
+        appendLE<quint16>(directory, member.flags);
+        appendLE<quint16>(directory, method);
+        appendLE<quint32>(directory, 0);
+        appendLE<quint32>(directory, crc);
+        appendLE<quint32>(directory, zip64 ? 0xffffffff : quint32(stored.size()));
+        appendLE<quint32>(directory, zip64 ? 0xffffffff : quint32(member.data.size()));
+        appendLE<quint16>(directory, quint16(member.name.size()));
+        appendLE<quint16>(directory, quint16(extra.size()));
+        appendLE<quint16>(directory, 0);
+        appendLE<quint16>(directory, 0);
+        appendLE<quint16>(directory, 0);
+        appendLE<quint32>(directory, 0);
+        appendLE<quint32>(directory, zip64 ? 0xffffffff : offset);
+        directory.append(member.name);
+        directory.append(extra);
+    }
+    
+    quint64 directoryOffset = quint64(archive.size());
+    archive.append(directory);
+    if (zip64) {
+        quint64 record = quint64(archive.size());
+        appendLE<quint32>(archive, 0x06064b50);
+        appendLE<quint64>(archive, 44);
+        appendLE<quint16>(archive, 45);
+        appendLE<quint16>(archive, 45);
+        appendLE<quint32>(archive, 0);
+        appendLE<quint32>(archive, 0);
+        appendLE<quint64>(archive, quint64(members.size()));
+        appendLE<quint64>(archive, quint64(members.size()));
+        appendLE<quint64>(archive, quint64(directory.size()));
+        appendLE<quint64>(archive, directoryOffset);
+        appendLE<quint32>(archive, 0x07064b50);
+        appendLE<quint32>(archive, 0);
+        appendLE<quint64>(archive, record);
+        appendLE<quint32>(archive, 1);
+    }
+    appendLE<quint32>(archive, 0x06054b50);
+    appendLE<quint16>(archive, 0);
+    appendLE<quint16>(archive, 0);
+    appendLE<quint16>(archive, zip64 ? 0xffff : quint16(members.size()));
+    appendLE<quint16>(archive, zip64 ? 0xffff : quint16(members.size()));
+    appendLE<quint32>(archive, zip64 ? 0xffffffff : quint32(directory.size()));
+    appendLE<quint32>(archive, zip64 ? 0xffffffff : quint32(directoryOffset));
+    appendLE<quint16>(archive, quint16(comment.size()));
+    archive.append(comment);
+    return archive;
+}
+
+// Content of the archive member, or a null array when it cannot be read
+QByteArray readEntry(ZipArchive& archive, const ZipArchive::Entry& entry)
+{
+    std::unique_ptr<QIODevice> device = archive.openEntry(entry);
+    if (!device) {
+        return QByteArray();
+    }
+    bool ok = false;
+    QByteArray data = readDevice(*device, 4096, ok);
+    return ok ? data : QByteArray();
+}
+
+} // namespace
+
+class TestCompression : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void inflatesEveryFormat();
+    void rejectsDamagedDeflateData();
+    void decompressesZstd();
+    void readsZipMembers();
+    void readsZip64Directories();
+    void rejectsDamagedZips();
+    void opensCompressedFiles();
+    void readsAheadOfReader();
+};
+
+void TestCompression::inflatesEveryFormat()
+{
+    QByteArray data = sampleText(3 << 20);
+    const QList<QPair<InflateDevice::Format, int>> formats = {
+        {InflateDevice::Raw, -MAX_WBITS}, {InflateDevice::Zlib, MAX_WBITS}, {InflateDevice::Gzip, 16 + MAX_WBITS}};
+    for (const auto& format : formats) {
+        QByteArray compressed = deflateData(data, format.second);
+        QVERIFY(!compressed.isEmpty());
+        for (qint64 chunk : {qint64(1000), qint64(65537), qint64(8 << 20)}) {
+            InflateDevice device(compressed.constData(), compressed.size(), format.first);
+            QVERIFY(device.open(QIODevice::ReadOnly));
+            QVERIFY(device.isSequential());
+            bool ok = false;
+            QCOMPARE(readDevice(device, chunk, ok), data);
+            QVERIFY(ok);
+            QCOMPARE(device.compressedPosition(), qint64(compressed.size()));
+        }
+    }
+    
+    // Concatenated gzip members are one stream
+    QByteArray second = sampleText(100000).toUpper();
+    QByteArray members = gzipData(data) + gzipData(second);
+    InflateDevice device(members.constData(), members.size(), InflateDevice::Gzip);
+    QVERIFY(device.open(QIODevice::ReadOnly));
+    bool ok = false;
+    QCOMPARE(readDevice(device, 65536, ok), data + second);
+    QVERIFY(ok);
+    
+    InflateDevice writable(members.constData(), members.size(), InflateDevice::Gzip);
+    QVERIFY(!writable.open(QIODevice::WriteOnly));
+}
+
+void TestCompression::rejectsDamagedDeflateData()
+{
+    QByteArray data = sampleText(1 << 20);
+    QByteArray compressed = gzipData(data);
+    
+    // Cut off anywhere, the stream ends early with an error
+    for (qsizetype size : {qsizetype(0), qsizetype(10), compressed.size() / 2, compressed.size() - 1}) {
+        InflateDevice device(compressed.constData(), size, InflateDevice::Gzip);
+        QVERIFY(device.open(QIODevice::ReadOnly));
+        bool ok = true;
+        QByteArray read = readDevice(device, 65536, ok);
+        QVERIFY(!ok);
+        QVERIFY(data.startsWith(read));
+        QVERIFY(!device.errorString().isEmpty());
+    }
+    
+    // Data that is not deflated at all
+    QByteArray text = "this is not compressed data at all";
+    for (InflateDevice::Format format : {InflateDevice::Zlib, InflateDevice::Gzip}) {
+        InflateDevice device(text.constData(), text.size(), format);
+        QVERIFY(device.open(QIODevice::ReadOnly));
+        bool ok = true;
+        readDevice(device, 4096, ok);
+        QVERIFY(!ok);
+    }
+}
+
+void TestCompression::decompressesZstd()
+{
+#ifdef HAVE_ZSTD
+    QByteArray data = sampleText(3 << 20);
+    QByteArray compressed(qsizetype(ZSTD_compressBound(size_t(data.size()))), Qt::Uninitialized);
+    size_t size = ZSTD_compress(compressed.data(), size_t(compressed.size()), data.constData(), size_t(data.size()), 3);
+    QVERIFY(!ZSTD_isError(size));
+    compressed.truncate(qsizetype(size));
+    QCOMPARE(ZstdDevice::contentSize(compressed.constData(), compressed.size()), qint64(data.size()));
+    
+    for (qint64 chunk : {qint64(1000), qint64(65537)}) {
+        ZstdDevice device(compressed.constData(), compressed.size());
+        QVERIFY(device.open(QIODevice::ReadOnly));
+        bool ok = false;
+        QCOMPARE(readDevice(device, chunk, ok), data);
+        QVERIFY(ok);
+    }
+    
+    // Concatenated frames are one stream
+    QByteArray frames = compressed + compressed;
+    ZstdDevice device(frames.constData(), frames.size());
+    QVERIFY(device.open(QIODevice::ReadOnly));
+    bool ok = false;
+    QCOMPARE(readDevice(device, 65536, ok), data + data);
+    QVERIFY(ok);
+    
+    // A cut-off frame fails
+    ZstdDevice truncated(compressed.constData(), compressed.size() / 2);
+    QVERIFY(truncated.open(QIODevice::ReadOnly));
+    QByteArray read = readDevice(truncated, 65536, ok);
+    QVERIFY(!ok);
+    QVERIFY(data.startsWith(read));
+    QVERIFY(!truncated.errorString().isEmpty());
+    
+    ZstdDevice empty(compressed.constData(), 0);
+    QVERIFY(empty.open(QIODevice::ReadOnly));
+    QVERIFY(empty.atEnd());
+    QCOMPARE(ZstdDevice::contentSize("not zstd", 8), qint64(-1));
+#else
+    QSKIP("Zstandard support is not built in");
+#endif
+}
+
+void TestCompression::readsZipMembers()
+{
+    QTemporaryDir directory;
+    QVERIFY(directory.isValid());
+    QByteArray csv = sampleText(500000);
+    ZipMember folder{"data/", QByteArray(), false};
+    ZipMember roads{"data/roads.csv", csv};
+    ZipMember notes{"notes.txt", "stored as is", false};
+    ZipMember named{"stra\xc3\x9f" "e.kml", "<kml/>", true, Utf8Flag};
+    ZipMember empty{"empty.csv", QByteArray(), true};
+    QString path = directory.filePath("layers.zip");
+    QVERIFY(writeFile(path, zipArchive({folder, roads, notes, named, empty}, false, "archive comment")));
+    
+    ZipArchive archive;
+    QVERIFY(archive.open(path));
+    const QVector<ZipArchive::Entry>& entries = archive.entries();
+    QCOMPARE(entries.size(), qsizetype(5));
+    QCOMPARE(entries[1].name, QString("data/roads.csv"));
+    QCOMPARE(entries[1].method, quint16(8));
+    QCOMPARE(entries[1].uncompressedSize, qint64(csv.size()));
+    QVERIFY(entries[1].compressedSize < csv.size());
+    QCOMPARE(entries[3].name, QString::fromUtf8("stra\xc3\x9f" "e.kml"));
+    
+    QCOMPARE(readEntry(archive, entries[1]), csv);
+    QCOMPARE(readEntry(archive, entries[2]), QByteArray("stored as is"));
+    QCOMPARE(readEntry(archive, entries[3]), QByteArray("<kml/>"));
+    QVERIFY(readEntry(archive, entries[4]).isEmpty());
+}
+
+void TestCompression::readsZip64Directories()
+{
+    // Sizes and offsets saturated in the 32-bit fields come from the zip64
+    // extra fields, and the directory from the zip64 end record
+    QTemporaryDir directory;
+    QByteArray csv = sampleText(200000);
+    QString path = directory.filePath("layers.zip");
+    QVERIFY(writeFile(path, zipArchive({{"first.csv", csv}, {"second.txt", "second member", false}}, true)));
+    
+    ZipArchive archive;
+    QVERIFY(archive.open(path));
+    const QVector<ZipArchive::Entry>& entries = archive.entries();
+    QCOMPARE(entries.size(), qsizetype(2));
+    QCOMPARE(entries[0].uncompressedSize, qint64(csv.size()));
+    QVERIFY(entries[0].compressedSize < csv.size());
+    QCOMPARE(entries[0].headerOffset, qint64(0));
+    QVERIFY(entries[1].headerOffset > entries[0].compressedSize);
+    QCOMPARE(readEntry(archive, entries[0]), csv);
+    QCOMPARE(readEntry(archive, entries[1]), QByteArray("second member"));
+}
+
+void TestCompression::rejectsDamagedZips()
+{
+    QTemporaryDir directory;
+    QString path = directory.filePath("damaged.zip");
+    ZipArchive archive;
+    
+    QVERIFY(writeFile(path, sampleText(1000)));
+    QVERIFY(!archive.open(path));
+    QVERIFY(!archive.errorString().isEmpty());
+    QVERIFY(!archive.open(directory.filePath("missing.zip")));
+    
+    // Encrypted members and unknown methods are not read
+    ZipMember encrypted{"secret.csv", "a,b\n1,2\n", false, EncryptedFlag};
+    ZipMember bzip2{"packed.csv", "a,b\n1,2\n", false, 0, 12};
+    QVERIFY(writeFile(path, zipArchive({encrypted, bzip2})));
+    QVERIFY(archive.open(path));
+    QCOMPARE(archive.entries().size(), qsizetype(2));
+    QVERIFY(!archive.openEntry(archive.entries()[0]));
+    QVERIFY(archive.errorString().contains("encrypted"));
+    QVERIFY(!archive.openEntry(archive.entries()[1]));
+    QVERIFY(archive.errorString().contains("12"));
+    
+    // Members running past the end of the file, or whose local header is
+    // not where the directory says
+    QByteArray csv = sampleText(100000);
+    QVERIFY(writeFile(path, zipArchive({{"roads.csv", csv}})));
+    QVERIFY(archive.open(path));
+    ZipArchive::Entry entry = archive.entries()[0];
+    ZipArchive::Entry truncated = entry;
+    truncated.compressedSize += 1 << 20;
+    QVERIFY(!archive.openEntry(truncated));
+    QVERIFY(archive.errorString().contains("truncated"));
+    ZipArchive::Entry misplaced = entry;
+    misplaced.headerOffset += 1;
+    QVERIFY(!archive.openEntry(misplaced));
+    
+    // A member cut short inflates up to where it stops, then fails
+    ZipArchive::Entry shortened = entry;
+    shortened.compressedSize /= 2;
+    std::unique_ptr<QIODevice> device = archive.openEntry(shortened);
+    QVERIFY(device);
+    bool ok = true;
+    QByteArray read = readDevice(*device, 65536, ok);
+    QVERIFY(!ok);
+    QVERIFY(csv.startsWith(read));
+    
+    // Archives cut off anywhere either fail to open or only give members
+    // that still read or fail cleanly
+    QByteArray data = zipArchive({{"roads.csv", csv.left(5000)}, {"notes.txt", "notes", false}}, true);
+    for (qsizetype size = 0; size < data.size(); size += 7) {
+        QVERIFY(writeFile(path, data.left(size)));
+        if (archive.open(path)) {
+            for (const ZipArchive::Entry& member : archive.entries()) {
+                readEntry(archive, member);
+            }
+        }
+    }
+}
+
+void TestCompression::opensCompressedFiles()
+{
+    QCOMPARE(CompressedFile::compression("roads.csv.gz"), CompressedFile::Gzip);
+    QCOMPARE(CompressedFile::compression("roads.csv.ZST"), CompressedFile::Zstd);
+    QCOMPARE(CompressedFile::compression("layers.zip"), CompressedFile::Zip);
+    QCOMPARE(CompressedFile::compression("roads.csv"), CompressedFile::None);
+    QCOMPARE(CompressedFile::strippedName("/data/roads.csv.gz"), QString("roads.csv"));
+    QCOMPARE(CompressedFile::strippedName("/data/roads.csv"), QString("roads.csv"));
+    
+    // Gzip, read whole and streamed
+    QTemporaryDir directory;
+    QByteArray csv = sampleText(5 << 20);
+    QString gzipPath = directory.filePath("roads.csv.gz");
+    QVERIFY(writeFile(gzipPath, gzipData(csv)));
+    CompressedFile gzip;
+    QVERIFY(gzip.open(gzipPath, {"csv"}));
+    QCOMPARE(gzip.compression(), CompressedFile::Gzip);
+    QCOMPARE(gzip.dataName(), QString("roads.csv"));
+    QCOMPARE(gzip.uncompressedSize(), qint64(csv.size()));
+    QByteArray data;
+    QVERIFY(gzip.readAll(data));
+    QCOMPARE(data, csv);
+    std::unique_ptr<QIODevice> stream = gzip.openStream();
+    QVERIFY(stream);
+    bool ok = false;
+    QCOMPARE(readDevice(*stream, 100000, ok), csv);
+    QVERIFY(ok);
+    
+    // The data member of an archive is picked by suffix preference, and
+    // its siblings are found by name
+    QString zipPath = directory.filePath("layers.zip");
+    QVERIFY(writeFile(zipPath, zipArchive({{"__MACOSX/data/._roads.shp", "resource fork"},
+                                           {"readme.txt", "read me"},
+                                           {"data/roads.shp", "shapes"},
+                                           {"data/roads.DBF", "attributes"},
+                                           {"data/ROADS.csv", csv.left(1000)}})));
+    CompressedFile shapes;
+    QVERIFY(shapes.open(zipPath, {"shp", "csv"}));
+    QCOMPARE(shapes.compression(), CompressedFile::Zip);
+    QCOMPARE(shapes.dataName(), QString("data/roads.shp"));
+    QVERIFY(shapes.readAll(data));
+    QCOMPARE(data, QByteArray("shapes"));
+    QVERIFY(shapes.readSibling("dbf", data));
+    QCOMPARE(data, QByteArray("attributes"));
+    QVERIFY(!shapes.readSibling("prj", data));
+    
+    CompressedFile table;
+    QVERIFY(table.open(zipPath, {"CSV", "shp"}));
+    QCOMPARE(table.dataName(), QString("data/ROADS.csv"));
+    stream = table.openStream();
+    QVERIFY(stream);
+    QCOMPARE(readDevice(*stream, 4096, ok), csv.left(1000));
+    QVERIFY(ok);
+    QVERIFY(table.readSibling("dbf", data));
+    QCOMPARE(data, QByteArray("attributes"));
+    
+    CompressedFile none;
+    QVERIFY(!none.open(zipPath, {"kml"}));
+    QVERIFY(!none.errorString().isEmpty());
+    QVERIFY(!none.open(directory.filePath("roads.csv"), {"csv"}));
+    
+    // Zstandard, when built in
+    QString zstdPath = directory.filePath("roads.csv.zst");
+#ifdef HAVE_ZSTD
+    QByteArray compressed(qsizetype(ZSTD_compressBound(size_t(csv.size()))), Qt::Uninitialized);
+    compressed.truncate(qsizetype(ZSTD_compress(compressed.data(), size_t(compressed.size()), csv.constData(), size_t(csv.size()), 3)));
+    QVERIFY(writeFile(zstdPath, compressed));
+    CompressedFile zstd;
+    QVERIFY(zstd.open(zstdPath, {"csv"}));
+    QCOMPARE(zstd.uncompressedSize(), qint64(csv.size()));
+    stream = zstd.openStream();
+    QVERIFY(stream);
+    QCOMPARE(readDevice(*stream, 100000, ok), csv);
+    QVERIFY(ok);
+#else
+    QVERIFY(writeFile(zstdPath, "zstd"));
+    CompressedFile zstd;
+    QVERIFY(!zstd.open(zstdPath, {"csv"}));
+#endif
+}
+
+void TestCompression::readsAheadOfReader()
+{
+    // More than the blocks queued ahead, read in sizes that straddle them
+    QByteArray data = sampleText(40 << 20);
+    for (qint64 chunk : {qint64(1000), qint64(3 << 20)}) {
+        auto source = std::make_unique<QBuffer>();
+        source->setData(data);
+        QVERIFY(source->open(QIODevice::ReadOnly));
+        ReadAheadDevice device(std::move(source));
+        QVERIFY(device.open(QIODevice::ReadOnly));
+        bool ok = false;
+        QCOMPARE(readDevice(device, chunk, ok), data);
+        QVERIFY(ok);
+        QVERIFY(device.atEnd());
+    }
+    
+    // A failing source fails the reader with its error after its data
+    QByteArray compressed = gzipData(data.left(4 << 20));
+    auto failing = std::make_unique<InflateDevice>(compressed.constData(), compressed.size() / 2, InflateDevice::Gzip);
+    QVERIFY(failing->open(QIODevice::ReadOnly));
+    ReadAheadDevice device(std::move(failing));
+    QVERIFY(device.open(QIODevice::ReadOnly));
+    bool ok = true;
+    QByteArray read = readDevice(device, 65536, ok);
+    QVERIFY(!ok);
+    QVERIFY(!device.atEnd());
+    QVERIFY(data.startsWith(read));
+    QVERIFY(!device.errorString().isEmpty());
+    
+    // Closing before the end stops the producer while its queue is full
+    auto source = std::make_unique<QBuffer>();
+    source->setData(data);
+    QVERIFY(source->open(QIODevice::ReadOnly));
+    ReadAheadDevice abandoned(std::move(source));
+    QVERIFY(abandoned.open(QIODevice::ReadOnly));
+    char first[16];
+    QCOMPARE(abandoned.read(first, sizeof(first)), qint64(sizeof(first)));
+    abandoned.close();
+    
+    QVERIFY(!ReadAheadDevice(std::make_unique<QBuffer>()).open(QIODevice::ReadOnly));
+}
+
+QTEST_GUILESS_MAIN(TestCompression)
+#include "tst_compression.moc"
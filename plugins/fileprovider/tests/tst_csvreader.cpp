@@ -0,0 +1,350 @@
+#include "CsvReader.h"
+#include <QObject>
+#include <QTest>
+#include <QThread>
+#include <QThreadPool>
+
+namespace {
+
+QVariant valueAt(const FeatureStore& store, const QString& column, qsizetype row)
+{
+    int index = store.columnIndex(column);
+    return index >= 0 ? store.columns()[index].value(row) : QVariant();
+}
+
+// Pieces of quoted text, unescaped and as written inside the quotes:
+// line breaks of both kinds, doubled quotes and lines that look like records
+const char* const TextPieces[][2] = {
+    {"plain words ", "plain words "},
+    {"a, b, c ", "a, b, c "},
+    {"\"quoted\" ", "\"\"quoted\"\" "},
+    {"\r\n", "\r\n"},
+    {"\n", "\n"},
+    {"7,8,9,10\r\n", "7,8,9,10\r\n"},
+    {"\"\r\n\"", "\"\"\r\n\"\""}
+};
+
+// CSV of records with a long quoted text field of varying length, so that
+// most bytes are inside quotes and chunk boundaries fall at many positions
+// within records. The first record is padded by shift bytes to move the
+// boundaries between runs.
+QByteArray quotedRecords(qsizetype minSize, int shift, QStringList& texts)
+{
+    QByteArray csv = "id,text,lon,lat\r\n";
+    quint32 seed = 12345;
+    for (int id = 0; csv.size() < minSize; ++id) {
+        QByteArray text;
+        QByteArray escaped;
+        if (id == 0) {
+            text = escaped = QByteArray(shift, 'p');
+        }
+        seed = seed * 1103515245 + 12345;
+        int pieces = 10 + int((seed >> 16) % 40);
+        for (int i = 0; i < pieces; ++i) {
+            seed = seed * 1103515245 + 12345;
+            int piece = int((seed >> 16) % (sizeof(TextPieces) / sizeof(TextPieces[0])));
+            text.append(TextPieces[piece][0]);
+            escaped.append(TextPieces[piece][1]);
+        }
+        texts.append(QString::fromUtf8(text));
+        csv.append(QByteArray::number(id) + ",\"" + escaped + "\"," + QByteArray::number(id % 360 - 180)
+                   + "," + QByteArray::number(id % 180 - 90) + "\r\n");
+    }
+    return csv;
+}
+
+} // namespace
+
+class TestCsvReader : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void readsTypedValues();
+    void readsQuotedFields();
+    void readsPointGeometry();
+    void readsWktGeometry();
+    void detectsDelimiter();
+    void skipsByteOrderMark();
+    void padsAndTruncatesRaggedRows();
+    void skipsBlankLines();
+    void rejectsEmptyInput();
+    void keepsTruncatedQuotedField();
+    void splitsAcrossQuotedLineBreaks();
+    void splitsAtEveryRecordOffset();
+    void splitsWithoutTrailingLineBreak();
+    void readsOnGivenPool();
+};
+
+void TestCsvReader::readsTypedValues()
+{
+    QByteArray text = "name,count,ratio,flag,zip,note\r\n"
+                      "\"12\",12,1.5,TRUE,01234,\r\n"
+                      "plain,-7,.25,false,-0,x\r\n";
+    CsvReader reader(text.constData(), text.size());
+    FeatureStore store;
+    QVERIFY(reader.read(store));
+    QCOMPARE(store.featureCount(), qsizetype(2));
+    
+    // Quoted values stay text, unquoted ones are typed
+    QCOMPARE(store.columns()[store.columnIndex("name")].type(), PropertyColumn::String);
+    QCOMPARE(valueAt(store, "name", 0).toString(), QString("12"));
+    QCOMPARE(store.columns()[store.columnIndex("count")].type(), PropertyColumn::Int);
+    QCOMPARE(valueAt(store, "count", 1).toLongLong(), qint64(-7));
+    QCOMPARE(store.columns()[store.columnIndex("ratio")].type(), PropertyColumn::Double);
+    QCOMPARE(valueAt(store, "ratio", 1).toDouble(), 0.25);
+    QCOMPARE(store.columns()[store.columnIndex("flag")].type(), PropertyColumn::Bool);
+    QCOMPARE(valueAt(store, "flag", 0).toBool(), true);
+    
+    // Leading zeros keep the text, empty fields are null
+    QCOMPARE(valueAt(store, "zip", 0).toString(), QString("01234"));
+    QVERIFY(store.columns()[store.columnIndex("note")].isNull(0));
+    QCOMPARE(valueAt(store, "note", 1).toString(), QString("x"));
+}
+
+void TestCsvReader::readsQuotedFields()
+{
+    QByteArray text = "id,text\n"
+                      "1,\"a, b\"\n"
+                      "2,\"say \"\"hi\"\"\"\n"
+                      "3,\"first\r\nsecond\nthird\"\n"
+                      "4,\"\"\n";
+    CsvReader reader(text.constData(), text.size());
+    FeatureStore store;
+    QVERIFY(reader.read(store));
+    QCOMPARE(store.featureCount(), qsizetype(4));
+    QCOMPARE(valueAt(store, "text", 0).toString(), QString("a, b"));
+    QCOMPARE(valueAt(store, "text", 1).toString(), QString("say \"hi\""));
+    QCOMPARE(valueAt(store, "text", 2).toString(), QString("first\r\nsecond\nthird"));
+    QCOMPARE(valueAt(store, "text", 3).toString(), QString(""));
+    QCOMPARE(valueAt(store, "id", 3).toLongLong(), qint64(4));
+}
+
+void TestCsvReader::readsPointGeometry()
+{
+    QByteArray text = "name,Latitude,Longitude\n"
+                      "a,52.5,13.25\n"
+                      "b,north,13.25\n"
+                      "c,,\n";
+    CsvReader reader(text.constData(), text.size());
+    FeatureStore store;
+    QVERIFY(reader.read(store));
+    QCOMPARE(reader.xField(), QString("Longitude"));
+    QCOMPARE(reader.yField(), QString("Latitude"));
+    QCOMPARE(store.featureCount(), qsizetype(3));
+    
+    QCOMPARE(store.geometryType(0), FeatureStore::Point);
+    qsizetype ring = store.ringBegin(store.partBegin(0));
+    QCOMPARE(store.x(store.coordinateBegin(ring)), 13.25);
+    QCOMPARE(store.y(store.coordinateBegin(ring)), 52.5);
+    
+    // Rows with unreadable coordinates are kept without geometry
+    QCOMPARE(store.geometryType(1), FeatureStore::NoGeometry);
+    QCOMPARE(store.geometryType(2), FeatureStore::NoGeometry);
+    QCOMPARE(valueAt(store, "name", 1).toString(), QString("b"));
+}
+
+void TestCsvReader::readsWktGeometry()
+{
+    QByteArray text = "id;wkt\n"
+                      "1;\"POLYGON ((0 0, 4 0, 4 4, 0 0), (1 1, 2 1, 1 2, 1 1))\"\n"
+                      "2;MULTIPOINT (1 2, 3 4)\n"
+                      "3;\"POLYGON ((0 0, 4 0\"\n"
+                      "4;\"LINESTRING (0 0, 1 1) trailing\"\n";
+    CsvReader reader(text.constData(), text.size());
+    FeatureStore store;
+    QVERIFY(reader.read(store));
+    QCOMPARE(reader.wktField(), QString("wkt"));
+    QCOMPARE(store.featureCount(), qsizetype(4));
+    
+    QCOMPARE(store.geometryType(0), FeatureStore::Polygon);
+    QCOMPARE(store.ringEnd(store.partBegin(0)) - store.ringBegin(store.partBegin(0)), qsizetype(2));
+    QCOMPARE(store.geometryType(1), FeatureStore::MultiPoint);
+    QCOMPARE(store.partEnd(1) - store.partBegin(1), qsizetype(2));
+    
+    // Malformed and truncated WKT leaves the row without geometry
+    QCOMPARE(store.geometryType(2), FeatureStore::NoGeometry);
+    QCOMPARE(store.partEnd(2), store.partBegin(2));
+    QCOMPARE(store.geometryType(3), FeatureStore::NoGeometry);
+    QCOMPARE(valueAt(store, "id", 3).toLongLong(), qint64(4));
+}
+
+void TestCsvReader::detectsDelimiter()
+{
+    QByteArray text = "a;b|c;d\n1;\"2;3\";4\n";
+    CsvReader reader(text.constData(), text.size());
+    FeatureStore store;
+    QVERIFY(reader.read(store));
+    QCOMPARE(store.columnNames(), QStringList({"a", "b|c", "d"}));
+    QCOMPARE(valueAt(store, "b|c", 0).toString(), QString("2;3"));
+}
+
+void TestCsvReader::skipsByteOrderMark()
+{
+    QByteArray text = "\xEF\xBB\xBF" "id,name\r\n1,a\r\n";
+    CsvReader reader(text.constData(), text.size());
+    FeatureStore store;
+    QVERIFY(reader.read(store));
+    QCOMPARE(store.columnNames(), QStringList({"id", "name"}));
+    QCOMPARE(reader.headerEnd(), qsizetype(text.indexOf("1,a")));
+}
+
+void TestCsvReader::padsAndTruncatesRaggedRows()
+{
+    QByteArray text = "a,b,c\n1\n1,2,3,4,5\n,,\n";
+    CsvReader reader(text.constData(), text.size());
+    FeatureStore store;
+    QVERIFY(reader.read(store));
+    QCOMPARE(store.featureCount(), qsizetype(3));
+    QCOMPARE(store.columnNames(), QStringList({"a", "b", "c"}));
+    QVERIFY(store.columns()[store.columnIndex("b")].isNull(0));
+    QVERIFY(store.columns()[store.columnIndex("c")].isNull(0));
+    QCOMPARE(valueAt(store, "c", 1).toLongLong(), qint64(3));
+    QVERIFY(store.columns()[store.columnIndex("a")].isNull(2));
+}
+
+void TestCsvReader::skipsBlankLines()
+{
+    QByteArray text = "a,b\n\n1,2\r\n\r\n3,4";
+    CsvReader reader(text.constData(), text.size());
+    FeatureStore store;
+    QVERIFY(reader.read(store));
+    QCOMPARE(store.featureCount(), qsizetype(2));
+    QCOMPARE(valueAt(store, "b", 1).toLongLong(), qint64(4));
+}
+
+void TestCsvReader::rejectsEmptyInput()
+{
+    QByteArray text;
+    CsvReader reader(text.constData(), text.size());
+    FeatureStore store;
+    QVERIFY(!reader.read(store));
+    QVERIFY(!reader.errorString().isEmpty());
+    QCOMPARE(store.featureCount(), qsizetype(0));
+}
+
+void TestCsvReader::keepsTruncatedQuotedField()
+{
+    // A file cut off inside a quoted field keeps the earlier rows and the
+    // rest of the file as the value of the open field
+    QByteArray text = "id,text\n1,done\n2,\"cut off\nhere";
+    CsvReader reader(text.constData(), text.size());
+    FeatureStore store;
+    QVERIFY(reader.read(store));
+    QCOMPARE(store.featureCount(), qsizetype(2));
+    QCOMPARE(valueAt(store, "text", 0).toString(), QString("done"));
+    QCOMPARE(valueAt(store, "text", 1).toString(), QString("cut off\nhere"));
+}
+
+void TestCsvReader::splitsAcrossQuotedLineBreaks()
+{
+    // Inputs of a few megabytes are split into chunks; every record must
+    // come out once, in order and with its quoted line breaks intact
+    for (int shift : {0, 1, 17, 150}) {
+        QStringList texts;
+        QByteArray text = quotedRecords(4 << 20, shift, texts);
+        for (int threads : {1, 8}) {
+            CsvReader reader(text.constData(), text.size());
+            reader.setThreadCount(threads);
+            FeatureStore store;
+            QVERIFY(reader.read(store));
+            QCOMPARE(store.featureCount(), qsizetype(texts.size()));
+            
+            const PropertyColumn& ids = store.columns()[store.columnIndex("id")];
+            const PropertyColumn& values = store.columns()[store.columnIndex("text")];
+            for (qsizetype row = 0; row < store.featureCount(); ++row) {
+                QCOMPARE(ids.value(row).toLongLong(), qint64(row));
+                QCOMPARE(values.value(row).toString(), texts[row]);
+                QCOMPARE(store.geometryType(row), FeatureStore::Point);
+                QCOMPARE(store.x(store.coordinateBegin(store.ringBegin(store.partBegin(row)))),
+                         double(row % 360 - 180));
+            }
+        }
+    }
+}
+
+void TestCsvReader::splitsAtEveryRecordOffset()
+{
+    // Records of a fixed length with CRLF both inside the quotes and at the
+    // end. Padding the first record moves the split points of the chunks by
+    // half a byte per byte of padding, so over two record lengths of padding
+    // they fall on every byte of a record: inside the quotes, on the quoted
+    // and the closing CR and LF, and on the first byte of the next record.
+    const QByteArray record = "\"x\r\n,y\",";
+    const qsizetype recordSize = record.size() + 8;
+    const qsizetype records = (2 << 20) / recordSize + 1;
+    for (int shift = 0; shift < 2 * recordSize; ++shift) {
+        QByteArray text = "text,id\r\n";
+        text.reserve(text.size() + shift + records * recordSize);
+        for (qsizetype row = 0; row < records; ++row) {
+            QByteArray line = record + QByteArray::number(100000 + row) + "\r\n";
+            if (row == 0) {
+                line.insert(6, QByteArray(shift, 'p'));
+            }
+            text.append(line);
+        }
+        
+        CsvReader reader(text.constData(), text.size());
+        reader.setThreadCount(2);
+        FeatureStore store;
+        QVERIFY(reader.read(store));
+        QCOMPARE(store.featureCount(), records);
+        
+        const PropertyColumn& values = store.columns()[store.columnIndex("text")];
+        const PropertyColumn& ids = store.columns()[store.columnIndex("id")];
+        QCOMPARE(values.value(0).toString(), "x\r\n,y" + QString(shift, 'p'));
+        for (qsizetype row = 1; row < records; ++row) {
+            QCOMPARE(values.value(row).toString(), QString("x\r\n,y"));
+            QCOMPARE(ids.value(row).toLongLong(), qint64(100000 + row));
+        }
+    }
+}
+
+void TestCsvReader::splitsWithoutTrailingLineBreak()
+{
+    // The last chunk ends inside an unterminated record
+    QStringList texts;
+    QByteArray text = quotedRecords(3 << 20, 0, texts);
+    text.chop(2);
+    text.append("\n" + QByteArray::number(texts.size()) + ",\"open");
+    
+    FeatureStore sequential;
+    CsvReader reader(text.constData(), text.size());
+    reader.setThreadCount(1);
+    QVERIFY(reader.read(sequential));
+    QCOMPARE(sequential.featureCount(), qsizetype(texts.size() + 1));
+    
+    FeatureStore parallel;
+    CsvReader parallelReader(text.constData(), text.size());
+    parallelReader.setThreadCount(8);
+    QVERIFY(parallelReader.read(parallel));
+    QCOMPARE(parallel.featureCount(), sequential.featureCount());
+    for (qsizetype row = 0; row < parallel.featureCount(); ++row) {
+        QCOMPARE(parallel.featureAt(row), sequential.featureAt(row));
+    }
+    QCOMPARE(parallel.columns()[parallel.columnIndex("text")].value(texts.size()).toString(), QString("open"));
+}
+
+void TestCsvReader::readsOnGivenPool()
+{
+    // The calling thread takes chunks too, so a pool that never runs the
+    // read's tasks does not stall it
+    QStringList texts;
+    QByteArray text = quotedRecords(4 << 20, 0, texts);
+    QThreadPool pool;
+    pool.setMaxThreadCount(1);
+    pool.start([]() { QThread::msleep(200); });
+    CsvReader reader(text.constData(), text.size());
+    reader.setThreadCount(4);
+    FeatureStore store;
+    QVERIFY(reader.read(store, IngestProgress(), &pool));
+    QCOMPARE(store.featureCount(), qsizetype(texts.size()));
+    const PropertyColumn& values = store.columns()[store.columnIndex("text")];
+    for (qsizetype row = 0; row < store.featureCount(); ++row) {
+        QCOMPARE(values.value(row).toString(), texts[row]);
+    }
+    pool.waitForDone();
+}
+
+QTEST_GUILESS_MAIN(TestCsvReader)
+#include "tst_csvreader.moc"
@@ -0,0 +1,259 @@
+#include "CsvReader.h"
+#include "CsvWriter.h"
+#include "TestFeatures.h"
+#include <QBuffer>
+#include <QObject>
+#include <QTest>
+#include <QThread>
+#include <QThreadPool>
+
+namespace {
+
+QByteArray writeCsv(const FeatureStore& store, CsvWriter::GeometryFormat format = CsvWriter::AutoGeometry,
+                    int threads = 1, char delimiter = ',', QThreadPool* pool = nullptr)
+{
+    QByteArray data;
+    QBuffer buffer(&data);
+    buffer.open(QIODevice::WriteOnly);
+    CsvWriter writer(&buffer);
+    writer.setGeometryFormat(format);
+    writer.setThreadCount(threads);
+    writer.setDelimiter(delimiter);
+    return writer.write(store, pool) ? data : QByteArray();
+}
+
+bool readCsv(const QByteArray& data, FeatureStore& store, int threads = 1)
+{
+    CsvReader reader(data.constData(), data.size());
+    reader.setThreadCount(threads);
+    return reader.read(store);
+}
+
+// Geometry and the properties of the written layer; the geometry columns
+// also come back as properties and are left out
+QVariantMap featureAt(const FeatureStore& store, qsizetype feature, const QStringList& columns)
+{
+    QVariantMap properties;
+    for (const QString& name : columns) {
+        int index = store.columnIndex(name);
+        properties[name] = index >= 0 ? store.columns()[index].value(feature) : QVariant();
+    }
+    QVariantMap map;
+    map["geometry"] = store.geometryAt(feature);
+    map["properties"] = properties;
+    return map;
+}
+
+} // namespace
+
+class TestCsvWriter : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void roundTripsWktGeometry();
+    void flattensNestedCollections();
+    void roundTripsPointsAsLonLat();
+    void quotesFieldsThatNeedIt();
+    void writesEveryColumn();
+    void writesSameBytesOnAnyThreadCount();
+    void rewritesCsvImportWithoutDuplicateGeometry();
+    void roundTripsOtherDelimiters();
+    void writesInPartsLikeWhole();
+};
+
+void TestCsvWriter::roundTripsWktGeometry()
+{
+    // Mixed geometry types pick WKT
+    FeatureStore store = sampleFeatures(500);
+    for (CsvWriter::GeometryFormat format : {CsvWriter::AutoGeometry, CsvWriter::WktGeometry}) {
+        QByteArray data = writeCsv(store, format);
+        QVERIFY(data.startsWith("wkt,id,name,value,flag\r\n"));
+        
+        FeatureStore read;
+        QVERIFY(readCsv(data, read));
+        QCOMPARE(read.featureCount(), store.featureCount());
+        for (qsizetype feature = 0; feature < store.featureCount(); ++feature) {
+            QCOMPARE(featureAt(read, feature, store.columnNames()), featureAt(store, feature, store.columnNames()));
+        }
+    }
+}
+
+void TestCsvWriter::flattensNestedCollections()
+{
+    // Multi* and collection members of a WKT collection become its simple
+    // members, which write back as a collection of simple members
+    QByteArray csv = "wkt\r\n\"GEOMETRYCOLLECTION (POINT (1 2), MULTIPOINT ((3 4), (5 6)), "
+                     "GEOMETRYCOLLECTION (LINESTRING (7 8, 9 10), POLYGON ((0 0, 4 0, 4 4, 0 0))), "
+                     "MULTIPOLYGON (((10 10, 11 10, 11 11, 10 10)), ((20 20, 21 20, 21 21, 20 20))))\"\r\n";
+    FeatureStore store;
+    QVERIFY(readCsv(csv, store));
+    QCOMPARE(store.featureCount(), qsizetype(1));
+    QCOMPARE(store.geometryType(0), FeatureStore::GeometryCollection);
+    QCOMPARE(store.partEnd(0) - store.partBegin(0), qsizetype(7));
+    QCOMPARE(store.coordinateCount(), qsizetype(1 + 2 + 2 + 4 + 8));
+    
+    QByteArray data = writeCsv(store, CsvWriter::WktGeometry);
+    QVERIFY(data.contains("GEOMETRYCOLLECTION (POINT (1 2), POINT (3 4), POINT (5 6), LINESTRING (7 8, 9 10), POLYGON"));
+    FeatureStore read;
+    QVERIFY(readCsv(data, read));
+    QCOMPARE(read.geometryAt(0), store.geometryAt(0));
+}
+
+void TestCsvWriter::roundTripsPointsAsLonLat()
+{
+    // Layers of points pick lon/lat columns; features without geometry get
+    // empty ones
+    FeatureStore store;
+    for (int id = 0; id < 200; ++id) {
+        FeatureStore::GeometryType type = id % 4 == 3 ? FeatureStore::NoGeometry : FeatureStore::Point;
+        store.beginFeature(type);
+        addSampleGeometry(store, id, type);
+        store.setProperty("id", qint64(id));
+        store.endFeature();
+    }
+    for (CsvWriter::GeometryFormat format : {CsvWriter::AutoGeometry, CsvWriter::LonLatGeometry}) {
+        QByteArray data = writeCsv(store, format);
+        QVERIFY(data.startsWith("lon,lat,id\r\n"));
+        
+        FeatureStore read;
+        QVERIFY(readCsv(data, read));
+        QCOMPARE(read.featureCount(), store.featureCount());
+        for (qsizetype feature = 0; feature < store.featureCount(); ++feature) {
+            QCOMPARE(featureAt(read, feature, {"id"}), featureAt(store, feature, {"id"}));
+        }
+    }
+}
+
+void TestCsvWriter::quotesFieldsThatNeedIt()
+{
+    // Strings are always quoted so that numbers and booleans stored as text
+    // stay text; other fields never need quotes
+    FeatureStore store;
+    const QStringList texts = {"plain", "a,b", "say \"hi\"", "two\r\nlines", "lf\nonly", " padded ", "0012", "1.5", "true", ""};
+    for (const QString& text : texts) {
+        store.beginFeature();
+        store.setProperty("text", text);
+        store.setProperty("number", 2.5);
+        store.endFeature();
+    }
+    QByteArray data = writeCsv(store, CsvWriter::SkipGeometry);
+    QCOMPARE(data, QByteArray("text,number\r\n"
+                              "\"plain\",2.5\r\n"
+                              "\"a,b\",2.5\r\n"
+                              "\"say \"\"hi\"\"\",2.5\r\n"
+                              "\"two\r\nlines\",2.5\r\n"
+                              "\"lf\nonly\",2.5\r\n"
+                              "\" padded \",2.5\r\n"
+                              "\"0012\",2.5\r\n"
+                              "\"1.5\",2.5\r\n"
+                              "\"true\",2.5\r\n"
+                              "\"\",2.5\r\n"));
+    
+    FeatureStore read;
+    QVERIFY(readCsv(data, read));
+    QCOMPARE(read.featureCount(), qsizetype(texts.size()));
+    for (qsizetype feature = 0; feature < read.featureCount(); ++feature) {
+        QCOMPARE(read.propertiesAt(feature)["text"], QVariant(texts[feature]));
+        QCOMPARE(read.propertiesAt(feature)["number"], QVariant(2.5));
+    }
+}
+
+void TestCsvWriter::writesEveryColumn()
+{
+    // Columns that only later features have are written for every row
+    FeatureStore store;
+    store.beginFeature();
+    store.setProperty("first", qint64(1));
+    store.endFeature();
+    store.beginFeature();
+    store.setProperty("second", true);
+    store.endFeature();
+    store.beginFeature();
+    store.setProperty("first", qint64(3));
+    store.setProperty("third", -0.125);
+    store.endFeature();
+    QCOMPARE(writeCsv(store, CsvWriter::SkipGeometry), QByteArray("first,second,third\r\n"
+                                                                  "1,,\r\n"
+                                                                  ",true,\r\n"
+                                                                  "3,,-0.125\r\n"));
+}
+
+void TestCsvWriter::writesSameBytesOnAnyThreadCount()
+{
+    // Several blocks of rows, formatted on threads and written in order
+    FeatureStore store = sampleFeatures(40000);
+    QByteArray data = writeCsv(store, CsvWriter::WktGeometry, 1);
+    QVERIFY(!data.isEmpty());
+    for (int threads : {2, 4, 16}) {
+        QCOMPARE(writeCsv(store, CsvWriter::WktGeometry, threads), data);
+    }
+    
+    // The calling thread formats blocks too, so a pool that never runs the
+    // write's tasks does not stall it
+    QThreadPool pool;
+    pool.setMaxThreadCount(1);
+    pool.start([]() { QThread::msleep(200); });
+    QCOMPARE(writeCsv(store, CsvWriter::WktGeometry, 4, ',', &pool), data);
+    pool.waitForDone();
+    
+    // Large enough to be read back in parallel as well
+    QVERIFY(data.size() > 4 * (1 << 20));
+    FeatureStore read;
+    QVERIFY(readCsv(data, read, 4));
+    QCOMPARE(read.featureCount(), store.featureCount());
+    for (qsizetype feature = 0; feature < store.featureCount(); ++feature) {
+        QCOMPARE(featureAt(read, feature, store.columnNames()), featureAt(store, feature, store.columnNames()));
+    }
+}
+
+void TestCsvWriter::rewritesCsvImportWithoutDuplicateGeometry()
+{
+    // The lon/lat properties of a CSV import already hold its geometry
+    QByteArray csv = "name,lon,lat\r\n\"a\",1.5,2.5\r\n\"b\",-3,4.25\r\n";
+    FeatureStore store;
+    QVERIFY(readCsv(csv, store));
+    QCOMPARE(writeCsv(store), csv);
+}
+
+void TestCsvWriter::roundTripsOtherDelimiters()
+{
+    // The reader detects the delimiter from the header
+    FeatureStore store = sampleFeatures(100);
+    for (char delimiter : {';', '\t', '|'}) {
+        QByteArray data = writeCsv(store, CsvWriter::WktGeometry, 1, delimiter);
+        QVERIFY(data.startsWith(QByteArray("wkt") + delimiter + "id"));
+        
+        FeatureStore read;
+        QVERIFY(readCsv(data, read));
+        QCOMPARE(read.featureCount(), store.featureCount());
+        for (qsizetype feature = 0; feature < store.featureCount(); ++feature) {
+            QCOMPARE(featureAt(read, feature, store.columnNames()), featureAt(store, feature, store.columnNames()));
+        }
+    }
+}
+
+void TestCsvWriter::writesInPartsLikeWhole()
+{
+    // Pages with their columns in another order, or lacking some, are
+    // matched to the header by name
+    FeatureStore store = sampleFeatures(1000);
+    QByteArray data;
+    QBuffer buffer(&data);
+    buffer.open(QIODevice::WriteOnly);
+    CsvWriter writer(&buffer);
+    writer.setGeometryFormat(CsvWriter::WktGeometry);
+    QVERIFY(writer.begin(store.columnNames(), QStringList()));
+    for (qsizetype first = 0; first < store.featureCount(); first += 300) {
+        FeatureStore page;
+        page.column("flag");
+        for (qsizetype feature = first; feature < qMin(first + 300, store.featureCount()); ++feature) {
+            page.appendFeature(store, feature);
+        }
+        QVERIFY(writer.writeFeatures(page));
+    }
+    QCOMPARE(data, writeCsv(store, CsvWriter::WktGeometry));
+}
+
+QTEST_GUILESS_MAIN(TestCsvWriter)
+#include "tst_csvwriter.moc"
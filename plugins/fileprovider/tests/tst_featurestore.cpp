@@ -0,0 +1,109 @@
+#include "FeatureStore.h"
+#include "TestFeatures.h"
+#include <QBuffer>
+#include <QObject>
+#include <QTest>
+#include <cstring>
+
+namespace {
+
+QByteArray writeSnapshot(const FeatureStore& store)
+{
+    QByteArray data;
+    QBuffer buffer(&data);
+    buffer.open(QIODevice::WriteOnly);
+    return store.writeBinary(&buffer) ? data : QByteArray();
+}
+
+// Overwrites one offset of the first offset array, the parts of each
+// feature, which follows the feature types of an 8-feature store
+QByteArray withFeaturePart(QByteArray data, qsizetype feature, quint32 part)
+{
+    std::memcpy(data.data() + 8 + 8 + 8 + feature * sizeof(part), &part, sizeof(part));
+    return data;
+}
+
+} // namespace
+
+class TestFeatureStore : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void roundTripsBinarySnapshots();
+    void rejectsOffsetsOutOfOrder();
+    void rejectsTruncatedSnapshots();
+    void survivesCorruptedSnapshots();
+};
+
+void TestFeatureStore::roundTripsBinarySnapshots()
+{
+    FeatureStore store = sampleFeatures(500);
+    QVariantMap metadata;
+    metadata["name"] = "snapshot";
+    store.setMetadata(metadata);
+    QByteArray data = writeSnapshot(store);
+    QVERIFY(!data.isEmpty());
+    QCOMPARE(data.size() % 8, qsizetype(0));
+    
+    FeatureStore read;
+    QVERIFY(read.readBinary(data.constData(), data.size()));
+    QCOMPARE(read.metadata(), metadata);
+    QCOMPARE(read.columnNames(), store.columnNames());
+    QCOMPARE(read.featureCount(), store.featureCount());
+    for (qsizetype feature = 0; feature < store.featureCount(); ++feature) {
+        QCOMPARE(read.featureAt(feature), store.featureAt(feature));
+    }
+}
+
+void TestFeatureStore::rejectsOffsetsOutOfOrder()
+{
+    FeatureStore store = sampleFeatures(8);
+    QByteArray data = writeSnapshot(store);
+    QCOMPARE(withFeaturePart(data, 0, 0), data);
+    FeatureStore read;
+    QVERIFY(read.readBinary(data.constData(), data.size()));
+    
+    // A first offset past 0, an interior one past the end or going back,
+    // and a last one past the end
+    const QList<QPair<qsizetype, quint32>> damaged = {{0, 1}, {3, 1000}, {3, 0}, {7, quint32(store.partCount() + 1)}};
+    for (const auto& offset : damaged) {
+        QByteArray corrupted = withFeaturePart(data, offset.first, offset.second);
+        QVERIFY(!read.readBinary(corrupted.constData(), corrupted.size()));
+        QCOMPARE(read.featureCount(), qsizetype(0));
+    }
+}
+
+void TestFeatureStore::rejectsTruncatedSnapshots()
+{
+    QByteArray data = writeSnapshot(sampleFeatures(20));
+    QVERIFY(!data.isEmpty());
+    for (qsizetype size = 0; size < data.size(); ++size) {
+        FeatureStore read;
+        QVERIFY2(!read.readBinary(data.constData(), size), QByteArray::number(size).constData());
+    }
+}
+
+void TestFeatureStore::survivesCorruptedSnapshots()
+{
+    // Damaged snapshots may or may not read, but what reads must be walkable
+    QByteArray data = writeSnapshot(sampleFeatures(40));
+    QVERIFY(!data.isEmpty());
+    quint32 seed = 1;
+    for (int round = 0; round < 2000; ++round) {
+        QByteArray corrupted = data;
+        for (int flip = 0; flip < 4; ++flip) {
+            seed = seed * 1103515245 + 12345;
+            corrupted[qsizetype((seed >> 8) % quint32(corrupted.size()))] = char(seed >> 24);
+        }
+        FeatureStore read;
+        if (read.readBinary(corrupted.constData(), corrupted.size())) {
+            for (qsizetype feature = 0; feature < read.featureCount(); ++feature) {
+                read.featureAt(feature);
+            }
+        }
+    }
+}
+
+QTEST_GUILESS_MAIN(TestFeatureStore)
+#include "tst_featurestore.moc"
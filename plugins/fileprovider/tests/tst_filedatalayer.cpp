@@ -0,0 +1,367 @@
+#include "FileDataLayer.h"
+#include <QFile>
+#include <QObject>
+#include <QStandardPaths>
+#include <QTemporaryDir>
+#include <QTest>
+#include <QtEndian>
+#include <zlib.h>
+
+namespace {
+
+bool writeFile(const QString& path, const QByteArray& data)
+{
+    QFile file(path);
+    return file.open(QIODevice::WriteOnly) && file.write(data) == data.size();
+}
+
+bool appendFile(const QString& path, const QByteArray& data)
+{
+    QFile file(path);
+    return file.open(QIODevice::Append) && file.write(data) == data.size();
+}
+
+// Overwrites bytes in place without changing the file's size
+bool overwriteFile(const QString& path, qint64 offset, const QByteArray& data)
+{
+    QFile file(path);
+    return file.open(QIODevice::ReadWrite) && file.seek(offset) && file.write(data) == data.size();
+}
+
+// Points on a grid of 0.1 degrees, row by row from the south west
+QByteArray gridCsv(int columns, int rows)
+{
+    QByteArray csv = "id,lon,lat\n";
+    for (int row = 0; row < rows; ++row) {
+        for (int column = 0; column < columns; ++column) {
+            csv += QByteArray::number(row * columns + column) + "," + QByteArray::number(-180 + column * 0.1) + ","
+                   + QByteArray::number(-80 + row * 0.1) + "\n";
+        }
+    }
+    return csv;
+}
+
+QVariantMap box(double minLon, double minLat, double maxLon, double maxLat)
+{
+    QVariantMap map;
+    map["minLon"] = minLon;
+    map["minLat"] = minLat;
+    map["maxLon"] = maxLon;
+    map["maxLat"] = maxLat;
+    return map;
+}
+
+template<typename T>
+void appendLE(QByteArray& data, T value)
+{
+    char bytes[sizeof(T)];
+    qToLittleEndian(value, bytes);
+    data.append(bytes, sizeof(T));
+}
+
+// A zip archive of uncompressed members, as some tools write KMZ files
+QByteArray storedZip(const QList<QPair<QByteArray, QByteArray>>& members)
+{
+    QByteArray archive;
+    QByteArray directory;
+    for (const auto& member : members) {
+        quint32 crc = quint32(crc32(0, reinterpret_cast<const Bytef*>(member.second.constData()), uInt(member.second.size())));
+        quint32 offset = quint32(archive.size());
+        appendLE<quint32>(archive, 0x04034b50);
+        appendLE<quint16>(archive, 10);
+        appendLE<quint16>(archive, 0);
+        appendLE<quint16>(archive, 0);
+        appendLE<quint32>(archive, 0);
+        appendLE<quint32>(archive, crc);
+        appendLE<quint32>(archive, quint32(member.second.size()));
+        appendLE<quint32>(archive, quint32(member.second.size()));
+        appendLE<quint16>(archive, quint16(member.first.size()));
+        appendLE<quint16>(archive, 0);
+        archive.append(member.first);
+        archive.append(member.second);
+        
+        appendLE<quint32>(directory, 0x02014b50);
+        appendLE<quint16>(directory, 20);
+        appendLE<quint16>(directory, 10);
+        appendLE<quint16>(directory, 0);
+        appendLE<quint16>(directory, 0);
+        appendLE<quint32>(directory, 0);
+        appendLE<quint32>(directory, crc);
+        appendLE<quint32>(directory, quint32(member.second.size()));
+        appendLE<quint32>(directory, quint32(member.second.size()));
+        appendLE<quint16>(directory, quint16(member.first.size()));
+        appendLE<quint16>(directory, 0);
+        appendLE<quint16>(directory, 0);
+        appendLE<quint16>(directory, 0);
+        appendLE<quint16>(directory, 0);
+        appendLE<quint32>(directory, 0);
+        appendLE<quint32>(directory, offset);
+        directory.append(member.first);
+    }
+    quint32 directoryOffset = quint32(archive.size());
+    archive.append(directory);
+    appendLE<quint32>(archive, 0x06054b50);
+    appendLE<quint16>(archive, 0);
+    appendLE<quint16>(archive, 0);
+    appendLE<quint16>(archive, quint16(members.size()));
+    appendLE<quint16>(archive, quint16(members.size()));
+    appendLE<quint32>(archive, quint32(directory.size()));
+    appendLE<quint32>(archive, directoryOffset);
+    appendLE<quint16>(archive, 0);
+    return archive;
+}
+
+// A KML document with one point placemark of the given name
+QByteArray placemarkKml(const QByteArray& name)
+{
+    return "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<kml xmlns=\"http://www.opengis.net/kml/2.2\"><Document>"
+           "<Placemark><name>" + name + "</name><Point><coordinates>12.5,41.9</coordinates></Point></Placemark>"
+           "</Document></kml>\n";
+}
+
+QVariant propertyAt(const FileDataLayer& layer, qsizetype feature, const QString& name)
+{
+    return layer.features().propertiesAt(feature).value(name);
+}
+
+// Loads a file without the layer cache and gives the names of its features
+bool loadNames(const QString& path, QStringList& names)
+{
+    FileDataLayer layer("layer", "layer", path);
+    QVariantMap options;
+    options["cache"] = false;
+    layer.setImportOptions(options);
+    if (!layer.loadFromFile()) {
+        return false;
+    }
+    names.clear();
+    for (const QVariant& feature : layer.data().toMap().value("features").toList()) {
+        names.append(feature.toMap().value("properties").toMap().value("name").toString());
+    }
+    return true;
+}
+
+} // namespace
+
+class TestFileDataLayer : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void truncatesPagedExtentQueries();
+    void readsKmzDocuments();
+    void rejectsMalformedKml();
+    void appendsCsvRows();
+    void appendsGeoJsonSequences();
+    void rejectsRewrittenFiles();
+};
+
+void TestFileDataLayer::initTestCase()
+{
+    // Page files and layer snapshots go to a cache directory of the test's own
+    QStandardPaths::setTestModeEnabled(true);
+}
+
+void TestFileDataLayer::truncatesPagedExtentQueries()
+{
+    QTemporaryDir directory;
+    QVERIFY(directory.isValid());
+    QString path = directory.filePath("grid.csv");
+    QVERIFY(writeFile(path, gridCsv(1000, 100)));
+    
+    FileDataLayer layer("grid", "grid", path);
+    QVariantMap options;
+    options["paged"] = true;
+    options["cache"] = false;
+    options["pageCacheSize"] = 1;
+    layer.setImportOptions(options);
+    QVERIFY(layer.loadFromFile());
+    QVERIFY(layer.isPaged());
+    QCOMPARE(layer.properties().value("featureCount").toLongLong(), qint64(100000));
+    QVERIFY(layer.properties().value("pageCount").toLongLong() > 4);
+    
+    // The whole layer is more than the cache holds, so the query stops at
+    // the pages that fit
+    QVariantMap world = layer.dataInExtent(box(-180, -90, 180, 90)).toMap();
+    QCOMPARE(world.value("type").toString(), QString("FeatureCollection"));
+    QCOMPARE(world.value("truncated").toBool(), true);
+    qsizetype returned = world.value("features").toList().size();
+    QVERIFY(returned > 0);
+    QVERIFY(returned < 100000);
+    
+    // A box within a page is answered in full
+    QVariantMap small = layer.dataInExtent(box(-170.05, -75.05, -169.75, -74.95)).toMap();
+    QVERIFY(!small.contains("truncated"));
+    QVariantList features = small.value("features").toList();
+    QCOMPARE(features.size(), qsizetype(3));
+    for (const QVariant& feature : features) {
+        qint64 id = feature.toMap().value("properties").toMap().value("id").toLongLong();
+        QCOMPARE(id / 1000, qint64(50));
+        QVERIFY(id % 1000 >= 100 && id % 1000 <= 102);
+    }
+}
+
+void TestFileDataLayer::readsKmzDocuments()
+{
+    QTemporaryDir directory;
+    QVERIFY(directory.isValid());
+    QString path = directory.filePath("places.kmz");
+    QStringList names;
+    
+    // doc.kml is the main document wherever it is in the archive
+    QVERIFY(writeFile(path, storedZip({{"files/icon.png", "\x89PNG"},
+                                       {"files/overlay.kml", placemarkKml("overlay")},
+                                       {"DOC.KML", placemarkKml("main")}})));
+    QVERIFY(loadNames(path, names));
+    QCOMPARE(names, QStringList({"main"}));
+    
+    // Otherwise it is the first .kml member
+    QVERIFY(writeFile(path, storedZip({{"readme.txt", "places"},
+                                       {"b/First.KML", placemarkKml("first")},
+                                       {"a/second.kml", placemarkKml("second")}})));
+    QVERIFY(loadNames(path, names));
+    QCOMPARE(names, QStringList({"first"}));
+    
+    QVERIFY(writeFile(path, storedZip({{"files/icon.png", "\x89PNG"}})));
+    QVERIFY(!loadNames(path, names));
+    QVERIFY(writeFile(path, placemarkKml("not an archive")));
+    QVERIFY(!loadNames(path, names));
+}
+
+void TestFileDataLayer::rejectsMalformedKml()
+{
+    QTemporaryDir directory;
+    QVERIFY(directory.isValid());
+    QStringList names;
+    QString path = directory.filePath("places.kml");
+    QVERIFY(writeFile(path, placemarkKml("plain")));
+    QVERIFY(loadNames(path, names));
+    QCOMPARE(names, QStringList({"plain"}));
+    
+    // Unclosed elements, inside a plain file or a KMZ member, fail the load
+    // rather than giving the placemarks read before the error
+    QByteArray broken = placemarkKml("broken");
+    broken.truncate(broken.indexOf("</Document>"));
+    QVERIFY(writeFile(path, broken));
+    QVERIFY(!loadNames(path, names));
+    QString kmzPath = directory.filePath("places.kmz");
+    QVERIFY(writeFile(kmzPath, storedZip({{"doc.kml", broken}})));
+    QVERIFY(!loadNames(kmzPath, names));
+}
+
+void TestFileDataLayer::appendsCsvRows()
+{
+    // The header record spans two lines, so appended rows only get the same
+    // columns when read under the whole of it
+    QTemporaryDir directory;
+    QVERIFY(directory.isValid());
+    QString path = directory.filePath("points.csv");
+    QVERIFY(writeFile(path, "id,\"place\nname\",lon,lat\n0,a,1,2\n1,b,3,4\n"));
+    FileDataLayer layer("points", "points", path);
+    QVariantMap options;
+    options["cache"] = false;
+    layer.setImportOptions(options);
+    QVERIFY(layer.loadFromFile());
+    QCOMPARE(layer.features().featureCount(), qsizetype(2));
+    
+    QVERIFY(appendFile(path, "2,c,-5,6\n3,d,7,8\n"));
+    QVERIFY(layer.appendFromFile());
+    QCOMPARE(layer.features().featureCount(), qsizetype(4));
+    QCOMPARE(layer.features().columnNames(), QStringList({"id", "place\nname", "lon", "lat"}));
+    QCOMPARE(propertyAt(layer, 2, "id").toLongLong(), qint64(2));
+    QCOMPARE(propertyAt(layer, 3, "place\nname").toString(), QString("d"));
+    QCOMPARE(layer.features().geometryType(3), FeatureStore::Point);
+    QCOMPARE(layer.boundingBox().value("minLon").toDouble(), -5.0);
+    QCOMPARE(layer.boundingBox().value("maxLat").toDouble(), 8.0);
+    QCOMPARE(layer.properties().value("featureCount").toLongLong(), qint64(4));
+    
+    // A line still being written waits for its line break
+    QVERIFY(appendFile(path, "4,e,9,10\n5,f,11"));
+    QVERIFY(layer.appendFromFile());
+    QCOMPARE(layer.features().featureCount(), qsizetype(5));
+    QVERIFY(layer.appendFromFile());
+    QCOMPARE(layer.features().featureCount(), qsizetype(5));
+    QVERIFY(appendFile(path, ",12\n"));
+    QVERIFY(layer.appendFromFile());
+    QCOMPARE(layer.features().featureCount(), qsizetype(6));
+    QCOMPARE(propertyAt(layer, 5, "id").toLongLong(), qint64(5));
+    QCOMPARE(propertyAt(layer, 5, "lat").toDouble(), 12.0);
+    QCOMPARE(layer.boundingBox().value("maxLon").toDouble(), 11.0);
+}
+
+void TestFileDataLayer::appendsGeoJsonSequences()
+{
+    QTemporaryDir directory;
+    QVERIFY(directory.isValid());
+    QString path = directory.filePath("points.geojsonl");
+    const QByteArray feature = "{\"type\": \"Feature\", \"properties\": {\"id\": %1}, "
+                               "\"geometry\": {\"type\": \"Point\", \"coordinates\": [%1, 1]}}\n";
+    auto line = [&feature](int id) { return QByteArray(feature).replace("%1", QByteArray::number(id)); };
+    QVERIFY(writeFile(path, line(0) + line(1)));
+    FileDataLayer layer("points", "points", path);
+    QVariantMap options;
+    options["cache"] = false;
+    layer.setImportOptions(options);
+    QVERIFY(layer.loadFromFile());
+    QCOMPARE(layer.features().featureCount(), qsizetype(2));
+    
+    QByteArray partial = line(3);
+    QVERIFY(appendFile(path, line(2) + partial.left(20)));
+    QVERIFY(layer.appendFromFile());
+    QCOMPARE(layer.features().featureCount(), qsizetype(3));
+    QVERIFY(appendFile(path, partial.mid(20)));
+    QVERIFY(layer.appendFromFile());
+    QCOMPARE(layer.features().featureCount(), qsizetype(4));
+    QCOMPARE(propertyAt(layer, 3, "id").toLongLong(), qint64(3));
+    QCOMPARE(layer.boundingBox().value("maxLon").toDouble(), 3.0);
+    
+    // A broken appended line is not taken, and the next append still fails
+    // on it rather than skipping it
+    QVERIFY(appendFile(path, "{\"type\": \"Feature\", \"geometry\": tru}\n"));
+    QVERIFY(!layer.appendFromFile());
+    QCOMPARE(layer.features().featureCount(), qsizetype(4));
+    QVERIFY(appendFile(path, line(4)));
+    QVERIFY(!layer.appendFromFile());
+}
+
+void TestFileDataLayer::rejectsRewrittenFiles()
+{
+    QTemporaryDir directory;
+    QVERIFY(directory.isValid());
+    QString path = directory.filePath("points.csv");
+    QByteArray csv = "id,lon,lat\n0,1,2\n1,3,4\n";
+    QVariantMap options;
+    options["cache"] = false;
+    
+    // Earlier rows changed in place, with the file grown as well
+    QVERIFY(writeFile(path, csv));
+    FileDataLayer edited("points", "points", path);
+    edited.setImportOptions(options);
+    QVERIFY(edited.loadFromFile());
+    QVERIFY(overwriteFile(path, csv.indexOf("1,3"), "9"));
+    QVERIFY(appendFile(path, "2,5,6\n"));
+    QVERIFY(!edited.appendFromFile());
+    QCOMPARE(edited.features().featureCount(), qsizetype(2));
+    
+    // A file that shrank, even if rows were then written past the old end
+    QVERIFY(writeFile(path, csv));
+    FileDataLayer shrunk("points", "points", path);
+    shrunk.setImportOptions(options);
+    QVERIFY(shrunk.loadFromFile());
+    QVERIFY(writeFile(path, "id,lon,lat\n0,1,2\n"));
+    QVERIFY(!shrunk.appendFromFile());
+    QVERIFY(appendFile(path, "7,7,7\n8,8,8\n"));
+    QVERIFY(!shrunk.appendFromFile());
+    
+    // A file whose last row had no line break when loaded is not tracked
+    QVERIFY(writeFile(path, csv.left(csv.size() - 1)));
+    FileDataLayer unterminated("points", "points", path);
+    unterminated.setImportOptions(options);
+    QVERIFY(unterminated.loadFromFile());
+    QVERIFY(appendFile(path, "\n2,5,6\n"));
+    QVERIFY(!unterminated.appendFromFile());
+}
+
+QTEST_GUILESS_MAIN(TestFileDataLayer)
+#include "tst_filedatalayer.moc"
@@ -0,0 +1,227 @@
+#include "FlatGeobufReader.h"
+#include "FlatGeobufWriter.h"
+#include "FeatureBounds.h"
+#include "PackedRTree.h"
+#include "TestFeatures.h"
+#include <QBuffer>
+#include <QObject>
+#include <QTest>
+
+namespace {
+
+QByteArray writeFlatGeobuf(const FeatureStore& store, quint16 nodeSize = PackedRTree::DefaultNodeSize)
+{
+    QByteArray data;
+    QBuffer buffer(&data);
+    buffer.open(QIODevice::WriteOnly);
+    FlatGeobufWriter writer(&buffer);
+    writer.setName("sample");
+    writer.setIndexNodeSize(nodeSize);
+    return writer.write(store) ? data : QByteArray();
+}
+
+// Features keyed by their "id" property; feature ids are not stored in
+// FlatGeobuf files and indexed files reorder the features
+QMap<qint64, QVariantMap> featuresById(const FeatureStore& store)
+{
+    QMap<qint64, QVariantMap> features;
+    for (qsizetype feature = 0; feature < store.featureCount(); ++feature) {
+        QVariantMap map = store.featureAt(feature);
+        map.remove("id");
+        features.insert(map["properties"].toMap()["id"].toLongLong(), map);
+    }
+    return features;
+}
+
+// Box of a given size somewhere in [-200, 200) x [-100, 100), so some
+// boxes reach past the data
+PackedRTree::Node sampleBox(int box, double size)
+{
+    quint32 seed = quint32(box) * 2654435761u + 7;
+    seed ^= seed >> 13;
+    seed *= 2246822519u;
+    PackedRTree::Node node;
+    node.minX = -200.0 + 400.0 * double(seed & 0xFFFF) / 65536.0;
+    node.minY = -100.0 + 200.0 * double(seed >> 16) / 65536.0;
+    node.maxX = node.minX + size;
+    node.maxY = node.minY + size / 2;
+    return node;
+}
+
+QVariantMap toBoundingBox(const PackedRTree::Node& box)
+{
+    QVariantMap map;
+    map["minLon"] = box.minX;
+    map["minLat"] = box.minY;
+    map["maxLon"] = box.maxX;
+    map["maxLat"] = box.maxY;
+    return map;
+}
+
+} // namespace
+
+class TestFlatGeobuf : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void roundTripsIndexedFile();
+    void roundTripsUnindexedFile();
+    void roundTripsEmptyLayer();
+    void searchesTreeLikeBruteForce();
+    void filtersExtentLikeBruteForce();
+    void rejectsTruncatedFiles();
+    void survivesCorruptedBytes();
+};
+
+void TestFlatGeobuf::roundTripsIndexedFile()
+{
+    FeatureStore store = sampleFeatures(500);
+    QByteArray data = writeFlatGeobuf(store);
+    QVERIFY(!data.isEmpty());
+    
+    FlatGeobufReader reader(data.constData(), data.size());
+    FeatureStore read;
+    QVERIFY(reader.read(read));
+    QVERIFY(reader.hasIndex());
+    QCOMPARE(reader.name(), QString("sample"));
+    QCOMPARE(reader.featureCount(), qint64(500));
+    QCOMPARE(reader.columnNames(), store.columnNames());
+    QCOMPARE(read.featureCount(), store.featureCount());
+    QCOMPARE(featuresById(read), featuresById(store));
+}
+
+void TestFlatGeobuf::roundTripsUnindexedFile()
+{
+    // Without an index the features keep their order
+    FeatureStore store = sampleFeatures(200);
+    QByteArray data = writeFlatGeobuf(store, 0);
+    QVERIFY(!data.isEmpty());
+    
+    FlatGeobufReader reader(data.constData(), data.size());
+    FeatureStore read;
+    QVERIFY(reader.read(read));
+    QVERIFY(!reader.hasIndex());
+    QCOMPARE(read.featureCount(), store.featureCount());
+    for (qsizetype feature = 0; feature < store.featureCount(); ++feature) {
+        QVariantMap expected = store.featureAt(feature);
+        expected.remove("id");
+        QCOMPARE(read.featureAt(feature), expected);
+    }
+}
+
+void TestFlatGeobuf::roundTripsEmptyLayer()
+{
+    FeatureStore store;
+    store.column("name");
+    QByteArray data = writeFlatGeobuf(store);
+    QVERIFY(!data.isEmpty());
+    
+    FlatGeobufReader reader(data.constData(), data.size());
+    FeatureStore read;
+    QVERIFY(reader.read(read));
+    QCOMPARE(read.featureCount(), qsizetype(0));
+    QCOMPARE(reader.columnNames(), QStringList({"name"}));
+}
+
+void TestFlatGeobuf::searchesTreeLikeBruteForce()
+{
+    // Every leaf intersecting the box and no other, for trees of one to
+    // several levels and partially filled nodes
+    for (int itemCount : {1, 2, 15, 16, 17, 257, 3000}) {
+        QVector<PackedRTree::Node> leaves;
+        for (int item = 0; item < itemCount; ++item) {
+            PackedRTree::Node leaf = sampleBox(item + 100000, 1.0 + item % 7);
+            leaf.offset = quint64(item);
+            leaves.append(leaf);
+        }
+        
+        for (quint16 nodeSize : {quint16(2), quint16(3), PackedRTree::DefaultNodeSize}) {
+            QByteArray index = PackedRTree::build(leaves, nodeSize);
+            QCOMPARE(quint64(index.size()), PackedRTree::indexSize(quint64(itemCount), nodeSize));
+            
+            for (int box = 0; box < 50; ++box) {
+                PackedRTree::Node query = sampleBox(box, box % 10 == 0 ? 400.0 : 2.0 + box);
+                QVector<quint64> expected;
+                for (const PackedRTree::Node& leaf : leaves) {
+                    if (query.intersects(leaf)) {
+                        expected.append(leaf.offset);
+                    }
+                }
+                QVector<quint64> found = PackedRTree::search(index.constData(), quint64(itemCount), nodeSize, query);
+                QCOMPARE(found, expected);
+            }
+        }
+    }
+}
+
+void TestFlatGeobuf::filtersExtentLikeBruteForce()
+{
+    FeatureStore store = sampleFeatures(2000);
+    PackedRTree::Node extent;
+    QVector<PackedRTree::Node> bounds = FeatureBounds::compute(store, extent, 1);
+    
+    // Indexed files are searched through the index, unindexed ones scanned
+    for (quint16 nodeSize : {quint16(0), quint16(4), PackedRTree::DefaultNodeSize}) {
+        QByteArray data = writeFlatGeobuf(store, nodeSize);
+        QVERIFY(!data.isEmpty());
+        
+        for (int box = 0; box < 40; ++box) {
+            PackedRTree::Node query = sampleBox(box, box % 8 == 0 ? 400.0 : 1.0 + box);
+            QList<qint64> expected;
+            for (qsizetype feature = 0; feature < store.featureCount(); ++feature) {
+                if (!bounds[feature].isEmpty() && query.intersects(bounds[feature])) {
+                    expected.append(feature);
+                }
+            }
+            
+            FlatGeobufReader reader(data.constData(), data.size());
+            reader.setFilter(toBoundingBox(query));
+            FeatureStore read;
+            QVERIFY(reader.read(read));
+            QList<qint64> found = featuresById(read).keys();
+            QCOMPARE(found, expected);
+        }
+    }
+}
+
+void TestFlatGeobuf::rejectsTruncatedFiles()
+{
+    // Cut off in the header, the index or any feature, a file must fail to
+    // read rather than come back short
+    for (quint16 nodeSize : {quint16(0), PackedRTree::DefaultNodeSize}) {
+        QByteArray data = writeFlatGeobuf(sampleFeatures(60), nodeSize);
+        QVERIFY(!data.isEmpty());
+        for (qsizetype size = 0; size < data.size(); ++size) {
+            QByteArray truncated = data.left(size);
+            FlatGeobufReader reader(truncated.constData(), truncated.size());
+            FeatureStore read;
+            QVERIFY(!reader.read(read));
+            QVERIFY(!reader.errorString().isEmpty());
+        }
+    }
+}
+
+void TestFlatGeobuf::survivesCorruptedBytes()
+{
+    // Damaged files may or may not read, but must stay within their bytes
+    QByteArray data = writeFlatGeobuf(sampleFeatures(40));
+    QVERIFY(!data.isEmpty());
+    quint32 seed = 1;
+    for (int round = 0; round < 2000; ++round) {
+        QByteArray corrupted = data;
+        for (int flip = 0; flip < 4; ++flip) {
+            seed = seed * 1103515245 + 12345;
+            corrupted[qsizetype((seed >> 8) % quint32(corrupted.size()))] = char(seed >> 24);
+        }
+        FlatGeobufReader reader(corrupted.constData(), corrupted.size());
+        FeatureStore read;
+        if (round % 2) {
+            reader.setFilter(toBoundingBox(sampleBox(round, 50.0)));
+        }
+        reader.read(read);
+    }
+}
+
+QTEST_GUILESS_MAIN(TestFlatGeobuf)
+#include "tst_flatgeobuf.moc"
@@ -0,0 +1,218 @@
+#include "GeoJsonSeqReader.h"
+#include "GeoJsonWriter.h"
+#include "TestFeatures.h"
+#include <QBuffer>
+#include <QObject>
+#include <QTest>
+#include <QThread>
+#include <QThreadPool>
+
+namespace {
+
+QByteArray writeSequence(const FeatureStore& store, bool recordSeparators)
+{
+    QByteArray data;
+    QBuffer buffer(&data);
+    buffer.open(QIODevice::WriteOnly);
+    GeoJsonWriter writer(&buffer);
+    // Sequences stay one feature per line even when indenting is asked for
+    writer.setIndented(true);
+    writer.setSequence(true, recordSeparators);
+    return writer.write(store) ? data : QByteArray();
+}
+
+bool readSequence(const QByteArray& data, FeatureStore& store, int threads, QString* error = nullptr,
+                  QThreadPool* pool = nullptr)
+{
+    GeoJsonSeqReader reader(data.constData(), data.size());
+    reader.setThreadCount(threads);
+    bool ok = reader.read(store, IngestProgress(), pool);
+    if (error) {
+        *error = reader.errorString();
+    }
+    return ok;
+}
+
+void compareFeatures(const FeatureStore& read, const FeatureStore& expected)
+{
+    QCOMPARE(read.featureCount(), expected.featureCount());
+    for (qsizetype feature = 0; feature < expected.featureCount(); ++feature) {
+        QCOMPARE(read.featureAt(feature), expected.featureAt(feature));
+    }
+}
+
+} // namespace
+
+class TestGeoJsonSeq : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void roundTripsNewlineDelimited();
+    void roundTripsTextSequences();
+    void readsLargeSequencesOnThreads();
+    void skipsBlankLinesAndCarriageReturns();
+    void rejectsMalformedTexts();
+    void readsTruncatedInputUpToLastText();
+    void survivesCorruptedBytes();
+};
+
+void TestGeoJsonSeq::roundTripsNewlineDelimited()
+{
+    FeatureStore store = sampleFeatures(300);
+    QByteArray data = writeSequence(store, false);
+    QVERIFY(!data.isEmpty());
+    QCOMPARE(data.count("\n"), qsizetype(300));
+    QVERIFY(!data.contains('\x1E'));
+    QCOMPARE(GeoJsonSeqReader::separator(data.constData(), data.size()), '\n');
+    QCOMPARE(GeoJsonSeqReader::countFeatures(data.constData(), data.size()), qint64(300));
+    
+    FeatureStore read;
+    QVERIFY(readSequence(data, read, 1));
+    compareFeatures(read, store);
+}
+
+void TestGeoJsonSeq::roundTripsTextSequences()
+{
+    FeatureStore store = sampleFeatures(300);
+    QByteArray data = writeSequence(store, true);
+    QVERIFY(data.startsWith("\x1E{"));
+    QCOMPARE(data.count("\n\x1E"), qsizetype(299));
+    QCOMPARE(GeoJsonSeqReader::separator(data.constData(), data.size()), '\x1E');
+    QCOMPARE(GeoJsonSeqReader::countFeatures(data.constData(), data.size()), qint64(300));
+    
+    FeatureStore read;
+    QVERIFY(readSequence(data, read, 1));
+    compareFeatures(read, store);
+}
+
+void TestGeoJsonSeq::readsLargeSequencesOnThreads()
+{
+    // Large enough to be split into slices, which must merge back in order
+    FeatureStore store = sampleFeatures(30000);
+    for (bool recordSeparators : {false, true}) {
+        QByteArray data = writeSequence(store, recordSeparators);
+        QVERIFY(data.size() > 4 * (1 << 20));
+        for (int threads : {1, 4}) {
+            FeatureStore read;
+            QVERIFY(readSequence(data, read, threads));
+            compareFeatures(read, store);
+        }
+    }
+    
+    // The calling thread takes slices too, so a pool that never runs the
+    // read's tasks does not stall it
+    QThreadPool pool;
+    pool.setMaxThreadCount(1);
+    pool.start([]() { QThread::msleep(200); });
+    FeatureStore read;
+    QVERIFY(readSequence(writeSequence(store, false), read, 4, nullptr, &pool));
+    compareFeatures(read, store);
+    pool.waitForDone();
+}
+
+void TestGeoJsonSeq::skipsBlankLinesAndCarriageReturns()
+{
+    const QByteArray feature = "{\"type\": \"Feature\", \"geometry\": {\"type\": \"Point\", \"coordinates\": [1, 2]}, \"properties\": {\"n\": 1}}";
+    const QList<QByteArray> inputs = {
+        feature + "\r\n" + feature + "\r\n",
+        "\n\n" + feature + "\n  \n\t\n" + feature,
+        feature + "\n" + feature + "\n\n\n",
+        "\x1E" + feature + "\r\n\x1E\r\n\x1E" + feature + "\n",
+        "\r\n\x1E" + feature + "\x1E" + feature,
+    };
+    for (const QByteArray& input : inputs) {
+        QCOMPARE(GeoJsonSeqReader::countFeatures(input.constData(), input.size()), qint64(2));
+        FeatureStore read;
+        QVERIFY2(readSequence(input, read, 1), input.constData());
+        QCOMPARE(read.featureCount(), qsizetype(2));
+        QCOMPARE(read.propertiesAt(1)["n"], QVariant(qint64(1)));
+    }
+}
+
+void TestGeoJsonSeq::rejectsMalformedTexts()
+{
+    const QByteArray feature = "{\"type\": \"Feature\", \"geometry\": null, \"properties\": {}}\n";
+    const QList<QByteArray> broken = {
+        "{\"type\": \"Feature\", \"geometry\": null, \"properties\": {}\n",
+        "{\"type\": \"Feature\", \"geometry\": {\"type\": \"Point\", \"coordinates\": [1, ]}}\n",
+        "{\"type\": \"Feature\" \"properties\": {}}\n",
+        "{\"type\": \"Feature\", \"properties\": {\"a\": tru}}\n",
+        "{\"type\": \"Feature\", \"properties\": {\"a\": \"open}}\n",
+    };
+    for (const QByteArray& text : broken) {
+        FeatureStore read;
+        QString error;
+        QVERIFY2(!readSequence(feature + text + feature, read, 1, &error), text.constData());
+        QVERIFY(!error.isEmpty());
+    }
+    
+    // A broken text deep in a large input fails a parallel read too
+    QByteArray data = writeSequence(sampleFeatures(30000), false);
+    qsizetype middle = data.indexOf('\n', data.size() / 2) + 1;
+    data.insert(middle, broken.first());
+    for (int threads : {1, 4}) {
+        FeatureStore read;
+        QString error;
+        QVERIFY(!readSequence(data, read, threads, &error));
+        QVERIFY(!error.isEmpty());
+    }
+}
+
+void TestGeoJsonSeq::readsTruncatedInputUpToLastText()
+{
+    // Sequences carry no count, so input cut off after a text reads as the
+    // texts before the cut; cut off inside a text, it fails
+    for (bool recordSeparators : {false, true}) {
+        QByteArray data = writeSequence(sampleFeatures(12), recordSeparators);
+        QVERIFY(!data.isEmpty());
+        QVector<qsizetype> ends;
+        for (qsizetype i = data.indexOf('\n'); i >= 0; i = data.indexOf('\n', i + 1)) {
+            ends.append(i);
+        }
+        for (qsizetype size = 0; size < data.size(); ++size) {
+            QByteArray truncated = data.left(size);
+            qsizetype content = size;
+            while (content > 0 && (truncated[content - 1] == '\n' || truncated[content - 1] == '\x1E')) {
+                --content;
+            }
+            qsizetype complete = 0;
+            while (complete < ends.size() && ends[complete] <= content) {
+                ++complete;
+            }
+            bool atEnd = content == 0 || ends.contains(content);
+            
+            FeatureStore read;
+            QString error;
+            QCOMPARE(readSequence(truncated, read, 1, &error), atEnd);
+            if (atEnd) {
+                QCOMPARE(read.featureCount(), complete);
+            } else {
+                QVERIFY(!error.isEmpty());
+            }
+        }
+    }
+}
+
+void TestGeoJsonSeq::survivesCorruptedBytes()
+{
+    // Damaged input may or may not read, but must stay within its bytes
+    for (bool recordSeparators : {false, true}) {
+        QByteArray data = writeSequence(sampleFeatures(40), recordSeparators);
+        QVERIFY(!data.isEmpty());
+        quint32 seed = 1;
+        for (int round = 0; round < 2000; ++round) {
+            QByteArray corrupted = data;
+            for (int flip = 0; flip < 4; ++flip) {
+                seed = seed * 1103515245 + 12345;
+                corrupted[qsizetype((seed >> 8) % quint32(corrupted.size()))] = char(seed >> 24);
+            }
+            GeoJsonSeqReader::countFeatures(corrupted.constData(), corrupted.size());
+            FeatureStore read;
+            readSequence(corrupted, read, 1);
+        }
+    }
+}
+
+QTEST_GUILESS_MAIN(TestGeoJsonSeq)
+#include "tst_geojsonseq.moc"
@@ -0,0 +1,252 @@
+#include "GeoJsonReader.h"
+#include "GeoJsonWriter.h"
+#include "TestFeatures.h"
+#include <QBuffer>
+#include <QObject>
+#include <QTest>
+#include <cmath>
+
+namespace {
+
+QByteArray writeGeoJson(const FeatureStore& store, bool indented, int precision = -1)
+{
+    QByteArray data;
+    QBuffer buffer(&data);
+    buffer.open(QIODevice::WriteOnly);
+    GeoJsonWriter writer(&buffer);
+    writer.setIndented(indented);
+    writer.setPrecision(precision);
+    return writer.write(store) ? data : QByteArray();
+}
+
+bool readGeoJson(const QByteArray& data, FeatureStore& store, QString* error = nullptr)
+{
+    GeoJsonReader reader(data.constData(), data.size());
+    bool ok = reader.read(store);
+    if (error) {
+        *error = reader.errorString();
+    }
+    return ok;
+}
+
+} // namespace
+
+class TestGeoJsonWriter : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void roundTripsCompactAndIndented();
+    void roundTripsIdsAndMetadata();
+    void flattensNestedCollections();
+    void roundsCoordinatesToPrecision();
+    void writesNonFiniteNumbersAsNull();
+    void writesInPartsLikeWhole();
+    void rejectsMalformedDocuments();
+    void rejectsTruncatedDocuments();
+    void survivesCorruptedBytes();
+};
+
+void TestGeoJsonWriter::roundTripsCompactAndIndented()
+{
+    // Large enough to be flushed several times
+    FeatureStore store = sampleFeatures(20000);
+    for (bool indented : {false, true}) {
+        QByteArray data = writeGeoJson(store, indented);
+        QVERIFY(data.size() > 2 * (1 << 20));
+        QCOMPARE(data.contains("\n"), indented);
+        
+        FeatureStore read;
+        QVERIFY(readGeoJson(data, read));
+        QCOMPARE(read.featureCount(), store.featureCount());
+        for (qsizetype feature = 0; feature < store.featureCount(); ++feature) {
+            QCOMPARE(read.featureAt(feature), store.featureAt(feature));
+        }
+    }
+}
+
+void TestGeoJsonWriter::roundTripsIdsAndMetadata()
+{
+    FeatureStore store;
+    const QVariantList ids = {qint64(7), QString("road \"7\""), QVariant(), qint64(-1)};
+    for (const QVariant& id : ids) {
+        store.beginFeature(FeatureStore::Point);
+        addSampleGeometry(store, 1, FeatureStore::Point);
+        if (!id.isNull()) {
+            store.setFeatureId(id);
+        }
+        store.setProperty("tab\tkey", QString("a\\b"));
+        store.endFeature();
+    }
+    QVariantMap metadata;
+    metadata["name"] = "sample";
+    metadata["version"] = qint64(3);
+    store.setMetadata(metadata);
+    
+    FeatureStore read;
+    QVERIFY(readGeoJson(writeGeoJson(store, true), read));
+    QCOMPARE(read.metadata(), metadata);
+    QCOMPARE(read.featureCount(), store.featureCount());
+    for (qsizetype feature = 0; feature < store.featureCount(); ++feature) {
+        QCOMPARE(read.featureAt(feature), store.featureAt(feature));
+    }
+}
+
+void TestGeoJsonWriter::flattensNestedCollections()
+{
+    // Multi* and collection members become simple members of the collection,
+    // in order and with every coordinate
+    QByteArray document = "{\"type\": \"Feature\", \"properties\": {}, \"geometry\": {\"type\": \"GeometryCollection\", \"geometries\": ["
+                          "{\"type\": \"Point\", \"coordinates\": [1, 2]},"
+                          "{\"type\": \"MultiPoint\", \"coordinates\": [[3, 4], [5, 6]]},"
+                          "{\"type\": \"GeometryCollection\", \"geometries\": ["
+                          "{\"type\": \"LineString\", \"coordinates\": [[7, 8], [9, 10]]},"
+                          "{\"type\": \"Polygon\", \"coordinates\": [[[0, 0], [4, 0], [4, 4], [0, 0]], [[1, 1], [2, 1], [2, 2], [1, 1]]]}]},"
+                          "{\"type\": \"MultiPolygon\", \"coordinates\": [[[[10, 10], [11, 10], [11, 11], [10, 10]]], [[[20, 20], [21, 20], [21, 21], [20, 20]]]]}"
+                          "]}}";
+    FeatureStore store;
+    QVERIFY(readGeoJson(document, store));
+    QCOMPARE(store.featureCount(), qsizetype(1));
+    QCOMPARE(store.geometryType(0), FeatureStore::GeometryCollection);
+    const QList<FeatureStore::GeometryType> parts = {FeatureStore::Point, FeatureStore::Point, FeatureStore::Point, FeatureStore::LineString,
+                                                     FeatureStore::Polygon, FeatureStore::Polygon, FeatureStore::Polygon};
+    QCOMPARE(store.partEnd(0) - store.partBegin(0), qsizetype(parts.size()));
+    for (qsizetype part = 0; part < parts.size(); ++part) {
+        QCOMPARE(store.partType(store.partBegin(0) + part), parts[part]);
+    }
+    QCOMPARE(store.coordinateCount(), qsizetype(1 + 2 + 2 + 8 + 8));
+    
+    // Written back with one member per part, the collection reads the same
+    for (bool indented : {false, true}) {
+        FeatureStore read;
+        QVERIFY(readGeoJson(writeGeoJson(store, indented), read));
+        QCOMPARE(read.featureAt(0), store.featureAt(0));
+    }
+}
+
+void TestGeoJsonWriter::roundsCoordinatesToPrecision()
+{
+    FeatureStore store = sampleFeatures(200);
+    for (int precision : {0, 3, 7}) {
+        FeatureStore read;
+        QVERIFY(readGeoJson(writeGeoJson(store, false, precision), read));
+        QCOMPARE(read.coordinateCount(), store.coordinateCount());
+        // Coordinates carry the requested decimals; ties may round either way
+        double scale = std::pow(10.0, precision);
+        for (qsizetype coordinate = 0; coordinate < store.coordinateCount(); ++coordinate) {
+            for (double value : {read.x(coordinate), read.y(coordinate)}) {
+                QVERIFY(std::abs(value * scale - std::round(value * scale)) < 1e-6);
+            }
+            QVERIFY(std::abs(read.x(coordinate) - store.x(coordinate)) * scale <= 0.5 + 1e-6);
+            QVERIFY(std::abs(read.y(coordinate) - store.y(coordinate)) * scale <= 0.5 + 1e-6);
+        }
+    }
+}
+
+void TestGeoJsonWriter::writesNonFiniteNumbersAsNull()
+{
+    FeatureStore store;
+    for (double value : {1.5, double(NAN), double(INFINITY), -double(INFINITY)}) {
+        store.beginFeature(FeatureStore::Point);
+        store.beginPart(FeatureStore::Point);
+        store.beginRing();
+        store.addCoordinate(value, 2.0);
+        store.setProperty("value", value);
+        store.endFeature();
+    }
+    QByteArray data = writeGeoJson(store, false);
+    QCOMPARE(data.count("null"), qsizetype(6));
+    
+    FeatureStore read;
+    QVERIFY(readGeoJson(data, read));
+    QCOMPARE(read.featureCount(), qsizetype(4));
+    QCOMPARE(read.propertiesAt(0)["value"], QVariant(1.5));
+    for (qsizetype feature = 1; feature < 4; ++feature) {
+        QVERIFY(read.propertiesAt(feature)["value"].isNull());
+    }
+}
+
+void TestGeoJsonWriter::writesInPartsLikeWhole()
+{
+    // A layer written page by page matches the same layer written at once
+    FeatureStore store = sampleFeatures(1000);
+    QVariantMap metadata;
+    metadata["name"] = "pages";
+    store.setMetadata(metadata);
+    
+    for (bool indented : {false, true}) {
+        QByteArray data;
+        QBuffer buffer(&data);
+        buffer.open(QIODevice::WriteOnly);
+        GeoJsonWriter writer(&buffer);
+        writer.setIndented(indented);
+        QVERIFY(writer.begin(metadata));
+        for (qsizetype first = 0; first < store.featureCount(); first += 300) {
+            // Pages of a layer share its columns
+            FeatureStore page;
+            for (const QString& name : store.columnNames()) {
+                page.column(name);
+            }
+            for (qsizetype feature = first; feature < qMin(first + 300, store.featureCount()); ++feature) {
+                page.appendFeature(store, feature);
+            }
+            QVERIFY(writer.writeFeatures(page));
+        }
+        QVERIFY(writer.finish());
+        QCOMPARE(data, writeGeoJson(store, indented));
+    }
+}
+
+void TestGeoJsonWriter::rejectsMalformedDocuments()
+{
+    const QList<QByteArray> documents = {
+        "",
+        "[]",
+        "{\"type\": \"FeatureCollection\", \"features\": [}",
+        "{\"type\": \"FeatureCollection\", \"features\": [{\"type\": \"Feature\", \"geometry\": nul}]}",
+        "{\"type\": \"FeatureCollection\" \"features\": []}",
+        "{\"type\": \"Feature\", \"properties\": {\"a\": 1.2.3}}",
+        "{\"type\": \"Feature\", \"properties\": {\"a\": \"unterminated}}",
+        "{\"type\": \"Point\", \"coordinates\": [1, 2,]}",
+        "{\"type\": \"FeatureCollection\", \"features\": []} trailing",
+    };
+    for (const QByteArray& document : documents) {
+        FeatureStore read;
+        QString error;
+        QVERIFY2(!readGeoJson(document, read, &error), document.constData());
+        QVERIFY2(!error.isEmpty(), document.constData());
+    }
+}
+
+void TestGeoJsonWriter::rejectsTruncatedDocuments()
+{
+    // Every prefix of a document is unbalanced JSON and must fail to read
+    QByteArray data = writeGeoJson(sampleFeatures(30), false);
+    QVERIFY(!data.isEmpty());
+    for (qsizetype size = 0; size < data.size(); ++size) {
+        FeatureStore read;
+        QString error;
+        QVERIFY2(!readGeoJson(data.left(size), read, &error), QByteArray::number(size).constData());
+        QVERIFY(!error.isEmpty());
+    }
+}
+
+void TestGeoJsonWriter::survivesCorruptedBytes()
+{
+    // Damaged documents may or may not read, but must stay within their bytes
+    QByteArray data = writeGeoJson(sampleFeatures(40), true);
+    QVERIFY(!data.isEmpty());
+    quint32 seed = 1;
+    for (int round = 0; round < 2000; ++round) {
+        QByteArray corrupted = data;
+        for (int flip = 0; flip < 4; ++flip) {
+            seed = seed * 1103515245 + 12345;
+            corrupted[qsizetype((seed >> 8) % quint32(corrupted.size()))] = char(seed >> 24);
+        }
+        FeatureStore read;
+        readGeoJson(corrupted, read);
+    }
+}
+
+QTEST_GUILESS_MAIN(TestGeoJsonWriter)
+#include "tst_geojsonwriter.moc"
@@ -0,0 +1,253 @@
+#include "KmlReader.h"
+#include <QBuffer>
+#include <QObject>
+#include <QTest>
+
+namespace {
+
+bool readKml(const QByteArray& kml, FeatureStore& store, QString* error = nullptr, QVariantMap* boundingBox = nullptr)
+{
+    QBuffer buffer;
+    buffer.setData(kml);
+    buffer.open(QIODevice::ReadOnly);
+    KmlReader reader(&buffer);
+    bool ok = reader.read(store);
+    if (error) {
+        *error = reader.errorString();
+    }
+    if (boundingBox) {
+        *boundingBox = reader.boundingBox();
+    }
+    return ok;
+}
+
+QByteArray document(const QByteArray& body)
+{
+    return "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+           "<kml xmlns=\"http://www.opengis.net/kml/2.2\">\n<Document>\n"
+           + body + "</Document>\n</kml>\n";
+}
+
+QVariantList position(double x, double y)
+{
+    return {x, y};
+}
+
+} // namespace
+
+class TestKmlReader : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void readsPlacemarks();
+    void readsMultiGeometry();
+    void readsExtendedData();
+    void tracksFolders();
+    void dropsMalformedCoordinates();
+    void rejectsMalformedXml();
+    void cancelsFromProgress();
+};
+
+void TestKmlReader::readsPlacemarks()
+{
+    QByteArray kml = document("<name>Roads</name>\n<description>Survey</description>\n"
+                              "<Style id=\"red\"><LineStyle><color>ff0000ff</color></LineStyle></Style>\n"
+                              "<Placemark id=\"p1\"><name>Well</name><styleUrl>#red</styleUrl>\n"
+                              "  <Point><coordinates>10.5,-20.25,100</coordinates></Point></Placemark>\n"
+                              "<Placemark><name>Track &amp; trail</name>\n"
+                              "  <LineString><coordinates>\n    1,2 3,4\n    5,6,7\n  </coordinates></LineString>\n"
+                              "</Placemark>\n"
+                              "<Placemark><name>Field</name><Polygon>\n"
+                              "  <outerBoundaryIs><LinearRing><coordinates>0,0 4,0 4,4 0,4 0,0</coordinates></LinearRing></outerBoundaryIs>\n"
+                              "  <innerBoundaryIs><LinearRing><coordinates>1,1 2,1 2,2 1,1</coordinates></LinearRing></innerBoundaryIs>\n"
+                              "</Polygon></Placemark>\n"
+                              "<Placemark><name>Empty</name><description><![CDATA[<b>no</b> geometry]]></description></Placemark>\n");
+    FeatureStore store;
+    QVariantMap box;
+    QVERIFY(readKml(kml, store, nullptr, &box));
+    QCOMPARE(store.featureCount(), qsizetype(4));
+    QCOMPARE(store.metadata().value("name").toString(), QString("Roads"));
+    QCOMPARE(store.metadata().value("description").toString(), QString("Survey"));
+    
+    QCOMPARE(store.geometryType(0), FeatureStore::Point);
+    QCOMPARE(store.featureIds().value(0).toString(), QString("p1"));
+    QCOMPARE(store.propertiesAt(0).value("name").toString(), QString("Well"));
+    QCOMPARE(store.propertiesAt(0).value("styleUrl").toString(), QString("#red"));
+    QCOMPARE(store.geometryAt(0).value("coordinates").toList(), position(10.5, -20.25));
+    
+    QCOMPARE(store.geometryType(1), FeatureStore::LineString);
+    QCOMPARE(store.propertiesAt(1).value("name").toString(), QString("Track & trail"));
+    QVariantList line = {QVariant(position(1, 2)), QVariant(position(3, 4)), QVariant(position(5, 6))};
+    QCOMPARE(store.geometryAt(1).value("coordinates").toList(), line);
+    
+    // The outer ring comes first, then the holes
+    QCOMPARE(store.geometryType(2), FeatureStore::Polygon);
+    QVariantList rings = store.geometryAt(2).value("coordinates").toList();
+    QCOMPARE(rings.size(), qsizetype(2));
+    QCOMPARE(rings[0].toList().size(), qsizetype(5));
+    QCOMPARE(rings[1].toList().size(), qsizetype(4));
+    
+    QCOMPARE(store.geometryType(3), FeatureStore::NoGeometry);
+    QCOMPARE(store.propertiesAt(3).value("description").toString(), QString("<b>no</b> geometry"));
+    
+    QCOMPARE(box.value("minLon").toDouble(), 0.0);
+    QCOMPARE(box.value("maxLon").toDouble(), 10.5);
+    QCOMPARE(box.value("minLat").toDouble(), -20.25);
+    QCOMPARE(box.value("maxLat").toDouble(), 6.0);
+}
+
+void TestKmlReader::readsMultiGeometry()
+{
+    QByteArray kml = document("<Placemark><MultiGeometry>\n"
+                              "  <Point><coordinates>1,1</coordinates></Point>\n"
+                              "  <MultiGeometry><Point><coordinates>2,2</coordinates></Point></MultiGeometry>\n"
+                              "</MultiGeometry></Placemark>\n"
+                              "<Placemark><MultiGeometry>\n"
+                              "  <LineString><coordinates>0,0 1,1</coordinates></LineString>\n"
+                              "  <LineString><coordinates>2,2 3,3</coordinates></LineString>\n"
+                              "</MultiGeometry></Placemark>\n"
+                              "<Placemark><MultiGeometry>\n"
+                              "  <Point><coordinates>5,5</coordinates></Point>\n"
+                              "  <Polygon><outerBoundaryIs><LinearRing><coordinates>0,0 1,0 1,1 0,0</coordinates></LinearRing></outerBoundaryIs></Polygon>\n"
+                              "  <Point><coordinates></coordinates></Point>\n"
+                              "</MultiGeometry></Placemark>\n"
+                              "<Placemark><MultiGeometry><Point/></MultiGeometry></Placemark>\n");
+    FeatureStore store;
+    QVERIFY(readKml(kml, store));
+    QCOMPARE(store.featureCount(), qsizetype(4));
+    
+    // Nested members are flattened, and like members make a Multi* geometry
+    QCOMPARE(store.geometryType(0), FeatureStore::MultiPoint);
+    QVariantList points = {QVariant(position(1, 1)), QVariant(position(2, 2))};
+    QCOMPARE(store.geometryAt(0).value("coordinates").toList(), points);
+    QCOMPARE(store.geometryType(1), FeatureStore::MultiLineString);
+    QCOMPARE(store.geometryAt(1).value("coordinates").toList().size(), qsizetype(2));
+    
+    // Mixed members make a collection, and empty members are dropped
+    QCOMPARE(store.geometryType(2), FeatureStore::GeometryCollection);
+    QVariantList geometries = store.geometryAt(2).value("geometries").toList();
+    QCOMPARE(geometries.size(), qsizetype(2));
+    QCOMPARE(geometries[0].toMap().value("type").toString(), QString("Point"));
+    QCOMPARE(geometries[1].toMap().value("type").toString(), QString("Polygon"));
+    QCOMPARE(store.geometryType(3), FeatureStore::NoGeometry);
+}
+
+void TestKmlReader::readsExtendedData()
+{
+    QByteArray kml = document("<Schema name=\"roads\" id=\"roads\"><SimpleField name=\"lanes\" type=\"int\"/></Schema>\n"
+                              "<Placemark><name>A</name><ExtendedData>\n"
+                              "  <Data name=\"surface\"><displayName>Surface</displayName><value>asphalt</value></Data>\n"
+                              "  <SchemaData schemaUrl=\"#roads\"><SimpleData name=\"lanes\">2</SimpleData></SchemaData>\n"
+                              "</ExtendedData>\n"
+                              "<TimeSpan><begin>2020-01-01</begin><end>2021-01-01</end></TimeSpan></Placemark>\n"
+                              "<Placemark><name>B</name><ExtendedData>\n"
+                              "  <Data name=\"surface\"><value>gravel</value></Data>\n"
+                              "  <Data><value>unnamed</value></Data>\n"
+                              "</ExtendedData>\n"
+                              "<TimeStamp><when>2022-06-01T12:00:00Z</when></TimeStamp></Placemark>\n");
+    FeatureStore store;
+    QVERIFY(readKml(kml, store));
+    QCOMPARE(store.featureCount(), qsizetype(2));
+    
+    QVariantMap first = store.propertiesAt(0);
+    QCOMPARE(first.value("surface").toString(), QString("asphalt"));
+    QCOMPARE(first.value("lanes").toString(), QString("2"));
+    QCOMPARE(first.value("begin").toString(), QString("2020-01-01"));
+    QCOMPARE(first.value("end").toString(), QString("2021-01-01"));
+    QVERIFY(!first.contains("timestamp"));
+    
+    // Columns missing from a placemark are null for it, and data without a
+    // name is dropped
+    QVariantMap second = store.propertiesAt(1);
+    QCOMPARE(second.value("surface").toString(), QString("gravel"));
+    QCOMPARE(second.value("timestamp").toString(), QString("2022-06-01T12:00:00Z"));
+    QVERIFY(!second.contains("lanes"));
+    QVERIFY(!store.columnNames().contains(QString()));
+    QVERIFY(!store.columnNames().contains("displayName"));
+}
+
+void TestKmlReader::tracksFolders()
+{
+    QByteArray kml = document("<name>Atlas</name>\n"
+                              "<Folder><name>Europe</name>\n"
+                              "  <Folder><name>Rivers</name>\n"
+                              "    <Placemark><name>Rhine</name></Placemark>\n"
+                              "  </Folder>\n"
+                              "  <Placemark><name>Alps</name></Placemark>\n"
+                              "</Folder>\n"
+                              "<Placemark><name>Loose</name></Placemark>\n");
+    FeatureStore store;
+    QVERIFY(readKml(kml, store));
+    QCOMPARE(store.featureCount(), qsizetype(3));
+    QCOMPARE(store.propertiesAt(0).value("folder").toString(), QString("Europe/Rivers"));
+    QCOMPARE(store.propertiesAt(1).value("folder").toString(), QString("Europe"));
+    QVERIFY(!store.propertiesAt(2).contains("folder"));
+    QCOMPARE(store.metadata().value("name").toString(), QString("Atlas"));
+}
+
+void TestKmlReader::dropsMalformedCoordinates()
+{
+    // Tuples that do not parse, or have a single value, are skipped and the
+    // rest of the geometry is kept
+    QByteArray kml = document("<Placemark><LineString><coordinates>\n"
+                              "  1,1 x,2 3 4,abc 5,5 1e400,2 6,6\n"
+                              "</coordinates></LineString></Placemark>\n"
+                              "<Placemark><Point><coordinates>not numbers</coordinates></Point></Placemark>\n");
+    FeatureStore store;
+    QVariantMap box;
+    QVERIFY(readKml(kml, store, nullptr, &box));
+    QCOMPARE(store.featureCount(), qsizetype(2));
+    QCOMPARE(store.geometryType(0), FeatureStore::LineString);
+    QVariantList line = {QVariant(position(1, 1)), QVariant(position(5, 5)), QVariant(position(6, 6))};
+    QCOMPARE(store.geometryAt(0).value("coordinates").toList(), line);
+    QCOMPARE(store.geometryType(1), FeatureStore::NoGeometry);
+    QCOMPARE(box.value("maxLon").toDouble(), 6.0);
+}
+
+void TestKmlReader::rejectsMalformedXml()
+{
+    const QList<QByteArray> broken = {
+        document("<Placemark><name>Open</name>\n<Point><coordinates>1,2</coordinates></Point>\n"),
+        document("<Placemark><name>Crossed</Placemark></name>\n"),
+        document("<Placemark><name>Bad &entity; reference</name></Placemark>\n"),
+        "<kml><Document><Placemark>",
+        "not xml at all",
+    };
+    for (const QByteArray& kml : broken) {
+        FeatureStore store;
+        QString error;
+        QVERIFY(!readKml(kml, store, &error));
+        QVERIFY(error.contains("line"));
+    }
+    
+    // A document without placemarks is an empty layer
+    FeatureStore store;
+    QVariantMap box;
+    QVERIFY(readKml(document("<name>Nothing</name>\n"), store, nullptr, &box));
+    QCOMPARE(store.featureCount(), qsizetype(0));
+    QVERIFY(box.isEmpty());
+}
+
+void TestKmlReader::cancelsFromProgress()
+{
+    QByteArray body;
+    for (int i = 0; i < 5000; ++i) {
+        body += "<Placemark><Point><coordinates>" + QByteArray::number(i % 180) + ",0</coordinates></Point></Placemark>\n";
+    }
+    QBuffer buffer;
+    buffer.setData(document(body));
+    buffer.open(QIODevice::ReadOnly);
+    KmlReader reader(&buffer);
+    FeatureStore store;
+    qint64 reported = 0;
+    QVERIFY(!reader.read(store, [&reported](qint64, qint64 features) {
+        reported = features;
+        return features < 2048;
+    }));
+    QVERIFY(reader.wasCancelled());
+    QCOMPARE(reported, qint64(2048));
+}
+
+QTEST_GUILESS_MAIN(TestKmlReader)
+#include "tst_kmlreader.moc"
@@ -0,0 +1,332 @@
+#include "FeatureBounds.h"
+#include "PageCache.h"
+#include "PagedLayerFile.h"
+#include "PagedLayerWriter.h"
+#include "TestFeatures.h"
+#include <QDateTime>
+#include <QFile>
+#include <QFileInfo>
+#include <QObject>
+#include <QTemporaryDir>
+#include <QTest>
+#include <QThreadPool>
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+
+namespace {
+
+bool writeFile(const QString& path, const QByteArray& data)
+{
+    QFile file(path);
+    return file.open(QIODevice::WriteOnly) && file.write(data) == data.size();
+}
+
+QByteArray readFile(const QString& path)
+{
+    QFile file(path);
+    return file.open(QIODevice::ReadOnly) ? file.readAll() : QByteArray();
+}
+
+// Writes the page file of store, in batches of batchSize features, for the
+// source at sourcePath
+bool writePages(const QString& path, const QString& sourcePath, const FeatureStore& store, qsizetype batchSize,
+                const QVariantMap& layer = QVariantMap())
+{
+    PagedLayerWriter writer(path);
+    if (!writer.open(sourcePath)) {
+        return false;
+    }
+    for (qsizetype first = 0; first < store.featureCount(); first += batchSize) {
+        FeatureStore batch;
+        for (qsizetype feature = first; feature < qMin(first + batchSize, store.featureCount()); ++feature) {
+            batch.appendFeature(store, feature);
+        }
+        if (!writer.addBatch(batch)) {
+            return false;
+        }
+    }
+    return writer.finish(layer);
+}
+
+// Features of every page by their "id" property, which sampleFeatures()
+// numbers from 0
+QVector<QVariantMap> readAllPages(const PagedLayerFile& file, QVector<PackedRTree::Node>* bounds = nullptr)
+{
+    QVector<QVariantMap> features(file.featureCount());
+    if (bounds) {
+        bounds->resize(file.featureCount());
+    }
+    for (qsizetype index = 0; index < file.pageCount(); ++index) {
+        PagedLayerFile::Page page;
+        if (!file.readPage(index, page)) {
+            return QVector<QVariantMap>();
+        }
+        for (qsizetype feature = 0; feature < page.features.featureCount(); ++feature) {
+            qint64 id = page.features.propertiesAt(feature)["id"].toLongLong();
+            features[id] = page.features.featureAt(feature);
+            if (bounds) {
+                (*bounds)[id] = page.bounds[feature];
+            }
+        }
+    }
+    return features;
+}
+
+} // namespace
+
+class TestPagedLayer : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void roundTripsFeaturesAndBounds();
+    void findsPagesInExtent();
+    void rejectsChangedSource();
+    void rejectsDamagedFiles();
+    void evictsWithinBudget();
+    void readsPagesConcurrently();
+};
+
+void TestPagedLayer::roundTripsFeaturesAndBounds()
+{
+    QTemporaryDir directory;
+    QVERIFY(directory.isValid());
+    QString source = directory.filePath("source.csv");
+    QVERIFY(writeFile(source, "id\n1\n"));
+    
+    // Several batches, each cut into pages of at most 4096 features
+    FeatureStore store = sampleFeatures(20000);
+    QVariantMap layer;
+    layer["fields"] = store.columnNames();
+    QString path = directory.filePath("layer.gwp");
+    QVERIFY(writePages(path, source, store, 7000, layer));
+    
+    PagedLayerFile file(path);
+    QVERIFY(file.open(source));
+    QCOMPARE(file.featureCount(), qint64(store.featureCount()));
+    QVERIFY(file.pageCount() >= 6);
+    QCOMPARE(file.layer(), layer);
+    
+    PackedRTree::Node extent;
+    QVector<PackedRTree::Node> expectedBounds = FeatureBounds::compute(store, extent, 1);
+    QVector<PackedRTree::Node> bounds;
+    QVector<QVariantMap> features = readAllPages(file, &bounds);
+    QCOMPARE(features.size(), store.featureCount());
+    for (qsizetype feature = 0; feature < store.featureCount(); ++feature) {
+        QCOMPARE(features[feature], store.featureAt(feature));
+        QCOMPARE(bounds[feature].isEmpty(), expectedBounds[feature].isEmpty());
+        if (!bounds[feature].isEmpty()) {
+            QCOMPARE(bounds[feature].minX, expectedBounds[feature].minX);
+            QCOMPARE(bounds[feature].maxY, expectedBounds[feature].maxY);
+        }
+    }
+    QCOMPARE(file.extent().minX, extent.minX);
+    QCOMPARE(file.extent().maxY, extent.maxY);
+}
+
+void TestPagedLayer::findsPagesInExtent()
+{
+    QTemporaryDir directory;
+    QString source = directory.filePath("source.csv");
+    QVERIFY(writeFile(source, "id\n1\n"));
+    FeatureStore store = sampleFeatures(20000);
+    QString path = directory.filePath("layer.gwp");
+    QVERIFY(writePages(path, source, store, 20000));
+    PagedLayerFile file(path);
+    QVERIFY(file.open(source));
+    
+    // The pages of a box hold every feature intersecting it, and only
+    // pages with such features are listed
+    PackedRTree::Node extent;
+    QVector<PackedRTree::Node> bounds = FeatureBounds::compute(store, extent, 1);
+    for (const PackedRTree::Node& box : {PackedRTree::Node{-10, -10, 10, 10}, PackedRTree::Node{100, 40, 101, 41}, extent}) {
+        qsizetype expected = 0;
+        for (const PackedRTree::Node& feature : bounds) {
+            expected += !feature.isEmpty() && feature.intersects(box);
+        }
+        qsizetype found = 0;
+        QVector<qsizetype> pages = file.pagesIn(box);
+        QVERIFY(std::is_sorted(pages.begin(), pages.end()));
+        for (qsizetype index : pages) {
+            PagedLayerFile::Page page;
+            QVERIFY(file.readPage(index, page));
+            for (const PackedRTree::Node& feature : page.bounds) {
+                found += !feature.isEmpty() && feature.intersects(box);
+            }
+        }
+        QCOMPARE(found, expected);
+    }
+    QVERIFY(file.pagesIn(PackedRTree::Node{500, 500, 501, 501}).isEmpty());
+}
+
+void TestPagedLayer::rejectsChangedSource()
+{
+    QTemporaryDir directory;
+    QString source = directory.filePath("source.csv");
+    QVERIFY(writeFile(source, "id,name\n1,first\n2,second\n"));
+    QString path = directory.filePath("layer.gwp");
+    QVERIFY(writePages(path, source, sampleFeatures(100), 100));
+    QVERIFY(PagedLayerFile(path).open(source));
+    
+    // Another file, even with the same content
+    QString other = directory.filePath("other.csv");
+    QVERIFY(writeFile(other, "id,name\n1,first\n2,second\n3,third\n"));
+    QVERIFY(!PagedLayerFile(path).open(other));
+    
+    // Rewritten with the same size and modification time, which only the
+    // fingerprint tells apart
+    QDateTime modified = QFileInfo(source).lastModified();
+    QVERIFY(writeFile(source, "id,name\n1,first\n2,SECOND\n"));
+    QFile touched(source);
+    QVERIFY(touched.open(QIODevice::ReadWrite));
+    QVERIFY(touched.setFileTime(modified, QFileDevice::FileModificationTime));
+    touched.close();
+    QCOMPARE(QFileInfo(source).lastModified(), modified);
+    QVERIFY(!PagedLayerFile(path).open(source));
+    
+    // Grown
+    QVERIFY(writeFile(source, "id,name\n1,first\n2,second\n3,third\n"));
+    QVERIFY(!PagedLayerFile(path).open(source));
+}
+
+void TestPagedLayer::rejectsDamagedFiles()
+{
+    QTemporaryDir directory;
+    QString source = directory.filePath("source.csv");
+    QVERIFY(writeFile(source, "id\n1\n"));
+    QString path = directory.filePath("layer.gwp");
+    QVERIFY(writePages(path, source, sampleFeatures(5000), 5000));
+    QByteArray data = readFile(path);
+    QVERIFY(!data.isEmpty());
+    QVERIFY(!PagedLayerFile(directory.filePath("missing.gwp")).open(source));
+    
+    // Cut off anywhere in the table, layer map or trailer
+    QString damaged = directory.filePath("damaged.gwp");
+    for (qsizetype cut : {qsizetype(0), qsizetype(1), qsizetype(sizeof(PagedLayer::Trailer)), data.size() / 2}) {
+        QVERIFY(writeFile(damaged, data.left(data.size() - 1 - cut)));
+        QVERIFY(!PagedLayerFile(damaged).open(source));
+    }
+    
+    // Trailer fields that no longer match the file
+    const qsizetype trailer = data.size() - qsizetype(sizeof(PagedLayer::Trailer));
+    const QList<QPair<qsizetype, qint64>> fields = {
+        {offsetof(PagedLayer::Trailer, featureCount), 4999},
+        {offsetof(PagedLayer::Trailer, pageCount), 1000000},
+        {offsetof(PagedLayer::Trailer, pageCount), -1},
+        {offsetof(PagedLayer::Trailer, tableOffset), 8},
+        {offsetof(PagedLayer::Trailer, layerSize), 1 << 30},
+    };
+    for (const auto& field : fields) {
+        QByteArray changed = data;
+        std::memcpy(changed.data() + trailer + field.first, &field.second, sizeof(field.second));
+        QVERIFY(writeFile(damaged, changed));
+        QVERIFY(!PagedLayerFile(damaged).open(source));
+    }
+    QByteArray wrongMagic = data;
+    wrongMagic[trailer] = 'X';
+    QVERIFY(writeFile(damaged, wrongMagic));
+    QVERIFY(!PagedLayerFile(damaged).open(source));
+    QByteArray wrongVersion = data;
+    quint32 version = PagedLayer::FormatVersion + 1;
+    std::memcpy(wrongVersion.data() + trailer + offsetof(PagedLayer::Trailer, version), &version, sizeof(version));
+    QVERIFY(writeFile(damaged, wrongVersion));
+    QVERIFY(!PagedLayerFile(damaged).open(source));
+    
+    // A damaged page fails to read, and the others still read: the count
+    // of feature types that starts the snapshot after the bounds
+    PagedLayerFile intact(path);
+    QVERIFY(intact.open(source));
+    QVERIFY(intact.pageCount() >= 2);
+    PagedLayerFile::Page first;
+    QVERIFY(intact.readPage(0, first));
+    QByteArray page = data;
+    std::memset(page.data() + PagedLayer::BoundsBytes * first.bounds.size(), 0xFF, sizeof(quint64));
+    QVERIFY(writeFile(damaged, page));
+    PagedLayerFile file(damaged);
+    QVERIFY(file.open(source));
+    PagedLayerFile::Page read;
+    QVERIFY(!file.readPage(0, read));
+    QVERIFY(file.readPage(1, read));
+}
+
+void TestPagedLayer::evictsWithinBudget()
+{
+    QTemporaryDir directory;
+    QString source = directory.filePath("source.csv");
+    QVERIFY(writeFile(source, "id\n1\n"));
+    QString path = directory.filePath("layer.gwp");
+    QVERIFY(writePages(path, source, sampleFeatures(40000), 40000));
+    PagedLayerFile file(path);
+    QVERIFY(file.open(source));
+    QVERIFY(file.pageCount() >= 10);
+    
+    // The decoded size of the largest page, as the cache counts it
+    qint64 largest = 0;
+    PageCache unbounded(file, qint64(1) << 40);
+    for (qsizetype index = 0; index < file.pageCount(); ++index) {
+        qint64 before = unbounded.residentBytes();
+        QVERIFY(unbounded.page(index));
+        largest = qMax(largest, unbounded.residentBytes() - before);
+    }
+    QCOMPARE(unbounded.misses(), qint64(file.pageCount()));
+    
+    // A budget of a few pages holds the recently used ones and never more
+    qint64 budget = largest * 3;
+    PageCache cache(file, budget);
+    QCOMPARE(cache.maxBytes(), budget);
+    PageCache::PagePointer held = cache.page(0);
+    for (int round = 0; round < 3; ++round) {
+        for (qsizetype index = 0; index < file.pageCount(); ++index) {
+            QVERIFY(cache.page(index));
+            QVERIFY(cache.residentBytes() <= budget);
+            QVERIFY(cache.page(index));
+        }
+    }
+    // Only the first page is still cached when the first round starts
+    QCOMPARE(cache.misses(), qint64(3 * file.pageCount()));
+    QCOMPARE(cache.hits(), qint64(3 * file.pageCount() + 1));
+    
+    // Evicted pages stay alive while held
+    QVERIFY(held->features.featureCount() > 0);
+    QCOMPARE(held->features.featureCount(), held->bounds.size());
+}
+
+void TestPagedLayer::readsPagesConcurrently()
+{
+    QTemporaryDir directory;
+    QString source = directory.filePath("source.csv");
+    QVERIFY(writeFile(source, "id\n1\n"));
+    QString path = directory.filePath("layer.gwp");
+    QVERIFY(writePages(path, source, sampleFeatures(30000), 30000));
+    PagedLayerFile file(path);
+    QVERIFY(file.open(source));
+    
+    // Pages in the order asked, cached ones included, read on the calling
+    // thread as well as on the pool
+    QVector<qsizetype> indexes;
+    for (qsizetype index = file.pageCount() - 1; index >= 0; index -= 2) {
+        indexes.append(index);
+    }
+    indexes.append(indexes.first());
+    QThreadPool pool;
+    pool.setMaxThreadCount(2);
+    for (QThreadPool* given : {static_cast<QThreadPool*>(nullptr), &pool}) {
+        PageCache cache(file, qint64(1) << 40);
+        QVERIFY(cache.page(1));
+        QVector<PageCache::PagePointer> pages = cache.pages(indexes, given);
+        QCOMPARE(pages.size(), indexes.size());
+        for (qsizetype i = 0; i < indexes.size(); ++i) {
+            PagedLayerFile::Page expected;
+            QVERIFY(pages[i]);
+            QVERIFY(file.readPage(indexes[i], expected));
+            QCOMPARE(pages[i]->features.featureCount(), expected.features.featureCount());
+            QCOMPARE(pages[i]->features.featureAt(0), expected.features.featureAt(0));
+        }
+        QCOMPARE(pages.first(), pages.last());
+        QCOMPARE(cache.hits() + cache.misses(), qint64(indexes.size() + 1));
+    }
+}
+
+QTEST_GUILESS_MAIN(TestPagedLayer)
+#include "tst_pagedlayer.moc"
@@ -0,0 +1,205 @@
+#include "GeoJsonReader.h"
+#include "GeoJsonWriter.h"
+#include "ParallelGeoJsonReader.h"
+#include "TestFeatures.h"
+#include <QBuffer>
+#include <QObject>
+#include <QTest>
+#include <QThread>
+#include <QThreadPool>
+
+namespace {
+
+QByteArray writeGeoJson(const FeatureStore& store, bool indented)
+{
+    QByteArray data;
+    QBuffer buffer(&data);
+    buffer.open(QIODevice::WriteOnly);
+    GeoJsonWriter writer(&buffer);
+    writer.setIndented(indented);
+    return writer.write(store) ? data : QByteArray();
+}
+
+bool readSequential(const QByteArray& data, FeatureStore& store)
+{
+    GeoJsonReader reader(data.constData(), data.size());
+    return reader.read(store);
+}
+
+bool readParallel(const QByteArray& data, FeatureStore& store, int threads, QString* error = nullptr,
+                  QThreadPool* pool = nullptr)
+{
+    ParallelGeoJsonReader reader(data.constData(), data.size());
+    reader.setThreadCount(threads);
+    bool ok = reader.read(store, IngestProgress(), pool);
+    if (error) {
+        *error = reader.errorString();
+    }
+    return ok;
+}
+
+void compareStores(const FeatureStore& read, const FeatureStore& expected)
+{
+    QCOMPARE(read.metadata(), expected.metadata());
+    QCOMPARE(read.columnNames(), expected.columnNames());
+    QCOMPARE(read.featureCount(), expected.featureCount());
+    for (qsizetype feature = 0; feature < expected.featureCount(); ++feature) {
+        QCOMPARE(read.featureAt(feature), expected.featureAt(feature));
+    }
+}
+
+// Offsets of the commas between the features of an indented document
+QVector<qsizetype> featureSeparators(const QByteArray& data)
+{
+    static const QByteArray Separator = "\n        },\n        {";
+    QVector<qsizetype> commas;
+    for (qsizetype i = data.indexOf(Separator); i >= 0; i = data.indexOf(Separator, i + 1)) {
+        commas.append(i + 10);
+    }
+    return commas;
+}
+
+// The commas a read on four threads splits a document of a few MB after:
+// the first one at least 1 MB past the previous split
+QVector<qsizetype> splitSeparators(const QByteArray& data)
+{
+    QVector<qsizetype> splits;
+    qsizetype chunkStart = data.indexOf('[') + 1;
+    for (qsizetype comma : featureSeparators(data)) {
+        if (comma + 1 - chunkStart >= (1 << 20)) {
+            splits.append(comma);
+            chunkStart = comma + 1;
+        }
+    }
+    return splits;
+}
+
+} // namespace
+
+class TestParallelGeoJson : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void readsSameAsSequential();
+    void readsOnGivenPool();
+    void rejectsSameSeparatorsAsSequential();
+    void rejectsBrokenFeaturesInAnySlice();
+};
+
+void TestParallelGeoJson::readsSameAsSequential()
+{
+    FeatureStore store = sampleFeatures(30000);
+    QVariantMap metadata;
+    metadata["name"] = "parallel";
+    store.setMetadata(metadata);
+    for (bool indented : {false, true}) {
+        QByteArray data = writeGeoJson(store, indented);
+        QVERIFY(data.size() > 4 * (1 << 20));
+        FeatureStore expected;
+        QVERIFY(readSequential(data, expected));
+        for (int threads : {1, 2, 4, 8}) {
+            FeatureStore read;
+            QVERIFY(readParallel(data, read, threads));
+            compareStores(read, expected);
+        }
+    }
+    
+    // Root members after the features array are read from the trailer
+    QByteArray data = writeGeoJson(sampleFeatures(30000), true);
+    data.insert(data.lastIndexOf('}'), ", \"name\": \"trailer\", \"count\": 3\n");
+    FeatureStore expected;
+    QVERIFY(readSequential(data, expected));
+    QCOMPARE(expected.metadata().value("name"), QVariant("trailer"));
+    FeatureStore read;
+    QVERIFY(readParallel(data, read, 4));
+    compareStores(read, expected);
+}
+
+void TestParallelGeoJson::readsOnGivenPool()
+{
+    // The calling thread takes slices too, so a pool that never runs the
+    // read's tasks does not stall it
+    QByteArray data = writeGeoJson(sampleFeatures(30000), true);
+    FeatureStore expected;
+    QVERIFY(readSequential(data, expected));
+    QThreadPool pool;
+    pool.setMaxThreadCount(1);
+    pool.start([]() { QThread::msleep(200); });
+    FeatureStore read;
+    QVERIFY(readParallel(data, read, 4, nullptr, &pool));
+    compareStores(read, expected);
+    pool.waitForDone();
+}
+
+void TestParallelGeoJson::rejectsSameSeparatorsAsSequential()
+{
+    QByteArray data = writeGeoJson(sampleFeatures(30000), true);
+    QVector<qsizetype> splits = splitSeparators(data);
+    QVERIFY(splits.size() >= 3);
+    QVector<qsizetype> separators = featureSeparators(data);
+    qsizetype arrayStart = data.indexOf('[') + 1;
+    qsizetype arrayEnd = data.lastIndexOf(']');
+    
+    // Faults where the document is split and within a slice
+    QList<QByteArray> broken;
+    for (qsizetype comma : {splits[0], splits[1], splits.last(), separators[5], separators[separators.size() / 2 + 1]}) {
+        broken.append(QByteArray(data).insert(comma, ','));
+        broken.append(QByteArray(data).insert(comma + 1, ",\n"));
+        broken.append(QByteArray(data).replace(comma, 1, " "));
+        broken.append(QByteArray(data).replace(comma, 1, "\x1E"));
+        broken.append(QByteArray(data).insert(comma + 1, "\x1E"));
+        broken.append(QByteArray(data).insert(comma, " 5"));
+    }
+    broken.append(QByteArray(data).insert(arrayStart, ','));
+    broken.append(QByteArray(data).insert(arrayEnd, ','));
+    broken.append(QByteArray(data).insert(arrayEnd, ",\n,"));
+    broken.append(QByteArray(data).replace(arrayEnd, 1, "}"));
+    broken.append("{\"type\": \"FeatureCollection\", \"features\": [,]}");
+    for (const QByteArray& input : broken) {
+        FeatureStore expected;
+        QVERIFY(!readSequential(input, expected));
+        for (int threads : {1, 4}) {
+            FeatureStore read;
+            QString error;
+            QVERIFY(!readParallel(input, read, threads, &error));
+            QVERIFY(!error.isEmpty());
+        }
+    }
+    
+    // Elements that are not objects are skipped by both
+    QList<QByteArray> accepted = {
+        QByteArray(data).insert(splits[0] + 1, " 5,"),
+        QByteArray(data).insert(splits[1] + 1, " \"text\", [1, {}],"),
+        QByteArray(data).insert(arrayEnd, ", null"),
+        "{\"type\": \"FeatureCollection\", \"features\": []}",
+        "{\"type\": \"FeatureCollection\", \"features\": [ \n ]}",
+    };
+    for (const QByteArray& input : accepted) {
+        FeatureStore expected;
+        QVERIFY(readSequential(input, expected));
+        FeatureStore read;
+        QVERIFY(readParallel(input, read, 4));
+        compareStores(read, expected);
+    }
+}
+
+void TestParallelGeoJson::rejectsBrokenFeaturesInAnySlice()
+{
+    // A broken feature in the last slice fails the read after the earlier
+    // slices have been merged
+    QByteArray data = writeGeoJson(sampleFeatures(30000), true);
+    QVector<qsizetype> separators = featureSeparators(data);
+    for (qsizetype comma : {separators[3], separators[separators.size() / 2], separators.last()}) {
+        QByteArray input = QByteArray(data).insert(comma + 1, "{\"type\": \"Feature\", \"properties\": {\"a\": tru}},");
+        FeatureStore expected;
+        QVERIFY(!readSequential(input, expected));
+        FeatureStore read;
+        QString error;
+        QVERIFY(!readParallel(input, read, 4, &error));
+        QVERIFY(!error.isEmpty());
+    }
+}
+
+QTEST_GUILESS_MAIN(TestParallelGeoJson)
+#include "tst_parallelgeojson.moc"
@@ -0,0 +1,462 @@
+#include "ShapefileReader.h"
+#include <QObject>
+#include <QTest>
+#include <QThread>
+#include <QThreadPool>
+#include <QtEndian>
+
+namespace {
+
+const qint32 PointShape = 1;
+const qint32 PolyLineShape = 3;
+const qint32 PolygonShape = 5;
+
+template<typename T>
+void appendLE(QByteArray& data, T value)
+{
+    char bytes[sizeof(T)];
+    qToLittleEndian(value, bytes);
+    data.append(bytes, sizeof(T));
+}
+
+template<typename T>
+void appendBE(QByteArray& data, T value)
+{
+    char bytes[sizeof(T)];
+    qToBigEndian(value, bytes);
+    data.append(bytes, sizeof(T));
+}
+
+QByteArray pointRecord(double x, double y)
+{
+    QByteArray content;
+    appendLE<qint32>(content, PointShape);
+    appendLE<double>(content, x);
+    appendLE<double>(content, y);
+    return content;
+}
+
+// Parts are flat lists of x and y values
+QByteArray polyRecord(qint32 shapeType, const QList<QVector<double>>& parts)
+{
+    qint32 pointCount = 0;
+    for (const QVector<double>& part : parts) {
+        pointCount += qint32(part.size() / 2);
+    }
+    
+    QByteArray content;
+    appendLE<qint32>(content, shapeType);
+    for (int i = 0; i < 4; ++i) {
+        appendLE<double>(content, 0.0);
+    }
+    appendLE<qint32>(content, qint32(parts.size()));
+    appendLE<qint32>(content, pointCount);
+    qint32 first = 0;
+    for (const QVector<double>& part : parts) {
+        appendLE<qint32>(content, first);
+        first += qint32(part.size() / 2);
+    }
+    for (const QVector<double>& part : parts) {
+        for (double value : part) {
+            appendLE<double>(content, value);
+        }
+    }
+    return content;
+}
+
+struct Shapefile {
+    QByteArray shp;
+    QByteArray shx;
+};
+
+QByteArray mainHeader(qint32 shapeType, qsizetype fileSize)
+{
+    QByteArray header;
+    appendBE<qint32>(header, 9994);
+    for (int i = 0; i < 5; ++i) {
+        appendBE<qint32>(header, 0);
+    }
+    appendBE<qint32>(header, qint32(fileSize / 2));
+    appendLE<qint32>(header, 1000);
+    appendLE<qint32>(header, shapeType);
+    for (int i = 0; i < 8; ++i) {
+        appendLE<double>(header, 0.0);
+    }
+    return header;
+}
+
+// The .shp and .shx of records given by their content
+Shapefile shapefile(qint32 shapeType, const QList<QByteArray>& records)
+{
+    QByteArray body;
+    QByteArray index;
+    for (qsizetype i = 0; i < records.size(); ++i) {
+        appendBE<qint32>(index, qint32((100 + body.size()) / 2));
+        appendBE<qint32>(index, qint32(records[i].size() / 2));
+        appendBE<qint32>(body, qint32(i + 1));
+        appendBE<qint32>(body, qint32(records[i].size() / 2));
+        body.append(records[i]);
+    }
+    Shapefile file;
+    file.shp = mainHeader(shapeType, 100 + body.size());
+    file.shp.append(body);
+    file.shx = mainHeader(shapeType, 100 + index.size());
+    file.shx.append(index);
+    return file;
+}
+
+struct DbfField {
+    QByteArray name;
+    char type;
+    int length;
+    int decimals;
+};
+
+// Rows hold one value per field
+QByteArray dbfFile(const QList<DbfField>& fields, const QList<QList<QByteArray>>& rows,
+                   const QList<qsizetype>& deletedRows = {})
+{
+    int recordSize = 1;
+    for (const DbfField& field : fields) {
+        recordSize += field.length;
+    }
+    
+    QByteArray dbf;
+    dbf.append(char(0x03));
+    dbf.append(3, char(1));
+    appendLE<quint32>(dbf, quint32(rows.size()));
+    appendLE<quint16>(dbf, quint16(32 + fields.size() * 32 + 1));
+    appendLE<quint16>(dbf, quint16(recordSize));
+    dbf.append(20, '\0');
+    for (const DbfField& field : fields) {
+        QByteArray descriptor = field.name.left(10);
+        descriptor.append(11 - descriptor.size(), '\0');
+        descriptor.append(field.type);
+        descriptor.append(4, '\0');
+        descriptor.append(char(field.length));
+        descriptor.append(char(field.decimals));
+        descriptor.append(14, '\0');
+        dbf.append(descriptor);
+    }
+    dbf.append(char(0x0D));
+    
+    for (qsizetype row = 0; row < rows.size(); ++row) {
+        dbf.append(deletedRows.contains(row) ? '*' : ' ');
+        for (qsizetype i = 0; i < fields.size(); ++i) {
+            QByteArray value = rows[row].value(i).left(fields[i].length);
+            dbf.append(value);
+            dbf.append(fields[i].length - value.size(), ' ');
+        }
+    }
+    dbf.append(char(0x1A));
+    return dbf;
+}
+
+QVariant valueAt(const FeatureStore& store, const QString& column, qsizetype row)
+{
+    int index = store.columnIndex(column);
+    return index >= 0 ? store.columns()[index].value(row) : QVariant();
+}
+
+// Squares listed clockwise as outer rings and counter-clockwise as holes
+QVector<double> square(double x, double y, double size, bool clockwise)
+{
+    if (clockwise) {
+        return {x, y, x, y + size, x + size, y + size, x + size, y, x, y};
+    }
+    return {x, y, x + size, y, x + size, y + size, x, y + size, x, y};
+}
+
+} // namespace
+
+class TestShapefile : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void readsPointsWithAttributes();
+    void decodesTextByCodePage();
+    void groupsPolygonRingsByOrientation();
+    void readsWithoutIndex();
+    void readsRecordRangesOnThreads();
+    void rejectsTruncatedFiles();
+    void rejectsMalformedRecords();
+    void survivesCorruptedBytes();
+};
+
+void TestShapefile::readsPointsWithAttributes()
+{
+    Shapefile file = shapefile(PointShape, {pointRecord(1.5, 2.5), pointRecord(-3, 4), pointRecord(5, 6)});
+    QByteArray dbf = dbfFile({{"NAME", 'C', 10, 0}, {"COUNT", 'N', 6, 0}, {"RATIO", 'N', 8, 3},
+                              {"OK", 'L', 1, 0}, {"DAY", 'D', 8, 0}},
+                             {{"first", "12", "0.500", "T", "20240131"},
+                              {"deleted", "1", "1", "F", ""},
+                              {"", "******", "", "?", ""}},
+                             {1});
+    
+    ShapefileReader reader(file.shp.constData(), file.shp.size());
+    reader.setIndex(file.shx.constData(), file.shx.size());
+    reader.setAttributes(dbf.constData(), dbf.size());
+    FeatureStore store;
+    QVERIFY(reader.read(store));
+    QCOMPARE(reader.fieldNames(), QStringList({"NAME", "COUNT", "RATIO", "OK", "DAY"}));
+    
+    // The deleted record is skipped
+    QCOMPARE(store.featureCount(), qsizetype(2));
+    QCOMPARE(store.geometryType(0), FeatureStore::Point);
+    QCOMPARE(store.x(0), 1.5);
+    QCOMPARE(store.y(0), 2.5);
+    QCOMPARE(store.x(1), 5.0);
+    
+    QCOMPARE(valueAt(store, "NAME", 0).toString(), QString("first"));
+    QCOMPARE(valueAt(store, "COUNT", 0).toLongLong(), qint64(12));
+    QCOMPARE(valueAt(store, "RATIO", 0).toDouble(), 0.5);
+    QCOMPARE(valueAt(store, "OK", 0).toBool(), true);
+    QCOMPARE(valueAt(store, "DAY", 0).toString(), QString("2024-01-31"));
+    
+    // Blank, overflowed and unknown values are null
+    for (const QString& column : {"NAME", "COUNT", "RATIO", "OK", "DAY"}) {
+        QVERIFY(store.columns()[store.columnIndex(column)].isNull(1));
+    }
+}
+
+void TestShapefile::decodesTextByCodePage()
+{
+    Shapefile file = shapefile(PointShape, {pointRecord(0, 0)});
+    QByteArray utf8 = dbfFile({{"NAME", 'C', 10, 0}}, {{"Z\xC3\xBCrich"}});
+    QByteArray latin1 = dbfFile({{"NAME", 'C', 10, 0}}, {{"Z\xFCrich"}});
+    
+    ShapefileReader utf8Reader(file.shp.constData(), file.shp.size());
+    utf8Reader.setAttributes(utf8.constData(), utf8.size(), "UTF-8");
+    FeatureStore utf8Store;
+    QVERIFY(utf8Reader.read(utf8Store));
+    QCOMPARE(valueAt(utf8Store, "NAME", 0).toString(), QString::fromUtf8("Z\xC3\xBCrich"));
+    
+    ShapefileReader latin1Reader(file.shp.constData(), file.shp.size());
+    latin1Reader.setAttributes(latin1.constData(), latin1.size());
+    FeatureStore latin1Store;
+    QVERIFY(latin1Reader.read(latin1Store));
+    QCOMPARE(valueAt(latin1Store, "NAME", 0).toString(), QString::fromUtf8("Z\xC3\xBCrich"));
+}
+
+void TestShapefile::groupsPolygonRingsByOrientation()
+{
+    Shapefile file = shapefile(PolygonShape, {
+        polyRecord(PolygonShape, {square(0, 0, 10, true), square(2, 2, 2, false), square(5, 5, 2, false)}),
+        polyRecord(PolygonShape, {square(0, 0, 1, true), square(5, 5, 1, true), square(5.25, 5.25, 0.5, false)}),
+        polyRecord(PolyLineShape, {{0, 0, 1, 1}, {2, 2, 3, 3, 4, 2}}),
+        QByteArray(4, '\0')
+    });
+    
+    ShapefileReader reader(file.shp.constData(), file.shp.size());
+    reader.setIndex(file.shx.constData(), file.shx.size());
+    FeatureStore store;
+    QVERIFY(reader.read(store));
+    QCOMPARE(store.featureCount(), qsizetype(4));
+    
+    // One outer ring and its two holes
+    QCOMPARE(store.geometryType(0), FeatureStore::Polygon);
+    QCOMPARE(store.partEnd(0) - store.partBegin(0), qsizetype(1));
+    QCOMPARE(store.ringEnd(store.partBegin(0)) - store.ringBegin(store.partBegin(0)), qsizetype(3));
+    
+    // Two outer rings, the second with a hole
+    QCOMPARE(store.geometryType(1), FeatureStore::MultiPolygon);
+    QCOMPARE(store.partEnd(1) - store.partBegin(1), qsizetype(2));
+    qsizetype second = store.partBegin(1) + 1;
+    QCOMPARE(store.ringEnd(second) - store.ringBegin(second), qsizetype(2));
+    
+    QCOMPARE(store.geometryType(2), FeatureStore::MultiLineString);
+    QCOMPARE(store.partEnd(2) - store.partBegin(2), qsizetype(2));
+    
+    // Null shapes are features without geometry
+    QCOMPARE(store.geometryType(3), FeatureStore::NoGeometry);
+}
+
+void TestShapefile::readsWithoutIndex()
+{
+    QList<QByteArray> records;
+    for (int i = 0; i < 100; ++i) {
+        records.append(i % 2 ? pointRecord(i, -i) : polyRecord(PolyLineShape, {{0, 0, double(i), 1}}));
+    }
+    Shapefile file = shapefile(PolyLineShape, records);
+    
+    ShapefileReader indexed(file.shp.constData(), file.shp.size());
+    indexed.setIndex(file.shx.constData(), file.shx.size());
+    FeatureStore indexedStore;
+    QVERIFY(indexed.read(indexedStore));
+    
+    // Record headers are walked without an index or with a broken one
+    QByteArray broken = file.shx;
+    qToBigEndian<qint32>(qint32(file.shp.size()), broken.data() + 100 + 8 * 50);
+    for (const QByteArray& shx : {QByteArray(), broken}) {
+        ShapefileReader reader(file.shp.constData(), file.shp.size());
+        if (!shx.isEmpty()) {
+            reader.setIndex(shx.constData(), shx.size());
+        }
+        FeatureStore store;
+        QVERIFY(reader.read(store));
+        QCOMPARE(store.featureCount(), qsizetype(100));
+        for (qsizetype feature = 0; feature < store.featureCount(); ++feature) {
+            QCOMPARE(store.featureAt(feature), indexedStore.featureAt(feature));
+        }
+    }
+}
+
+void TestShapefile::readsRecordRangesOnThreads()
+{
+    const int count = 40000;
+    QList<QByteArray> records;
+    QList<QList<QByteArray>> rows;
+    for (int i = 0; i < count; ++i) {
+        records.append(pointRecord(i * 0.001, -i * 0.002));
+        rows.append({QByteArray::number(i)});
+    }
+    Shapefile file = shapefile(PointShape, records);
+    QByteArray dbf = dbfFile({{"ID", 'N', 8, 0}}, rows);
+    
+    for (int threads : {1, 4}) {
+        ShapefileReader reader(file.shp.constData(), file.shp.size());
+        reader.setIndex(file.shx.constData(), file.shx.size());
+        reader.setAttributes(dbf.constData(), dbf.size());
+        reader.setThreadCount(threads);
+        FeatureStore store;
+        QVERIFY(reader.read(store));
+        QCOMPARE(store.featureCount(), qsizetype(count));
+        const PropertyColumn& ids = store.columns()[store.columnIndex("ID")];
+        for (qsizetype feature = 0; feature < count; ++feature) {
+            QCOMPARE(ids.value(feature).toLongLong(), qint64(feature));
+            QCOMPARE(store.x(feature), feature * 0.001);
+        }
+    }
+    
+    // The calling thread reads ranges too, so a pool that never runs the
+    // read's tasks does not stall it
+    QThreadPool pool;
+    pool.setMaxThreadCount(1);
+    pool.start([]() { QThread::msleep(200); });
+    ShapefileReader pooled(file.shp.constData(), file.shp.size());
+    pooled.setIndex(file.shx.constData(), file.shx.size());
+    pooled.setAttributes(dbf.constData(), dbf.size());
+    pooled.setThreadCount(4);
+    FeatureStore store;
+    QVERIFY(pooled.read(store, IngestProgress(), &pool));
+    QCOMPARE(store.featureCount(), qsizetype(count));
+    QCOMPARE(valueAt(store, "ID", count - 1).toLongLong(), qint64(count - 1));
+    pool.waitForDone();
+    
+    ShapefileReader reader(file.shp.constData(), file.shp.size());
+    reader.setIndex(file.shx.constData(), file.shx.size());
+    reader.setAttributes(dbf.constData(), dbf.size());
+    FeatureStore range;
+    QVERIFY(reader.readRecords(range, 1000, 1010));
+    QCOMPARE(range.featureCount(), qsizetype(10));
+    QCOMPARE(valueAt(range, "ID", 0).toLongLong(), qint64(1000));
+}
+
+void TestShapefile::rejectsTruncatedFiles()
+{
+    Shapefile file = shapefile(PolygonShape, {
+        polyRecord(PolygonShape, {square(0, 0, 10, true), square(2, 2, 2, false)}),
+        pointRecord(1, 2),
+        polyRecord(PolyLineShape, {{0, 0, 1, 1, 2, 0}})
+    });
+    
+    // A .shp cut off anywhere, with the full index or none, fails to read
+    for (bool indexed : {true, false}) {
+        for (qsizetype size = 0; size < file.shp.size(); ++size) {
+            QByteArray shp = file.shp.left(size);
+            ShapefileReader reader(shp.constData(), shp.size());
+            if (indexed) {
+                reader.setIndex(file.shx.constData(), file.shx.size());
+            }
+            FeatureStore store;
+            QVERIFY(!reader.read(store));
+            QVERIFY(!reader.errorString().isEmpty());
+        }
+    }
+    
+    // A truncated .shx is not trusted and the records are walked instead
+    for (qsizetype size = 0; size < file.shx.size(); ++size) {
+        QByteArray shx = file.shx.left(size);
+        ShapefileReader reader(file.shp.constData(), file.shp.size());
+        reader.setIndex(shx.constData(), shx.size());
+        FeatureStore store;
+        QVERIFY(reader.read(store));
+        QCOMPARE(store.featureCount(), qsizetype(3));
+    }
+}
+
+void TestShapefile::rejectsMalformedRecords()
+{
+    QByteArray valid = polyRecord(PolygonShape, {square(0, 0, 10, true)});
+    QList<QByteArray> malformed;
+    
+    // Point count larger than the record
+    QByteArray tooManyPoints = valid;
+    qToLittleEndian<qint32>(6, tooManyPoints.data() + 40);
+    malformed.append(tooManyPoints);
+    
+    // Negative part count
+    QByteArray negativeParts = valid;
+    qToLittleEndian<qint32>(-1, negativeParts.data() + 36);
+    malformed.append(negativeParts);
+    
+    // Part starting past the points
+    QByteArray partPastEnd = valid;
+    qToLittleEndian<qint32>(7, partPastEnd.data() + 44);
+    malformed.append(partPastEnd);
+    
+    // Records too short for their shape
+    malformed.append(valid.left(40));
+    malformed.append(pointRecord(1, 2).left(12));
+    
+    for (const QByteArray& record : malformed) {
+        Shapefile file = shapefile(PolygonShape, {valid, record});
+        ShapefileReader reader(file.shp.constData(), file.shp.size());
+        reader.setIndex(file.shx.constData(), file.shx.size());
+        FeatureStore store;
+        QVERIFY(!reader.read(store));
+        QVERIFY(reader.errorString().contains("record 1"));
+    }
+    
+    // A .dbf whose fields do not fit its records
+    Shapefile file = shapefile(PointShape, {pointRecord(1, 2)});
+    QByteArray dbf = dbfFile({{"NAME", 'C', 10, 0}}, {{"a"}});
+    qToLittleEndian<quint16>(5, dbf.data() + 10);
+    ShapefileReader reader(file.shp.constData(), file.shp.size());
+    reader.setAttributes(dbf.constData(), dbf.size());
+    FeatureStore store;
+    QVERIFY(!reader.read(store));
+    QVERIFY(!reader.errorString().isEmpty());
+}
+
+void TestShapefile::survivesCorruptedBytes()
+{
+    // Damaged files may or may not read, but must stay within their bytes
+    Shapefile file = shapefile(PolygonShape, {
+        polyRecord(PolygonShape, {square(0, 0, 10, true), square(2, 2, 2, false)}),
+        polyRecord(PolyLineShape, {{0, 0, 1, 1, 2, 0}, {5, 5, 6, 6}}),
+        pointRecord(1, 2)
+    });
+    QByteArray dbf = dbfFile({{"NAME", 'C', 10, 0}, {"VALUE", 'N', 8, 2}}, {{"a", "1.5"}, {"b", "2"}, {"c", "x"}});
+    
+    quint32 seed = 1;
+    for (int round = 0; round < 3000; ++round) {
+        QByteArray shp = file.shp;
+        QByteArray shx = file.shx;
+        QByteArray attributes = dbf;
+        QByteArray& target = round % 3 == 0 ? shp : (round % 3 == 1 ? shx : attributes);
+        for (int flip = 0; flip < 3; ++flip) {
+            seed = seed * 1103515245 + 12345;
+            target[qsizetype((seed >> 8) % quint32(target.size()))] = char(seed >> 24);
+        }
+        ShapefileReader reader(shp.constData(), shp.size());
+        reader.setIndex(shx.constData(), shx.size());
+        reader.setAttributes(attributes.constData(), attributes.size());
+        FeatureStore store;
+        reader.read(store);
+    }
+}
+
+QTEST_GUILESS_MAIN(TestShapefile)
+#include "tst_shapefile.moc"
@@ -0,0 +1,319 @@
+#include "GeoPackageDataLayer.h"
+#include "GeoPackageGeometryReader.h"
+#include <QFileInfo>
+#include <QSqlDatabase>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QDebug>
+
+namespace {
+
+QString quoted(const QString& identifier)
+{
+    return '"' + QString(identifier).replace('"', "\"\"") + '"';
+}
+
+QVariantMap extentMap(double minX, double minY, double maxX, double maxY)
+{
+    QVariantMap box;
+    box["minLat"] = minY;
+    box["maxLat"] = maxY;
+    box["minLon"] = minX;
+    box["maxLon"] = maxX;
+    return box;
+}
+
+} // namespace
+
+GeoPackageDataLayer::GeoPackageDataLayer(const QString& id, const QString& name, const QString& filePath, const QString& table)
+    : m_id(id)
+    , m_name(name)
+    , m_filePath(filePath)
+    , m_table(table)
+    , m_connectionName("geopackage-" + id)
+    , m_visible(true)
+    , m_opacity(1.0)
+    , m_lastUpdated(QDateTime::currentDateTime())
+{
+    QFileInfo fileInfo(filePath);
+    m_description = QString("GeoPackage layer: %1 (%2)").arg(table, fileInfo.fileName());
+    
+    m_style["stroke"] = "#0000FF";
+    m_style["strokeWidth"] = 2;
+    m_style["fill"] = "#0000FF33";
+    
+    m_properties["fileName"] = fileInfo.fileName();
+    m_properties["filePath"] = filePath;
+    m_properties["fileSize"] = fileInfo.size();
+    m_properties["lastModified"] = fileInfo.lastModified().toString();
+    m_properties["table"] = table;
+}
+
+GeoPackageDataLayer::~GeoPackageDataLayer()
+{
+    if (QSqlDatabase::contains(m_connectionName)) {
+        // The handle has to be gone before the connection can be removed
+        {
+            QSqlDatabase db = database();
+            db.close();
+        }
+        QSqlDatabase::removeDatabase(m_connectionName);
+    }
+}
+
+QIcon GeoPackageDataLayer::icon() const
+{
+    return QIcon(":/icons/vector-layer.png");
+}
+
+QVariant GeoPackageDataLayer::data() const
+{
+    return dataInExtent(QVariantMap());
+}
+
+QVariant GeoPackageDataLayer::dataInExtent(const QVariantMap& boundingBox) const
+{
+    FeatureStore store;
+    if (!query(boundingBox, store)) {
+        return QVariant();
+    }
+    return store.toVariant();
+}
+
+QSqlDatabase GeoPackageDataLayer::database() const
+{
+    return QSqlDatabase::database(m_connectionName, false);
+}
+
+bool GeoPackageDataLayer::open()
+{
+    QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", m_connectionName);
+    db.setDatabaseName(m_filePath);
+    db.setConnectOptions("QSQLITE_OPEN_READONLY");
+    if (!db.open()) {
+        qWarning() << "Cannot open GeoPackage:" << m_filePath << "Error:" << db.lastError().text();
+        return false;
+    }
+    
+    if (!readContents(db) || !readColumns(db)) {
+        return false;
+    }
+    findSpatialIndex(db);
+    readExtent(db);
+    
+    QSqlQuery count(db);
+    if (count.exec("SELECT COUNT(*) FROM " + quoted(m_table)) && count.next()) {
+        m_properties["featureCount"] = count.value(0).toLongLong();
+    }
+    return true;
+}
+
+// Geometry column, SRS and declared geometry type from the GeoPackage
+// metadata tables
+bool GeoPackageDataLayer::readContents(QSqlDatabase& db)
+{
+    QSqlQuery query(db);
+    query.prepare("SELECT c.description, c.srs_id, g.column_name, g.geometry_type_name "
+                  "FROM gpkg_contents c JOIN gpkg_geometry_columns g ON g.table_name = c.table_name "
+                  "WHERE c.table_name = ? AND c.data_type = 'features'");
+    query.addBindValue(m_table);
+    if (!query.exec() || !query.next()) {
+        qWarning() << "Not a GeoPackage feature table:" << m_table << "in" << m_filePath
+                   << "Error:" << query.lastError().text();
+        return false;
+    }
+    
+    QString description = query.value(0).toString();
+    if (!description.isEmpty()) {
+        m_description = description;
+    }
+    m_properties["srsId"] = query.value(1).toInt();
+    m_geometryColumn = query.value(2).toString();
+    
+    // GEOMETRY and the other abstract types leave the list empty
+    QStringList geometryTypes;
+    QString typeName = query.value(3).toString();
+    for (int type = FeatureStore::Point; type <= FeatureStore::GeometryCollection; ++type) {
+        QString name = FeatureStore::geometryTypeName(FeatureStore::GeometryType(type));
+        if (name.compare(typeName, Qt::CaseInsensitive) == 0) {
+            geometryTypes.append(name);
+        }
+    }
+    m_properties["geometryTypes"] = geometryTypes;
+    return true;
+}
+
+bool GeoPackageDataLayer::readColumns(QSqlDatabase& db)
+{
+    QSqlQuery query(db);
+    if (!query.exec("PRAGMA table_info(" + quoted(m_table) + ")")) {
+        qWarning() << "Cannot read the columns of" << m_table << "Error:" << query.lastError().text();
+        return false;
+    }
+    
+    m_columns.clear();
+    while (query.next()) {
+        QString name = query.value(1).toString();
+        if (query.value(5).toInt() > 0) {
+            m_primaryKey = name;
+        } else if (name.compare(m_geometryColumn, Qt::CaseInsensitive) != 0) {
+            m_columns.append(name);
+        }
+    }
+    if (m_primaryKey.isEmpty()) {
+        m_primaryKey = "rowid";
+    }
+    m_properties["fields"] = m_columns;
+    return true;
+}
+
+// The index is a SQLite R*Tree virtual table, which is only usable when the
+// SQLite build includes that module
+void GeoPackageDataLayer::findSpatialIndex(QSqlDatabase& db)
+{
+    m_rtreeTable.clear();
+    
+    QSqlQuery query(db);
+    query.prepare("SELECT 1 FROM gpkg_extensions WHERE lower(table_name) = lower(?) "
+                  "AND lower(column_name) = lower(?) AND extension_name = 'gpkg_rtree_index'");
+    query.addBindValue(m_table);
+    query.addBindValue(m_geometryColumn);
+    if (query.exec() && query.next()) {
+        QString rtreeTable = QString("rtree_%1_%2").arg(m_table, m_geometryColumn);
+        QSqlQuery probe(db);
+        if (probe.exec("SELECT id FROM " + quoted(rtreeTable) + " LIMIT 1")) {
+            m_rtreeTable = rtreeTable;
+        } else {
+            qWarning() << "Spatial index of" << m_table << "is not readable, extent queries will scan the table"
+                       << "Error:" << probe.lastError().text();
+        }
+    }
+    m_properties["spatialIndex"] = !m_rtreeTable.isEmpty();
+}
+
+// Extent from gpkg_contents, which may leave it unset; the index root then
+// gives it cheaply
+void GeoPackageDataLayer::readExtent(QSqlDatabase& db)
+{
+    QSqlQuery query(db);
+    query.prepare("SELECT min_x, min_y, max_x, max_y FROM gpkg_contents WHERE table_name = ?");
+    query.addBindValue(m_table);
+    if (query.exec() && query.next() && !query.value(0).isNull() && !query.value(1).isNull()
+        && !query.value(2).isNull() && !query.value(3).isNull()) {
+        m_boundingBox = extentMap(query.value(0).toDouble(), query.value(1).toDouble(),
+                                  query.value(2).toDouble(), query.value(3).toDouble());
+        return;
+    }
+    
+    if (hasSpatialIndex()) {
+        QSqlQuery extent(db);
+        if (extent.exec("SELECT MIN(minx), MIN(miny), MAX(maxx), MAX(maxy) FROM " + quoted(m_rtreeTable))
+            && extent.next() && !extent.value(0).isNull()) {
+            m_boundingBox = extentMap(extent.value(0).toDouble(), extent.value(1).toDouble(),
+                                      extent.value(2).toDouble(), extent.value(3).toDouble());
+        }
+    }
+}
+
+bool GeoPackageDataLayer::setFilter(const QVariantMap& attributes)
+{
+    for (auto it = attributes.begin(); it != attributes.end(); ++it) {
+        if (!m_columns.contains(it.key()) && it.key() != m_primaryKey) {
+            qWarning() << "Unknown filter column:" << it.key() << "in" << m_table;
+            return false;
+        }
+    }
+    m_filter = attributes;
+    return true;
+}
+
+bool GeoPackageDataLayer::query(const QVariantMap& boundingBox, FeatureStore& store) const
+{
+    QSqlDatabase db = database();
+    if (!db.isOpen()) {
+        qWarning() << "GeoPackage is not open:" << m_filePath;
+        return false;
+    }
+    
+    bool extentFilter = !boundingBox.isEmpty();
+    double minX = boundingBox.value("minLon").toDouble();
+    double minY = boundingBox.value("minLat").toDouble();
+    double maxX = boundingBox.value("maxLon").toDouble();
+    double maxY = boundingBox.value("maxLat").toDouble();
+    
+    QStringList selected = {quoted(m_primaryKey), quoted(m_geometryColumn)};
+    for (const QString& column : m_columns) {
+        selected.append(quoted(column));
+    }
+    QString sql = "SELECT " + selected.join(", ") + " FROM " + quoted(m_table);
+    
+    // The index lookup lets SQLite fetch only the matching rows by key
+    QStringList conditions;
+    QVariantList values;
+    if (extentFilter && hasSpatialIndex()) {
+        conditions.append(quoted(m_primaryKey) + " IN (SELECT id FROM " + quoted(m_rtreeTable)
+                          + " WHERE minx <= ? AND maxx >= ? AND miny <= ? AND maxy >= ?)");
+        values << maxX << minX << maxY << minY;
+    }
+    for (auto it = m_filter.begin(); it != m_filter.end(); ++it) {
+        if (it.value().isNull()) {
+            conditions.append(quoted(it.key()) + " IS NULL");
+        } else {
+            conditions.append(quoted(it.key()) + " = ?");
+            values.append(it.value());
+        }
+    }
+    if (!conditions.isEmpty()) {
+        sql += " WHERE " + conditions.join(" AND ");
+    }
+    
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    if (!query.prepare(sql)) {
+        qWarning() << "Cannot query" << m_table << "Error:" << query.lastError().text();
+        return false;
+    }
+    for (const QVariant& value : values) {
+        query.addBindValue(value);
+    }
+    if (!query.exec()) {
+        qWarning() << "Cannot query" << m_table << "Error:" << query.lastError().text();
+        return false;
+    }
+    
+    // Columns are created up front so they keep the table's order
+    QVector<int> storeColumns;
+    for (const QString& column : m_columns) {
+        store.column(column);
+        storeColumns.append(store.columnIndex(column));
+    }
+    
+    // Without an index the extent is checked against each geometry, which
+    // skips decoding the ones outside
+    bool scan = extentFilter && !hasSpatialIndex();
+    while (query.next()) {
+        QByteArray blob = query.value(1).toByteArray();
+        GeoPackageGeometryReader geometry(blob);
+        if (scan) {
+            double featureMinX, featureMinY, featureMaxX, featureMaxY;
+            if (!geometry.bounds(featureMinX, featureMinY, featureMaxX, featureMaxY)
+                || featureMinX > maxX || featureMaxX < minX || featureMinY > maxY || featureMaxY < minY) {
+                continue;
+            }
+        }
+        
+        store.beginFeature();
+        store.setFeatureId(query.value(0));
+        if (!blob.isEmpty() && !geometry.read(store)) {
+            qWarning() << "Invalid geometry in" << m_table << "feature" << query.value(0).toLongLong();
+        }
+        for (int i = 0; i < storeColumns.size(); ++i) {
+            QVariant value = query.value(i + 2);
+            if (!value.isNull()) {
+                store.columnAt(storeColumns[i]).append(value);
+            }
+        }
+        store.endFeature();
+    }
+    return true;
+}
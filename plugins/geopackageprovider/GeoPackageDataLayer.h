@@ -0,0 +1,87 @@
+#pragma once
+
+#include "IDataProvider.h"
+#include "FeatureStore.h"
+#include <QVariantMap>
+#include <QDateTime>
+#include <QIcon>
+
+class QSqlDatabase;
+
+// A feature table of a GeoPackage. Nothing is held in memory beyond the
+// table description: every data request is run as a query against the
+// file, with bounding boxes pushed into the table's R-tree index and
+// attribute filters into the WHERE clause. Like any SQL connection the
+// layer must be queried from the thread that opened it.
+class GeoPackageDataLayer : public IDataLayer
+{
+public:
+    GeoPackageDataLayer(const QString& id, const QString& name, const QString& filePath, const QString& table);
+    ~GeoPackageDataLayer();
+    
+    // IDataLayer interface
+    QString id() const override { return m_id; }
+    QString name() const override { return m_name; }
+    QString type() const override { return "vector"; }
+    QString description() const override { return m_description; }
+    QIcon icon() const override;
+    
+    bool isVisible() const override { return m_visible; }
+    void setVisible(bool visible) override { m_visible = visible; }
+    double opacity() const override { return m_opacity; }
+    void setOpacity(double opacity) override { m_opacity = qBound(0.0, opacity, 1.0); }
+    
+    QVariantMap properties() const override { return m_properties; }
+    QVariantMap style() const override { return m_style; }
+    void setStyle(const QVariantMap& style) override { m_style = style; }
+    
+    QVariantMap boundingBox() const override { return m_boundingBox; }
+    // Reads the whole (filtered) table on every call; prefer dataInExtent()
+    QVariant data() const override;
+    QVariant dataInExtent(const QVariantMap& boundingBox) const override;
+    QDateTime lastUpdated() const override { return m_lastUpdated; }
+    
+    // GeoPackage-specific methods
+    QString filePath() const { return m_filePath; }
+    QString table() const { return m_table; }
+    bool hasSpatialIndex() const { return !m_rtreeTable.isEmpty(); }
+    
+    // Opens the file read-only and describes the table
+    bool open();
+    
+    // Attribute equality filter applied to every read, as column -> value.
+    // A null value matches NULL. Fails on unknown columns.
+    bool setFilter(const QVariantMap& attributes);
+    QVariantMap filter() const { return m_filter; }
+    
+    // Appends the features intersecting the box (all of them for an empty
+    // box) that pass the attribute filter
+    bool query(const QVariantMap& boundingBox, FeatureStore& store) const;
+
+private:
+    QSqlDatabase database() const;
+    bool readContents(QSqlDatabase& db);
+    bool readColumns(QSqlDatabase& db);
+    void findSpatialIndex(QSqlDatabase& db);
+    void readExtent(QSqlDatabase& db);
+    
+    QString m_id;
+    QString m_name;
+    QString m_description;
+    QString m_filePath;
+    QString m_table;
+    QString m_connectionName;
+    bool m_visible;
+    double m_opacity;
+    
+    QString m_geometryColumn;
+    QString m_primaryKey;
+    QStringList m_columns;
+    QString m_rtreeTable;
+    QVariantMap m_filter;
+    
+    QVariantMap m_properties;
+    QVariantMap m_style;
+    QVariantMap m_boundingBox;
+    QDateTime m_lastUpdated;
+};
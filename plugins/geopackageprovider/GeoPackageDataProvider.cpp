@@ -0,0 +1,214 @@
+#include "GeoPackageDataProvider.h"
+#include <QFileInfo>
+#include <QSqlDatabase>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QUuid>
+#include <QDebug>
+
+GeoPackageDataProvider::GeoPackageDataProvider(QObject* parent)
+    : QObject(parent)
+    , m_initialized(false)
+{
+}
+
+GeoPackageDataProvider::~GeoPackageDataProvider()
+{
+    shutdown();
+}
+
+QString GeoPackageDataProvider::providerId() const
+{
+    return "geopackage-provider";
+}
+
+QString GeoPackageDataProvider::name() const
+{
+    return "GeoPackage Data Provider";
+}
+
+QString GeoPackageDataProvider::description() const
+{
+    return "Queries feature tables of GeoPackage files through their spatial index";
+}
+
+QIcon GeoPackageDataProvider::icon() const
+{
+    return QIcon(":/icons/geopackage-provider.png");
+}
+
+QStringList GeoPackageDataProvider::supportedTypes() const
+{
+    return QStringList() << "gpkg";
+}
+
+bool GeoPackageDataProvider::canCreateLayers() const
+{
+    return false;
+}
+
+bool GeoPackageDataProvider::canImportData() const
+{
+    return true;
+}
+
+bool GeoPackageDataProvider::canExportData() const
+{
+    return false;
+}
+
+bool GeoPackageDataProvider::isRealTime() const
+{
+    return false;
+}
+
+QStringList GeoPackageDataProvider::layerIds() const
+{
+    return m_layers.keys();
+}
+
+IDataLayer* GeoPackageDataProvider::getLayer(const QString& layerId) const
+{
+    auto it = m_layers.find(layerId);
+    return (it != m_layers.end()) ? it.value() : nullptr;
+}
+
+QList<IDataLayer*> GeoPackageDataProvider::getAllLayers() const
+{
+    QList<IDataLayer*> layers;
+    for (auto it = m_layers.begin(); it != m_layers.end(); ++it) {
+        layers.append(it.value());
+    }
+    return layers;
+}
+
+bool GeoPackageDataProvider::createLayer(const QString& name, const QString& type, const QVariantMap& parameters)
+{
+    Q_UNUSED(name)
+    Q_UNUSED(type)
+    Q_UNUSED(parameters)
+    
+    qWarning() << "GeoPackage provider does not support creating new layers";
+    return false;
+}
+
+bool GeoPackageDataProvider::removeLayer(const QString& layerId)
+{
+    auto it = m_layers.find(layerId);
+    if (it == m_layers.end()) {
+        qWarning() << "Layer not found:" << layerId;
+        return false;
+    }
+    
+    delete it.value();
+    m_layers.erase(it);
+    emit layerRemoved(layerId);
+    
+    qDebug() << "Removed layer:" << layerId;
+    return true;
+}
+
+bool GeoPackageDataProvider::importData(const QString& filePath, const QVariantMap& options)
+{
+    QFileInfo fileInfo(filePath);
+    if (!fileInfo.exists()) {
+        qWarning() << "File does not exist:" << filePath;
+        return false;
+    }
+    
+    QStringList tables = options.contains("table")
+        ? QStringList() << options.value("table").toString()
+        : featureTables(filePath);
+    if (tables.isEmpty()) {
+        qWarning() << "No feature tables in GeoPackage:" << filePath;
+        return false;
+    }
+    
+    int imported = 0;
+    for (const QString& table : tables) {
+        QString layerName = tables.size() == 1 ? options.value("name", table).toString() : table;
+        GeoPackageDataLayer* layer = new GeoPackageDataLayer(generateLayerId(), layerName, filePath, table);
+        if (!layer->open() || !layer->setFilter(options.value("filter").toMap())) {
+            qWarning() << "Failed to open GeoPackage table:" << table << "from" << filePath;
+            delete layer;
+            continue;
+        }
+        
+        QString layerId = layer->id();
+        m_layers[layerId] = layer;
+        emit layerAdded(layerId);
+        ++imported;
+        
+        qDebug() << "Imported GeoPackage table" << table << "as layer:" << layerId << "from" << filePath;
+    }
+    return imported > 0;
+}
+
+bool GeoPackageDataProvider::exportLayer(const QString& layerId, const QString& filePath, const QVariantMap& options)
+{
+    Q_UNUSED(layerId)
+    Q_UNUSED(filePath)
+    Q_UNUSED(options)
+    
+    qWarning() << "GeoPackage provider does not support export";
+    return false;
+}
+
+bool GeoPackageDataProvider::initialize()
+{
+    if (m_initialized) {
+        return true;
+    }
+    
+    if (!QSqlDatabase::isDriverAvailable("QSQLITE")) {
+        qWarning() << "QSQLITE driver is not available";
+        return false;
+    }
+    
+    qDebug() << "Initializing GeoPackage Data Provider";
+    m_initialized = true;
+    return true;
+}
+
+void GeoPackageDataProvider::shutdown()
+{
+    if (!m_initialized) {
+        return;
+    }
+    
+    qDebug() << "Shutting down GeoPackage Data Provider";
+    
+    qDeleteAll(m_layers);
+    m_layers.clear();
+    m_initialized = false;
+}
+
+QStringList GeoPackageDataProvider::featureTables(const QString& filePath)
+{
+    QStringList tables;
+    QString connectionName = "geopackage-tables-" + QUuid::createUuid().toString(QUuid::WithoutBraces);
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", connectionName);
+        db.setDatabaseName(filePath);
+        db.setConnectOptions("QSQLITE_OPEN_READONLY");
+        if (db.open()) {
+            QSqlQuery query(db);
+            if (query.exec("SELECT table_name FROM gpkg_contents WHERE data_type = 'features' ORDER BY table_name")) {
+                while (query.next()) {
+                    tables.append(query.value(0).toString());
+                }
+            } else {
+                qWarning() << "Not a GeoPackage:" << filePath << "Error:" << query.lastError().text();
+            }
+        } else {
+            qWarning() << "Cannot open GeoPackage:" << filePath << "Error:" << db.lastError().text();
+        }
+    }
+    QSqlDatabase::removeDatabase(connectionName);
+    return tables;
+}
+
+QString GeoPackageDataProvider::generateLayerId() const
+{
+    return QUuid::createUuid().toString(QUuid::WithoutBraces);
+}
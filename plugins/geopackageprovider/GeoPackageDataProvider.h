@@ -0,0 +1,59 @@
+#pragma once
+
+#include "IDataProvider.h"
+#include "GeoPackageDataLayer.h"
+#include <QObject>
+#include <QMap>
+
+class GeoPackageDataProvider : public QObject, public IDataProvider
+{
+    Q_OBJECT
+    Q_INTERFACES(IDataProvider)
+
+public:
+    explicit GeoPackageDataProvider(QObject* parent = nullptr);
+    ~GeoPackageDataProvider();
+    
+    // IDataProvider interface
+    QString providerId() const override;
+    QString name() const override;
+    QString description() const override;
+    QIcon icon() const override;
+    QStringList supportedTypes() const override;
+    
+    bool canCreateLayers() const override;
+    bool canImportData() const override;
+    bool canExportData() const override;
+    bool isRealTime() const override;
+    
+    QStringList layerIds() const override;
+    IDataLayer* getLayer(const QString& layerId) const override;
+    QList<IDataLayer*> getAllLayers() const override;
+    
+    bool createLayer(const QString& name, const QString& type, 
+                     const QVariantMap& parameters = QVariantMap()) override;
+    bool removeLayer(const QString& layerId) override;
+    // Adds one layer per feature table, or only the `table` option's
+    bool importData(const QString& filePath, 
+                    const QVariantMap& options = QVariantMap()) override;
+    bool exportLayer(const QString& layerId, const QString& filePath, 
+                     const QVariantMap& options = QVariantMap()) override;
+    
+    bool initialize() override;
+    void shutdown() override;
+    
+    // Feature tables listed in the file's gpkg_contents
+    static QStringList featureTables(const QString& filePath);
+
+signals:
+    void layerAdded(const QString& layerId) override;
+    void layerRemoved(const QString& layerId) override;
+    void layerChanged(const QString& layerId) override;
+    void dataUpdated(const QString& layerId) override;
+
+private:
+    QString generateLayerId() const;
+    
+    QMap<QString, GeoPackageDataLayer*> m_layers;
+    bool m_initialized;
+};
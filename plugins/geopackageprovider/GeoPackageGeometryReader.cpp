@@ -0,0 +1,107 @@
+#include "GeoPackageGeometryReader.h"
+#include "WkbReader.h"
+#include <QtEndian>
+
+namespace {
+
+// Flags byte of the GeoPackage binary header
+const quint8 LittleEndianFlag = 0x01;
+const quint8 EnvelopeMask = 0x0e;
+const quint8 EmptyFlag = 0x10;
+const quint8 ExtendedFlag = 0x20;
+const qsizetype HeaderSize = 8;
+
+template<typename T>
+T readValue(const char* data, bool littleEndian)
+{
+    return littleEndian ? qFromLittleEndian<T>(data) : qFromBigEndian<T>(data);
+}
+
+// Number of doubles in the header envelope, -1 for reserved indicators
+int envelopeSize(quint8 flags)
+{
+    switch ((flags & EnvelopeMask) >> 1) {
+    case 0:
+        return 0;
+    case 1:
+        return 4;
+    case 2:
+    case 3:
+        return 6;
+    case 4:
+        return 8;
+    }
+    return -1;
+}
+
+} // namespace
+
+GeoPackageGeometryReader::GeoPackageGeometryReader(QByteArrayView blob)
+    : m_blob(blob)
+    , m_wkbOffset(-1)
+    , m_empty(false)
+    , m_hasEnvelope(false)
+    , m_envelope{0, 0, 0, 0}
+{
+}
+
+bool GeoPackageGeometryReader::readHeader()
+{
+    if (m_wkbOffset >= 0) {
+        return true;
+    }
+    if (m_blob.size() < HeaderSize || m_blob[0] != 'G' || m_blob[1] != 'P') {
+        return false;
+    }
+    
+    quint8 flags = quint8(m_blob[3]);
+    int envelopeDoubles = envelopeSize(flags);
+    // Extended geometries carry a format of their own after the header
+    if (envelopeDoubles < 0 || (flags & ExtendedFlag)) {
+        return false;
+    }
+    qsizetype offset = HeaderSize + envelopeDoubles * 8;
+    if (m_blob.size() < offset) {
+        return false;
+    }
+    
+    // The envelope is stored as minX, maxX, minY, maxY, then the Z and M
+    // ranges which are ignored
+    bool littleEndian = flags & LittleEndianFlag;
+    m_hasEnvelope = envelopeDoubles > 0;
+    if (m_hasEnvelope) {
+        for (int i = 0; i < 4; ++i) {
+            m_envelope[i] = readValue<double>(m_blob.data() + HeaderSize + i * 8, littleEndian);
+        }
+    }
+    m_empty = flags & EmptyFlag;
+    m_wkbOffset = offset;
+    return true;
+}
+
+bool GeoPackageGeometryReader::bounds(double& minX, double& minY, double& maxX, double& maxY)
+{
+    if (!readHeader() || m_empty) {
+        return false;
+    }
+    
+    if (m_hasEnvelope) {
+        minX = m_envelope[0];
+        maxX = m_envelope[1];
+        minY = m_envelope[2];
+        maxY = m_envelope[3];
+        return minX <= maxX && minY <= maxY;
+    }
+    
+    // Points are written without an envelope, so walk the WKB instead
+    return WkbReader(m_blob.sliced(m_wkbOffset)).bounds(minX, minY, maxX, maxY);
+}
+
+bool GeoPackageGeometryReader::read(FeatureStore& store)
+{
+    if (!readHeader()) {
+        return false;
+    }
+    
+    return WkbReader(m_blob.sliced(m_wkbOffset)).read(store);
+}
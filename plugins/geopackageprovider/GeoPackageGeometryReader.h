@@ -0,0 +1,30 @@
+#pragma once
+
+#include "FeatureStore.h"
+#include <QByteArrayView>
+
+// Parses a GeoPackage geometry blob (the "GP" header followed by WKB) into
+// the current feature of a FeatureStore; the WKB is decoded by WkbReader.
+class GeoPackageGeometryReader
+{
+public:
+    explicit GeoPackageGeometryReader(QByteArrayView blob);
+    
+    // Parses the header; false if the blob is not a GeoPackage geometry
+    bool readHeader();
+    bool isEmpty() const { return m_empty; }
+    
+    // Extent of the geometry, taken from the header envelope when there is
+    // one and computed from the WKB otherwise. False for empty geometries.
+    bool bounds(double& minX, double& minY, double& maxX, double& maxY);
+    
+    // Adds the geometry's parts to the current feature and sets its type
+    bool read(FeatureStore& store);
+
+private:
+    QByteArrayView m_blob;
+    qsizetype m_wkbOffset;
+    bool m_empty;
+    bool m_hasEnvelope;
+    double m_envelope[4];
+};
@@ -0,0 +1,86 @@
+#include "GeoPackageProviderPlugin.h"
+#include <QDebug>
+
+GeoPackageProviderPlugin::GeoPackageProviderPlugin(QObject* parent)
+    : QObject(parent)
+    , m_dataProvider(nullptr)
+    , m_initialized(false)
+{
+}
+
+GeoPackageProviderPlugin::~GeoPackageProviderPlugin()
+{
+    shutdown();
+}
+
+QString GeoPackageProviderPlugin::name() const
+{
+    return "GeoPackage Data Provider";
+}
+
+QString GeoPackageProviderPlugin::version() const
+{
+    return "1.0.0";
+}
+
+QString GeoPackageProviderPlugin::description() const
+{
+    return "Provides feature tables of GeoPackage files with spatial index queries";
+}
+
+QIcon GeoPackageProviderPlugin::icon() const
+{
+    return QIcon(":/icons/geopackage-provider.png");
+}
+
+bool GeoPackageProviderPlugin::initialize()
+{
+    if (m_initialized) {
+        return true;
+    }
+    
+    qDebug() << "Initializing GeoPackage Provider Plugin";
+    
+    m_dataProvider = new GeoPackageDataProvider(this);
+    
+    if (!m_dataProvider->initialize()) {
+        qWarning() << "Failed to initialize GeoPackage Data Provider";
+        delete m_dataProvider;
+        m_dataProvider = nullptr;
+        return false;
+    }
+    
+    m_initialized = true;
+    qDebug() << "GeoPackage Provider Plugin initialized successfully";
+    return true;
+}
+
+void GeoPackageProviderPlugin::shutdown()
+{
+    if (!m_initialized) {
+        return;
+    }
+    
+    qDebug() << "Shutting down GeoPackage Provider Plugin";
+    
+    if (m_dataProvider) {
+        m_dataProvider->shutdown();
+        delete m_dataProvider;
+        m_dataProvider = nullptr;
+    }
+    
+    m_initialized = false;
+}
+
+QWidget* GeoPackageProviderPlugin::createWidget(QWidget* parent)
+{
+    Q_UNUSED(parent)
+    
+    // Layers are managed through the layer manager
+    return nullptr;
+}
+
+QStringList GeoPackageProviderPlugin::capabilities() const
+{
+    return QStringList() << "data-provider" << "import";
+}
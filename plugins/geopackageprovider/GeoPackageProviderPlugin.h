@@ -0,0 +1,37 @@
+#pragma once
+
+#include "IPlugin.h"
+#include "GeoPackageDataProvider.h"
+#include <QObject>
+#include <QtPlugin>
+
+class GeoPackageProviderPlugin : public QObject, public IPlugin
+{
+    Q_OBJECT
+    Q_INTERFACES(IPlugin)
+    Q_PLUGIN_METADATA(IID "com.geoworld.IPlugin/1.0" FILE "geopackageprovider.json")
+
+public:
+    explicit GeoPackageProviderPlugin(QObject* parent = nullptr);
+    ~GeoPackageProviderPlugin();
+    
+    // IPlugin interface
+    QString name() const override;
+    QString version() const override;
+    QString description() const override;
+    QIcon icon() const override;
+    
+    bool initialize() override;
+    void shutdown() override;
+    
+    QWidget* createWidget(QWidget* parent = nullptr) override;
+    
+    QStringList capabilities() const override;
+    
+    // Access to the data provider, looked up by the application to register it
+    Q_INVOKABLE QObject* dataProvider() const { return m_dataProvider; }
+
+private:
+    GeoPackageDataProvider* m_dataProvider;
+    bool m_initialized;
+};
@@ -0,0 +1,194 @@
+// Compares viewport reads from a GeoPackage against the GeoJSON path on the
+// same dataset.
+//
+// Usage: gpkg_query_bench data.gpkg data.geojson [--table NAME] [--queries N] [--fraction F]
+//
+// Both files should hold the same features, e.g. written with
+// `ogr2ogr data.gpkg data.geojson`. The GeoJSON file is parsed completely
+// and each viewport is then cut from memory; the GeoPackage layer is only
+// opened and each viewport is a query against its R-tree index. Viewports
+// are random boxes covering the given fraction of the layer's extent in
+// each direction.
+
+#include "FeatureStore.h"
+#include "GeoJsonReader.h"
+#include "GeoPackageDataLayer.h"
+#include "GeoPackageDataProvider.h"
+#include "MappedFile.h"
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QRandomGenerator>
+#include <QTextStream>
+#include <cmath>
+
+namespace {
+
+struct Box {
+    double minX;
+    double minY;
+    double maxX;
+    double maxY;
+};
+
+QVariantMap boxMap(const Box& box)
+{
+    QVariantMap map;
+    map["minLon"] = box.minX;
+    map["minLat"] = box.minY;
+    map["maxLon"] = box.maxX;
+    map["maxLat"] = box.maxY;
+    return map;
+}
+
+// Features of the store whose bounds intersect the box, as a viewport read
+// over an in-memory layer would produce them
+QVariantList featuresInBox(const FeatureStore& store, const Box& box)
+{
+    QVariantList features;
+    for (qsizetype feature = 0; feature < store.featureCount(); ++feature) {
+        double minX = INFINITY;
+        double minY = INFINITY;
+        double maxX = -INFINITY;
+        double maxY = -INFINITY;
+        for (qsizetype part = store.partBegin(feature); part < store.partEnd(feature); ++part) {
+            for (qsizetype ring = store.ringBegin(part); ring < store.ringEnd(part); ++ring) {
+                for (qsizetype coordinate = store.coordinateBegin(ring); coordinate < store.coordinateEnd(ring); ++coordinate) {
+                    minX = qMin(minX, store.x(coordinate));
+                    minY = qMin(minY, store.y(coordinate));
+                    maxX = qMax(maxX, store.x(coordinate));
+                    maxY = qMax(maxY, store.y(coordinate));
+                }
+            }
+        }
+        if (minX <= box.maxX && maxX >= box.minX && minY <= box.maxY && maxY >= box.minY) {
+            features.append(store.featureAt(feature));
+        }
+    }
+    return features;
+}
+
+qsizetype featureCount(const QVariant& collection)
+{
+    return collection.toMap().value("features").toList().size();
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+    QTextStream out(stdout);
+    
+    QStringList files;
+    QString table;
+    int queries = 100;
+    double fraction = 0.05;
+    
+    QStringList args = app.arguments();
+    for (int i = 1; i < args.size(); ++i) {
+        if (args[i] == "--table" && i + 1 < args.size()) {
+            table = args[++i];
+        } else if (args[i] == "--queries" && i + 1 < args.size()) {
+            queries = args[++i].toInt();
+        } else if (args[i] == "--fraction" && i + 1 < args.size()) {
+            fraction = args[++i].toDouble();
+        } else {
+            files.append(args[i]);
+        }
+    }
+    if (files.size() != 2) {
+        out << "Usage: gpkg_query_bench data.gpkg data.geojson [--table NAME] [--queries N] [--fraction F]" << Qt::endl;
+        return 1;
+    }
+    
+    // GeoPackage: open the table
+    if (table.isEmpty()) {
+        QStringList tables = GeoPackageDataProvider::featureTables(files[0]);
+        if (tables.isEmpty()) {
+            out << "No feature tables in " << files[0] << Qt::endl;
+            return 1;
+        }
+        table = tables.first();
+    }
+    QElapsedTimer timer;
+    timer.start();
+    GeoPackageDataLayer layer("bench", table, files[0], table);
+    if (!layer.open()) {
+        out << "Cannot open " << files[0] << Qt::endl;
+        return 1;
+    }
+    double gpkgOpen = timer.nsecsElapsed() / 1e9;
+    
+    // GeoJSON: parse the whole file
+    timer.restart();
+    MappedFile file;
+    FeatureStore store;
+    if (!file.open(files[1])) {
+        out << "Cannot open " << files[1] << ": " << file.errorString() << Qt::endl;
+        return 1;
+    }
+    GeoJsonReader reader(file.data(), file.size());
+    if (!reader.read(store)) {
+        out << "Parse failed: " << reader.errorString() << Qt::endl;
+        return 1;
+    }
+    double geojsonOpen = timer.nsecsElapsed() / 1e9;
+    
+    QVariantMap extent = layer.boundingBox();
+    double minX = extent.value("minLon").toDouble();
+    double minY = extent.value("minLat").toDouble();
+    double width = extent.value("maxLon").toDouble() - minX;
+    double height = extent.value("maxLat").toDouble() - minY;
+    
+    QVector<Box> boxes;
+    QRandomGenerator random(42);
+    for (int i = 0; i < queries; ++i) {
+        double x = minX + random.generateDouble() * width * (1.0 - fraction);
+        double y = minY + random.generateDouble() * height * (1.0 - fraction);
+        boxes.append({x, y, x + width * fraction, y + height * fraction});
+    }
+    
+    qsizetype gpkgFeatures = 0;
+    timer.restart();
+    for (const Box& box : boxes) {
+        gpkgFeatures += featureCount(layer.dataInExtent(boxMap(box)));
+    }
+    double gpkgQueries = timer.nsecsElapsed() / 1e9;
+    
+    qsizetype geojsonFeatures = 0;
+    timer.restart();
+    for (const Box& box : boxes) {
+        geojsonFeatures += featuresInBox(store, box).size();
+    }
+    double geojsonQueries = timer.nsecsElapsed() / 1e9;
+    
+    out << QString("Layer: %1 features, %2 viewports of %3% per side, spatial index %4")
+               .arg(store.featureCount())
+               .arg(queries)
+               .arg(fraction * 100.0)
+               .arg(layer.hasSpatialIndex() ? "yes" : "no")
+        << Qt::endl;
+    out << QString("%1 %2 %3 %4")
+               .arg("source", 8)
+               .arg("open s", 9)
+               .arg("ms/view", 9)
+               .arg("features", 10)
+        << Qt::endl;
+    out << QString("%1 %2 %3 %4")
+               .arg("geojson", 8)
+               .arg(geojsonOpen, 9, 'f', 3)
+               .arg(1000.0 * geojsonQueries / qMax(1, queries), 9, 'f', 2)
+               .arg(geojsonFeatures, 10)
+        << Qt::endl;
+    out << QString("%1 %2 %3 %4")
+               .arg("gpkg", 8)
+               .arg(gpkgOpen, 9, 'f', 3)
+               .arg(1000.0 * gpkgQueries / qMax(1, queries), 9, 'f', 2)
+               .arg(gpkgFeatures, 10)
+        << Qt::endl;
+    
+    if (gpkgFeatures != geojsonFeatures) {
+        out << "Warning: the two sources returned different features" << Qt::endl;
+    }
+    return 0;
+}
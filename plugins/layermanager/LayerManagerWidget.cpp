@@ -1,7 +1,9 @@
 #include "LayerManagerWidget.h"
 #include "DataProviderManager.h"
+#include "ImportBatch.h"
 #include <QHeaderView>
 #include <QFileDialog>
+#include <QFileInfo>
 #include <QMessageBox>
 #include <QApplication>
 #include <QMimeData>
@@ -10,6 +12,8 @@
 
 LayerManagerWidget::LayerManagerWidget(DataProviderManager* dataManager, QWidget *parent)
     : QWidget(parent)
+    , m_importJob(nullptr)
+    , m_importBatch(nullptr)
     , m_dataManager(dataManager)
     , m_updating(false)
 {
@@ -41,8 +45,15 @@ void LayerManagerWidget::setupUI()
     m_toolbarLayout = new QHBoxLayout();
     m_refreshButton = new QPushButton("Refresh");
     m_refreshButton->setToolTip("Refresh data providers");
-    m_importButton = new QPushButton("Import");
-    m_importButton->setToolTip("Import data file");
+    m_importButton = new QToolButton();
+    m_importButton->setText("Import");
+    m_importButton->setToolTip("Import data files");
+    m_importButton->setPopupMode(QToolButton::MenuButtonPopup);
+    
+    m_importMenu = new QMenu(this);
+    m_importFilesAction = m_importMenu->addAction("Import Files...");
+    m_importFolderAction = m_importMenu->addAction("Import Folder...");
+    m_importButton->setMenu(m_importMenu);
     
     m_exportButton = new QToolButton();
     m_exportButton->setText("Export");
@@ -71,8 +82,21 @@ void LayerManagerWidget::setupUI()
     m_statusLabel = new QLabel("No data providers loaded");
     m_statusLabel->setStyleSheet("QLabel { color: gray; font-style: italic; }");
     
+    // Import progress, shown while an import runs
+    m_importWidget = new QWidget();
+    QHBoxLayout* importLayout = new QHBoxLayout(m_importWidget);
+    importLayout->setContentsMargins(0, 0, 0, 0);
+    m_importProgress = new QProgressBar();
+    m_importProgress->setRange(0, 1000);
+    m_cancelImportButton = new QPushButton("Cancel");
+    m_cancelImportButton->setToolTip("Cancel the running import");
+    importLayout->addWidget(m_importProgress);
+    importLayout->addWidget(m_cancelImportButton);
+    m_importWidget->hide();
+    
     m_treeLayout->addLayout(m_toolbarLayout);
     m_treeLayout->addWidget(m_dataTree);
+    m_treeLayout->addWidget(m_importWidget);
     m_treeLayout->addWidget(m_statusLabel);
     
     // === Properties Section ===
@@ -173,6 +197,12 @@ void LayerManagerWidget::setupConnections()
                 this, &LayerManagerWidget::onLayerRemoved);
         connect(m_dataManager, &DataProviderManager::layerChanged,
                 this, &LayerManagerWidget::onLayerChanged);
+        connect(m_dataManager, &DataProviderManager::importStarted,
+                this, &LayerManagerWidget::onImportStarted);
+        connect(m_dataManager, &DataProviderManager::importProgress,
+                this, &LayerManagerWidget::onImportProgress);
+        connect(m_dataManager, &DataProviderManager::importFinished,
+                this, &LayerManagerWidget::onImportFinished);
     }
     
     // Tree widget signals
@@ -188,10 +218,16 @@ void LayerManagerWidget::setupConnections()
     // Toolbar buttons
     connect(m_refreshButton, &QPushButton::clicked,
             this, &LayerManagerWidget::refreshProviders);
-    connect(m_importButton, &QPushButton::clicked,
+    connect(m_importButton, &QToolButton::clicked,
+            this, &LayerManagerWidget::importData);
+    connect(m_importFilesAction, &QAction::triggered,
             this, &LayerManagerWidget::importData);
+    connect(m_importFolderAction, &QAction::triggered,
+            this, &LayerManagerWidget::importFolder);
     connect(m_exportButton, &QPushButton::clicked,
             this, &LayerManagerWidget::exportSelectedLayer);
+    connect(m_cancelImportButton, &QPushButton::clicked,
+            this, &LayerManagerWidget::cancelImport);
     
     // Layer controls
     connect(m_visibilityCheck, &QCheckBox::toggled,
@@ -275,15 +311,162 @@ void LayerManagerWidget::importData()
     }
     filter += ");;All Files (*.*)";
     
-    QString filePath = QFileDialog::getOpenFileName(this, "Import Data", "", filter);
-    if (!filePath.isEmpty()) {
-        if (m_dataManager->importData(filePath)) {
-            QMessageBox::information(this, "Import", "Data imported successfully");
-            refreshProviders();
-        } else {
-            QMessageBox::warning(this, "Import Error", "Failed to import data");
+    QStringList filePaths = QFileDialog::getOpenFileNames(this, "Import Data", "", filter);
+    if (filePaths.isEmpty()) {
+        return;
+    }
+    if (filePaths.size() > 1) {
+        startBatchImport(filePaths);
+        return;
+    }
+    QString filePath = filePaths.first();
+    
+    // Load in the background when a provider supports it
+    m_importJob = m_dataManager->importDataAsync(filePath);
+    if (m_importJob) {
+        m_importButton->setEnabled(false);
+        m_importProgress->setValue(0);
+        m_importProgress->setFormat(QString("Importing %1... %p%").arg(QFileInfo(filePath).fileName()));
+        m_cancelImportButton->setEnabled(true);
+        m_importWidget->show();
+        return;
+    }
+    
+    if (m_dataManager->importData(filePath)) {
+        refreshProviders();
+    } else {
+        QMessageBox::warning(this, "Import Error", "Failed to import data");
+    }
+}
+
+// Imports every supported file directly in the chosen folder
+void LayerManagerWidget::importFolder()
+{
+    if (!m_dataManager) return;
+    
+    QString dirPath = QFileDialog::getExistingDirectory(this, "Import Folder");
+    if (dirPath.isEmpty()) {
+        return;
+    }
+    startBatchImport(QStringList() << dirPath);
+}
+
+void LayerManagerWidget::startBatchImport(const QStringList& paths)
+{
+    m_importBatch = m_dataManager->importDataBatch(paths);
+    if (!m_importBatch) {
+        QMessageBox::warning(this, "Import Error", "No supported files to import");
+        return;
+    }
+    connect(m_importBatch, &ImportBatch::progressChanged,
+            this, &LayerManagerWidget::onBatchProgress);
+    connect(m_importBatch, &ImportBatch::finished,
+            this, &LayerManagerWidget::onBatchFinished);
+    
+    m_importButton->setEnabled(false);
+    m_importProgress->setValue(0);
+    m_importProgress->setFormat(QString("Importing %1 files... %p%").arg(m_importBatch->fileCount()));
+    m_cancelImportButton->setEnabled(true);
+    m_importWidget->show();
+}
+
+// Jobs not started from here, such as a lazily imported layer loading once
+// shown, use the progress bar when it is free
+void LayerManagerWidget::onImportStarted(IImportJob* job)
+{
+    if (m_importJob || m_importBatch) {
+        return;
+    }
+    
+    m_importJob = job;
+    m_importButton->setEnabled(false);
+    m_importProgress->setValue(0);
+    m_importProgress->setFormat(QString("Loading %1... %p%").arg(QFileInfo(job->filePath()).fileName()));
+    m_cancelImportButton->setEnabled(true);
+    m_importWidget->show();
+}
+
+void LayerManagerWidget::onImportProgress(IImportJob* job, qint64 bytesProcessed, qint64 totalBytes, qint64 featuresProcessed)
+{
+    if (job != m_importJob) {
+        return;
+    }
+    
+    if (totalBytes > 0) {
+        m_importProgress->setValue(int(qMin<qint64>(1000, bytesProcessed * 1000 / totalBytes)));
+    }
+    m_importProgress->setFormat(QString("Importing %1... %p% (%2 features)")
+                                .arg(QFileInfo(job->filePath()).fileName())
+                                .arg(featuresProcessed));
+}
+
+void LayerManagerWidget::onImportFinished(IImportJob* job, bool success)
+{
+    if (job != m_importJob) {
+        return;
+    }
+    
+    m_importJob = nullptr;
+    m_importWidget->hide();
+    m_importButton->setEnabled(true);
+    
+    if (success) {
+        refreshProviders();
+    } else if (!job->isCancelled()) {
+        QMessageBox::warning(this, "Import Error", QString("Failed to import data\n%1").arg(job->errorString()));
+    }
+}
+
+void LayerManagerWidget::onBatchProgress(qint64 bytesProcessed, qint64 totalBytes, qint64 featuresProcessed)
+{
+    if (!m_importBatch) {
+        return;
+    }
+    
+    if (totalBytes > 0) {
+        m_importProgress->setValue(int(qMin<qint64>(1000, bytesProcessed * 1000 / totalBytes)));
+    }
+    m_importProgress->setFormat(QString("Importing %1 of %2 files... %p% (%3 features)")
+                                .arg(m_importBatch->finishedCount())
+                                .arg(m_importBatch->fileCount())
+                                .arg(featuresProcessed));
+}
+
+void LayerManagerWidget::onBatchFinished(bool success)
+{
+    ImportBatch* batch = m_importBatch;
+    m_importBatch = nullptr;
+    m_importWidget->hide();
+    m_importButton->setEnabled(true);
+    refreshProviders();
+    
+    if (!success && batch && !batch->isCancelled()) {
+        QStringList failed = batch->failedFiles();
+        QStringList names;
+        for (qsizetype i = 0; i < failed.size() && i < 10; ++i) {
+            names.append(QFileInfo(failed[i]).fileName());
+        }
+        if (failed.size() > names.size()) {
+            names.append(QString("and %1 more").arg(failed.size() - names.size()));
         }
+        QMessageBox::warning(this, "Import Error", QString("Failed to import %1 of %2 files\n%3")
+                             .arg(failed.size())
+                             .arg(batch->fileCount())
+                             .arg(names.join("\n")));
+    }
+}
+
+void LayerManagerWidget::cancelImport()
+{
+    if (m_importJob) {
+        m_importJob->cancel();
+    } else if (m_importBatch) {
+        m_importBatch->cancel();
+    } else {
+        return;
     }
+    m_cancelImportButton->setEnabled(false);
+    m_importProgress->setFormat("Cancelling...");
 }
 
 void LayerManagerWidget::exportSelectedLayer()
@@ -18,6 +18,7 @@
 #include "IDataProvider.h"
 
 class DataProviderManager;
+class ImportBatch;
 
 class LayerManagerWidget : public QWidget
 {
@@ -30,6 +31,7 @@ public:
 public slots:
     void refreshProviders();
     void importData();
+    void importFolder();
     void exportSelectedLayer();
     void moveLayerUp();
     void moveLayerDown();
@@ -40,6 +42,12 @@ private slots:
     void onLayerAdded(const QString& providerId, const QString& layerId);
     void onLayerRemoved(const QString& providerId, const QString& layerId);
     void onLayerChanged(const QString& providerId, const QString& layerId);
+    void onImportStarted(IImportJob* job);
+    void onImportProgress(IImportJob* job, qint64 bytesProcessed, qint64 totalBytes, qint64 featuresProcessed);
+    void onImportFinished(IImportJob* job, bool success);
+    void onBatchProgress(qint64 bytesProcessed, qint64 totalBytes, qint64 featuresProcessed);
+    void onBatchFinished(bool success);
+    void cancelImport();
     
     void onItemSelectionChanged();
     void onItemChanged(QTreeWidgetItem* item, int column);
@@ -76,6 +84,7 @@ private:
     
     void setupUI();
     void setupConnections();
+    void startBatchImport(const QStringList& paths);
     void populateProviders();
     void updateLayerProperties(IDataLayer* layer);
     void clearLayerProperties();
@@ -98,11 +107,21 @@ private:
     QHBoxLayout* m_toolbarLayout;
     QTreeWidget* m_dataTree;
     QPushButton* m_refreshButton;
-    QPushButton* m_importButton;
+    QToolButton* m_importButton;
+    QMenu* m_importMenu;
+    QAction* m_importFilesAction;
+    QAction* m_importFolderAction;
     QToolButton* m_exportButton;
     QMenu* m_exportMenu;
     QLabel* m_statusLabel;
     
+    // Import progress
+    QWidget* m_importWidget;
+    QProgressBar* m_importProgress;
+    QPushButton* m_cancelImportButton;
+    IImportJob* m_importJob;
+    ImportBatch* m_importBatch;
+    
     // Layer properties panel
     QWidget* m_propertiesWidget;
     QVBoxLayout* m_propertiesLayout;
@@ -1,9 +1,13 @@
 #include "DataProviderManager.h"
+#include "ImportBatch.h"
 #include <QDebug>
+#include <QDir>
 #include <QFileInfo>
 
 DataProviderManager::DataProviderManager(QObject* parent)
     : QObject(parent)
+    , m_runningBatches(0)
+    , m_layersChangedPending(false)
 {
 }
 
@@ -222,34 +226,110 @@ QStringList DataProviderManager::getSupportedExportFormats() const
     return formats;
 }
 
-bool DataProviderManager::importData(const QString& filePath, const QString& preferredProviderId)
+bool DataProviderManager::importData(const QString& filePath, const QString& preferredProviderId,
+                                     const QVariantMap& options)
+{
+    for (IDataProvider* provider : importProviders(filePath, preferredProviderId)) {
+        if (provider->importData(filePath, options)) {
+            qDebug() << "Data imported successfully by provider:" << provider->providerId();
+            return true;
+        }
+    }
+    
+    qWarning() << "No provider could import file:" << filePath;
+    return false;
+}
+
+IImportJob* DataProviderManager::importDataAsync(const QString& filePath, const QString& preferredProviderId,
+                                                 const QVariantMap& options)
+{
+    for (IDataProvider* provider : importProviders(filePath, preferredProviderId)) {
+        IImportJob* job = provider->importDataAsync(filePath, options);
+        if (!job) {
+            continue;
+        }
+        
+        connectImportJob(job);
+        qDebug() << "Import started by provider:" << provider->providerId();
+        emit importStarted(job);
+        return job;
+    }
+    
+    qWarning() << "No provider could start an import of file:" << filePath;
+    return nullptr;
+}
+
+ImportBatch* DataProviderManager::importDataBatch(const QStringList& paths, const QString& preferredProviderId)
+{
+    QStringList filePaths = expandImportPaths(paths);
+    if (filePaths.isEmpty()) {
+        qWarning() << "No files to import from:" << paths;
+        return nullptr;
+    }
+    
+    ImportBatch* batch = new ImportBatch(this, filePaths, preferredProviderId);
+    ++m_runningBatches;
+    connect(batch, &ImportBatch::finished, this, [this]() {
+        --m_runningBatches;
+        if (m_runningBatches == 0 && m_layersChangedPending) {
+            m_layersChangedPending = false;
+            emit layersChanged();
+        }
+    });
+    
+    qDebug() << "Batch import started:" << filePaths.size() << "files";
+    batch->start();
+    return batch;
+}
+
+QStringList DataProviderManager::expandImportPaths(const QStringList& paths) const
+{
+    QStringList formats = getSupportedImportFormats();
+    QStringList filePaths;
+    for (const QString& path : paths) {
+        QFileInfo fileInfo(path);
+        QString fileName = fileInfo.fileName();
+        if (fileInfo.isDir()) {
+            for (const QFileInfo& entry : QDir(path).entryInfoList(QDir::Files, QDir::Name)) {
+                if (formats.contains(entry.suffix().toLower())) {
+                    filePaths.append(entry.filePath());
+                }
+            }
+        } else if (fileName.contains('*') || fileName.contains('?') || fileName.contains('[')) {
+            for (const QFileInfo& entry : fileInfo.dir().entryInfoList(QStringList() << fileName, QDir::Files, QDir::Name)) {
+                if (formats.contains(entry.suffix().toLower())) {
+                    filePaths.append(entry.filePath());
+                }
+            }
+        } else {
+            filePaths.append(path);
+        }
+    }
+    filePaths.removeDuplicates();
+    return filePaths;
+}
+
+// Preferred provider first, then every provider that can import this type
+QList<IDataProvider*> DataProviderManager::importProviders(const QString& filePath, const QString& preferredProviderId) const
 {
     QFileInfo fileInfo(filePath);
     QString extension = fileInfo.suffix().toLower();
     
-    // Try preferred provider first
+    QList<IDataProvider*> providers;
     if (!preferredProviderId.isEmpty()) {
         IDataProvider* provider = getProvider(preferredProviderId);
         if (provider && provider->canImportData()) {
-            if (provider->importData(filePath)) {
-                qDebug() << "Data imported successfully by provider:" << preferredProviderId;
-                return true;
-            }
+            providers.append(provider);
         }
     }
     
-    // Try all providers that can import this type
     for (IDataProvider* provider : m_providers.values()) {
-        if (provider->canImportData() && provider->supportedTypes().contains(extension)) {
-            if (provider->importData(filePath)) {
-                qDebug() << "Data imported successfully by provider:" << provider->providerId();
-                return true;
-            }
+        if (provider->canImportData() && provider->supportedTypes().contains(extension)
+            && !providers.contains(provider)) {
+            providers.append(provider);
         }
     }
-    
-    qWarning() << "No provider could import file:" << filePath;
-    return false;
+    return providers;
 }
 
 void DataProviderManager::onProviderLayerAdded(const QString& layerId)
@@ -260,7 +340,7 @@ void DataProviderManager::onProviderLayerAdded(const QString& layerId)
         QString globalId = makeGlobalLayerId(providerId, layerId);
         m_layerToProvider[globalId] = providerId;
         emit layerAdded(providerId, layerId);
-        emit layersChanged();
+        notifyLayersChanged();
     }
 }
 
@@ -272,7 +352,7 @@ void DataProviderManager::onProviderLayerRemoved(const QString& layerId)
         QString globalId = makeGlobalLayerId(providerId, layerId);
         m_layerToProvider.remove(globalId);
         emit layerRemoved(providerId, layerId);
-        emit layersChanged();
+        notifyLayersChanged();
     }
 }
 
@@ -282,7 +362,7 @@ void DataProviderManager::onProviderLayerChanged(const QString& layerId)
     if (provider) {
         QString providerId = provider->providerId();
         emit layerChanged(providerId, layerId);
-        emit layersChanged();
+        notifyLayersChanged();
     }
 }
 
@@ -295,6 +375,46 @@ void DataProviderManager::onProviderDataUpdated(const QString& layerId)
     }
 }
 
+void DataProviderManager::onProviderDataAppended(const QString& layerId, qint64 firstFeature, qint64 featureCount)
+{
+    IDataProvider* provider = qobject_cast<IDataProvider*>(sender());
+    if (provider) {
+        emit dataAppended(provider->providerId(), layerId, firstFeature, featureCount);
+    }
+}
+
+void DataProviderManager::onProviderLoadStarted(IImportJob* job)
+{
+    connectImportJob(job);
+    emit importStarted(job);
+}
+
+void DataProviderManager::onImportJobProgress(qint64 bytesProcessed, qint64 totalBytes, qint64 featuresProcessed)
+{
+    IImportJob* job = qobject_cast<IImportJob*>(sender());
+    if (job) {
+        emit importProgress(job, bytesProcessed, totalBytes, featuresProcessed);
+    }
+}
+
+void DataProviderManager::onImportJobFinished(bool success)
+{
+    IImportJob* job = qobject_cast<IImportJob*>(sender());
+    if (job) {
+        emit importFinished(job, success);
+    }
+}
+
+// Provider changes during a batch import are announced once it ends
+void DataProviderManager::notifyLayersChanged()
+{
+    if (m_runningBatches > 0) {
+        m_layersChangedPending = true;
+        return;
+    }
+    emit layersChanged();
+}
+
 QString DataProviderManager::makeGlobalLayerId(const QString& providerId, const QString& layerId) const
 {
     return QString("%1::%2").arg(providerId, layerId);
@@ -321,6 +441,26 @@ void DataProviderManager::connectProvider(IDataProvider* provider)
                 this, SLOT(onProviderLayerChanged(QString)));
         connect(providerObj, SIGNAL(dataUpdated(QString)), 
                 this, SLOT(onProviderDataUpdated(QString)));
+        // Optional: background loads of a layer's data and appends to it
+        if (providerObj->metaObject()->indexOfSignal("loadStarted(IImportJob*)") >= 0) {
+            connect(providerObj, SIGNAL(loadStarted(IImportJob*)),
+                    this, SLOT(onProviderLoadStarted(IImportJob*)));
+        }
+        if (providerObj->metaObject()->indexOfSignal("dataAppended(QString,qint64,qint64)") >= 0) {
+            connect(providerObj, SIGNAL(dataAppended(QString,qint64,qint64)),
+                    this, SLOT(onProviderDataAppended(QString,qint64,qint64)));
+        }
+    }
+}
+
+void DataProviderManager::connectImportJob(IImportJob* job)
+{
+    QObject* jobObj = dynamic_cast<QObject*>(job);
+    if (jobObj) {
+        connect(jobObj, SIGNAL(progressChanged(qint64,qint64,qint64)),
+                this, SLOT(onImportJobProgress(qint64,qint64,qint64)));
+        connect(jobObj, SIGNAL(finished(bool)),
+                this, SLOT(onImportJobFinished(bool)));
     }
 }
 
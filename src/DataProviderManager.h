@@ -5,6 +5,8 @@
 #include <QStringList>
 #include "IDataProvider.h"
 
+class ImportBatch;
+
 class DataProviderManager : public QObject
 {
     Q_OBJECT
@@ -41,8 +43,21 @@ public:
     // Data import/export coordination
     QStringList getSupportedImportFormats() const;
     QStringList getSupportedExportFormats() const;
-    bool importData(const QString& filePath, const QString& preferredProviderId = QString());
-    
+    // Options are passed on to the provider (see IDataProvider::importData)
+    bool importData(const QString& filePath, const QString& preferredProviderId = QString(),
+                    const QVariantMap& options = QVariantMap());
+    IImportJob* importDataAsync(const QString& filePath, const QString& preferredProviderId = QString(),
+                                const QVariantMap& options = QVariantMap());
+    // Imports many files in the background, a bounded number at a time.
+    // Paths may name files, directories or file name wildcards (see
+    // expandImportPaths). layersChanged is held back while batches run and
+    // emitted once when the last one finishes.
+    ImportBatch* importDataBatch(const QStringList& paths, const QString& preferredProviderId = QString());
+    // Directories stand for the importable files directly in them and names
+    // with wildcards (*, ? or [...]) for the importable files they match,
+    // both sorted by name; other paths are kept as they are
+    QStringList expandImportPaths(const QStringList& paths) const;
+
 signals:
     // Provider events
     void providerRegistered(const QString& providerId);
@@ -54,6 +69,15 @@ signals:
     void layerChanged(const QString& providerId, const QString& layerId);
     void layerVisibilityChanged(const QString& layerId, bool visible);
     void dataUpdated(const QString& providerId, const QString& layerId);
+    // Features firstFeature to firstFeature + featureCount - 1 were added
+    // to a layer and the others left as they were; dataUpdated follows
+    void dataAppended(const QString& providerId, const QString& layerId, qint64 firstFeature, qint64 featureCount);
+    
+    // Import events (forwarded from asynchronous import jobs, and from jobs
+    // providers start to load a layer's data in the background)
+    void importStarted(IImportJob* job);
+    void importProgress(IImportJob* job, qint64 bytesProcessed, qint64 totalBytes, qint64 featuresProcessed);
+    void importFinished(IImportJob* job, bool success);
     
     // Global events
     void layersChanged(); // Any layer was added/removed/modified
@@ -63,13 +87,22 @@ private slots:
     void onProviderLayerRemoved(const QString& layerId);
     void onProviderLayerChanged(const QString& layerId);
     void onProviderDataUpdated(const QString& layerId);
+    void onProviderDataAppended(const QString& layerId, qint64 firstFeature, qint64 featureCount);
+    void onProviderLoadStarted(IImportJob* job);
+    void onImportJobProgress(qint64 bytesProcessed, qint64 totalBytes, qint64 featuresProcessed);
+    void onImportJobFinished(bool success);
 
 private:
     QString makeGlobalLayerId(const QString& providerId, const QString& layerId) const;
     QPair<QString, QString> parseGlobalLayerId(const QString& globalLayerId) const;
     void connectProvider(IDataProvider* provider);
     void disconnectProvider(IDataProvider* provider);
+    void connectImportJob(IImportJob* job);
+    QList<IDataProvider*> importProviders(const QString& filePath, const QString& preferredProviderId) const;
+    void notifyLayersChanged();
     
     QMap<QString, IDataProvider*> m_providers;
     QMap<QString, QString> m_layerToProvider; // globalLayerId -> providerId
+    int m_runningBatches;
+    bool m_layersChangedPending; // layersChanged held back for a batch
 };
\ No newline at end of file
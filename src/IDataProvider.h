@@ -35,11 +35,42 @@ public:
     
     // Data access (returns format-specific data)
     virtual QVariant data() const = 0;
+    // Only the data intersecting a {minLat, minLon, maxLat, maxLon} box, for
+    // viewport reads. Layers that cannot filter return all of their data.
+    virtual QVariant dataInExtent(const QVariantMap& boundingBox) const { Q_UNUSED(boundingBox) return data(); }
     virtual QDateTime lastUpdated() const = 0;
 };
 
 Q_DECLARE_INTERFACE(IDataLayer, "com.geoworld.IDataLayer/1.0")
 
+// Handle for an import running in the background. Jobs are owned by their
+// provider and delete themselves after emitting finished(), so a handle
+// must not be used once finished() has been delivered.
+class IImportJob
+{
+public:
+    virtual ~IImportJob() = default;
+    
+    virtual QString filePath() const = 0;
+    virtual qint64 totalBytes() const = 0;
+    virtual qint64 bytesProcessed() const = 0;
+    virtual qint64 featuresProcessed() const = 0;
+    
+    virtual bool isFinished() const = 0;
+    virtual bool isCancelled() const = 0;
+    virtual QString layerId() const = 0; // Set when the import succeeded
+    virtual QString errorString() const = 0;
+    
+    // Requests cancellation; finished(false) follows once the work stops
+    virtual void cancel() = 0;
+    
+signals:
+    virtual void progressChanged(qint64 bytesProcessed, qint64 totalBytes, qint64 featuresProcessed) = 0;
+    virtual void finished(bool success) = 0;
+};
+
+Q_DECLARE_INTERFACE(IImportJob, "com.geoworld.IImportJob/1.0")
+
 class IDataProvider
 {
 public:
@@ -69,6 +100,16 @@ public:
     virtual bool importData(const QString& filePath, const QVariantMap& options = QVariantMap()) = 0;
     virtual bool exportLayer(const QString& layerId, const QString& filePath, const QVariantMap& options = QVariantMap()) = 0;
     
+    // Starts an import off the calling thread and returns immediately.
+    // layerAdded() is emitted when the job finishes successfully. Providers
+    // that only import synchronously return nullptr.
+    virtual IImportJob* importDataAsync(const QString& filePath, const QVariantMap& options = QVariantMap())
+    {
+        Q_UNUSED(filePath)
+        Q_UNUSED(options)
+        return nullptr;
+    }
+    
     // Provider lifecycle
     virtual bool initialize() = 0;
     virtual void shutdown() = 0;
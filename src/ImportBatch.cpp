@@ -0,0 +1,193 @@
+#include "ImportBatch.h"
+#include "DataProviderManager.h"
+#include <QDebug>
+#include <QFileInfo>
+#include <QThread>
+
+namespace {
+
+// Keeps the receiving event loop from drowning in progress updates
+const qint64 ProgressInterval = 100;
+
+// Small files are dominated by opening and per-file setup and run side by
+// side; beyond this many bytes in flight more files only compete for the disk
+const qint64 DefaultBytesInFlight = 256 * 1024 * 1024;
+
+} // namespace
+
+ImportBatch::ImportBatch(DataProviderManager* manager, const QStringList& filePaths, const QString& preferredProviderId)
+    : QObject(manager)
+    , m_manager(manager)
+    , m_filePaths(filePaths)
+    , m_preferredProviderId(preferredProviderId)
+    , m_finishedCount(0)
+    , m_maxConcurrent(qMax(2, QThread::idealThreadCount()))
+    , m_maxBytesInFlight(DefaultBytesInFlight)
+    , m_totalBytes(0)
+    , m_finishedBytes(0)
+    , m_finishedFeatures(0)
+    , m_started(false)
+    , m_cancelled(false)
+    , m_finished(false)
+{
+    for (qsizetype i = 0; i < m_filePaths.size(); ++i) {
+        qint64 size = QFileInfo(m_filePaths[i]).size();
+        m_sizes.append(size);
+        m_totalBytes += size;
+        m_pending.enqueue(int(i));
+    }
+    
+    connect(m_manager, &DataProviderManager::importProgress, this, &ImportBatch::onImportProgress);
+    connect(m_manager, &DataProviderManager::importFinished, this, &ImportBatch::onImportFinished);
+}
+
+// The first imports start from the event loop, so callers can connect to
+// the batch after starting it
+void ImportBatch::start()
+{
+    if (m_started) {
+        return;
+    }
+    m_started = true;
+    m_progressTimer.start();
+    QMetaObject::invokeMethod(this, &ImportBatch::startImports, Qt::QueuedConnection);
+}
+
+// Files not started yet are dropped, running imports are asked to stop
+void ImportBatch::cancel()
+{
+    if (m_finished || m_cancelled) {
+        return;
+    }
+    m_cancelled = true;
+    m_pending.clear();
+    for (IImportJob* job : m_running.keys()) {
+        job->cancel();
+    }
+    if (m_started && m_running.isEmpty()) {
+        startImports();
+    }
+}
+
+void ImportBatch::setMaxConcurrentImports(int count)
+{
+    m_maxConcurrent = qMax(1, count);
+}
+
+void ImportBatch::setMaxBytesInFlight(qint64 bytes)
+{
+    m_maxBytesInFlight = qMax<qint64>(1, bytes);
+}
+
+void ImportBatch::onImportProgress(IImportJob* job, qint64 bytesProcessed, qint64 totalBytes, qint64 featuresProcessed)
+{
+    Q_UNUSED(totalBytes)
+    auto it = m_running.find(job);
+    if (it == m_running.end()) {
+        return;
+    }
+    it->bytes = qMin(bytesProcessed, it->size);
+    it->features = featuresProcessed;
+    reportProgress(false);
+}
+
+void ImportBatch::onImportFinished(IImportJob* job, bool success)
+{
+    auto it = m_running.find(job);
+    if (it == m_running.end()) {
+        return;
+    }
+    qint64 size = it->size;
+    m_running.erase(it);
+    finishImport(job->filePath(), size, success ? job->featuresProcessed() : 0, !success && !job->isCancelled());
+    startImports();
+}
+
+// Starts pending files up to the limits, and ends the batch once nothing is
+// left to run
+void ImportBatch::startImports()
+{
+    if (m_finished) {
+        return;
+    }
+    
+    while (!m_pending.isEmpty()) {
+        int index = m_pending.head();
+        qint64 inFlight = 0;
+        for (const RunningImport& running : m_running) {
+            inFlight += running.size;
+        }
+        if (!m_running.isEmpty()
+            && (m_running.size() >= m_maxConcurrent || inFlight + m_sizes[index] > m_maxBytesInFlight)) {
+            break;
+        }
+        m_pending.dequeue();
+        
+        const QString& filePath = m_filePaths[index];
+        QVariantMap options;
+        options["threads"] = threadBudget(m_sizes[index]);
+        IImportJob* job = m_manager->importDataAsync(filePath, m_preferredProviderId, options);
+        if (job) {
+            m_running.insert(job, {m_sizes[index], 0, 0});
+            continue;
+        }
+        // Providers without background imports load on this thread
+        bool success = m_manager->importData(filePath, m_preferredProviderId, options);
+        finishImport(filePath, m_sizes[index], 0, !success);
+        // Go back to the event loop after each of those, so the UI keeps
+        // painting and cancel() can drop the remaining files
+        if (!m_pending.isEmpty()) {
+            QMetaObject::invokeMethod(this, &ImportBatch::startImports, Qt::QueuedConnection);
+            return;
+        }
+    }
+    
+    if (!m_running.isEmpty()) {
+        return;
+    }
+    m_finished = true;
+    reportProgress(true);
+    qDebug() << "Batch import finished:" << m_finishedCount - m_failedFiles.size() << "of"
+             << m_filePaths.size() << "files imported";
+    emit finished(!m_cancelled && m_failedFiles.isEmpty());
+    deleteLater();
+}
+
+// Files running side by side share the cores, so their readers split the
+// ideal thread count instead of each starting one thread per core. A file
+// over the byte budget runs alone and gets every core.
+int ImportBatch::threadBudget(qint64 size) const
+{
+    qsizetype sideBySide = 1;
+    if (size < m_maxBytesInFlight) {
+        sideBySide = qMin<qsizetype>(m_maxConcurrent, m_running.size() + 1 + m_pending.size());
+    }
+    return qMax(1, QThread::idealThreadCount() / int(sideBySide));
+}
+
+void ImportBatch::finishImport(const QString& filePath, qint64 size, qint64 features, bool failed)
+{
+    ++m_finishedCount;
+    m_finishedBytes += size;
+    m_finishedFeatures += features;
+    if (failed) {
+        m_failedFiles.append(filePath);
+    }
+    reportProgress(false);
+}
+
+void ImportBatch::reportProgress(bool force)
+{
+    if (!force && m_progressTimer.elapsed() < ProgressInterval) {
+        return;
+    }
+    m_progressTimer.restart();
+    
+    qint64 bytes = m_finishedBytes;
+    qint64 features = m_finishedFeatures;
+    for (const RunningImport& running : m_running) {
+        bytes += running.bytes;
+        features += running.features;
+    }
+    emit progressChanged(bytes, m_totalBytes, features);
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QObject>
+#include <QQueue>
+#include <QStringList>
+#include "IDataProvider.h"
+
+class DataProviderManager;
+
+// Imports a list of files through DataProviderManager, a bounded number at
+// a time. Files start in the order given while fewer than maxConcurrentImports
+// jobs run and the running files add up to less than maxBytesInFlight; a file
+// larger than that budget runs alone, since its reader already uses every
+// core and is bound by reading the disk. Each file's reader gets its share
+// of the cores through the "threads" import option. Progress is the sum over
+// all files.
+// Batches are owned by the manager and delete themselves after emitting
+// finished().
+class ImportBatch : public QObject
+{
+    Q_OBJECT
+
+public:
+    ImportBatch(DataProviderManager* manager, const QStringList& filePaths, const QString& preferredProviderId);
+    
+    void start();
+    void cancel();
+    
+    QStringList filePaths() const { return m_filePaths; }
+    int fileCount() const { return int(m_filePaths.size()); }
+    int finishedCount() const { return m_finishedCount; }
+    // Files that could not be imported, in the order they finished; files
+    // whose import was cancelled are not listed
+    QStringList failedFiles() const { return m_failedFiles; }
+    qint64 totalBytes() const { return m_totalBytes; }
+    bool isCancelled() const { return m_cancelled; }
+    
+    int maxConcurrentImports() const { return m_maxConcurrent; }
+    void setMaxConcurrentImports(int count);
+    qint64 maxBytesInFlight() const { return m_maxBytesInFlight; }
+    void setMaxBytesInFlight(qint64 bytes);
+
+signals:
+    void progressChanged(qint64 bytesProcessed, qint64 totalBytes, qint64 featuresProcessed);
+    // Emitted once every file has been imported, has failed or was cancelled;
+    // success means every file was imported
+    void finished(bool success);
+
+private slots:
+    void onImportProgress(IImportJob* job, qint64 bytesProcessed, qint64 totalBytes, qint64 featuresProcessed);
+    void onImportFinished(IImportJob* job, bool success);
+
+private:
+    struct RunningImport {
+        qint64 size;
+        qint64 bytes;
+        qint64 features;
+    };
+    
+    void startImports();
+    int threadBudget(qint64 size) const;
+    void finishImport(const QString& filePath, qint64 size, qint64 features, bool failed);
+    void reportProgress(bool force);
+    
+    DataProviderManager* m_manager;
+    QStringList m_filePaths;
+    QString m_preferredProviderId;
+    QQueue<int> m_pending;
+    QList<qint64> m_sizes;
+    QHash<IImportJob*, RunningImport> m_running;
+    QStringList m_failedFiles;
+    int m_finishedCount;
+    int m_maxConcurrent;
+    qint64 m_maxBytesInFlight;
+    qint64 m_totalBytes;
+    qint64 m_finishedBytes;
+    qint64 m_finishedFeatures;
+    bool m_started;
+    bool m_cancelled;
+    bool m_finished;
+    QElapsedTimer m_progressTimer;
+};
@@ -247,9 +247,22 @@ void MainWindow::registerDataProviders()
     for (const QString& pluginName : plugins) {
         IPlugin* plugin = m_pluginManager->getPlugin(pluginName);
         if (plugin && plugin->capabilities().contains("data-provider")) {
-            // Try to get data provider from plugin (this would need to be extended in actual plugins)
             qDebug() << "Found data provider plugin:" << pluginName;
-            // TODO: Extract IDataProvider from plugin and register with m_dataProviderManager
+            
+            // Provider plugins hand out their provider through an invokable
+            // dataProvider() method
+            QObject* pluginObj = dynamic_cast<QObject*>(plugin);
+            QObject* providerObj = nullptr;
+            if (!pluginObj || !QMetaObject::invokeMethod(pluginObj, "dataProvider",
+                                                         Q_RETURN_ARG(QObject*, providerObj))) {
+                qWarning() << "Data provider plugin has no dataProvider() method:" << pluginName;
+                continue;
+            }
+            
+            IDataProvider* provider = qobject_cast<IDataProvider*>(providerObj);
+            if (provider) {
+                m_dataProviderManager->registerProvider(provider);
+            }
         }
     }
 }
@@ -0,0 +1,355 @@
+#include "DataProviderManager.h"
+#include "ImportBatch.h"
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QObject>
+#include <QPointer>
+#include <QSignalSpy>
+#include <QTemporaryDir>
+#include <QTest>
+#include <QTimer>
+#include <memory>
+
+namespace {
+
+bool touchFile(const QString& path)
+{
+    QFile file(path);
+    return file.open(QIODevice::WriteOnly) && file.write("data\n") == 5;
+}
+
+} // namespace
+
+// Import job finished by its provider or by cancel()
+class FakeImportJob : public QObject, public IImportJob
+{
+    Q_OBJECT
+    Q_INTERFACES(IImportJob)
+
+public:
+    FakeImportJob(const QString& filePath, QObject* parent)
+        : QObject(parent)
+        , m_filePath(filePath)
+        , m_finished(false)
+        , m_cancelled(false)
+        , m_succeeded(false)
+    {
+    }
+    
+    QString filePath() const override { return m_filePath; }
+    qint64 totalBytes() const override { return 5; }
+    qint64 bytesProcessed() const override { return m_finished ? 5 : 0; }
+    qint64 featuresProcessed() const override { return m_succeeded ? 1 : 0; }
+    bool isFinished() const override { return m_finished; }
+    bool isCancelled() const override { return m_cancelled; }
+    QString layerId() const override { return m_succeeded ? m_filePath : QString(); }
+    QString errorString() const override { return m_succeeded ? QString() : QString("Import failed"); }
+    
+    void cancel() override
+    {
+        m_cancelled = true;
+        QTimer::singleShot(0, this, [this]() { finish(false); });
+    }
+    
+    void finish(bool success)
+    {
+        if (m_finished) {
+            return;
+        }
+        m_finished = true;
+        m_succeeded = success;
+        emit finished(success);
+        deleteLater();
+    }
+
+signals:
+    void progressChanged(qint64 bytesProcessed, qint64 totalBytes, qint64 featuresProcessed) override;
+    void finished(bool success) override;
+
+private:
+    QString m_filePath;
+    bool m_finished;
+    bool m_cancelled;
+    bool m_succeeded;
+};
+
+// Provider of csv, kml and gz files whose imports add a layer named by the
+// file, unless the file name contains "bad". Background imports finish on
+// their own after a few milliseconds unless holdJobs is set.
+class FakeProvider : public QObject, public IDataProvider
+{
+    Q_OBJECT
+    Q_INTERFACES(IDataProvider)
+
+public:
+    bool asyncImports = true;
+    bool holdJobs = false;
+    int startedImports = 0;
+    int runningImports = 0;
+    int maxRunningImports = 0;
+    QList<int> threadOptions;
+    
+    QString providerId() const override { return "fake"; }
+    QString name() const override { return "Fake"; }
+    QString description() const override { return QString(); }
+    QIcon icon() const override { return QIcon(); }
+    QStringList supportedTypes() const override { return {"csv", "kml", "gz"}; }
+    
+    bool canCreateLayers() const override { return false; }
+    bool canImportData() const override { return true; }
+    bool canExportData() const override { return false; }
+    bool isRealTime() const override { return false; }
+    
+    QStringList layerIds() const override { return m_layerIds; }
+    IDataLayer* getLayer(const QString&) const override { return nullptr; }
+    QList<IDataLayer*> getAllLayers() const override { return {}; }
+    
+    bool createLayer(const QString&, const QString&, const QVariantMap&) override { return false; }
+    bool removeLayer(const QString&) override { return false; }
+    bool exportLayer(const QString&, const QString&, const QVariantMap&) override { return false; }
+    
+    bool importData(const QString& filePath, const QVariantMap& options) override
+    {
+        ++startedImports;
+        threadOptions.append(options.value("threads").toInt());
+        return addLayer(filePath);
+    }
+    
+    IImportJob* importDataAsync(const QString& filePath, const QVariantMap& options) override
+    {
+        if (!asyncImports) {
+            return nullptr;
+        }
+        ++startedImports;
+        threadOptions.append(options.value("threads").toInt());
+        maxRunningImports = qMax(maxRunningImports, ++runningImports);
+        
+        auto* job = new FakeImportJob(filePath, this);
+        connect(job, &FakeImportJob::finished, this, [this]() { --runningImports; });
+        if (!holdJobs) {
+            QTimer::singleShot(5, job, [this, job, filePath]() { job->finish(addLayer(filePath)); });
+        }
+        return job;
+    }
+    
+    bool initialize() override { return true; }
+    void shutdown() override {}
+    
+    void changeLayer(const QString& layerId) { emit layerChanged(layerId); }
+
+signals:
+    void layerAdded(const QString& layerId) override;
+    void layerRemoved(const QString& layerId) override;
+    void layerChanged(const QString& layerId) override;
+    void dataUpdated(const QString& layerId) override;
+
+private:
+    bool addLayer(const QString& filePath)
+    {
+        QString layerId = QFileInfo(filePath).fileName();
+        if (layerId.contains("bad")) {
+            return false;
+        }
+        m_layerIds.append(layerId);
+        emit layerAdded(layerId);
+        return true;
+    }
+    
+    QStringList m_layerIds;
+};
+
+class TestImportBatch : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+    void cleanup();
+    void expandsDirectoriesAndWildcards();
+    void importsWithinConcurrencyLimit();
+    void coalescesLayersChanged();
+    void reportsFailedFiles();
+    void cancelsPendingFiles();
+
+private:
+    // Starts a batch of the paths and waits for it to finish
+    bool runBatch(const QStringList& paths, int maxConcurrent, bool& success, QStringList& failedFiles);
+    QString filePath(const QString& name) const { return m_directory->filePath(name); }
+    QStringList createFiles(const QStringList& names) const;
+    
+    std::unique_ptr<QTemporaryDir> m_directory;
+    std::unique_ptr<DataProviderManager> m_manager;
+    FakeProvider* m_provider = nullptr;
+};
+
+void TestImportBatch::init()
+{
+    m_directory = std::make_unique<QTemporaryDir>();
+    QVERIFY(m_directory->isValid());
+    m_manager = std::make_unique<DataProviderManager>();
+    m_provider = new FakeProvider;
+    m_provider->setParent(m_manager.get());
+    QVERIFY(m_manager->registerProvider(m_provider));
+}
+
+void TestImportBatch::cleanup()
+{
+    m_manager.reset();
+    m_provider = nullptr;
+    m_directory.reset();
+}
+
+QStringList TestImportBatch::createFiles(const QStringList& names) const
+{
+    QStringList paths;
+    for (const QString& name : names) {
+        if (touchFile(filePath(name))) {
+            paths.append(filePath(name));
+        }
+    }
+    return paths;
+}
+
+bool TestImportBatch::runBatch(const QStringList& paths, int maxConcurrent, bool& success, QStringList& failedFiles)
+{
+    ImportBatch* batch = m_manager->importDataBatch(paths);
+    if (!batch) {
+        return false;
+    }
+    batch->setMaxConcurrentImports(maxConcurrent);
+    bool finished = false;
+    connect(batch, &ImportBatch::finished, this, [&, batch](bool ok) {
+        finished = true;
+        success = ok;
+        failedFiles = batch->failedFiles();
+    });
+    return QTest::qWaitFor([&finished]() { return finished; }, 10000);
+}
+
+void TestImportBatch::expandsDirectoriesAndWildcards()
+{
+    // Compressed files are matched by their last suffix, and files of other
+    // types and subdirectories are left out
+    createFiles({"b.csv", "roads.csv.gz", "parks.kml", "readme.txt", "notes"});
+    QVERIFY(QDir(m_directory->path()).mkdir("sub.csv"));
+    QVERIFY(touchFile(filePath("sub.csv/inner.csv")));
+    
+    QStringList all = {filePath("b.csv"), filePath("parks.kml"), filePath("roads.csv.gz")};
+    QCOMPARE(m_manager->expandImportPaths({m_directory->path()}), all);
+    QCOMPARE(m_manager->expandImportPaths({filePath("r*")}), QStringList({filePath("roads.csv.gz")}));
+    QCOMPARE(m_manager->expandImportPaths({filePath("*.gz")}), QStringList({filePath("roads.csv.gz")}));
+    QCOMPARE(m_manager->expandImportPaths({filePath("[bp]*")}), QStringList({filePath("b.csv"), filePath("parks.kml")}));
+    
+    // Plain paths are kept even when missing or of another type, and
+    // duplicates are dropped
+    QString missing = filePath("missing.csv");
+    QStringList mixed = {filePath("parks.kml"), m_directory->path(), filePath("readme.txt"), missing};
+    QStringList expected = {filePath("parks.kml"), filePath("b.csv"), filePath("roads.csv.gz"), filePath("readme.txt"), missing};
+    QCOMPARE(m_manager->expandImportPaths(mixed), expected);
+    
+    QVERIFY(m_manager->expandImportPaths({filePath("*.txt")}).isEmpty());
+    QVERIFY(!m_manager->importDataBatch({filePath("*.txt")}));
+}
+
+void TestImportBatch::importsWithinConcurrencyLimit()
+{
+    QStringList paths = createFiles({"a.csv", "b.csv", "c.csv", "d.kml", "e.csv.gz", "f.csv"});
+    bool success = false;
+    QStringList failedFiles;
+    QVERIFY(runBatch(paths, 2, success, failedFiles));
+    QVERIFY(success);
+    QVERIFY(failedFiles.isEmpty());
+    QCOMPARE(m_provider->startedImports, 6);
+    QCOMPARE(m_provider->maxRunningImports, 2);
+    QCOMPARE(m_provider->layerIds(), QStringList({"a.csv", "b.csv", "c.csv", "d.kml", "e.csv.gz", "f.csv"}));
+    for (int threads : m_provider->threadOptions) {
+        QVERIFY(threads >= 1);
+    }
+}
+
+void TestImportBatch::coalescesLayersChanged()
+{
+    QSignalSpy layersChanged(m_manager.get(), &DataProviderManager::layersChanged);
+    QSignalSpy layerAdded(m_manager.get(), &DataProviderManager::layerAdded);
+    
+    // Outside a batch every change is announced
+    m_provider->changeLayer("existing");
+    QCOMPARE(layersChanged.count(), 1);
+    
+    // Layers added by two overlapping batches, by background and
+    // synchronous imports, are announced once the last batch ends
+    QStringList first = createFiles({"a.csv", "b.csv", "c.csv"});
+    QStringList second = createFiles({"d.csv", "e.csv"});
+    ImportBatch* firstBatch = m_manager->importDataBatch(first);
+    QVERIFY(firstBatch);
+    bool firstFinished = false;
+    connect(firstBatch, &ImportBatch::finished, this, [&firstFinished]() { firstFinished = true; });
+    bool success = false;
+    QStringList failedFiles;
+    QVERIFY(runBatch(second, 1, success, failedFiles));
+    QVERIFY(QTest::qWaitFor([&firstFinished]() { return firstFinished; }, 10000));
+    QCOMPARE(layerAdded.count(), 5);
+    QCOMPARE(layersChanged.count(), 2);
+    
+    m_provider->asyncImports = false;
+    QVERIFY(runBatch(createFiles({"f.csv", "g.csv"}), 2, success, failedFiles));
+    QCOMPARE(layerAdded.count(), 7);
+    QCOMPARE(layersChanged.count(), 3);
+}
+
+void TestImportBatch::reportsFailedFiles()
+{
+    // Background and synchronous imports alike
+    for (bool async : {true, false}) {
+        m_provider->asyncImports = async;
+        QStringList paths = createFiles({"a.csv", "bad.csv", "c.csv", "worse-bad.kml"});
+        QSignalSpy layersChanged(m_manager.get(), &DataProviderManager::layersChanged);
+        bool success = true;
+        QStringList failedFiles;
+        QVERIFY(runBatch(paths, 2, success, failedFiles));
+        QVERIFY(!success);
+        failedFiles.sort();
+        QCOMPARE(failedFiles, QStringList({filePath("bad.csv"), filePath("worse-bad.kml")}));
+        QCOMPARE(layersChanged.count(), 1);
+    }
+}
+
+void TestImportBatch::cancelsPendingFiles()
+{
+    m_provider->holdJobs = true;
+    QStringList paths = createFiles({"a.csv", "b.csv", "c.csv", "d.csv", "e.csv"});
+    QSignalSpy layersChanged(m_manager.get(), &DataProviderManager::layersChanged);
+    QPointer<ImportBatch> batch = m_manager->importDataBatch(paths);
+    QVERIFY(batch);
+    batch->setMaxConcurrentImports(2);
+    bool finished = false;
+    bool success = true;
+    int finishedCount = -1;
+    QStringList failedFiles = {"unset"};
+    connect(batch.data(), &ImportBatch::finished, this, [&](bool ok) {
+        finished = true;
+        success = ok;
+        finishedCount = batch->finishedCount();
+        failedFiles = batch->failedFiles();
+    });
+    QVERIFY(QTest::qWaitFor([this]() { return m_provider->startedImports == 2; }, 10000));
+    
+    // The running imports are stopped and the pending ones never start;
+    // cancelled files are not failures
+    batch->cancel();
+    QVERIFY(batch->isCancelled());
+    QVERIFY(QTest::qWaitFor([&finished]() { return finished; }, 10000));
+    QVERIFY(!success);
+    QCOMPARE(finishedCount, 2);
+    QVERIFY(failedFiles.isEmpty());
+    QCOMPARE(m_provider->startedImports, 2);
+    QCOMPARE(m_provider->runningImports, 0);
+    QCOMPARE(layersChanged.count(), 0);
+    
+    // The batch deletes itself
+    QVERIFY(QTest::qWaitFor([&batch]() { return batch.isNull(); }, 10000));
+}
+
+QTEST_GUILESS_MAIN(TestImportBatch)
+#include "tst_importbatch.moc"